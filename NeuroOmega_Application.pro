@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui charts network
+QT       += core gui charts network sql
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -35,6 +35,32 @@ SOURCES += main.cpp\
     recordingannotation.cpp \
     manuallabelentry.cpp \
     novelstimulationconfiguration.cpp \
+    filtergraph.cpp \
+    workerthread.cpp \
+    rereferencemontage.cpp \
+    latencyhistogram.cpp \
+    closedloopcontroller.cpp \
+    merprofilebuilder.cpp \
+    contactqualityestimator.cpp \
+    sdkinstrumentation.cpp \
+    sdkdiagnosticsdialog.cpp \
+    eventloopprofiler.cpp \
+    devicestatemachine.cpp \
+    channelcatalog.cpp \
+    channelconfigurationengine.cpp \
+    channeltablemodel.cpp \
+    traceviewer.cpp \
+    contactselectionmodel.cpp \
+    electrodegridwidget.cpp \
+    streamingstft.cpp \
+    spectrogramview.cpp \
+    interfaceconfiguration.cpp \
+    startupwarmup.cpp \
+    sessioncatalog.cpp \
+    shadowrecordingwriter.cpp \
+    clocksynchronizer.cpp \
+    labeldispatcher.cpp \
+    protocolcompiler.cpp \
     streamdatahandler.cpp
     NeuroOmega_SDK/Include/AOSystemAPI_TEST.cpp \
 
@@ -52,6 +78,32 @@ HEADERS  += mainwindow.h \
     NeuroOmega_SDK/Include/AOSystemAPI_TEST.h \
     NeuroOmega_SDK/Include/AOTypes.h \
     NeuroOmega_SDK/Include/StreamFormat.h \
+    filtergraph.h \
+    workerthread.h \
+    rereferencemontage.h \
+    latencyhistogram.h \
+    closedloopcontroller.h \
+    merprofilebuilder.h \
+    contactqualityestimator.h \
+    sdkinstrumentation.h \
+    sdkdiagnosticsdialog.h \
+    eventloopprofiler.h \
+    devicestatemachine.h \
+    channelcatalog.h \
+    channelconfigurationengine.h \
+    channeltablemodel.h \
+    traceviewer.h \
+    contactselectionmodel.h \
+    electrodegridwidget.h \
+    streamingstft.h \
+    spectrogramview.h \
+    interfaceconfiguration.h \
+    startupwarmup.h \
+    sessioncatalog.h \
+    shadowrecordingwriter.h \
+    clocksynchronizer.h \
+    labeldispatcher.h \
+    protocolcompiler.h \
     streamdatahandler.h
 
 FORMS    += mainwindow.ui \
@@ -62,14 +114,29 @@ FORMS    += mainwindow.ui \
     detailchannelslist.ui \
     recordingannotation.ui \
     manuallabelentry.ui \
-    novelstimulationconfiguration.ui
+    novelstimulationconfiguration.ui \
+    sdkdiagnosticsdialog.ui
 
 RC_ICONS = $$PWD/resources/logo_icon.ico
 
-win32: LIBS += -L$$PWD/NeuroOmega_SDK/ -lNeuroOmega_x64
+win32:!simulator: LIBS += -L$$PWD/NeuroOmega_SDK/ -lNeuroOmega_x64
 
 INCLUDEPATH += $$PWD/NeuroOmega_SDK/Include
 DEPENDPATH += $$PWD/NeuroOmega_SDK
 
 DISTFILES += \
-    InterfaceConfigurations.json
+    InterfaceConfigurations.json \
+    FilterGraphs.json \
+    ClosedLoopConfiguration.json
+
+# Hardware-free build (qmake CONFIG+=simulator): the SDK test stub is replaced by a simulated NeuroOmega
+# with synthetic 44 kHz data, stimulation artifacts and configurable per-call latency and failures.
+simulator {
+    SOURCES -= NeuroOmega_SDK/Include/AOSystemAPI_TEST.cpp
+    SOURCES += NeuroOmega_Simulator/neuroomegasimulator.cpp
+    HEADERS += NeuroOmega_Simulator/neuroomegasimulator.h
+    DEFINES += NEUROOMEGA_SIMULATOR
+    INCLUDEPATH += $$PWD/NeuroOmega_Simulator
+    !win32: INCLUDEPATH += $$PWD/NeuroOmega_Simulator/compat
+    DISTFILES += NeuroOmega_Simulator/SimulatorConfiguration.json
+}
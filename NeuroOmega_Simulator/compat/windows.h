@@ -0,0 +1,13 @@
+// Minimal stand-in for the Win32 calls used by the application, for simulator builds on Linux/macOS.
+#ifndef SIMULATOR_WINDOWS_H
+#define SIMULATOR_WINDOWS_H
+
+#include <thread>
+#include <chrono>
+
+inline void Sleep(unsigned long milliseconds)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+#endif // SIMULATOR_WINDOWS_H
@@ -0,0 +1,680 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#include "neuroomegasimulator.h"
+
+#include <thread>
+#include <cmath>
+#include <cstring>
+
+static qint64 simulatorNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+NeuroOmegaSimulator::NeuroOmegaSimulator()
+{
+    // NEUROOMEGA_SIMULATOR_CONFIGURATION overrides the configuration next to the executable, for scripted soak tests.
+    QString filename = qEnvironmentVariable("NEUROOMEGA_SIMULATOR_CONFIGURATION", QDir::currentPath() + "/SimulatorConfiguration.json");
+    if (!loadConfiguration(filename)) createChannels(QJsonObject());
+}
+
+NeuroOmegaSimulator *NeuroOmegaSimulator::instance()
+{
+    static NeuroOmegaSimulator simulator;
+    return &simulator;
+}
+
+bool NeuroOmegaSimulator::loadConfiguration(QString filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QJsonDocument loadedDocument = QJsonDocument::fromJson(file.readAll());
+    if (!loadedDocument.isObject()) return false;
+    QJsonObject configuration = loadedDocument.object();
+
+    seed = configuration.value("Seed").toInt(seed);
+    disconnectAfter = configuration.value("DisconnectAfter").toDouble(disconnectAfter);
+    callGenerator.seed(seed);
+
+    QJsonObject callConfiguration = configuration.value("Calls").toObject();
+    QStringList functionNames = callConfiguration.keys();
+    for (int i = 0; i < functionNames.size(); i++)
+    {
+        QJsonObject callObject = callConfiguration[functionNames[i]].toObject();
+        SimulatedCall call;
+        call.latency = callObject.value("Latency").toDouble(0);
+        call.jitter = callObject.value("Jitter").toDouble(0);
+        call.failureRate = callObject.value("FailureRate").toDouble(0);
+        if (functionNames[i] == "Default") defaultCall = call;
+        else calls.insert(functionNames[i], call);
+    }
+
+    QJsonObject signalConfiguration = configuration.value("Signal").toObject();
+    noiseLevel = signalConfiguration.value("Noise").toDouble(noiseLevel);
+    lfpLevel = signalConfiguration.value("LFP").toDouble(lfpLevel);
+    betaLevel = signalConfiguration.value("Beta").toDouble(betaLevel);
+    lineNoiseLevel = signalConfiguration.value("LineNoise").toDouble(lineNoiseLevel);
+    lineFrequency = signalConfiguration.value("LineFrequency").toDouble(lineFrequency);
+    spikeAmplitude = signalConfiguration.value("SpikeAmplitude").toDouble(spikeAmplitude);
+    backgroundSpikeRate = signalConfiguration.value("BackgroundSpikeRate").toDouble(backgroundSpikeRate);
+    targetSpikeRate = signalConfiguration.value("TargetSpikeRate").toDouble(targetSpikeRate);
+    artifactGain = signalConfiguration.value("ArtifactGain").toDouble(artifactGain);
+
+    QJsonObject driveConfiguration = configuration.value("Drive").toObject();
+    startDepth = driveConfiguration.value("StartDepth").toInt(startDepth);
+    endDepth = driveConfiguration.value("EndDepth").toInt(endDepth);
+    stepSize = qMax(1, driveConfiguration.value("StepSize").toInt(stepSize));
+    stepInterval = qMax(0.1, driveConfiguration.value("StepInterval").toDouble(stepInterval));
+    moveDuration = qBound(0.0, driveConfiguration.value("MoveDuration").toDouble(moveDuration), stepInterval);
+    targetStart = driveConfiguration.value("TargetStart").toInt(targetStart);
+    targetEnd = driveConfiguration.value("TargetEnd").toInt(targetEnd);
+
+    createChannels(configuration);
+    return true;
+}
+
+// Default layout: 5 microelectrodes (10000-10004), 5 macroelectrodes (10005-10009) and 4 ECoG HF boxes (10272-10335).
+// "Faults" marks channels as "Flat", "Saturated" or "Noisy" to exercise the quality estimator.
+void NeuroOmegaSimulator::createChannels(QJsonObject configuration)
+{
+    channels.clear();
+    channelOrder.clear();
+
+    QJsonObject faults = configuration.value("Faults").toObject();
+    for (int i = 0; i < 5 + 5 + 64; i++)
+    {
+        SimulatedChannel channel;
+        if (i < 5)
+        {
+            channel.channelID = 10000 + i;
+            channel.channelName = QString("SPK %1").arg(i + 1, 2, 10, QLatin1Char('0'));
+            channel.type = "Micro";
+        }
+        else if (i < 10)
+        {
+            channel.channelID = 10005 + i - 5;
+            channel.channelName = QString("MACRO %1").arg(i - 4, 2, 10, QLatin1Char('0'));
+            channel.type = "Macro";
+        }
+        else
+        {
+            int boxID = (i - 10) / 16;
+            int channelID = (i - 10) % 16;
+            channel.channelID = 10272 + i - 10;
+            channel.channelName = "ECOG HF " + QString::number(boxID+1) + " / " + QStringLiteral("%1").arg(channelID+1, 2, 10, QLatin1Char('0')) + " - Array " + QString::number(boxID+1) + " / " + QStringLiteral("%1").arg(channelID+1, 2, 10, QLatin1Char('0'));
+            channel.type = "ECoG";
+        }
+        channel.fault = faults.value(QString::number(channel.channelID)).toString("");
+        channel.generator.seed(seed * 100003 + channel.channelID);
+        channels.insert(channel.channelID, channel);
+        channelOrder.append(channel.channelID);
+    }
+}
+
+// Every SDK entry point starts here: apply the configured latency, then decide whether the call fails.
+int NeuroOmegaSimulator::beginCall(const char *function)
+{
+    callMutex.lock();
+    QString functionName(function);
+    if (!calls.contains(functionName)) calls.insert(functionName, defaultCall);
+    SimulatedCall &call = calls[functionName];
+
+    std::normal_distribution<double> gaussian(0, 1);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    double latency = qMax(0.0, call.latency + call.jitter * gaussian(callGenerator));
+    bool failed = call.failureRate > 0 && uniform(callGenerator) < call.failureRate;
+    call.calls++;
+    call.totalLatency += latency;
+    if (failed) call.failures++;
+    callMutex.unlock();
+
+    if (latency > 0) std::this_thread::sleep_for(std::chrono::microseconds((qint64)(latency * 1000)));
+
+    if (disconnectAfter > 0)
+    {
+        QMutexLocker locker(&stateMutex);
+        if (connected && (simulatorNanoseconds() - connectionStart) / 1e9 > disconnectAfter) connected = false;
+    }
+
+    if (failed)
+    {
+        setError(QString("Simulated failure in %1").arg(functionName));
+        return eAO_BAD_ARG;
+    }
+    return eAO_OK;
+}
+
+void NeuroOmegaSimulator::setError(QString message)
+{
+    QMutexLocker locker(&errorMutex);
+    errors.append(message);
+}
+
+QString NeuroOmegaSimulator::takeError(int *errorCount)
+{
+    QMutexLocker locker(&errorMutex);
+    *errorCount = errors.size();
+    QString message = errors.join("\n");
+    errors.clear();
+    return message;
+}
+
+// Sample clock of the simulated system, 44 kHz since DefaultStartConnection.
+qint64 NeuroOmegaSimulator::currentSample()
+{
+    if (!connected) return 0;
+    return (simulatorNanoseconds() - connectionStart) * SIMULATOR_SAMPLING_RATE / 1000000000;
+}
+
+// The drive descends by StepSize every StepInterval, moving for MoveDuration at the start of each step.
+int NeuroOmegaSimulator::driveDepth(qint64 sample, bool *moving)
+{
+    double time = (double)sample / SIMULATOR_SAMPLING_RATE;
+    int step = (int)floor(time / stepInterval);
+    int maxSteps = qMax(0, (endDepth - startDepth) / stepSize);
+    *moving = false;
+    if (step >= maxSteps) return startDepth + maxSteps * stepSize;
+
+    double depth = startDepth + step * stepSize;
+    double withinStep = time - step * stepInterval;
+    if (step > 0 && withinStep < moveDuration)
+    {
+        depth -= stepSize * (1 - withinStep / moveDuration);
+        *moving = true;
+    }
+    return (int)depth;
+}
+
+void NeuroOmegaSimulator::motorTimestamps(qint64 sample, qint64 *moveSample, qint64 *stopSample)
+{
+    int maxSteps = qMax(0, (endDepth - startDepth) / stepSize);
+    int step = qMin(maxSteps, (int)floor((double)sample / SIMULATOR_SAMPLING_RATE / stepInterval));
+    *moveSample = (qint64)(step * stepInterval * SIMULATOR_SAMPLING_RATE);
+    *stopSample = *moveSample + (qint64)(moveDuration * SIMULATOR_SAMPLING_RATE);
+    if (*stopSample > sample) *stopSample = 0;
+}
+
+bool NeuroOmegaSimulator::inTarget(int depth) const
+{
+    return depth >= targetStart && depth <= targetEnd;
+}
+
+// Pulses of every active stimulation channel appear on all inputs, strongest on the stimulated contact.
+double NeuroOmegaSimulator::stimulationArtifact(const SimulatedChannel &channel, qint64 sample)
+{
+    double artifact = 0;
+    for (QHash<int, SimulatedStimulation>::const_iterator it = stimulation.constBegin(); it != stimulation.constEnd(); ++it)
+    {
+        const SimulatedStimulation &pulse = it.value();
+        if (pulse.startSample < 0 || sample < pulse.startSample) continue;
+        if (pulse.stopSample >= 0 && sample >= pulse.stopSample) continue;
+
+        double coupling = (it.key() == channel.channelID) ? 1.0 : 0.2;
+        qint64 elapsed = sample - pulse.startSample;
+        if (pulse.waveID >= 0 && pulse.waveID < embeddedWaves.size() && !embeddedWaves[pulse.waveID].isEmpty())
+        {
+            const QVector<int16> &wave = embeddedWaves[pulse.waveID];
+            artifact += coupling * wave[elapsed % wave.size()] * 0.05;
+            continue;
+        }
+        if (pulse.frequency <= 0) continue;
+
+        qint64 position = elapsed % qMax((qint64)1, (qint64)(SIMULATOR_SAMPLING_RATE / pulse.frequency));
+        qint64 firstPhase = (qint64)(pulse.pulsewidth1 * SIMULATOR_SAMPLING_RATE / 1000);
+        qint64 secondPhase = (qint64)(pulse.pulsewidth2 * SIMULATOR_SAMPLING_RATE / 1000);
+        if (position < firstPhase) artifact += coupling * artifactGain * pulse.amplitude1;
+        else if (position < firstPhase + secondPhase) artifact += coupling * artifactGain * pulse.amplitude2;
+    }
+    return artifact;
+}
+
+int16 NeuroOmegaSimulator::sampleAt(const SimulatedChannel &channel, qint64 sample) const
+{
+    return channel.ring[sample % channel.bufferSamples];
+}
+
+// Extend the channel's ring up to untilSample. If the reader fell further behind than the ring, the gap is skipped.
+void NeuroOmegaSimulator::generate(SimulatedChannel &channel, qint64 untilSample)
+{
+    if (channel.bufferSamples <= 0 || untilSample <= channel.generatedSamples) return;
+    if (untilSample - channel.generatedSamples > channel.bufferSamples) channel.generatedSamples = untilSample - channel.bufferSamples;
+
+    bool moving = false;
+    bool target = inTarget(driveDepth(untilSample, &moving));
+    double spikeRate = (channel.type == "Micro") ? (target ? targetSpikeRate : backgroundSpikeRate) : 0;
+    double beta = (target || channel.type == "ECoG") ? betaLevel : betaLevel * 0.1;
+    double line = (channel.fault == "Noisy") ? lineNoiseLevel * 20 : lineNoiseLevel;
+
+    std::normal_distribution<double> gaussian(0, 1);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    for (qint64 n = channel.generatedSamples; n < untilSample; n++)
+    {
+        double value = 0;
+        if (channel.fault != "Flat")
+        {
+            double time = (double)n / SIMULATOR_SAMPLING_RATE;
+            channel.pinkState = 0.999 * channel.pinkState + 0.045 * gaussian(channel.generator);
+            value = noiseLevel * gaussian(channel.generator) + lfpLevel * channel.pinkState;
+            value += line * sin(2 * M_PI * lineFrequency * time);
+            value += beta * sin(2 * M_PI * 20 * time) * (0.5 + 0.5 * sin(2 * M_PI * 0.3 * time + channel.channelID));
+
+            // Biphasic 1 ms spike template
+            if (channel.spikeRemaining == 0 && spikeRate > 0 && uniform(channel.generator) < spikeRate / SIMULATOR_SAMPLING_RATE)
+            {
+                channel.spikeRemaining = SIMULATOR_SAMPLING_RATE / 1000;
+            }
+            if (channel.spikeRemaining > 0)
+            {
+                int k = SIMULATOR_SAMPLING_RATE / 1000 - channel.spikeRemaining;
+                value += (k < 15) ? -spikeAmplitude * sin(M_PI * k / 15) : 0.4 * spikeAmplitude * sin(M_PI * (k - 15) / 29);
+                channel.spikeRemaining--;
+            }
+
+            if (moving) value += 20 * noiseLevel * gaussian(channel.generator);
+            value += stimulationArtifact(channel, n);
+            if (channel.fault == "Saturated") value *= 200;
+        }
+        channel.ring[n % channel.bufferSamples] = (int16)qBound(-32768.0, value, 32767.0);
+    }
+    channel.generatedSamples = untilSample;
+}
+
+// Call statistics for soak tests, written next to the executable on AO_Exit.
+void NeuroOmegaSimulator::writeReport()
+{
+    QJsonArray callArray;
+    callMutex.lock();
+    for (QHash<QString, SimulatedCall>::const_iterator it = calls.constBegin(); it != calls.constEnd(); ++it)
+    {
+        QJsonObject callObject;
+        callObject["Function"] = QJsonValue(it.key());
+        callObject["Calls"] = QJsonValue(it.value().calls);
+        callObject["Failures"] = QJsonValue(it.value().failures);
+        callObject["MeanLatency"] = QJsonValue(it.value().calls > 0 ? it.value().totalLatency / it.value().calls : 0);
+        callArray.append(callObject);
+    }
+    callMutex.unlock();
+
+    QJsonObject reportObject;
+    reportObject["Calls"] = callArray;
+    stateMutex.lock();
+    reportObject["TextMessages"] = QJsonArray::fromStringList(textMessages);
+    stateMutex.unlock();
+
+    QFile file(QDir::currentPath() + "/SimulatorReport.json");
+    if (!file.open(QIODevice::WriteOnly)) return;
+    file.write(QJsonDocument(reportObject).toJson());
+    file.close();
+}
+
+////////////////////////////////////
+/////// Simulated SDK Surface //////
+////////////////////////////////////
+#define SIMULATOR_CALL(function) \
+    NeuroOmegaSimulator *simulator = NeuroOmegaSimulator::instance(); \
+    int callResult = simulator->beginCall(function); \
+    if (callResult != eAO_OK) return callResult;
+
+int DefaultStartConnection(MAC_ADDR *pSystemMAC, void (*pCallback)())
+{
+    SIMULATOR_CALL("DefaultStartConnection");
+    Q_UNUSED(pSystemMAC);
+    Q_UNUSED(pCallback);
+
+    QMutexLocker locker(&simulator->stateMutex);
+    if (!simulator->connected)
+    {
+        simulator->connected = true;
+        simulator->connectionStart = simulatorNanoseconds();
+    }
+    return eAO_OK;
+}
+
+int isConnected()
+{
+    NeuroOmegaSimulator *simulator = NeuroOmegaSimulator::instance();
+    if (simulator->beginCall("isConnected") != eAO_OK) return eAO_DISCONNECTED;
+
+    QMutexLocker locker(&simulator->stateMutex);
+    return simulator->connected ? eAO_CONNECTED : eAO_DISCONNECTED;
+}
+
+int CloseConnection()
+{
+    SIMULATOR_CALL("CloseConnection");
+    QMutexLocker locker(&simulator->stateMutex);
+    simulator->connected = false;
+    simulator->stimulation.clear();
+    return eAO_OK;
+}
+
+int AO_Exit()
+{
+    NeuroOmegaSimulator::instance()->writeReport();
+    return eAO_OK;
+}
+
+int ErrorHandlingfunc(int *pErrorCount, cChar *sError, int nErrorLength)
+{
+    if (pErrorCount == nullptr || sError == nullptr) return eAO_ARG_NULL;
+    if (nErrorLength <= 0) return eAO_BAD_ARG;
+
+    QByteArray message = NeuroOmegaSimulator::instance()->takeError(pErrorCount).toLatin1();
+    int length = qMin((int)message.size(), nErrorLength - 1);
+    memcpy(sError, message.constData(), length);
+    sError[length] = 0;
+    return eAO_OK;
+}
+
+int CheckQualityConnection(int *pQuality, real32 *pPercent)
+{
+    SIMULATOR_CALL("CheckQualityConnection");
+    if (pQuality == nullptr || pPercent == nullptr) return eAO_ARG_NULL;
+    *pQuality = 3;
+    *pPercent = 100;
+    return eAO_OK;
+}
+
+int GetChannelsCount(uint32 *pCount)
+{
+    SIMULATOR_CALL("GetChannelsCount");
+    if (pCount == nullptr) return eAO_ARG_NULL;
+    QMutexLocker locker(&simulator->stateMutex);
+    *pCount = simulator->channelOrder.size();
+    return eAO_OK;
+}
+
+int GetAllChannels(SInformation *pInfo, int nCount)
+{
+    SIMULATOR_CALL("GetAllChannels");
+    if (pInfo == nullptr) return eAO_ARG_NULL;
+
+    QMutexLocker locker(&simulator->stateMutex);
+    for (int i = 0; i < qMin(nCount, (int)simulator->channelOrder.size()); i++)
+    {
+        const SimulatedChannel &channel = simulator->channels[simulator->channelOrder[i]];
+        QByteArray channelName = channel.channelName.toLatin1();
+        pInfo[i].channelID = channel.channelID;
+        memset(pInfo[i].channelName, 0, sizeof(pInfo[i].channelName));
+        memcpy(pInfo[i].channelName, channelName.constData(), qMin((int)channelName.size(), (int)sizeof(pInfo[i].channelName) - 1));
+    }
+    return eAO_OK;
+}
+
+int SetChannelSaveState(int nChannelID, bool bSave)
+{
+    SIMULATOR_CALL("SetChannelSaveState");
+    QMutexLocker locker(&simulator->stateMutex);
+    if (!simulator->channels.contains(nChannelID)) return eAO_BAD_ARG;
+    simulator->channels[nChannelID].saveState = bSave;
+    return eAO_OK;
+}
+
+int GetChannelSaveState(int nChannelID, int *pSave)
+{
+    SIMULATOR_CALL("GetChannelSaveState");
+    if (pSave == nullptr) return eAO_ARG_NULL;
+    QMutexLocker locker(&simulator->stateMutex);
+    if (!simulator->channels.contains(nChannelID)) return eAO_BAD_ARG;
+    *pSave = simulator->channels[nChannelID].saveState;
+    return eAO_OK;
+}
+
+int SetChannelName(int nChannelID, cChar *sName, int nLength)
+{
+    SIMULATOR_CALL("SetChannelName");
+    if (sName == nullptr) return eAO_ARG_NULL;
+    QMutexLocker locker(&simulator->stateMutex);
+    if (!simulator->channels.contains(nChannelID)) return eAO_BAD_ARG;
+    simulator->channels[nChannelID].channelName = QString::fromLatin1(sName, nLength);
+    return eAO_OK;
+}
+
+int SetSaveFileName(cChar *sName, int nLength)
+{
+    SIMULATOR_CALL("SetSaveFileName");
+    if (sName == nullptr) return eAO_ARG_NULL;
+    QMutexLocker locker(&simulator->stateMutex);
+    simulator->saveFileName = QString::fromLatin1(sName, nLength);
+    return eAO_OK;
+}
+
+int StartSave()
+{
+    SIMULATOR_CALL("StartSave");
+    QMutexLocker locker(&simulator->stateMutex);
+    simulator->saving = true;
+    return eAO_OK;
+}
+
+int StopSave()
+{
+    SIMULATOR_CALL("StopSave");
+    QMutexLocker locker(&simulator->stateMutex);
+    simulator->saving = false;
+    return eAO_OK;
+}
+
+int SendText(cChar *sText, int nLength)
+{
+    SIMULATOR_CALL("SendText");
+    if (sText == nullptr) return eAO_ARG_NULL;
+    QMutexLocker locker(&simulator->stateMutex);
+    simulator->textMessages.append(QString::fromLatin1(sText, nLength));
+    return eAO_OK;
+}
+
+int GetLatestTimeStamp(ulong *pTS)
+{
+    SIMULATOR_CALL("GetLatestTimeStamp");
+    if (pTS == nullptr) return eAO_ARG_NULL;
+    QMutexLocker locker(&simulator->stateMutex);
+    *pTS = simulator->currentSample();
+    return eAO_OK;
+}
+
+int GetDriveDepth(int32 *pDepth)
+{
+    SIMULATOR_CALL("GetDriveDepth");
+    if (pDepth == nullptr) return eAO_ARG_NULL;
+    QMutexLocker locker(&simulator->stateMutex);
+    bool moving = false;
+    *pDepth = simulator->driveDepth(simulator->currentSample(), &moving);
+    return eAO_OK;
+}
+
+int GetMoveMotorTS(uint32 *pTS)
+{
+    SIMULATOR_CALL("GetMoveMotorTS");
+    if (pTS == nullptr) return eAO_ARG_NULL;
+    QMutexLocker locker(&simulator->stateMutex);
+    qint64 moveSample = 0, stopSample = 0;
+    simulator->motorTimestamps(simulator->currentSample(), &moveSample, &stopSample);
+    *pTS = (uint32)moveSample;
+    return eAO_OK;
+}
+
+int GetStopMotorTS(uint32 *pTS)
+{
+    SIMULATOR_CALL("GetStopMotorTS");
+    if (pTS == nullptr) return eAO_ARG_NULL;
+    QMutexLocker locker(&simulator->stateMutex);
+    qint64 moveSample = 0, stopSample = 0;
+    simulator->motorTimestamps(simulator->currentSample(), &moveSample, &stopSample);
+    *pTS = (uint32)stopSample;
+    return eAO_OK;
+}
+
+int SetStimulationParameters(real32 a1, real32 w1, real32 a2, real32 w2, int freq, real32 dur, int ret, int ch, int ad1, int ad2)
+{
+    SIMULATOR_CALL("SetStimulationParameters");
+    Q_UNUSED(ad1);
+    Q_UNUSED(ad2);
+
+    QMutexLocker locker(&simulator->stateMutex);
+    if (!simulator->channels.contains(ch) || freq < 0 || w1 < 0 || w2 < 0) return eAO_BAD_ARG;
+
+    SimulatedStimulation pulse;
+    pulse.amplitude1 = a1;
+    pulse.pulsewidth1 = w1;
+    pulse.amplitude2 = a2;
+    pulse.pulsewidth2 = w2;
+    pulse.frequency = freq;
+    pulse.duration = dur;
+    pulse.returnChannel = ret;
+    simulator->stimulation.insert(ch, pulse);
+    return eAO_OK;
+}
+
+int StartStimulation(int ch)
+{
+    SIMULATOR_CALL("StartStimulation");
+    QMutexLocker locker(&simulator->stateMutex);
+    if (!simulator->stimulation.contains(ch)) return eAO_BAD_ARG;
+
+    SimulatedStimulation &pulse = simulator->stimulation[ch];
+    pulse.waveID = -1;
+    pulse.startSample = simulator->currentSample();
+    pulse.stopSample = (pulse.duration > 0) ? pulse.startSample + (qint64)(pulse.duration * SIMULATOR_SAMPLING_RATE) : -1;
+    return eAO_OK;
+}
+
+int StopStimulation(int ch)
+{
+    SIMULATOR_CALL("StopStimulation");
+    QMutexLocker locker(&simulator->stateMutex);
+    qint64 now = simulator->currentSample();
+    for (QHash<int, SimulatedStimulation>::iterator it = simulator->stimulation.begin(); it != simulator->stimulation.end(); ++it)
+    {
+        if (ch != -1 && it.key() != ch) continue;
+        if (it.value().startSample >= 0 && (it.value().stopSample < 0 || it.value().stopSample > now)) it.value().stopSample = now;
+    }
+    return eAO_OK;
+}
+
+int LoadWaveToEmbedded(int16 *pWave, int nLength, int nDown, cChar *sName)
+{
+    SIMULATOR_CALL("LoadWaveToEmbedded");
+    Q_UNUSED(sName);
+    if (pWave == nullptr) return eAO_ARG_NULL;
+    if (nLength <= 0 || nDown <= 0) return eAO_BAD_ARG;
+
+    // Embedded waves are stored at the system rate, repeating each sample nDown times.
+    QVector<int16> wave(nLength * nDown);
+    for (int i = 0; i < wave.size(); i++) wave[i] = pWave[i / nDown];
+
+    QMutexLocker locker(&simulator->stateMutex);
+    simulator->embeddedWaves.append(wave);
+    return eAO_OK;
+}
+
+int StartAnalogStimulation(int ch, int wave, int freq, real32 dur, int ret)
+{
+    SIMULATOR_CALL("StartAnalogStimulation");
+    Q_UNUSED(freq);
+
+    QMutexLocker locker(&simulator->stateMutex);
+    if (!simulator->channels.contains(ch) || wave < 0 || wave >= simulator->embeddedWaves.size()) return eAO_BAD_ARG;
+
+    SimulatedStimulation pulse;
+    pulse.waveID = wave;
+    pulse.duration = dur;
+    pulse.returnChannel = ret;
+    pulse.startSample = simulator->currentSample();
+    pulse.stopSample = (dur > 0) ? pulse.startSample + (qint64)(dur * SIMULATOR_SAMPLING_RATE) : -1;
+    simulator->stimulation.insert(ch, pulse);
+    return eAO_OK;
+}
+
+int AddBufferChannel(int ch, int ms)
+{
+    SIMULATOR_CALL("AddBufferChannel");
+    QMutexLocker locker(&simulator->stateMutex);
+    if (!simulator->channels.contains(ch) || ms <= 0) return eAO_BAD_ARG;
+
+    SimulatedChannel &channel = simulator->channels[ch];
+    channel.bufferSamples = (qint64)ms * SIMULATOR_SAMPLING_RATE / 1000;
+    channel.ring.fill(0, channel.bufferSamples);
+    channel.generatedSamples = simulator->currentSample();
+    channel.readCursor = channel.generatedSamples;
+    return eAO_OK;
+}
+
+int ClearBuffers()
+{
+    SIMULATOR_CALL("ClearBuffers");
+    QMutexLocker locker(&simulator->stateMutex);
+    for (QHash<int, SimulatedChannel>::iterator it = simulator->channels.begin(); it != simulator->channels.end(); ++it)
+    {
+        it.value().bufferSamples = 0;
+        it.value().ring.clear();
+        it.value().readCursor = -1;
+    }
+    return eAO_OK;
+}
+
+// Channel-major, like the hardware: pData holds nChannels runs of (*pCapture / nChannels) samples.
+int GetAlignedData(int16 *pData, int nSize, int *pCapture, int *pChannels, int nChannels, uint32 *pBeginTS)
+{
+    SIMULATOR_CALL("GetAlignedData");
+    if (pData == nullptr || pCapture == nullptr || pChannels == nullptr || pBeginTS == nullptr) return eAO_ARG_NULL;
+    if (nChannels <= 0 || nSize < nChannels) return eAO_BAD_ARG;
+
+    QMutexLocker locker(&simulator->stateMutex);
+    if (!simulator->connected) return eAO_BAD_ARG;
+
+    qint64 now = simulator->currentSample();
+    qint64 start = -1;
+    for (int i = 0; i < nChannels; i++)
+    {
+        if (!simulator->channels.contains(pChannels[i]) || simulator->channels[pChannels[i]].bufferSamples <= 0) return eAO_BAD_ARG;
+        const SimulatedChannel &channel = simulator->channels[pChannels[i]];
+        start = qMax(start, qMax(channel.readCursor, now - channel.bufferSamples));
+    }
+
+    int count = (int)qMin(now - start, (qint64)(nSize / nChannels));
+    for (int i = 0; i < nChannels; i++)
+    {
+        SimulatedChannel &channel = simulator->channels[pChannels[i]];
+        simulator->generate(channel, start + count);
+        for (int n = 0; n < count; n++) pData[i * count + n] = simulator->sampleAt(channel, start + n);
+        channel.readCursor = start + count;
+    }
+    *pCapture = count * nChannels;
+    *pBeginTS = (uint32)start;
+    return eAO_OK;
+}
+
+int GetChannelData(int ch, int16 *pData, int nSize, int *pCapture)
+{
+    SIMULATOR_CALL("GetChannelData");
+    if (pData == nullptr || pCapture == nullptr) return eAO_ARG_NULL;
+
+    QMutexLocker locker(&simulator->stateMutex);
+    if (!simulator->connected || !simulator->channels.contains(ch) || simulator->channels[ch].bufferSamples <= 0) return eAO_BAD_ARG;
+
+    SimulatedChannel &channel = simulator->channels[ch];
+    qint64 now = simulator->currentSample();
+    qint64 start = qMax(channel.readCursor, now - channel.bufferSamples);
+    int count = (int)qMin(now - start, (qint64)nSize);
+    simulator->generate(channel, start + count);
+    for (int n = 0; n < count; n++) pData[n] = simulator->sampleAt(channel, start + n);
+    channel.readCursor = start + count;
+    *pCapture = count;
+    return eAO_OK;
+}
@@ -0,0 +1,153 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#ifndef NEUROOMEGASIMULATOR_H
+#define NEUROOMEGASIMULATOR_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+#include <QFile>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include <random>
+#include <chrono>
+
+#include "AOSystemAPI_TEST.h"
+#include "AOTypes.h"
+
+#define SIMULATOR_SAMPLING_RATE 44000
+
+// Per-call behaviour, "Calls" in SimulatorConfiguration.json. Latency and jitter are in milliseconds.
+typedef struct SimulatedCall
+{
+    double latency = 0;
+    double jitter = 0;
+    double failureRate = 0;
+    qint64 calls = 0;
+    qint64 failures = 0;
+    double totalLatency = 0;
+} SimulatedCall;
+
+typedef struct SimulatedStimulation
+{
+    double amplitude1 = 0;
+    double pulsewidth1 = 0;
+    double amplitude2 = 0;
+    double pulsewidth2 = 0;
+    int frequency = 0;
+    double duration = 0;
+    int returnChannel = -1;
+    int waveID = -1;
+    qint64 startSample = -1;
+    qint64 stopSample = -1;
+} SimulatedStimulation;
+
+// One simulated input. Samples are generated lazily up to "now" into a ring that both
+// GetAlignedData and GetChannelData read from, so every reader sees the same signal.
+typedef struct SimulatedChannel
+{
+    int channelID = 0;
+    QString channelName = "";
+    QString type = "";
+    int saveState = 0;
+    QString fault = "";
+
+    int bufferSamples = 0;
+    QVector<int16> ring;
+    qint64 generatedSamples = 0;
+    qint64 readCursor = -1;
+
+    std::mt19937 generator;
+    double phase = 0;
+    double pinkState = 0;
+    int spikeRemaining = 0;
+} SimulatedChannel;
+
+// Hardware-free stand-in for the NeuroOmega system behind the AOSystemAPI_TEST surface. All SDK
+// entry points in neuroomegasimulator.cpp forward here. Time advances with the host monotonic clock.
+class NeuroOmegaSimulator
+{
+public:
+    static NeuroOmegaSimulator *instance();
+
+    bool loadConfiguration(QString filename);
+    int beginCall(const char *function);
+    void setError(QString message);
+    QString takeError(int *errorCount);
+
+    qint64 currentSample();
+    int driveDepth(qint64 sample, bool *moving);
+    void motorTimestamps(qint64 sample, qint64 *moveSample, qint64 *stopSample);
+    void generate(SimulatedChannel &channel, qint64 untilSample);
+    int16 sampleAt(const SimulatedChannel &channel, qint64 sample) const;
+    void writeReport();
+
+    QMutex stateMutex;
+    bool connected = false;
+    qint64 connectionStart = 0;
+    QHash<int, SimulatedChannel> channels;
+    QVector<int> channelOrder;
+    QHash<int, SimulatedStimulation> stimulation;
+    QVector<QVector<int16>> embeddedWaves;
+    QString saveFileName = "";
+    bool saving = false;
+    QStringList textMessages;
+
+private:
+    NeuroOmegaSimulator();
+    void createChannels(QJsonObject configuration);
+    double stimulationArtifact(const SimulatedChannel &channel, qint64 sample);
+    bool inTarget(int depth) const;
+
+    QMutex callMutex;
+    QHash<QString, SimulatedCall> calls;
+    SimulatedCall defaultCall;
+    std::mt19937 callGenerator;
+
+    QMutex errorMutex;
+    QStringList errors;
+
+    int seed = 1;
+    double disconnectAfter = 0;
+
+    // Signal model, in ADC counts
+    double noiseLevel = 40;
+    double lfpLevel = 120;
+    double betaLevel = 150;
+    double lineNoiseLevel = 30;
+    double lineFrequency = 60;
+    double spikeAmplitude = 600;
+    double backgroundSpikeRate = 5;
+    double targetSpikeRate = 60;
+    double artifactGain = 2000;
+
+    // Drive model, in micrometers and seconds
+    int startDepth = -10000;
+    int endDepth = 5000;
+    int stepSize = 500;
+    double stepInterval = 10;
+    double moveDuration = 1;
+    int targetStart = -1000;
+    int targetEnd = 4000;
+};
+
+#endif // NEUROOMEGASIMULATOR_H
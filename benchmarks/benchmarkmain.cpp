@@ -0,0 +1,943 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QTemporaryDir>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QImage>
+#include <QRandomGenerator>
+
+#include <cmath>
+
+#include "benchmarkrunner.h"
+#include "streamdatahandler.h"
+#include "filtergraph.h"
+#include "jsonstorage.h"
+#include "detailchannelslist.h"
+#include "channelconfigurationengine.h"
+#include "traceviewer.h"
+#include "contactselectionmodel.h"
+#include "electrodegridwidget.h"
+#include "streamingstft.h"
+#include "interfaceconfiguration.h"
+#include "sessioncatalog.h"
+#include "shadowrecordingwriter.h"
+#include "clocksynchronizer.h"
+#include "labeldispatcher.h"
+#include "protocolcompiler.h"
+#include "sdkinstrumentation.h"
+
+// One resolved entry of a StimulationSequence, the shape ControllerForm walks on every tick.
+typedef struct BenchmarkSequenceStep
+{
+    QString stimulationType = "";
+    QString recordingFilename = "";
+    int lead = 0;
+    QVector<int> contacts;
+    int returnContact = -1;
+    int waveIndex = -1;
+    double duration = 0;
+    double amplitude = 0;
+    double pulsewidth = 0;
+    int frequency = 0;
+    double startTime = 0;
+} BenchmarkSequenceStep;
+
+// Counts what the acquisition thread hands out and how old each block is on arrival.
+class BenchmarkStreamConsumer : public StreamConsumer
+{
+public:
+    void processBlock(const SignalBlock &block) override
+    {
+        blockLatency.record(monotonicNanoseconds() - block.hostTimestamp);
+        samples.fetchAndAddRelaxed((quint64)block.numSamples * block.numChannels);
+        blocks.fetchAndAddRelaxed(1);
+    }
+
+    LatencyHistogram blockLatency;
+    QAtomicInteger<quint64> samples;
+    QAtomicInteger<quint64> blocks;
+};
+
+static QVector<int> ecogChannels(int numChannels)
+{
+    QVector<int> channelIDs;
+    for (int i = 0; i < numChannels; i++) channelIDs.append(10272 + i);
+    return channelIDs;
+}
+
+// Deterministic test signal so every run sees identical data.
+static QVector<int16> syntheticSignal(int numSamples, double frequency, double amplitude)
+{
+    QVector<int16> signal(numSamples);
+    for (int i = 0; i < numSamples; i++) signal[i] = (int16)(amplitude * std::sin(2 * M_PI * frequency * i / NEUROOMEGA_SAMPLING_RATE));
+    return signal;
+}
+
+static void benchmarkCircularBuffer(BenchmarkRunner &runner, int scale)
+{
+    int blockSize = NEUROOMEGA_SAMPLING_RATE / 10;
+    QVector<int16> block = syntheticSignal(blockSize, 20, 1000);
+
+    CircularBuffer addRing;
+    addRing.initiateBuffer(10 * NEUROOMEGA_SAMPLING_RATE);
+    runner.run("CircularBuffer/AddBuffer", "samples", 2000 * scale, [&]() {
+        addRing.addBuffer(block.data(), blockSize);
+        return (qint64) blockSize;
+    }, QJsonObject{{"BlockSamples", blockSize}, {"RingSeconds", 10}});
+
+    int windowSize = NEUROOMEGA_SAMPLING_RATE / 4;
+    QVector<int16> window(windowSize);
+    runner.run("CircularBuffer/GetLatest", "samples", 2000 * scale, [&]() {
+        addRing.getLatest(window.data(), windowSize);
+        return (qint64) windowSize;
+    }, QJsonObject{{"WindowSamples", windowSize}});
+
+    runner.run("CircularBuffer/GetBuffer", "samples", 2000 * scale, [&]() {
+        addRing.getBuffer(window.data(), windowSize);
+        return (qint64) windowSize;
+    }, QJsonObject{{"WindowSamples", windowSize}});
+}
+
+// Per-frame work of the trace viewer for 64 channels at 60 Hz: feed one frame of samples into the pyramids,
+// then build the per-pixel envelope of a 10 s window at 800 pixels.
+static void benchmarkTraceViewer(BenchmarkRunner &runner, int scale)
+{
+    int numChannels = 64;
+    int frameSamples = NEUROOMEGA_SAMPLING_RATE / 60;
+    int historySamples = 10 * NEUROOMEGA_SAMPLING_RATE;
+    int pixels = 800;
+
+    QVector<int16> history = syntheticSignal(historySamples, 20, 1000);
+    QList<TracePyramid> pyramids;
+    for (int i = 0; i < numChannels; i++)
+    {
+        TracePyramid pyramid;
+        pyramid.configure(historySamples);
+        pyramid.append(history.constData(), historySamples);
+        pyramids.append(pyramid);
+    }
+
+    int offset = 0;
+    runner.run("TraceViewer/PyramidAppend", "samples", 600 * scale, [&]() {
+        for (int i = 0; i < numChannels; i++) pyramids[i].append(history.constData() + offset, frameSamples);
+        offset = (offset + frameSamples) % (historySamples - frameSamples);
+        return (qint64) numChannels * frameSamples;
+    }, QJsonObject{{"Channels", numChannels}, {"FrameSamples", frameSamples}});
+
+    QVector<int16> minimum(pixels);
+    QVector<int16> maximum(pixels);
+    int level = pyramids[0].levelFor((double)historySamples / pixels);
+    runner.run("TraceViewer/Envelope", "frames", 600 * scale, [&]() {
+        for (int i = 0; i < numChannels; i++)
+        {
+            qint64 lastSample = pyramids[i].totalSamples();
+            pyramids[i].envelope(level, lastSample - historySamples, lastSample, pixels, minimum.data(), maximum.data());
+        }
+        return (qint64) 1;
+    }, QJsonObject{{"Channels", numChannels}, {"Pixels", pixels}, {"WindowSeconds", 10}, {"Level", level}});
+}
+
+// The channel-major split and int16 to float conversion StreamDataHandler::run() does for every poll.
+static void benchmarkStreamDecode(BenchmarkRunner &runner, int scale)
+{
+    int numChannels = 64;
+    int numSamples = NEUROOMEGA_SAMPLING_RATE / 10;
+    QVector<int16> alignedBuffer(numChannels * numSamples);
+    QVector<float> blockBuffer(numChannels * numSamples);
+    for (int i = 0; i < numChannels; i++)
+    {
+        QVector<int16> channelSignal = syntheticSignal(numSamples, 10 + i, 500);
+        memcpy(alignedBuffer.data() + i * numSamples, channelSignal.data(), sizeof(int16) * numSamples);
+    }
+
+    QList<CircularBuffer*> channelBuffers;
+    for (int i = 0; i < numChannels; i++)
+    {
+        channelBuffers.append(new CircularBuffer());
+        channelBuffers[i]->initiateBuffer(10 * NEUROOMEGA_SAMPLING_RATE);
+    }
+
+    runner.run("Stream/DecodeAlignedBlock", "samples", 200 * scale, [&]() {
+        for (int i = 0; i < numChannels; i++)
+        {
+            int16 *channelData = alignedBuffer.data() + i * numSamples;
+            channelBuffers[i]->addBuffer(channelData, numSamples);
+
+            float *channelOutput = blockBuffer.data() + i * numSamples;
+            for (int j = 0; j < numSamples; j++) channelOutput[j] = channelData[j];
+        }
+        return (qint64) numChannels * numSamples;
+    }, QJsonObject{{"Channels", numChannels}, {"BlockSamples", numSamples}});
+
+    for (int i = 0; i < channelBuffers.size(); i++) delete(channelBuffers[i]);
+}
+
+// Full acquisition path against the simulator: GetAlignedData polling, ring writes and consumer fan-out, in real time.
+static void benchmarkStreamAcquisition(BenchmarkRunner &runner, double seconds)
+{
+    if (!runner.selected("Stream/Acquisition")) return;
+
+    StreamDataHandler streamDataHandler;
+    BenchmarkStreamConsumer consumer;
+    if (!streamDataHandler.configureChannels(ecogChannels(64))) return;
+    streamDataHandler.addConsumer(&consumer);
+
+    qint64 startTime = monotonicNanoseconds();
+    streamDataHandler.start(QThread::TimeCriticalPriority);
+    QThread::msleep((unsigned long)(seconds * 1000));
+    streamDataHandler.stopStreaming();
+    double elapsed = (monotonicNanoseconds() - startTime) / 1e9;
+
+    QJsonObject result;
+    result["Iterations"] = QJsonValue((qint64) consumer.blocks.loadRelaxed());
+    result["TotalSeconds"] = QJsonValue(elapsed);
+    result["Unit"] = QJsonValue("samples");
+    result["Work"] = QJsonValue((qint64) consumer.samples.loadRelaxed());
+    result["Throughput"] = QJsonValue(consumer.samples.loadRelaxed() / elapsed);
+    result["RealTimeFactor"] = QJsonValue(consumer.samples.loadRelaxed() / (elapsed * 64.0 * NEUROOMEGA_SAMPLING_RATE));
+    result["Latency"] = consumer.blockLatency.toJson();
+    result["Parameters"] = QJsonObject{{"Channels", 64}, {"Seconds", seconds}};
+    runner.addResult("Stream/Acquisition", result);
+}
+
+// Shadow recording of 64 channels with a new segment every 5 s of data, then the write statistics and a read back across chunks.
+static void benchmarkShadowRecording(BenchmarkRunner &runner, int scale, QString workDirectory)
+{
+    if (!runner.selected("ShadowRecording/Write")) return;
+
+    int numChannels = 64;
+    int numSamples = NEUROOMEGA_SAMPLING_RATE / 10;
+    QVector<int> channelIDs = ecogChannels(numChannels);
+
+    QVector<float> blockData(numChannels * numSamples);
+    for (int i = 0; i < numChannels; i++)
+    {
+        QVector<int16> channelSignal = syntheticSignal(numSamples, 10 + i, 500);
+        for (int j = 0; j < numSamples; j++) blockData[i * numSamples + j] = channelSignal[j];
+    }
+
+    SignalBlock block;
+    block.data = blockData.data();
+    block.numChannels = numChannels;
+    block.numSamples = numSamples;
+    block.stride = numSamples;
+    block.samplingRate = NEUROOMEGA_SAMPLING_RATE;
+    block.channelIDs = channelIDs;
+
+    ShadowRecordingWriter writer;
+    QString recordingDirectory = workDirectory + "/ShadowRecording";
+    if (!writer.configure(recordingDirectory, channelIDs, 10, 1))
+    {
+        QTextStream(stderr) << "ShadowRecording/Write skipped: " << writer.errorMessage() << Qt::endl;
+        return;
+    }
+    writer.start(QThread::HighPriority);
+
+    int blocks = 0;
+    runner.run("ShadowRecording/Write", "samples", 300 * scale, [&]() {
+        if (blocks % 50 == 0) writer.markSegment(QString("Segment%1").arg(blocks / 50));
+        block.hostTimestamp = monotonicNanoseconds();
+        writer.processBlock(block);
+        block.firstSample += numSamples;
+        blocks++;
+        return (qint64) numChannels * numSamples;
+    }, QJsonObject{{"Channels", numChannels}, {"BlockSamples", numSamples}, {"ChunkSeconds", 10}});
+    writer.endSegment();
+    writer.stopWriter();
+
+    // Read one channel back over the whole recording; with nothing dropped every sample comes back.
+    ShadowRecordingReader reader;
+    QJsonObject readObject = writer.report();
+    if (reader.open(recordingDirectory))
+    {
+        QVector<int16> channelData(reader.totalSamples());
+        qint64 readStart = monotonicNanoseconds();
+        int copied = reader.readSamples(channelIDs[numChannels / 2], 0, channelData.size(), channelData.data());
+        readObject["ReadSeconds"] = (monotonicNanoseconds() - readStart) / 1e9;
+        readObject["SamplesRead"] = copied;
+        readObject["TotalSamples"] = (qint64) reader.totalSamples();
+    }
+    runner.addResult("ShadowRecording/Statistics", readObject);
+}
+
+// Running clock fit on a synthetic device clock with 25 ppm drift, packet-sized quantization and occasional stalled calls,
+// then the error of the estimated device sample against the true one.
+static void benchmarkClockSynchronizer(BenchmarkRunner &runner, int scale)
+{
+    if (!runner.selected("Clock/AddSample")) return;
+
+    double trueRate = NEUROOMEGA_SAMPLING_RATE * (1 + 25e-6);
+    qint64 trueOffset = 123456789;
+    QRandomGenerator random(7);
+
+    ClockSynchronizer clockSynchronizer;
+    clockSynchronizer.configure(100, 600, 3);
+
+    qint64 hostTime = 1000000000;
+    runner.run("Clock/AddSample", "samples", 20000 * scale, [&]() {
+        hostTime += 100000000;
+        ClockSample sample;
+        sample.roundTrip = 20000 + random.bounded(80000);
+        sample.hostNanoseconds = hostTime + random.bounded((int)sample.roundTrip) - sample.roundTrip / 2;
+        qint64 deviceSample = trueOffset + (qint64)(trueRate * hostTime / 1e9);
+        sample.deviceSample = deviceSample - deviceSample % 44;
+        if (random.bounded(200) == 0) sample.deviceSample -= 20 * NEUROOMEGA_SAMPLING_RATE / 1000;
+        clockSynchronizer.addSample(sample);
+        return (qint64) 1;
+    }, QJsonObject{{"DriftPPM", 25}, {"WindowSize", 600}});
+
+    double maxError = 0;
+    for (int i = 0; i < 100; i++)
+    {
+        qint64 queryTime = hostTime - i * 50000000;
+        double error = clockSynchronizer.deviceSample(queryTime) - (trueOffset + trueRate * queryTime / 1e9);
+        maxError = qMax(maxError, fabs(error));
+    }
+
+    QJsonObject fitObject = clockSynchronizer.report();
+    fitObject["MaxErrorSamples"] = maxError;
+    fitObject["MaxErrorMilliseconds"] = maxError * 1000 / NEUROOMEGA_SAMPLING_RATE;
+    runner.addResult("Clock/FitAccuracy", fitObject);
+
+    QJsonObject event;
+    runner.run("Clock/TagEvent", "events", 100000 * scale, [&]() {
+        clockSynchronizer.tagEvent(event);
+        return (qint64) 1;
+    }, QJsonObject());
+}
+
+// A benefit or side effect burst of five labels: the time the button slot spends queueing them, and the click to
+// acknowledge latency of the background sender against the simulator.
+static void benchmarkLabelDispatcher(BenchmarkRunner &runner, int scale)
+{
+    if (!runner.selected("Label/EnqueueBurst")) return;
+
+    LabelDispatcher dispatcher;
+    dispatcher.configure(nullptr);
+    QAtomicInteger<qint64> dispatched = 0;
+    QObject::connect(&dispatcher, &LabelDispatcher::labelDispatched, [&](QJsonObject labelObject) {
+        Q_UNUSED(labelObject);
+        dispatched.fetchAndAddRelaxed(1);
+    });
+    dispatcher.start(QThread::HighPriority);
+
+    QStringList burst = {"Rigidity Benefit", "Tremor Benefit", "Bradykinesia Benefit", "Speech", "Paresthesia"};
+    qint64 enqueued = 0;
+    runner.run("Label/EnqueueBurst", "labels", 200 * scale, [&]() {
+        for (int i = 0; i < burst.size(); i++) dispatcher.enqueue(burst[i]);
+        enqueued += burst.size();
+
+        // One burst in flight at a time, like an operator pressing buttons
+        while (dispatched.loadRelaxed() < enqueued) QThread::usleep(50);
+        return (qint64) burst.size();
+    }, QJsonObject{{"BurstSize", burst.size()}});
+    dispatcher.stopDispatcher();
+    runner.addResult("Label/Dispatch", dispatcher.report());
+}
+
+static void benchmarkFilterGraph(BenchmarkRunner &runner, int scale, QString dataDirectory)
+{
+    QStringList graphNames = {"Default", "SpikeBand"};
+    for (int k = 0; k < graphNames.size(); k++)
+    {
+        QString benchmarkName = "FilterGraph/" + graphNames[k];
+        if (!runner.selected(benchmarkName)) continue;
+
+        int numChannels = 32;
+        int numSamples = NEUROOMEGA_SAMPLING_RATE / 10;
+        QVector<int> channelIDs = ecogChannels(numChannels);
+
+        ElectrodeInformation electrode;
+        electrode.electrodeType = "ECoG - 32";
+        electrode.channelIDs = channelIDs;
+        electrode.numContacts = numChannels;
+        electrode.layoutSize[0] = 4;
+        electrode.layoutSize[1] = 8;
+
+        FilterGraph filterGraph;
+        filterGraph.setElectrodeLayouts({electrode});
+        if (!filterGraph.loadConfiguration(dataDirectory + "/FilterGraphs.json", graphNames[k]) ||
+                !filterGraph.prepare(numChannels, numSamples, NEUROOMEGA_SAMPLING_RATE, channelIDs))
+        {
+            QTextStream(stderr) << benchmarkName << " skipped: " << filterGraph.errorMessage() << Qt::endl;
+            continue;
+        }
+
+        QVector<float> blockData(numChannels * numSamples);
+        for (int i = 0; i < numChannels; i++)
+        {
+            QVector<int16> channelSignal = syntheticSignal(numSamples, 20 + i, 500);
+            for (int j = 0; j < numSamples; j++) blockData[i * numSamples + j] = channelSignal[j];
+        }
+
+        SignalBlock block;
+        block.data = blockData.data();
+        block.numChannels = numChannels;
+        block.numSamples = numSamples;
+        block.stride = numSamples;
+        block.samplingRate = NEUROOMEGA_SAMPLING_RATE;
+        block.channelIDs = channelIDs;
+
+        runner.run(benchmarkName, "samples", 100 * scale, [&]() {
+            block.hostTimestamp = monotonicNanoseconds();
+            filterGraph.processBlock(block);
+            block.firstSample += numSamples;
+            return (qint64) numChannels * numSamples;
+        }, QJsonObject{{"Channels", numChannels}, {"BlockSamples", numSamples}});
+    }
+}
+
+// Same steps as ControllerForm::loadAnalogWaveform followed by the upload done at each Novel stage.
+static void benchmarkWaveformLoading(BenchmarkRunner &runner, int scale, QString workDirectory)
+{
+    if (!runner.selected("Waveform/LoadAndUpload")) return;
+
+    int numWaveforms = 4;
+    QStringList waveformFiles;
+    for (int i = 0; i < numWaveforms; i++)
+    {
+        QVector<int16> waveform = syntheticSignal(NEUROOMEGA_SAMPLING_RATE, 130 * (i + 1), 8000);
+        QString filename = workDirectory + QString("/BenchmarkWave%1.bin").arg(i);
+        QFile file(filename);
+        if (!file.open(QIODevice::WriteOnly)) return;
+        file.write((const char*) waveform.data(), waveform.size() * sizeof(int16));
+        file.close();
+        waveformFiles.append(filename);
+    }
+
+    runner.run("Waveform/LoadAndUpload", "bytes", 20 * scale, [&]() {
+        qint64 bytesLoaded = 0;
+        for (int i = 0; i < waveformFiles.size(); i++)
+        {
+            QFile file(waveformFiles[i]);
+            if (!file.open(QIODevice::ReadOnly)) continue;
+            QByteArray byteArray = file.readAll();
+
+            int16 *stimulationVector = (int16*)malloc(file.size());
+            memcpy(stimulationVector, byteArray.data(), file.size());
+
+            QString wavename = QFileInfo(waveformFiles[i]).fileName().split(".").first();
+            AO_CALL(LoadWaveToEmbedded)(stimulationVector, file.size() / 2, 1, (cChar*) wavename.toStdString().c_str());
+            free(stimulationVector);
+            bytesLoaded += byteArray.size();
+        }
+        return bytesLoaded;
+    }, QJsonObject{{"Waveforms", numWaveforms}, {"WaveformSeconds", 1}});
+}
+
+static QVector<BenchmarkSequenceStep> compileSequence(QByteArray configurationData, bool *valid)
+{
+    QVector<BenchmarkSequenceStep> steps;
+    *valid = false;
+
+    QJsonDocument loadedDocument = QJsonDocument::fromJson(configurationData);
+    QJsonArray stimulationSequences = loadedDocument.object()["StimulationSequence"].toArray();
+
+    double phaseTimer = 0;
+    for (int i = 0; i < stimulationSequences.size(); i++)
+    {
+        if (!stimulationSequences[i].isObject()) return steps;
+        QJsonObject stageObject = stimulationSequences[i].toObject();
+        if (!stageObject.contains("StimulationType") || !stageObject.contains("StimulationLead") ||
+                !stageObject.contains("StimulationChannel") || !stageObject.contains("StimulationReturn") ||
+                !stageObject.contains("Duration"))
+        {
+            return steps;
+        }
+
+        BenchmarkSequenceStep step;
+        step.stimulationType = stageObject["StimulationType"].toString();
+        step.recordingFilename = stageObject["RecordingFilename"].toString();
+        step.lead = stageObject["StimulationLead"].toInt();
+        step.returnContact = stageObject["StimulationReturn"].toInt();
+        step.waveIndex = stageObject.value("StimulationIndex").toInt(-1);
+        step.duration = stageObject["Duration"].toDouble();
+        step.amplitude = stageObject.value("Amplitude").toDouble(0);
+        step.pulsewidth = stageObject.value("Pulsewidth").toDouble(0);
+        step.frequency = stageObject.value("Frequency").toInt(0);
+        step.startTime = phaseTimer;
+
+        QJsonArray contactArray = stageObject["StimulationChannel"].toArray();
+        for (int j = 0; j < contactArray.size(); j++) step.contacts.append(contactArray[j].toInt());
+
+        steps.append(step);
+        phaseTimer += step.duration;
+    }
+
+    *valid = true;
+    return steps;
+}
+
+static void benchmarkSequencer(BenchmarkRunner &runner, int scale, QString dataDirectory)
+{
+    QStringList sequenceFiles = {"DefaultStimulationConfiguration_8Contacts.json", "ERNA_VariableFrequency_8Contacts.json"};
+    for (int k = 0; k < sequenceFiles.size(); k++)
+    {
+        QFile file(dataDirectory + "/" + sequenceFiles[k]);
+        if (!file.open(QIODevice::ReadOnly)) continue;
+        QByteArray configurationData = file.readAll();
+        QString sequenceName = sequenceFiles[k].split(".").first();
+
+        bool valid = false;
+        QVector<BenchmarkSequenceStep> steps = compileSequence(configurationData, &valid);
+        if (!valid) continue;
+
+        runner.run("Sequence/Compile/" + sequenceName, "stages", 200 * scale, [&]() {
+            bool compiled = false;
+            return (qint64) compileSequence(configurationData, &compiled).size();
+        }, QJsonObject{{"Stages", steps.size()}});
+
+        // ControllerForm re-reads the JSON array on every tick to find the active stage.
+        QJsonArray stimulationSequences = QJsonDocument::fromJson(configurationData).object()["StimulationSequence"].toArray();
+        double totalDuration = steps.last().startTime + steps.last().duration;
+        int tickCount = 0;
+        int activeStage = 0;
+        runner.run("Sequence/Tick/" + sequenceName, "ticks", 5000 * scale, [&]() {
+            double elapsedTime = fmod(tickCount++ * 0.01, totalDuration);
+            double phaseTimer = 0;
+            for (int i = 0; i < stimulationSequences.size(); i++)
+            {
+                if (stimulationSequences[i].toObject().contains("StimulationType") &&
+                        stimulationSequences[i].toObject()["StimulationLead"].toInt() >= 0 &&
+                        elapsedTime >= phaseTimer)
+                {
+                    activeStage = i;
+                }
+                phaseTimer += stimulationSequences[i].toObject()["Duration"].toDouble();
+            }
+            return (qint64) 1;
+        }, QJsonObject{{"Stages", steps.size()}, {"TickInterval", 0.01}});
+
+        // Issue every stage's SDK calls back to back, as if each stage's start time had just been reached.
+        QVector<int> electrodeContacts = ecogChannels(8);
+        QVector<int16> waveform = syntheticSignal(NEUROOMEGA_SAMPLING_RATE, 130, 8000);
+        runner.run("Sequence/Execute/" + sequenceName, "stages", 20 * scale, [&]() {
+            QString currentFilename = "";
+            for (int i = 0; i < steps.size(); i++)
+            {
+                int returnContact = steps[i].returnContact >= 0 ? electrodeContacts[steps[i].returnContact] : -1;
+                if (steps[i].recordingFilename != currentFilename)
+                {
+                    AO_CALL(StopSave)();
+                    AO_CALL(StartSave)();
+                    currentFilename = steps[i].recordingFilename;
+                }
+
+                if (steps[i].stimulationType.contains("Novel"))
+                {
+                    AO_CALL(LoadWaveToEmbedded)(waveform.data(), waveform.size(), 1, (cChar*) "BenchmarkWave");
+                    for (int j = 0; j < steps[i].contacts.size(); j++)
+                    {
+                        AO_CALL(StartAnalogStimulation)(electrodeContacts[steps[i].contacts[j]], 0, -1, steps[i].duration, returnContact);
+                    }
+                }
+                else if (steps[i].stimulationType.contains("Standard"))
+                {
+                    for (int j = 0; j < steps[i].contacts.size(); j++)
+                    {
+                        AO_CALL(SetStimulationParameters)(-steps[i].amplitude / steps[i].contacts.size(), steps[i].pulsewidth / 1000.0,
+                                                          steps[i].amplitude / steps[i].contacts.size(), steps[i].pulsewidth / 1000.0,
+                                                          steps[i].frequency, steps[i].duration, returnContact, electrodeContacts[steps[i].contacts[j]], 0, 0);
+                    }
+                    for (int j = 0; j < steps[i].contacts.size(); j++) AO_CALL(StartStimulation)(electrodeContacts[steps[i].contacts[j]]);
+                }
+                AO_CALL(StopStimulation)(-1);
+            }
+            AO_CALL(StopSave)();
+            return (qint64) steps.size();
+        }, QJsonObject{{"Stages", steps.size()}});
+    }
+}
+
+// An ERNA sweep of 8 contacts x 5 waveforms and a threshold sweep, 3 randomized blocks. Costs come from the
+// Sequence/Execute calls above, so the plan compares uploads and file switches against declaration order.
+static void benchmarkProtocolCompiler(BenchmarkRunner &runner, int scale)
+{
+    if (!runner.selected("Protocol/Compile")) return;
+
+    QJsonObject ernaSweep;
+    ernaSweep["StimulationType"] = "Novel";
+    ernaSweep["RecordingFilename"] = "ERNA";
+    ernaSweep["StimulationLead"] = 0;
+    ernaSweep["StimulationReturn"] = -1;
+    ernaSweep["Contacts"] = QJsonArray{0, 1, 2, 3, 4, 5, 6, 7};
+    ernaSweep["Waveforms"] = QJsonArray{0, 1, 2, 3, 4};
+    ernaSweep["Duration"] = 10;
+    ernaSweep["Rest"] = 2;
+
+    QJsonObject thresholdSweep;
+    thresholdSweep["StimulationType"] = "Standard";
+    thresholdSweep["RecordingFilename"] = "Threshold";
+    thresholdSweep["StimulationLead"] = 0;
+    thresholdSweep["StimulationReturn"] = -1;
+    thresholdSweep["Contacts"] = QJsonArray{QJsonArray{1, 2}, QJsonArray{5, 6}};
+    thresholdSweep["Amplitudes"] = QJsonArray{1, 2, 3};
+    thresholdSweep["Pulsewidths"] = QJsonArray{60};
+    thresholdSweep["Frequencies"] = QJsonArray{130};
+    thresholdSweep["Duration"] = 5;
+    thresholdSweep["Rest"] = 5;
+
+    QJsonObject sweepDefinition;
+    sweepDefinition["StimulationName"] = "Benchmark Sweep";
+    sweepDefinition["AnalogWaveforms"] = QJsonArray{"Wave1.bin", "Wave2.bin", "Wave3.bin", "Wave4.bin", "Wave5.bin"};
+    sweepDefinition["Sweeps"] = QJsonArray{ernaSweep, thresholdSweep};
+    sweepDefinition["Repetitions"] = 3;
+    sweepDefinition["Randomize"] = QJsonArray{"Contacts", "Amplitudes"};
+    sweepDefinition["Seed"] = 1;
+
+    ProtocolCompiler compiler;
+    compiler.setCosts(ProtocolCompiler::measuredCosts());
+    runner.run("Protocol/Compile", "trials", 200 * scale, [&]() {
+        compiler.compile(sweepDefinition);
+        return (qint64) (ernaSweep["Contacts"].toArray().size() * 5 + 6) * 3;
+    }, QJsonObject{{"Blocks", 3}});
+
+    QJsonObject planObject = compiler.report();
+    planObject.remove("Timeline");
+
+    // A drawn seed must reproduce the same order when the logged protocol is compiled again
+    sweepDefinition.remove("Seed");
+    compiler.compile(sweepDefinition);
+    QJsonObject drawnProtocol = compiler.compiledDocument().object();
+    sweepDefinition["Seed"] = drawnProtocol["Seed"];
+    compiler.compile(sweepDefinition);
+    QJsonObject replayedProtocol = compiler.compiledDocument().object();
+    planObject["DrawnSeed"] = drawnProtocol["Seed"];
+    planObject["SeedReproducible"] = QJsonValue(replayedProtocol.value("Seed") == drawnProtocol.value("Seed") &&
+                                                 replayedProtocol.value("StimulationSequence") == drawnProtocol.value("StimulationSequence"));
+    runner.addResult("Protocol/Plan", planObject);
+}
+
+// A six-hour case logs roughly one object per second (labels, stimulation, quality, depth).
+static QJsonObject sessionEntry(int index)
+{
+    QJsonObject entry;
+    entry["ObjectType"] = QJsonValue(index % 3 == 0 ? "Label" : (index % 3 == 1 ? "StimulationOn" : "ContactQuality"));
+    entry["Time"] = QJsonValue(QString("2021/01/01 %1:%2:%3").arg(index / 3600 % 24, 2, 10, QChar('0')).arg(index / 60 % 60, 2, 10, QChar('0')).arg(index % 60, 2, 10, QChar('0')));
+    entry["Annotation"] = QJsonValue(QString("Benchmark entry %1").arg(index));
+    entry["Amplitude"] = QJsonValue(index % 50 / 10.0);
+    entry["Contacts"] = QJsonArray{index % 8, (index + 1) % 8};
+    return entry;
+}
+
+static void benchmarkJSONStorage(BenchmarkRunner &runner, int scale, QString workDirectory)
+{
+    int entriesPerIteration = 100;
+    JSONStorage appendStorage(workDirectory + "/", "BenchmarkAppend.json");
+    int entryCounter = 0;
+    runner.run("JSONStorage/Append", "objects", 200 * scale, [&]() {
+        for (int i = 0; i < entriesPerIteration; i++) appendStorage.addJSON(sessionEntry(entryCounter++));
+        return (qint64) entriesPerIteration;
+    }, QJsonObject{{"ObjectsPerIteration", entriesPerIteration}});
+
+    if (!runner.selected("JSONStorage/SaveLargeSession")) return;
+
+    int sessionEntries = 6 * 3600;
+    JSONStorage sessionStorage(workDirectory + "/", "BenchmarkSession.json");
+    for (int i = 0; i < sessionEntries; i++) sessionStorage.addJSON(sessionEntry(i));
+
+    runner.run("JSONStorage/SaveLargeSession", "bytes", 5 * scale, [&]() {
+        sessionStorage.saveJSON();
+        return QFileInfo(workDirectory + "/BenchmarkSession.json").size();
+    }, QJsonObject{{"Objects", sessionEntries}});
+}
+
+static void benchmarkChannelTable(BenchmarkRunner &runner, int scale)
+{
+    uint32 channelCount = 0;
+    AO_CALL(GetChannelsCount)(&channelCount);
+
+    if (runner.selected("ChannelTable/Setup"))
+    {
+        DetailChannelsList channelListView;
+        runner.run("ChannelTable/Setup", "rows", 20 * scale, [&]() {
+            channelListView.setupChannels();
+            return (qint64) channelCount;
+        }, QJsonObject{{"Channels", (int) channelCount}});
+    }
+
+    // 28-contact ECoG strip plus two 4-contact DBS leads, alternating hemisphere between iterations
+    // so that every iteration renames all contacts, as when the operator reconfigures the leads.
+    if (runner.selected("ChannelTable/Configure"))
+    {
+        ChannelConfigurationEngine *channelConfiguration = ChannelConfigurationEngine::instance();
+        ChannelCatalog::instance()->refresh(true);
+
+        int iteration = 0;
+        runner.run("ChannelTable/Configure", "configurations", 20 * scale, [&]() {
+            QString hemisphere = (iteration++ % 2 == 0) ? "Left" : "Right";
+            channelConfiguration->beginConfiguration();
+            channelConfiguration->setSaveStates(ECOG_FIRST_CHANNEL, ECOG_LAST_CHANNEL, false);
+            for (int j = 0; j < 28; j++)
+            {
+                channelConfiguration->setChannelName(ECOG_FIRST_CHANNEL + j, "Lead_1_" + hemisphere + "_Cortex_" + QString::number(j));
+                channelConfiguration->setSaveState(ECOG_FIRST_CHANNEL + j, true);
+            }
+            for (int j = 0; j < 8; j++)
+            {
+                channelConfiguration->setChannelName(ECOG_FIRST_CHANNEL + 32 + j, "Lead_" + QString::number(2 + j / 4) + "_" + hemisphere + "_STN_" + QString::number(j % 4));
+                channelConfiguration->setSaveState(ECOG_FIRST_CHANNEL + 32 + j, true);
+            }
+            channelConfiguration->setSaveState(11221, true);
+            channelConfiguration->apply();
+            return (qint64) 1;
+        }, QJsonObject{{"Contacts", 36}});
+        runner.addResult("ChannelTable/ConfigureCalls", channelConfiguration->report());
+
+        channelConfiguration->beginConfiguration();
+        channelConfiguration->setDefaultNames(ECOG_FIRST_CHANNEL, ECOG_LAST_CHANNEL);
+        channelConfiguration->apply();
+    }
+}
+
+// Contact clicks on a 28-contact ECoG grid. Every click should touch at most the clicked contact and the previous return.
+static void benchmarkContactSelection(BenchmarkRunner &runner, int scale)
+{
+    QVector<int> channelIDs;
+    QStringList labels;
+    for (int i = 0; i < 28; i++)
+    {
+        channelIDs.append(ECOG_FIRST_CHANNEL + i);
+        labels.append(QString::number(i));
+    }
+
+    ContactSelectionModel contactSelection;
+    contactSelection.setLayout(channelIDs, labels);
+
+    qint64 contactUpdates = 0;
+    QObject::connect(&contactSelection, &ContactSelectionModel::contactChanged, [&](int, int) { contactUpdates++; });
+
+    int click = 0;
+    runner.run("ContactSelection/Click", "clicks", 20000 * scale, [&]() {
+        contactSelection.cycleContact((click++ * 11) % 28);
+        contactSelection.anodeChannels();
+        return (qint64) 1;
+    }, QJsonObject{{"Contacts", 28}});
+    runner.addResult("ContactSelection/ContactUpdates", QJsonObject{{"Clicks", click}, {"ContactUpdates", contactUpdates}});
+}
+
+// One 30 fps overlay frame on a 2x14 ECoG grid: new values for every contact, then a full repaint.
+static void benchmarkElectrodeGrid(BenchmarkRunner &runner, int scale)
+{
+    QStringList labels;
+    for (int i = 0; i < 28; i++) labels.append(QString::number(i));
+
+    ElectrodeGridWidget electrodeGrid;
+    electrodeGrid.resize(340, 570);
+    electrodeGrid.setElectrodeLayout(14, 28, labels);
+
+    QImage frame(340, 570, QImage::Format_ARGB32_Premultiplied);
+    QVector<float> values(28);
+    int iteration = 0;
+    runner.run("ElectrodeGrid/OverlayFrame", "frames", 500 * scale, [&]() {
+        for (int i = 0; i < values.size(); i++) values[i] = (float) sin(0.1 * iteration + i);
+        iteration++;
+        electrodeGrid.setOverlayValues(values, -1, 1);
+        electrodeGrid.render(&frame);
+        return (qint64) 1;
+    }, QJsonObject{{"Contacts", 28}, {"Width", 340}, {"Height", 570}});
+}
+
+// One spectrogram column: 50 ms of the 2 kHz "Downsample" output through a 1024-point STFT, then drained.
+static void benchmarkSpectrogram(BenchmarkRunner &runner, int scale)
+{
+    double samplingRate = NEUROOMEGA_SAMPLING_RATE / 22.0;
+    int hopSize = (int)round(0.05 * samplingRate);
+
+    StreamingSTFT stft;
+    stft.configure(1024, hopSize, samplingRate, 100);
+
+    QVector<int16> signal = syntheticSignal(hopSize * 64, 20, 1000);
+    QVector<float> input(signal.size());
+    for (int i = 0; i < signal.size(); i++) input[i] = signal[i];
+    QVector<float> columns(stft.bins() * 4);
+
+    int offset = 0;
+    runner.run("Spectrogram/STFTColumn", "columns", 5000 * scale, [&]() {
+        stft.push(input.constData() + offset, hopSize);
+        offset = (offset + hopSize) % input.size();
+        return (qint64) stft.takeColumns(columns.data(), 4);
+    }, QJsonObject{{"FFTSize", 1024}, {"HopSize", hopSize}, {"Bins", stft.bins()}});
+}
+
+// Parsing InterfaceConfigurations.json, which each dialog used to do on open, against the cached lookups they do now.
+static void benchmarkInterfaceConfiguration(BenchmarkRunner &runner, int scale, QString dataDirectory)
+{
+    InterfaceConfiguration *interfaceConfiguration = InterfaceConfiguration::instance();
+    QString filename = dataDirectory + "/InterfaceConfigurations.json";
+
+    runner.run("InterfaceConfiguration/Parse", "files", 200 * scale, [&]() {
+        interfaceConfiguration->load(filename);
+        return (qint64) 1;
+    }, QJsonObject{{"Bytes", QFileInfo(filename).size()}});
+
+    runner.run("InterfaceConfiguration/DialogLookup", "dialogs", 20000 * scale, [&]() {
+        qint64 found = interfaceConfiguration->electrodeNames().size() + interfaceConfiguration->targets().size();
+        for (int i = 0; i < interfaceConfiguration->tasks().size(); i++)
+        {
+            if (interfaceConfiguration->task(interfaceConfiguration->tasks()[i].taskName) != nullptr) found++;
+        }
+        return found > 0 ? (qint64) 1 : (qint64) 0;
+    }, QJsonObject{{"Tasks", interfaceConfiguration->tasks().size()}});
+}
+
+// A synthetic case: one STN lead and an ERNA protocol of 40 stages alternating over the four contacts.
+static void writeCatalogSession(QString directory, int sessionIndex)
+{
+    JSONStorage sessionStorage(directory + "/", QString("Session%1.json").arg(sessionIndex));
+    QDateTime startTime = QDateTime::fromString("2021/01/01 08:00:00", "yyyy/MM/dd HH:mm:ss").addSecs(sessionIndex * 86400);
+    sessionStorage.addJSON(QJsonObject{{"Name", QString("Patient%1").arg(sessionIndex % 10)}, {"Diagnosis", "PD"}, {"Time", startTime.toString("yyyy/MM/dd HH:mm:ss")}});
+    sessionStorage.addJSON(QJsonObject{{"ObjectType", "ElectrodeConfigurations"}, {"Lead1", QString(sessionIndex % 2 == 0 ? "Medtronic 3387 Left STN" : "Medtronic 3387 Right GPi")},
+                                       {"Lead1Channels", QJsonArray{10272, 10273, 10274, 10275}}, {"Time", startTime.toString("yyyy/MM/dd HH:mm:ss")}});
+    for (int i = 0; i < 40; i++)
+    {
+        sessionStorage.addJSON(QJsonObject{{"ObjectType", "SequenceStage"}, {"Stage", i + 1}, {"StimulationType", i % 2 == 0 ? "Novel" : "Baseline"}, {"RecordingFilename", "ERNA"},
+                                           {"StimulationLead", 0}, {"StimulationContacts", QJsonArray{(i / 2) % 4}}, {"StimulationReturn", -1}, {"Duration", 10},
+                                           {"Time", startTime.addSecs(60 + i * 10).toString("yyyy/MM/dd HH:mm:ss")}});
+        if (i % 10 == 0) sessionStorage.addJSON(QJsonObject{{"ObjectType", "Label"}, {"LabelText", "Test Benefit"}, {"Time", startTime.addSecs(60 + i * 10).toString("yyyy/MM/dd HH:mm:ss")}});
+    }
+    sessionStorage.addJSON(QJsonObject{{"ObjectType", "StimulationOff"}, {"Time", startTime.addSecs(500).toString("yyyy/MM/dd HH:mm:ss")}});
+    sessionStorage.saveJSON();
+}
+
+// Indexing one session log, and "all ERNA stages on STN contact 2 across cases" against 200 indexed sessions.
+static void benchmarkSessionCatalog(BenchmarkRunner &runner, int scale, QString workDirectory)
+{
+    int numSessions = 200;
+    QString logFolder = workDirectory + "/SurgicalLogs";
+    QDir().mkpath(logFolder);
+    for (int i = 0; i < numSessions; i++) writeCatalogSession(logFolder, i);
+
+    SessionCatalog catalog("SessionCatalogBenchmark");
+    if (!catalog.open(workDirectory + "/SessionCatalog.sqlite")) return;
+    catalog.setElectrodeDefinitions(InterfaceConfiguration::instance()->electrodeDefinitions());
+
+    int session = 0;
+    runner.run("SessionCatalog/IndexSession", "sessions", 2 * numSessions * scale, [&]() {
+        return catalog.indexSessionLog(QString("%1/Session%2.json").arg(logFolder).arg(session++ % numSessions)) ? (qint64) 1 : (qint64) 0;
+    }, QJsonObject{{"StagesPerSession", 40}});
+
+    StimulationEventQuery query;
+    query.recordingName = "ERNA";
+    query.target = "STN";
+    query.contact = 2;
+    qint64 matches = 0;
+    runner.run("SessionCatalog/QueryStagesOnContact", "queries", 200 * scale, [&]() {
+        matches = catalog.stimulationEvents(query).size();
+        return (qint64) 1;
+    }, QJsonObject{{"Sessions", numSessions}});
+    runner.addResult("SessionCatalog/QueryMatches", QJsonObject{{"Matches", matches}});
+}
+
+int main(int argc, char *argv[])
+{
+    // Widgets are only needed for the channel table; render offscreen so the suite runs headless.
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication application(argc, argv);
+    QCoreApplication::setApplicationName("NeuroOmega_Benchmarks");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Microbenchmarks and macrobenchmarks of the NeuroOmega application hot paths, run against the simulator SDK.");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("output", "Write the JSON results to <file> instead of stdout.", "file"));
+    parser.addOption(QCommandLineOption("filter", "Only run benchmarks whose name matches <regex>.", "regex"));
+    parser.addOption(QCommandLineOption("scale", "Multiply every iteration count by <factor>.", "factor", "1"));
+    parser.addOption(QCommandLineOption("stream-seconds", "Duration of the real-time acquisition benchmark.", "seconds", "5"));
+    parser.addOption(QCommandLineOption("data", "Directory holding FilterGraphs.json and the stimulation sequences.", "directory", BENCHMARK_SOURCE_DIRECTORY));
+    parser.process(application);
+
+    int scale = qMax(1, parser.value("scale").toInt());
+    QString dataDirectory = parser.value("data");
+
+    // A zero-latency, fault-free simulator unless the caller points NEUROOMEGA_SIMULATOR_CONFIGURATION elsewhere
+    if (!qEnvironmentVariableIsSet("NEUROOMEGA_SIMULATOR_CONFIGURATION"))
+    {
+        qputenv("NEUROOMEGA_SIMULATOR_CONFIGURATION", QString(BENCHMARK_SOURCE_DIRECTORY "/benchmarks/BenchmarkSimulatorConfiguration.json").toLocal8Bit());
+    }
+
+    MAC_ADDR sysMACAddress = {0};
+    if (AO_CALL(DefaultStartConnection)(&sysMACAddress, nullptr) != eAO_OK)
+    {
+        QTextStream(stderr) << "Cannot connect to the simulator" << Qt::endl;
+        return 1;
+    }
+
+    QTemporaryDir workDirectory;
+    if (!workDirectory.isValid()) return 1;
+
+    BenchmarkRunner runner(parser.value("filter"));
+    benchmarkCircularBuffer(runner, scale);
+    benchmarkStreamDecode(runner, scale);
+    benchmarkTraceViewer(runner, scale);
+    benchmarkShadowRecording(runner, scale, workDirectory.path());
+    benchmarkClockSynchronizer(runner, scale);
+    benchmarkLabelDispatcher(runner, scale);
+    benchmarkFilterGraph(runner, scale, dataDirectory);
+    benchmarkWaveformLoading(runner, scale, workDirectory.path());
+    benchmarkSequencer(runner, scale, dataDirectory);
+    benchmarkProtocolCompiler(runner, scale);
+    benchmarkJSONStorage(runner, scale, workDirectory.path());
+    benchmarkSessionCatalog(runner, scale, workDirectory.path());
+    benchmarkChannelTable(runner, scale);
+    benchmarkContactSelection(runner, scale);
+    benchmarkElectrodeGrid(runner, scale);
+    benchmarkSpectrogram(runner, scale);
+    benchmarkInterfaceConfiguration(runner, scale, dataDirectory);
+    benchmarkStreamAcquisition(runner, parser.value("stream-seconds").toDouble());
+
+    AO_CALL(CloseConnection)();
+
+    QJsonObject resultObject = runner.results();
+    QJsonObject configurationObject;
+    configurationObject["Scale"] = QJsonValue(scale);
+    configurationObject["Filter"] = QJsonValue(parser.value("filter"));
+    configurationObject["SimulatorConfiguration"] = QJsonValue(qEnvironmentVariable("NEUROOMEGA_SIMULATOR_CONFIGURATION"));
+    configurationObject["QtVersion"] = QJsonValue(qVersion());
+    configurationObject["IdealThreadCount"] = QJsonValue(QThread::idealThreadCount());
+#ifdef QT_DEBUG
+    configurationObject["Build"] = QJsonValue("Debug");
+#else
+    configurationObject["Build"] = QJsonValue("Release");
+#endif
+    resultObject["Configuration"] = configurationObject;
+    resultObject["SDKInstrumentation"] = SDKInstrumentation::instance()->toJson();
+
+    QDateTime currentTime;
+    resultObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+
+    QByteArray resultData = QJsonDocument(resultObject).toJson();
+    if (parser.isSet("output"))
+    {
+        QFile file(parser.value("output"));
+        if (!file.open(QFile::WriteOnly | QFile::Truncate)) return 1;
+        file.write(resultData);
+        file.close();
+    }
+    else
+    {
+        QTextStream(stdout) << resultData;
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#include "benchmarkrunner.h"
+
+BenchmarkRunner::BenchmarkRunner(QString filter) :
+    console(stderr)
+{
+    if (!filter.isEmpty()) filterExpression = QRegularExpression(filter);
+}
+
+bool BenchmarkRunner::selected(QString name) const
+{
+    if (!filterExpression.isValid() || filterExpression.pattern().isEmpty()) return true;
+    return filterExpression.match(name).hasMatch();
+}
+
+void BenchmarkRunner::run(QString name, QString unit, int iterations, BenchmarkBody body, QJsonObject parameters)
+{
+    if (!selected(name) || iterations <= 0) return;
+
+    int warmupIterations = qMax(1, iterations / 10);
+    for (int i = 0; i < warmupIterations; i++) body();
+
+    LatencyHistogram *histogram = new LatencyHistogram();
+    qint64 totalWork = 0;
+    qint64 benchmarkStart = monotonicNanoseconds();
+    for (int i = 0; i < iterations; i++)
+    {
+        qint64 iterationStart = monotonicNanoseconds();
+        totalWork += body();
+        histogram->record(monotonicNanoseconds() - iterationStart);
+    }
+    double totalSeconds = (monotonicNanoseconds() - benchmarkStart) / 1e9;
+
+    QJsonObject result;
+    result["Iterations"] = QJsonValue(iterations);
+    result["TotalSeconds"] = QJsonValue(totalSeconds);
+    result["Unit"] = QJsonValue(unit);
+    result["Work"] = QJsonValue(totalWork);
+    result["Throughput"] = QJsonValue(totalSeconds > 0 ? totalWork / totalSeconds : 0);
+    result["Latency"] = histogram->toJson();
+    result["Parameters"] = parameters;
+    delete histogram;
+
+    addResult(name, result);
+}
+
+void BenchmarkRunner::addResult(QString name, QJsonObject result)
+{
+    result["Name"] = QJsonValue(name);
+    benchmarkArray.append(result);
+
+    // Human-readable progress goes to stderr so stdout stays valid JSON
+    QJsonObject latency = result["Latency"].toObject();
+    console << QString("%1  %2 %3/s  p50 %4 us  p99 %5 us")
+               .arg(name, -40)
+               .arg(result["Throughput"].toDouble(), 0, 'g', 4)
+               .arg(result["Unit"].toString())
+               .arg(latency["P50Microseconds"].toDouble(), 0, 'f', 1)
+               .arg(latency["P99Microseconds"].toDouble(), 0, 'f', 1) << Qt::endl;
+}
+
+QJsonObject BenchmarkRunner::results() const
+{
+    QJsonObject resultObject;
+    resultObject["Benchmarks"] = benchmarkArray;
+    return resultObject;
+}
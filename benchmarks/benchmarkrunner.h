@@ -0,0 +1,53 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#ifndef BENCHMARKRUNNER_H
+#define BENCHMARKRUNNER_H
+
+#include <QString>
+#include <QRegularExpression>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QTextStream>
+
+#include <functional>
+
+#include "latencyhistogram.h"
+#include "streamdatahandler.h"
+
+// One benchmark iteration. Returns the amount of work done (samples, bytes, rows...) for the throughput figure.
+typedef std::function<qint64()> BenchmarkBody;
+
+// Times benchmark bodies into a LatencyHistogram per benchmark and collects machine-readable results.
+// Every benchmark is preceded by untimed warm-up iterations so allocations and caches settle first.
+class BenchmarkRunner
+{
+public:
+    BenchmarkRunner(QString filter = "");
+
+    bool selected(QString name) const;
+    void run(QString name, QString unit, int iterations, BenchmarkBody body, QJsonObject parameters = QJsonObject());
+    void addResult(QString name, QJsonObject result);
+
+    QJsonObject results() const;
+
+private:
+    QRegularExpression filterExpression;
+    QJsonArray benchmarkArray;
+    QTextStream console;
+};
+
+#endif // BENCHMARKRUNNER_H
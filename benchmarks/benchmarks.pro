@@ -0,0 +1,85 @@
+#-------------------------------------------------
+#
+# Benchmark suite for the NeuroOmega application hot paths.
+# Always built against the simulator SDK, so it runs without hardware:
+#   qmake benchmarks.pro && make && ./NeuroOmega_Benchmarks --output results.json
+#
+#-------------------------------------------------
+
+QT       += core gui widgets sql
+
+TARGET = NeuroOmega_Benchmarks
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS NEUROOMEGA_SIMULATOR
+DEFINES += BENCHMARK_SOURCE_DIRECTORY=\\\"$$clean_path($$PWD/..)\\\"
+
+INCLUDEPATH += $$PWD/.. \
+    $$PWD/../NeuroOmega_SDK/Include \
+    $$PWD/../NeuroOmega_Simulator
+!win32: INCLUDEPATH += $$PWD/../NeuroOmega_Simulator/compat
+
+SOURCES += benchmarkmain.cpp \
+    benchmarkrunner.cpp \
+    ../NeuroOmega_Simulator/neuroomegasimulator.cpp \
+    ../streamdatahandler.cpp \
+    ../workerthread.cpp \
+    ../latencyhistogram.cpp \
+    ../sdkinstrumentation.cpp \
+    ../eventloopprofiler.cpp \
+    ../filtergraph.cpp \
+    ../rereferencemontage.cpp \
+    ../jsonstorage.cpp \
+    ../channelcatalog.cpp \
+    ../channelconfigurationengine.cpp \
+    ../channeltablemodel.cpp \
+    ../traceviewer.cpp \
+    ../contactselectionmodel.cpp \
+    ../electrodegridwidget.cpp \
+    ../streamingstft.cpp \
+    ../interfaceconfiguration.cpp \
+    ../electrodeconfigurations.cpp \
+    ../channelselectiondialog.cpp \
+    ../sessioncatalog.cpp \
+    ../shadowrecordingwriter.cpp \
+    ../clocksynchronizer.cpp \
+    ../labeldispatcher.cpp \
+    ../protocolcompiler.cpp \
+    ../detailchannelslist.cpp \
+    ../contactqualityestimator.cpp
+
+HEADERS += benchmarkrunner.h \
+    ../NeuroOmega_Simulator/neuroomegasimulator.h \
+    ../streamdatahandler.h \
+    ../workerthread.h \
+    ../latencyhistogram.h \
+    ../sdkinstrumentation.h \
+    ../eventloopprofiler.h \
+    ../filtergraph.h \
+    ../rereferencemontage.h \
+    ../jsonstorage.h \
+    ../channelcatalog.h \
+    ../channelconfigurationengine.h \
+    ../channeltablemodel.h \
+    ../traceviewer.h \
+    ../contactselectionmodel.h \
+    ../electrodegridwidget.h \
+    ../streamingstft.h \
+    ../interfaceconfiguration.h \
+    ../electrodeconfigurations.h \
+    ../channelselectiondialog.h \
+    ../sessioncatalog.h \
+    ../shadowrecordingwriter.h \
+    ../clocksynchronizer.h \
+    ../labeldispatcher.h \
+    ../protocolcompiler.h \
+    ../detailchannelslist.h \
+    ../contactqualityestimator.h
+
+FORMS += ../detailchannelslist.ui \
+    ../electrodeconfigurations.ui \
+    ../channelselectiondialog.ui
+
+DISTFILES += BenchmarkSimulatorConfiguration.json
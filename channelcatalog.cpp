@@ -0,0 +1,153 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "channelcatalog.h"
+#include "sdkinstrumentation.h"
+
+#include <algorithm>
+
+ChannelCatalog *ChannelCatalog::instance()
+{
+    static ChannelCatalog channelCatalog;
+    return &channelCatalog;
+}
+
+bool ChannelCatalog::refresh(bool refreshSaveStates)
+{
+    PROFILE_SCOPE("ChannelCatalog::refresh");
+
+    uint32 channelCount = 0;
+    int result = AO_CALL(GetChannelsCount)(&channelCount);
+    if (result != eAO_OK)
+    {
+        lastError = sdkErrorLog();
+        return false;
+    }
+
+    // Heap buffer; large systems would overflow a stack array
+    QVector<SInformation> channelsInfo((int)channelCount);
+    result = AO_CALL(GetAllChannels)(channelsInfo.data(), channelCount);
+    if (result != eAO_OK)
+    {
+        lastError = sdkErrorLog();
+        return false;
+    }
+
+    QVector<ChannelState> updatedCatalog((int)channelCount);
+    for (unsigned i = 0; i < channelCount; i++)
+    {
+        updatedCatalog[i].channelID = channelsInfo[i].channelID;
+        updatedCatalog[i].channelName = QString(channelsInfo[i].channelName);
+    }
+    std::sort(updatedCatalog.begin(), updatedCatalog.end(), [](const ChannelState &a, const ChannelState &b) { return a.channelID < b.channelID; });
+
+    // Known channels keep their cached save state; only new channels are queried.
+    for (int i = 0; i < updatedCatalog.size(); i++)
+    {
+        const ChannelState *cached = valid ? find(updatedCatalog[i].channelID) : nullptr;
+        if (cached != nullptr && !refreshSaveStates)
+        {
+            updatedCatalog[i].saveState = cached->saveState;
+            continue;
+        }
+
+        int saveState = 0;
+        result = AO_CALL(GetChannelSaveState)(updatedCatalog[i].channelID, &saveState);
+        if (result != eAO_OK)
+        {
+            lastError = sdkErrorLog();
+            return false;
+        }
+        updatedCatalog[i].saveState = saveState != 0;
+    }
+
+    catalog = updatedCatalog;
+    catalogIndex.clear();
+    for (int i = 0; i < catalog.size(); i++) catalogIndex[catalog[i].channelID] = i;
+    valid = true;
+    return true;
+}
+
+bool ChannelCatalog::isValid() const
+{
+    return valid;
+}
+
+// Forces the next refresh to re-read every save state.
+void ChannelCatalog::invalidate()
+{
+    valid = false;
+}
+
+int ChannelCatalog::size() const
+{
+    return catalog.size();
+}
+
+const QVector<ChannelState> &ChannelCatalog::channels() const
+{
+    return catalog;
+}
+
+const ChannelState *ChannelCatalog::find(int channelID) const
+{
+    auto entry = catalogIndex.find(channelID);
+    if (entry == catalogIndex.end()) return nullptr;
+    return &catalog[entry.value()];
+}
+
+bool ChannelCatalog::contains(int channelID) const
+{
+    return catalogIndex.contains(channelID);
+}
+
+QString ChannelCatalog::channelName(int channelID) const
+{
+    const ChannelState *channel = find(channelID);
+    return channel != nullptr ? channel->channelName : QString();
+}
+
+bool ChannelCatalog::saveState(int channelID) const
+{
+    const ChannelState *channel = find(channelID);
+    return channel != nullptr && channel->saveState;
+}
+
+QVector<int> ChannelCatalog::channelIDs(int firstChannelID, int lastChannelID) const
+{
+    QVector<int> rangeIDs;
+    auto first = std::lower_bound(catalog.begin(), catalog.end(), firstChannelID, [](const ChannelState &channel, int channelID) { return channel.channelID < channelID; });
+    for (auto channel = first; channel != catalog.end() && channel->channelID <= lastChannelID; ++channel) rangeIDs.append(channel->channelID);
+    return rangeIDs;
+}
+
+void ChannelCatalog::updateChannelName(int channelID, QString channelName)
+{
+    auto entry = catalogIndex.find(channelID);
+    if (entry != catalogIndex.end()) catalog[entry.value()].channelName = channelName;
+}
+
+void ChannelCatalog::updateSaveState(int channelID, bool saveState)
+{
+    auto entry = catalogIndex.find(channelID);
+    if (entry != catalogIndex.end()) catalog[entry.value()].saveState = saveState;
+}
+
+QString ChannelCatalog::errorMessage() const
+{
+    return lastError;
+}
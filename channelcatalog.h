@@ -0,0 +1,78 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef CHANNELCATALOG_H
+#define CHANNELCATALOG_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+
+#if defined(QT_DEBUG) || defined(NEUROOMEGA_SIMULATOR)
+#include "AOSystemAPI_TEST.h"
+#else
+#include "AOSystemAPI.h"
+#endif
+#include "AOTypes.h"
+
+// ECoG HF channels share the 64-channel block 10272 - 10335 (4 boxes of 16 contacts).
+#define ECOG_FIRST_CHANNEL 10272
+#define ECOG_LAST_CHANNEL 10335
+
+typedef struct ChannelState
+{
+    int channelID = 0;
+    QString channelName = "";
+    bool saveState = false;
+} ChannelState;
+
+// Cached copy of the NeuroOmega channel table. Channels are kept in a flat array sorted by ID with a hash index,
+// so lookups are O(1) and ID ranges are contiguous. Names cost one GetAllChannels call to refresh; save states cost
+// one call per channel and are only read for channels the catalog has not seen, unless a full refresh is requested.
+// Writers (ChannelConfigurationEngine) report successful changes back with update*(). Used from the GUI thread only.
+class ChannelCatalog
+{
+public:
+    static ChannelCatalog *instance();
+
+    bool refresh(bool refreshSaveStates = false);
+    bool isValid() const;
+    void invalidate();
+
+    int size() const;
+    const QVector<ChannelState> &channels() const;
+    const ChannelState *find(int channelID) const;
+    bool contains(int channelID) const;
+    QString channelName(int channelID) const;
+    bool saveState(int channelID) const;
+    QVector<int> channelIDs(int firstChannelID, int lastChannelID) const;
+
+    void updateChannelName(int channelID, QString channelName);
+    void updateSaveState(int channelID, bool saveState);
+
+    QString errorMessage() const;
+
+private:
+    ChannelCatalog() {}
+
+    QVector<ChannelState> catalog;
+    QHash<int, int> catalogIndex;
+    bool valid = false;
+    QString lastError = "";
+};
+
+#endif // CHANNELCATALOG_H
@@ -0,0 +1,180 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "channelconfigurationengine.h"
+#include "sdkinstrumentation.h"
+
+ChannelConfigurationEngine *ChannelConfigurationEngine::instance()
+{
+    static ChannelConfigurationEngine engine;
+    return &engine;
+}
+
+// Desired state starts from the catalog; anything not set below is left untouched.
+void ChannelConfigurationEngine::beginConfiguration()
+{
+    const QVector<ChannelState> &channels = ChannelCatalog::instance()->channels();
+    desiredState.clear();
+    for (int i = 0; i < channels.size(); i++) desiredState[channels[i].channelID] = channels[i];
+    requestedNames.clear();
+    requestedSaveStates.clear();
+}
+
+void ChannelConfigurationEngine::setChannelName(int channelID, QString channelName)
+{
+    if (!desiredState.contains(channelID)) return;
+    desiredState[channelID].channelName = channelName;
+    requestedNames.insert(channelID);
+}
+
+void ChannelConfigurationEngine::setSaveState(int channelID, bool saveState)
+{
+    if (!desiredState.contains(channelID)) return;
+    desiredState[channelID].saveState = saveState;
+    requestedSaveStates.insert(channelID);
+}
+
+void ChannelConfigurationEngine::setSaveStates(int firstChannelID, int lastChannelID, bool saveState)
+{
+    QVector<int> channelIDs = ChannelCatalog::instance()->channelIDs(firstChannelID, lastChannelID);
+    for (int i = 0; i < channelIDs.size(); i++) setSaveState(channelIDs[i], saveState);
+}
+
+void ChannelConfigurationEngine::setDefaultNames(int firstChannelID, int lastChannelID)
+{
+    QVector<int> channelIDs = ChannelCatalog::instance()->channelIDs(firstChannelID, lastChannelID);
+    for (int i = 0; i < channelIDs.size(); i++)
+    {
+        QString channelName = defaultChannelName(channelIDs[i]);
+        if (!channelName.isEmpty()) setChannelName(channelIDs[i], channelName);
+    }
+}
+
+ChannelConfigurationPlan ChannelConfigurationEngine::plan() const
+{
+    ChannelConfigurationPlan configurationPlan;
+    const QVector<ChannelState> &channels = ChannelCatalog::instance()->channels();
+
+    QHash<QString, int> nameOwners;
+    QSet<int> renamedChannels;
+    for (int i = 0; i < channels.size(); i++)
+    {
+        const ChannelState &current = channels[i];
+        nameOwners[current.channelName] = current.channelID;
+        if (desiredState[current.channelID].channelName != current.channelName) renamedChannels.insert(current.channelID);
+    }
+
+    QSet<int> temporaryChannels;
+    for (int i = 0; i < channels.size(); i++)
+    {
+        const ChannelState &current = channels[i];
+        const ChannelState &desired = desiredState[current.channelID];
+
+        if (renamedChannels.contains(current.channelID))
+        {
+            int owner = nameOwners.value(desired.channelName, 0);
+            if (owner != 0 && owner != current.channelID && renamedChannels.contains(owner) && !temporaryChannels.contains(owner))
+            {
+                ChannelState temporary;
+                temporary.channelID = owner;
+                temporary.channelName = "temp_" + QString::number(owner);
+                configurationPlan.temporaryNames.append(temporary);
+                temporaryChannels.insert(owner);
+            }
+            configurationPlan.channelNames.append(desired);
+        }
+        else if (requestedNames.contains(current.channelID))
+        {
+            configurationPlan.unchanged++;
+        }
+
+        if (desired.saveState != current.saveState) configurationPlan.saveStates.append(desired);
+        else if (requestedSaveStates.contains(current.channelID)) configurationPlan.unchanged++;
+    }
+
+    return configurationPlan;
+}
+
+// Renames go first so a channel is never recorded under a stale name once its save state flips on.
+bool ChannelConfigurationEngine::apply()
+{
+    PROFILE_SCOPE("ChannelConfigurationEngine::apply");
+
+    QElapsedTimer elapsedTimer;
+    elapsedTimer.start();
+
+    ChannelConfigurationPlan configurationPlan = plan();
+    appliedCalls = 0;
+    skippedChanges = configurationPlan.unchanged;
+    lastError = "";
+
+    QList<ChannelState> renames = configurationPlan.temporaryNames + configurationPlan.channelNames;
+    for (int i = 0; i < renames.size(); i++)
+    {
+        QByteArray channelName = renames[i].channelName.toLatin1();
+        int result = AO_CALL(SetChannelName)(renames[i].channelID, channelName.data(), channelName.length());
+        appliedCalls++;
+        if (result != eAO_OK)
+        {
+            lastError = sdkErrorLog();
+            applyElapsed = elapsedTimer.elapsed();
+            return false;
+        }
+        ChannelCatalog::instance()->updateChannelName(renames[i].channelID, renames[i].channelName);
+    }
+
+    for (int i = 0; i < configurationPlan.saveStates.size(); i++)
+    {
+        int result = AO_CALL(SetChannelSaveState)(configurationPlan.saveStates[i].channelID, configurationPlan.saveStates[i].saveState);
+        appliedCalls++;
+        if (result != eAO_OK)
+        {
+            lastError = sdkErrorLog();
+            applyElapsed = elapsedTimer.elapsed();
+            return false;
+        }
+        ChannelCatalog::instance()->updateSaveState(configurationPlan.saveStates[i].channelID, configurationPlan.saveStates[i].saveState);
+    }
+
+    applyElapsed = elapsedTimer.elapsed();
+    return true;
+}
+
+// Default ECoG HF channel names are "ECOG HF 1 / 01 - Array 1 / 01". Other channels have no default here.
+QString ChannelConfigurationEngine::defaultChannelName(int channelID)
+{
+    if (channelID < ECOG_FIRST_CHANNEL || channelID > ECOG_LAST_CHANNEL) return "";
+
+    int boxID = (channelID - ECOG_FIRST_CHANNEL) / 16;
+    int contactID = (channelID - ECOG_FIRST_CHANNEL) % 16;
+    return "ECOG HF " + QString::number(boxID+1) + " / " + QStringLiteral("%1").arg(contactID+1, 2, 10, QLatin1Char('0')) + " - Array " + QString::number(boxID+1) + " / " + QStringLiteral("%1").arg(contactID+1, 2, 10, QLatin1Char('0'));
+}
+
+QString ChannelConfigurationEngine::errorMessage() const
+{
+    return lastError;
+}
+
+QJsonObject ChannelConfigurationEngine::report() const
+{
+    QJsonObject reportObject;
+    reportObject["Channels"] = QJsonValue(ChannelCatalog::instance()->size());
+    reportObject["SDKCalls"] = QJsonValue(appliedCalls);
+    reportObject["SkippedChanges"] = QJsonValue(skippedChanges);
+    reportObject["Milliseconds"] = QJsonValue(applyElapsed);
+    return reportObject;
+}
@@ -0,0 +1,76 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef CHANNELCONFIGURATIONENGINE_H
+#define CHANNELCONFIGURATIONENGINE_H
+
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QElapsedTimer>
+#include <QJsonObject>
+
+#include "channelcatalog.h"
+
+// SDK calls required to move NeuroOmega from the catalog to the desired state. Channels whose current name is
+// wanted by another channel are given a temporary name first so no two channels hold the same name in between.
+typedef struct ChannelConfigurationPlan
+{
+    QList<ChannelState> temporaryNames;
+    QList<ChannelState> channelNames;
+    QList<ChannelState> saveStates;
+    int unchanged = 0;
+
+    int size() const { return temporaryNames.size() + channelNames.size() + saveStates.size(); }
+} ChannelConfigurationPlan;
+
+// Turns configuration requests into the minimal set of SetChannelName / SetChannelSaveState calls against the
+// ChannelCatalog. Usage: beginConfiguration(), set*() for the desired state, apply(). The catalog is updated with
+// every successful call, so later configurations only pay for what changed.
+class ChannelConfigurationEngine
+{
+public:
+    static ChannelConfigurationEngine *instance();
+
+    void beginConfiguration();
+    void setChannelName(int channelID, QString channelName);
+    void setSaveState(int channelID, bool saveState);
+    void setSaveStates(int firstChannelID, int lastChannelID, bool saveState);
+    void setDefaultNames(int firstChannelID, int lastChannelID);
+
+    ChannelConfigurationPlan plan() const;
+    bool apply();
+
+    static QString defaultChannelName(int channelID);
+    QString errorMessage() const;
+    QJsonObject report() const;
+
+private:
+    ChannelConfigurationEngine() {}
+
+    QHash<int, ChannelState> desiredState;
+    QSet<int> requestedNames;
+    QSet<int> requestedSaveStates;
+
+    QString lastError = "";
+    int appliedCalls = 0;
+    int skippedChanges = 0;
+    qint64 applyElapsed = 0;
+};
+
+#endif // CHANNELCONFIGURATIONENGINE_H
@@ -0,0 +1,213 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "channeltablemodel.h"
+
+ChannelTableModel::ChannelTableModel(QObject *parent) :
+    QAbstractTableModel(parent)
+{
+
+}
+
+int ChannelTableModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return 0;
+    return ChannelCatalog::instance()->size();
+}
+
+int ChannelTableModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return 0;
+    return ChannelTableColumns;
+}
+
+QVariant ChannelTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount()) return QVariant();
+
+    const ChannelState &channel = ChannelCatalog::instance()->channels()[index.row()];
+    switch (role)
+    {
+        case Qt::DisplayRole:
+        case Qt::EditRole:
+            if (index.column() == ChannelIDColumn) return channel.channelID;
+            if (index.column() == ChannelNameColumn) return channelName(channel);
+            break;
+
+        case Qt::CheckStateRole:
+            if (index.column() == SaveStateColumn) return saveState(channel) ? Qt::Checked : Qt::Unchecked;
+            break;
+
+        case ChannelSortRole:
+            if (index.column() == ChannelIDColumn) return channel.channelID;
+            if (index.column() == ChannelNameColumn) return channelName(channel);
+            if (index.column() == SaveStateColumn) return saveState(channel) ? 1 : 0;
+            break;
+
+        case Qt::TextAlignmentRole:
+            if (index.column() == ChannelIDColumn) return Qt::AlignCenter;
+            break;
+
+        case Qt::BackgroundRole:
+        case Qt::ToolTipRole:
+        {
+            // Channels that are not streamed keep the default row color.
+            auto quality = channelQuality.find(channel.channelID);
+            if (quality == channelQuality.end() || index.column() == SaveStateColumn) break;
+
+            if (role == Qt::BackgroundRole)
+            {
+                QColor qualityColors[] = {QColor(200, 255, 200), QColor(255, 230, 150), QColor(210, 210, 210), QColor(255, 170, 170)};
+                return qualityColors[quality.value().state];
+            }
+
+            QString toolTip = ContactQualityEstimator::stateName(quality.value().state) + "\n";
+            toolTip += "Variance: " + QString::number(quality.value().variance, 'g', 4) + "\n";
+            toolTip += "Line Noise: " + QString::number(quality.value().lineNoiseRatio * 100, 'f', 1) + "%\n";
+            toolTip += "Flat: " + QString::number(quality.value().flatFraction * 100, 'f', 1) + "%\n";
+            toolTip += "Saturated: " + QString::number(quality.value().saturationFraction * 100, 'f', 1) + "%";
+            return toolTip;
+        }
+    }
+
+    return QVariant();
+}
+
+QVariant ChannelTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return QVariant();
+
+    switch (section)
+    {
+        case ChannelIDColumn: return QString("Channel IDs");
+        case ChannelNameColumn: return QString("Channel Name");
+        case SaveStateColumn: return QString("Save States");
+    }
+    return QVariant();
+}
+
+// Changes that bring a channel back to its catalog value are dropped rather than kept as no-op edits.
+bool ChannelTableModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || index.row() >= rowCount()) return false;
+
+    const ChannelState &channel = ChannelCatalog::instance()->channels()[index.row()];
+    if (index.column() == ChannelNameColumn && role == Qt::EditRole)
+    {
+        QString channelName = value.toString();
+        if (channelName == channel.channelName) pendingNames.remove(channel.channelID);
+        else pendingNames[channel.channelID] = channelName;
+    }
+    else if (index.column() == SaveStateColumn && role == Qt::CheckStateRole)
+    {
+        bool checked = value.toInt() == Qt::Checked;
+        if (checked == channel.saveState) pendingSaveStates.remove(channel.channelID);
+        else pendingSaveStates[channel.channelID] = checked;
+    }
+    else
+    {
+        return false;
+    }
+
+    emit dataChanged(index, index, QList<int>() << role);
+    return true;
+}
+
+Qt::ItemFlags ChannelTableModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid()) return Qt::NoItemFlags;
+
+    switch (index.column())
+    {
+        case ChannelNameColumn: return Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsEditable;
+        case SaveStateColumn: return Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsUserCheckable;
+    }
+    return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+}
+
+// The catalog changed underneath the model; pending edits were either applied or are no longer meaningful.
+void ChannelTableModel::refresh()
+{
+    beginResetModel();
+    pendingNames.clear();
+    pendingSaveStates.clear();
+    endResetModel();
+}
+
+bool ChannelTableModel::hasPendingChanges() const
+{
+    return !pendingNames.isEmpty() || !pendingSaveStates.isEmpty();
+}
+
+void ChannelTableModel::stageChanges(ChannelConfigurationEngine *channelConfiguration) const
+{
+    for (auto name = pendingNames.begin(); name != pendingNames.end(); ++name) channelConfiguration->setChannelName(name.key(), name.value());
+    for (auto state = pendingSaveStates.begin(); state != pendingSaveStates.end(); ++state) channelConfiguration->setSaveState(state.key(), state.value());
+}
+
+void ChannelTableModel::setChannelQuality(QVector<ChannelQuality> quality)
+{
+    channelQuality.clear();
+    for (int i = 0; i < quality.size(); i++) channelQuality[quality[i].channelID] = quality[i];
+
+    if (rowCount() > 0) emit dataChanged(index(0, ChannelIDColumn), index(rowCount() - 1, ChannelNameColumn), QList<int>() << Qt::BackgroundRole << Qt::ToolTipRole);
+}
+
+QString ChannelTableModel::channelName(const ChannelState &channel) const
+{
+    auto pending = pendingNames.find(channel.channelID);
+    return pending != pendingNames.end() ? pending.value() : channel.channelName;
+}
+
+bool ChannelTableModel::saveState(const ChannelState &channel) const
+{
+    auto pending = pendingSaveStates.find(channel.channelID);
+    return pending != pendingSaveStates.end() ? pending.value() : channel.saveState;
+}
+
+ChannelFilterProxyModel::ChannelFilterProxyModel(QObject *parent) :
+    QSortFilterProxyModel(parent)
+{
+    setSortRole(ChannelSortRole);
+}
+
+void ChannelFilterProxyModel::setFilterText(QString text)
+{
+    filterText = text.trimmed();
+    invalidateFilter();
+}
+
+void ChannelFilterProxyModel::setSaveStateFilter(int filter)
+{
+    saveStateFilter = filter;
+    invalidateFilter();
+}
+
+bool ChannelFilterProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    if (saveStateFilter != AllChannels)
+    {
+        bool saved = sourceModel()->index(sourceRow, SaveStateColumn, sourceParent).data(ChannelSortRole).toInt() != 0;
+        if (saved != (saveStateFilter == SavedChannels)) return false;
+    }
+
+    if (filterText.isEmpty()) return true;
+
+    QString channelID = sourceModel()->index(sourceRow, ChannelIDColumn, sourceParent).data(ChannelSortRole).toString();
+    QString channelName = sourceModel()->index(sourceRow, ChannelNameColumn, sourceParent).data(ChannelSortRole).toString();
+    return channelID.startsWith(filterText) || channelName.contains(filterText, Qt::CaseInsensitive);
+}
@@ -0,0 +1,88 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef CHANNELTABLEMODEL_H
+#define CHANNELTABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QSortFilterProxyModel>
+#include <QColor>
+#include <QHash>
+#include <QVector>
+
+#include "channelcatalog.h"
+#include "channelconfigurationengine.h"
+#include "contactqualityestimator.h"
+
+enum ChannelTableColumn { ChannelIDColumn = 0, ChannelNameColumn, SaveStateColumn, ChannelTableColumns };
+
+// Plain values (ID, name, 0/1 save state) for sorting and filtering
+#define ChannelSortRole (Qt::UserRole + 1)
+
+// Table view of the ChannelCatalog. Rows are read straight from the catalog, so refresh() is a model reset and only
+// visible rows are ever drawn. Edits are held as pending changes until stageChanges() hands them to the engine.
+// Save states are exposed through Qt::CheckStateRole and drawn by the view's delegate.
+class ChannelTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit ChannelTableModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+    void refresh();
+    bool hasPendingChanges() const;
+    void stageChanges(ChannelConfigurationEngine *channelConfiguration) const;
+    void setChannelQuality(QVector<ChannelQuality> quality);
+
+private:
+    QString channelName(const ChannelState &channel) const;
+    bool saveState(const ChannelState &channel) const;
+
+    QHash<int, QString> pendingNames;
+    QHash<int, bool> pendingSaveStates;
+    QHash<int, ChannelQuality> channelQuality;
+};
+
+// Filters rows by a text matched against the channel ID and name, and by save state.
+class ChannelFilterProxyModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+    enum SaveStateFilter { AllChannels = 0, SavedChannels, UnsavedChannels };
+
+    explicit ChannelFilterProxyModel(QObject *parent = nullptr);
+
+    void setFilterText(QString text);
+    void setSaveStateFilter(int filter);
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private:
+    QString filterText = "";
+    int saveStateFilter = AllChannels;
+};
+
+#endif // CHANNELTABLEMODEL_H
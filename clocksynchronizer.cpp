@@ -0,0 +1,300 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#include "clocksynchronizer.h"
+#include "sdkinstrumentation.h"
+
+ClockSynchronizer::ClockSynchronizer(QObject *parent) :
+    WorkerThread(parent)
+{
+}
+
+ClockSynchronizer::~ClockSynchronizer()
+{
+    stopSynchronizer();
+}
+
+// pollInterval in ms. windowSize readings are kept in the fit (60 s at the defaults); each reading is the
+// fastest of burstSize GetLatestTimeStamp calls.
+void ClockSynchronizer::configure(int pollInterval, int windowSize, int burstSize)
+{
+    if (this->isRunning()) return;
+
+    this->pollInterval = qMax(pollInterval, 1);
+    this->windowSize = qMax(windowSize, minimumPoints);
+    this->burstSize = qMax(burstSize, 1);
+    resetFit();
+
+    fitMutex.lock();
+    totalSamples = 0;
+    rejectedSamples = 0;
+    resets = 0;
+    minimumRoundTrip = 0;
+    maximumRoundTrip = 0;
+    fitMutex.unlock();
+
+    arm();
+}
+
+void ClockSynchronizer::stopSynchronizer()
+{
+    disarm(&stopMutex, &stopCondition);
+}
+
+void ClockSynchronizer::run()
+{
+    while (running.loadAcquire())
+    {
+        ClockSample sample;
+        if (readDeviceClock(sample)) addSample(sample);
+
+        stopMutex.lock();
+        if (running.loadAcquire()) stopCondition.wait(&stopMutex, pollInterval);
+        stopMutex.unlock();
+    }
+}
+
+// NeuroOmega reports a 32-bit tick counter. Extend it to 64 bits using the previous unwrapped reading.
+qint64 ClockSynchronizer::unwrapTimestamp(quint32 timestamp, qint64 previousSample)
+{
+    if (previousSample < 0) return timestamp;
+
+    const qint64 wrap = (qint64)1 << 32;
+    qint64 sample = (previousSample & ~(wrap - 1)) | timestamp;
+    if (sample < previousSample - wrap / 2) sample += wrap;
+    else if (sample > previousSample + wrap / 2 && sample >= wrap) sample -= wrap;
+    return sample;
+}
+
+// The reading with the shortest round trip of a burst has the least uncertainty about when the device was sampled.
+bool ClockSynchronizer::readDeviceClock(ClockSample &sample)
+{
+    bool success = false;
+    for (int i = 0; i < burstSize; i++)
+    {
+        ulong timestamp = 0;
+        qint64 callStart = monotonicNanoseconds();
+        int result = AO_CALL(GetLatestTimeStamp)(&timestamp);
+        qint64 callEnd = monotonicNanoseconds();
+        if (result != eAO_OK) continue;
+
+        qint64 roundTrip = callEnd - callStart;
+        if (success && roundTrip >= sample.roundTrip) continue;
+        sample.hostNanoseconds = callStart + roundTrip / 2;
+        sample.deviceSample = unwrapTimestamp((quint32)timestamp, lastDeviceSample);
+        sample.roundTrip = roundTrip;
+        success = true;
+    }
+    return success;
+}
+
+void ClockSynchronizer::resetFit()
+{
+    window.clear();
+    windowStart = 0;
+    sumX = 0;
+    sumY = 0;
+    sumXX = 0;
+    sumXY = 0;
+    samplesSinceRebuild = 0;
+    lastDeviceSample = -1;
+    consecutiveRejections = 0;
+
+    QMutexLocker locker(&fitMutex);
+    currentFit = ClockFit();
+}
+
+// Add one reading to the sliding window. Only called from one thread (the synchronizer, or a test harness).
+void ClockSynchronizer::addSample(ClockSample sample)
+{
+    ClockFit fit = this->fit();
+
+    // A counter that runs backwards means NeuroOmega restarted; the old fit no longer applies.
+    bool restarted = lastDeviceSample >= 0 && sample.deviceSample < lastDeviceSample - minimumOutlier;
+
+    // Readings far from the fit come from calls that stalled between the device and the host. A long run of them
+    // means the fit itself is wrong, so it is rebuilt from scratch.
+    if (!restarted && fit.valid)
+    {
+        double predicted = fit.intercept + fit.slope * (sample.hostNanoseconds - fit.hostReference) / 1e9;
+        double residual = (sample.deviceSample - fit.deviceReference) - predicted;
+        if (fabs(residual) > qMax(outlierThreshold * fit.residualRMS, minimumOutlier))
+        {
+            fitMutex.lock();
+            totalSamples++;
+            rejectedSamples++;
+            fitMutex.unlock();
+
+            lastDeviceSample = sample.deviceSample;
+            if (++consecutiveRejections < minimumPoints) return;
+            restarted = true;
+        }
+    }
+
+    if (restarted)
+    {
+        resetFit();
+        fitMutex.lock();
+        resets++;
+        fitMutex.unlock();
+        emit synchronizationLost();
+    }
+    consecutiveRejections = 0;
+    lastDeviceSample = sample.deviceSample;
+
+    if (window.isEmpty())
+    {
+        hostReference = sample.hostNanoseconds;
+        deviceReference = sample.deviceSample;
+    }
+
+    double x = (sample.hostNanoseconds - hostReference) / 1e9;
+    double y = sample.deviceSample - deviceReference;
+    if (window.size() < windowSize)
+    {
+        window.append(sample);
+    }
+    else
+    {
+        ClockSample &oldest = window[windowStart];
+        double oldX = (oldest.hostNanoseconds - hostReference) / 1e9;
+        double oldY = oldest.deviceSample - deviceReference;
+        sumX -= oldX;
+        sumY -= oldY;
+        sumXX -= oldX * oldX;
+        sumXY -= oldX * oldY;
+        oldest = sample;
+        windowStart = (windowStart + 1) % windowSize;
+    }
+    sumX += x;
+    sumY += y;
+    sumXX += x * x;
+    sumXY += x * y;
+
+    // Once per window length the sums are rebuilt relative to the oldest reading, which keeps them small and drops
+    // the rounding error the running subtraction accumulates.
+    if (++samplesSinceRebuild >= windowSize)
+    {
+        const ClockSample &oldest = window[windowStart];
+        hostReference = oldest.hostNanoseconds;
+        deviceReference = oldest.deviceSample;
+        sumX = 0;
+        sumY = 0;
+        sumXX = 0;
+        sumXY = 0;
+        for (int i = 0; i < window.size(); i++)
+        {
+            double windowX = (window[i].hostNanoseconds - hostReference) / 1e9;
+            double windowY = window[i].deviceSample - deviceReference;
+            sumX += windowX;
+            sumY += windowY;
+            sumXX += windowX * windowX;
+            sumXY += windowX * windowY;
+        }
+        samplesSinceRebuild = 0;
+    }
+
+    fitMutex.lock();
+    totalSamples++;
+    if (minimumRoundTrip == 0 || sample.roundTrip < minimumRoundTrip) minimumRoundTrip = sample.roundTrip;
+    maximumRoundTrip = qMax(maximumRoundTrip, sample.roundTrip);
+    fitMutex.unlock();
+
+    updateFit();
+}
+
+void ClockSynchronizer::updateFit()
+{
+    int n = window.size();
+    double denominator = n * sumXX - sumX * sumX;
+    if (n < 2 || denominator <= 0) return;
+
+    ClockFit fit;
+    fit.hostReference = hostReference;
+    fit.deviceReference = deviceReference;
+    fit.slope = (n * sumXY - sumX * sumY) / denominator;
+    fit.intercept = (sumY - fit.slope * sumX) / n;
+    fit.numPoints = n;
+
+    double squares = 0;
+    for (int i = 0; i < n; i++)
+    {
+        double residual = (window[i].deviceSample - deviceReference) - (fit.intercept + fit.slope * (window[i].hostNanoseconds - hostReference) / 1e9);
+        squares += residual * residual;
+    }
+    fit.residualRMS = sqrt(squares / n);
+    fit.valid = n >= minimumPoints;
+
+    QMutexLocker locker(&fitMutex);
+    currentFit = fit;
+}
+
+bool ClockSynchronizer::isSynchronized()
+{
+    QMutexLocker locker(&fitMutex);
+    return currentFit.valid;
+}
+
+ClockFit ClockSynchronizer::fit()
+{
+    QMutexLocker locker(&fitMutex);
+    return currentFit;
+}
+
+// Estimated NeuroOmega sample index at a monotonicNanoseconds() time, or -1 before the fit is usable.
+qint64 ClockSynchronizer::deviceSample(qint64 hostNanoseconds)
+{
+    ClockFit fit = this->fit();
+    if (!fit.valid) return -1;
+    return fit.deviceReference + llround(fit.intercept + fit.slope * (hostNanoseconds - fit.hostReference) / 1e9);
+}
+
+qint64 ClockSynchronizer::hostNanoseconds(qint64 deviceSample)
+{
+    ClockFit fit = this->fit();
+    if (!fit.valid || fit.slope <= 0) return -1;
+    return fit.hostReference + llround((deviceSample - fit.deviceReference - fit.intercept) / fit.slope * 1e9);
+}
+
+// Stamp a log entry with the device sample it happened at. Entries logged before the fit converges, and entries that
+// already carry the sample of an earlier moment (e.g. the click of a label), are left alone.
+void ClockSynchronizer::tagEvent(QJsonObject &event)
+{
+    if (event.contains("DeviceSample")) return;
+    qint64 sample = deviceSample(monotonicNanoseconds());
+    if (sample >= 0) event["DeviceSample"] = QJsonValue(sample);
+}
+
+QJsonObject ClockSynchronizer::report()
+{
+    ClockFit fit = this->fit();
+
+    QJsonObject reportObject;
+    reportObject["Synchronized"] = QJsonValue(fit.valid);
+    reportObject["Points"] = QJsonValue(fit.numPoints);
+    reportObject["SamplesPerSecond"] = QJsonValue(fit.slope);
+    reportObject["DriftPPM"] = QJsonValue((fit.slope / NEUROOMEGA_SAMPLING_RATE - 1) * 1e6);
+    reportObject["ResidualRMS"] = QJsonValue(fit.residualRMS);
+    reportObject["ResidualRMSMilliseconds"] = QJsonValue(fit.residualRMS * 1000 / NEUROOMEGA_SAMPLING_RATE);
+
+    QMutexLocker locker(&fitMutex);
+    reportObject["TotalSamples"] = QJsonValue(totalSamples);
+    reportObject["RejectedSamples"] = QJsonValue(rejectedSamples);
+    reportObject["Resets"] = QJsonValue(resets);
+    reportObject["MinRoundTrip"] = QJsonValue(minimumRoundTrip / 1e6);
+    reportObject["MaxRoundTrip"] = QJsonValue(maximumRoundTrip / 1e6);
+    return reportObject;
+}
@@ -0,0 +1,121 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#ifndef CLOCKSYNCHRONIZER_H
+#define CLOCKSYNCHRONIZER_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QVector>
+#include <QJsonObject>
+
+#include <cmath>
+
+#include "workerthread.h"
+#include "streamdatahandler.h"
+
+// Device clock as a linear function of the host monotonic clock:
+// deviceSample = deviceReference + intercept + slope * (hostNanoseconds - hostReference) / 1e9
+typedef struct ClockFit
+{
+    qint64 hostReference = 0;
+    qint64 deviceReference = 0;
+    double intercept = 0;
+    double slope = NEUROOMEGA_SAMPLING_RATE;
+    double residualRMS = 0;
+    int numPoints = 0;
+    bool valid = false;
+} ClockFit;
+
+// One GetLatestTimeStamp reading, taken at the midpoint of the call on the host clock. deviceSample is unwrapped to 64 bits.
+typedef struct ClockSample
+{
+    qint64 hostNanoseconds = 0;
+    qint64 deviceSample = 0;
+    qint64 roundTrip = 0;
+} ClockSample;
+
+// Samples the NeuroOmega 44 kHz tick counter against monotonicNanoseconds() and keeps a running least-squares fit of
+// offset and drift over a sliding window. Any thread can then convert host time to an estimated device sample index,
+// which is how JSON events are aligned with the recordings.
+class ClockSynchronizer : public WorkerThread
+{
+    Q_OBJECT
+
+public:
+    explicit ClockSynchronizer(QObject *parent = nullptr);
+    ~ClockSynchronizer();
+
+    void configure(int pollInterval = 100, int windowSize = 600, int burstSize = 3);
+    void stopSynchronizer();
+
+    void addSample(ClockSample sample);
+    bool isSynchronized();
+    ClockFit fit();
+    qint64 deviceSample(qint64 hostNanoseconds);
+    qint64 hostNanoseconds(qint64 deviceSample);
+    void tagEvent(QJsonObject &event);
+    QJsonObject report();
+
+    static qint64 unwrapTimestamp(quint32 timestamp, qint64 previousSample);
+
+signals:
+    void synchronizationLost();
+
+protected:
+    void run() override;
+
+private:
+    bool readDeviceClock(ClockSample &sample);
+    void resetFit();
+    void updateFit();
+
+    int pollInterval = 100;
+    int windowSize = 600;
+    int burstSize = 3;
+    int minimumPoints = 10;
+
+    // Readings further than this from the fit are treated as outliers (late calls, stalls), below it they always count.
+    double outlierThreshold = 5;
+    double minimumOutlier = NEUROOMEGA_SAMPLING_RATE / 1000.0;
+
+    QMutex stopMutex;
+    QWaitCondition stopCondition;
+
+    // Sliding window and running sums in seconds / samples relative to the window reference, only touched by addSample().
+    QVector<ClockSample> window;
+    int windowStart = 0;
+    qint64 hostReference = 0;
+    qint64 deviceReference = 0;
+    double sumX = 0;
+    double sumY = 0;
+    double sumXX = 0;
+    double sumXY = 0;
+    int samplesSinceRebuild = 0;
+    int consecutiveRejections = 0;
+    qint64 lastDeviceSample = -1;
+
+    QMutex fitMutex;
+    ClockFit currentFit;
+    qint64 totalSamples = 0;
+    qint64 rejectedSamples = 0;
+    qint64 resets = 0;
+    qint64 minimumRoundTrip = 0;
+    qint64 maximumRoundTrip = 0;
+};
+
+#endif // CLOCKSYNCHRONIZER_H
@@ -0,0 +1,391 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "closedloopcontroller.h"
+#include "sdkinstrumentation.h"
+
+ClosedLoopController::ClosedLoopController(QObject *parent) :
+    WorkerThread(parent)
+{
+    stimulating = 0;
+}
+
+ClosedLoopController::~ClosedLoopController()
+{
+    stopController();
+    detach();
+}
+
+// Parse a closed-loop JSON file and resolve lead/contact indices against the configured electrodes.
+bool ClosedLoopController::loadParameters(QString filename, QList<ElectrodeInformation> electrodes, ClosedLoopParameters *parameters, QString *errorMessage)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        *errorMessage = "Cannot open " + filename;
+        return false;
+    }
+
+    QJsonDocument loadedDocument = QJsonDocument::fromJson(file.readAll());
+    if (!loadedDocument.isObject())
+    {
+        *errorMessage = "Bad Closed-Loop Configuration";
+        return false;
+    }
+    QJsonObject configuration = loadedDocument.object();
+
+    if (!configuration.contains("BiomarkerNode") || !configuration.contains("BiomarkerLead") || !configuration.contains("BiomarkerContact") ||
+        !configuration.contains("OnThreshold") || !configuration.contains("OffThreshold") ||
+        !configuration.contains("StimulationLead") || !configuration.contains("StimulationChannel") || !configuration.contains("StimulationReturn") ||
+        !configuration.contains("Amplitude") || !configuration.contains("Pulsewidth") || !configuration.contains("Frequency"))
+    {
+        *errorMessage = "Bad Closed-Loop Configuration, Missing Important Configurations";
+        return false;
+    }
+
+    int biomarkerLead = configuration["BiomarkerLead"].toInt();
+    int biomarkerContact = configuration["BiomarkerContact"].toInt();
+    int stimulationLead = configuration["StimulationLead"].toInt();
+    if (biomarkerLead < 0 || biomarkerLead >= electrodes.size() || stimulationLead < 0 || stimulationLead >= electrodes.size() ||
+        electrodes[biomarkerLead].electrodeType == "None" || electrodes[stimulationLead].electrodeType == "None")
+    {
+        *errorMessage = "Closed-Loop Configuration refers to a lead that is not connected";
+        return false;
+    }
+    if (biomarkerContact < 0 || biomarkerContact >= electrodes[biomarkerLead].channelIDs.size())
+    {
+        *errorMessage = "Bad Closed-Loop Configuration, Bad biomarker contact";
+        return false;
+    }
+
+    ClosedLoopParameters loaded;
+    loaded.biomarkerNode = configuration["BiomarkerNode"].toString();
+    loaded.biomarkerChannelID = electrodes[biomarkerLead].channelIDs[biomarkerContact];
+    loaded.onThreshold = configuration["OnThreshold"].toDouble();
+    loaded.offThreshold = configuration["OffThreshold"].toDouble();
+    loaded.onDelay = configuration.value("OnDelay").toDouble(0);
+
+    QJsonArray stimulationContacts = configuration["StimulationChannel"].toArray();
+    QVector<int> leadContacts = electrodes[stimulationLead].channelIDs;
+    for (int i = 0; i < stimulationContacts.size(); i++)
+    {
+        int contact = stimulationContacts[i].toInt();
+        if (contact < 0 || contact >= leadContacts.size())
+        {
+            *errorMessage = "Bad Closed-Loop Configuration, Bad contacts";
+            return false;
+        }
+        loaded.stimulationContacts.append(leadContacts[contact]);
+    }
+
+    int returnContact = configuration["StimulationReturn"].toInt();
+    if (returnContact >= leadContacts.size() || returnContact < -1)
+    {
+        *errorMessage = "Bad Closed-Loop Configuration, Bad contacts";
+        return false;
+    }
+    loaded.returnContact = (returnContact == -1) ? -1 : leadContacts[returnContact];
+
+    loaded.amplitude = configuration["Amplitude"].toDouble();
+    loaded.pulsewidth = configuration["Pulsewidth"].toDouble();
+    loaded.frequency = configuration["Frequency"].toInt();
+
+    QJsonObject safetyLimits = configuration["SafetyLimits"].toObject();
+    loaded.maxAmplitude = safetyLimits.value("MaxAmplitude").toDouble(loaded.maxAmplitude);
+    loaded.maxOnDuration = safetyLimits.value("MaxOnDuration").toDouble(loaded.maxOnDuration);
+    loaded.minOffDuration = safetyLimits.value("MinOffDuration").toDouble(loaded.minOffDuration);
+    loaded.maxTriggersPerMinute = safetyLimits.value("MaxTriggersPerMinute").toInt(loaded.maxTriggersPerMinute);
+    loaded.maxTotalDuration = safetyLimits.value("MaxTotalDuration").toDouble(loaded.maxTotalDuration);
+
+    *parameters = loaded;
+    return true;
+}
+
+// Validate against the safety limits and pre-program every contact, so that a trigger only costs StartStimulation calls.
+// The programmed duration is maxOnDuration, which makes NeuroOmega itself the last line of defence if this process stalls.
+bool ClosedLoopController::configure(ClosedLoopParameters parameters, QString *errorMessage)
+{
+    if (this->isRunning())
+    {
+        *errorMessage = "Closed-Loop controller is already running";
+        return false;
+    }
+    if (parameters.stimulationContacts.isEmpty())
+    {
+        *errorMessage = "No closed-loop stimulation contacts selected";
+        return false;
+    }
+    if (parameters.amplitude <= 0 || parameters.amplitude > parameters.maxAmplitude)
+    {
+        *errorMessage = QString("Closed-loop amplitude %1 mA exceeds the safety limit of %2 mA").arg(parameters.amplitude).arg(parameters.maxAmplitude);
+        return false;
+    }
+    if (parameters.offThreshold > parameters.onThreshold)
+    {
+        *errorMessage = "Closed-loop off threshold must not be above the on threshold";
+        return false;
+    }
+    if (parameters.maxOnDuration <= 0 || parameters.minOffDuration < 0 || parameters.maxTriggersPerMinute <= 0)
+    {
+        *errorMessage = "Bad Closed-Loop safety limits";
+        return false;
+    }
+
+    int numContacts = parameters.stimulationContacts.size();
+    for (int i = 0; i < numContacts; i++)
+    {
+        int result = AO_CALL(SetStimulationParameters)(-parameters.amplitude / numContacts, parameters.pulsewidth / 1000.0,
+                                              parameters.amplitude / numContacts, parameters.pulsewidth / 1000.0,
+                                              parameters.frequency, ceil(parameters.maxOnDuration),
+                                              parameters.returnContact, parameters.stimulationContacts[i], 0, 0);
+        if (result != eAO_OK)
+        {
+            *errorMessage = QString("Cannot configure closed-loop stimulation on channel %1").arg(parameters.stimulationContacts[i]);
+            return false;
+        }
+    }
+
+    this->parameters = parameters;
+    biomarkerIndex = -1;
+    aboveThresholdSince = -1;
+    stimulationStopTime = -1;
+    totalStimulationTime = 0;
+    triggerTimes.clear();
+    numTriggers = 0;
+    numSafetyStops = 0;
+    numRejectedTriggers = 0;
+    numFailedTriggers = 0;
+    senseToStimulation.reset();
+    stimulationToStop.reset();
+    startLockWait.reset();
+    stopLockWait.reset();
+
+    arm();
+    return true;
+}
+
+bool ClosedLoopController::attach(FilterGraph *graph)
+{
+    detach();
+    sinkID = graph->addSink(parameters.biomarkerNode, [this](const SignalBlock &block) { pushBiomarker(block); });
+    if (sinkID == 0) return false;
+
+    filterGraph = graph;
+    return true;
+}
+
+void ClosedLoopController::detach()
+{
+    if (filterGraph != nullptr && sinkID != 0) filterGraph->removeSink(sinkID);
+    filterGraph = nullptr;
+    sinkID = 0;
+}
+
+// Runs on the acquisition thread: only copy the biomarker channel and wake the controller.
+void ClosedLoopController::pushBiomarker(const SignalBlock &block)
+{
+    if (!running.loadAcquire()) return;
+
+    if (biomarkerIndex < 0 || biomarkerIndex >= block.numChannels || block.channelIDs[biomarkerIndex] != parameters.biomarkerChannelID)
+    {
+        biomarkerIndex = block.channelIDs.indexOf(parameters.biomarkerChannelID);
+        if (biomarkerIndex < 0) return;
+    }
+
+    const float *values = block.channel(biomarkerIndex);
+    queueMutex.lock();
+    for (int n = 0; n < block.numSamples; n++)
+    {
+        BiomarkerSample sample;
+        sample.value = values[n];
+        sample.arrivalTime = block.hostTimestamp;
+        pendingSamples.append(sample);
+    }
+    queueCondition.wakeOne();
+    queueMutex.unlock();
+}
+
+void ClosedLoopController::stopController()
+{
+    disarm(&queueMutex, &queueCondition);
+}
+
+bool ClosedLoopController::isStimulating() const
+{
+    return stimulating.loadAcquire() != 0;
+}
+
+bool ClosedLoopController::safetyAllowsStart(qint64 now, QString *reason)
+{
+    if (stimulationStopTime >= 0 && now - stimulationStopTime < parameters.minOffDuration * 1e9)
+    {
+        *reason = "Minimum off duration";
+        return false;
+    }
+
+    while (!triggerTimes.isEmpty() && now - triggerTimes.first() > 60e9) triggerTimes.removeFirst();
+    if (triggerTimes.size() >= parameters.maxTriggersPerMinute)
+    {
+        *reason = "Maximum triggers per minute";
+        return false;
+    }
+
+    if (totalStimulationTime >= parameters.maxTotalDuration * 1e9)
+    {
+        *reason = "Maximum total stimulation duration";
+        return false;
+    }
+    return true;
+}
+
+bool ClosedLoopController::startClosedLoopStimulation(const BiomarkerSample &sample)
+{
+    qint64 lockWait = 0;
+    for (int i = 0; i < parameters.stimulationContacts.size(); i++)
+    {
+        int result = AO_CALL(StartStimulation)(parameters.stimulationContacts[i]);
+        lockWait += SDKInstrumentation::lastLockWait();
+        if (result != eAO_OK)
+        {
+            // A failed attempt counts as a trigger followed by an off period, so the rate and off-time limits
+            // still pace the retries instead of every sample above threshold calling the SDK again.
+            AO_CALL(StopStimulation)(-1);
+            qint64 now = monotonicNanoseconds();
+            triggerTimes.append(now);
+            stimulationStopTime = now;
+            aboveThresholdSince = -1;
+            numFailedTriggers++;
+            emit safetyLimitReached(QString("StartStimulation failed on channel %1").arg(parameters.stimulationContacts[i]));
+            return false;
+        }
+    }
+
+    qint64 now = monotonicNanoseconds();
+    senseToStimulation.record(now - sample.arrivalTime);
+    startLockWait.record(lockWait);
+    stimulationStartTime = now;
+    triggerTimes.append(now);
+    numTriggers++;
+    stimulating = 1;
+    emit stimulationStateChanged(true, sample.value);
+    return true;
+}
+
+bool ClosedLoopController::stopClosedLoopStimulation(double biomarker)
+{
+    qint64 requestTime = monotonicNanoseconds();
+    int result = AO_CALL(StopStimulation)(-1);
+    qint64 now = monotonicNanoseconds();
+    stimulationToStop.record(now - requestTime);
+    stopLockWait.record(SDKInstrumentation::lastLockWait());
+
+    totalStimulationTime += now - stimulationStartTime;
+    stimulationStopTime = now;
+    aboveThresholdSince = -1;
+    stimulating = 0;
+    emit stimulationStateChanged(false, biomarker);
+    return result == eAO_OK;
+}
+
+// Controller thread. Wakes on every biomarker block (or every 5 ms to enforce time limits) and runs the
+// threshold/hysteresis state machine: on after the biomarker stays above onThreshold for onDelay, off below offThreshold.
+void ClosedLoopController::run()
+{
+    double lastValue = 0;
+    QString lastRejection;
+
+    while (running.loadAcquire())
+    {
+        queueMutex.lock();
+        if (pendingSamples.isEmpty()) queueCondition.wait(&queueMutex, 5);
+        processingSamples.swap(pendingSamples);
+        queueMutex.unlock();
+
+        for (int i = 0; i < processingSamples.size(); i++)
+        {
+            const BiomarkerSample &sample = processingSamples[i];
+            lastValue = sample.value;
+
+            if (!stimulating.loadRelaxed())
+            {
+                if (sample.value < parameters.onThreshold)
+                {
+                    aboveThresholdSince = -1;
+                    continue;
+                }
+
+                if (aboveThresholdSince < 0) aboveThresholdSince = sample.arrivalTime;
+                if (sample.arrivalTime - aboveThresholdSince < parameters.onDelay * 1e9) continue;
+
+                QString reason;
+                if (!safetyAllowsStart(monotonicNanoseconds(), &reason))
+                {
+                    numRejectedTriggers++;
+                    aboveThresholdSince = -1;
+                    if (reason != lastRejection) emit safetyLimitReached("Closed-loop trigger blocked: " + reason);
+                    lastRejection = reason;
+                    continue;
+                }
+                lastRejection = "";
+                startClosedLoopStimulation(sample);
+            }
+            else if (sample.value <= parameters.offThreshold)
+            {
+                stopClosedLoopStimulation(sample.value);
+            }
+        }
+        processingSamples.clear();
+
+        if (stimulating.loadRelaxed())
+        {
+            qint64 now = monotonicNanoseconds();
+            if (now - stimulationStartTime >= parameters.maxOnDuration * 1e9)
+            {
+                numSafetyStops++;
+                stopClosedLoopStimulation(lastValue);
+                emit safetyLimitReached("Closed-loop stimulation reached the maximum on duration");
+            }
+            else if (totalStimulationTime + (now - stimulationStartTime) >= parameters.maxTotalDuration * 1e9)
+            {
+                numSafetyStops++;
+                stopClosedLoopStimulation(lastValue);
+                emit safetyLimitReached("Closed-loop stimulation reached the maximum total duration");
+            }
+        }
+    }
+
+    if (stimulating.loadRelaxed()) stopClosedLoopStimulation(lastValue);
+}
+
+QJsonObject ClosedLoopController::report()
+{
+    QJsonObject reportObject;
+    reportObject["BiomarkerNode"] = QJsonValue(parameters.biomarkerNode);
+    reportObject["BiomarkerChannel"] = QJsonValue(parameters.biomarkerChannelID);
+    reportObject["OnThreshold"] = QJsonValue(parameters.onThreshold);
+    reportObject["OffThreshold"] = QJsonValue(parameters.offThreshold);
+    reportObject["Triggers"] = QJsonValue(numTriggers);
+    reportObject["RejectedTriggers"] = QJsonValue(numRejectedTriggers);
+    reportObject["FailedTriggers"] = QJsonValue(numFailedTriggers);
+    reportObject["SafetyStops"] = QJsonValue(numSafetyStops);
+    reportObject["TotalStimulationSeconds"] = QJsonValue(totalStimulationTime / 1e9);
+    reportObject["SenseToStimulationLatency"] = senseToStimulation.toJson();
+    reportObject["StopLatency"] = stimulationToStop.toJson();
+    reportObject["StartStimulationLockWait"] = startLockWait.toJson();
+    reportObject["StopStimulationLockWait"] = stopLockWait.toJson();
+    return reportObject;
+}
@@ -0,0 +1,135 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef CLOSEDLOOPCONTROLLER_H
+#define CLOSEDLOOPCONTROLLER_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QVector>
+#include <QList>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#if defined(QT_DEBUG) || defined(NEUROOMEGA_SIMULATOR)
+#include "AOSystemAPI_TEST.h"
+#else
+#include "AOSystemAPI.h"
+#endif
+#include "AOTypes.h"
+
+#include "workerthread.h"
+#include "electrodeconfigurations.h"
+#include "filtergraph.h"
+#include "latencyhistogram.h"
+
+// Closed-loop configuration. Lead/contact indices follow the stimulation sequence JSON convention
+// (StimulationLead, StimulationChannel, StimulationReturn = -1 for CAN) and are resolved to NeuroOmega channel IDs.
+typedef struct ClosedLoopParameters
+{
+    QString biomarkerNode = "BetaEnvelope";
+    int biomarkerChannelID = 0;
+    double onThreshold = 0;
+    double offThreshold = 0;
+    double onDelay = 0;
+
+    QVector<int> stimulationContacts;
+    int returnContact = -1;
+    double amplitude = 0;
+    double pulsewidth = 60;
+    int frequency = 130;
+
+    // Safety limits. These are enforced by the controller thread itself, independently of the UI.
+    double maxAmplitude = 3;
+    double maxOnDuration = 10;
+    double minOffDuration = 1;
+    int maxTriggersPerMinute = 20;
+    double maxTotalDuration = 600;
+} ClosedLoopParameters;
+
+// arrivalTime is the monotonicNanoseconds() at which the block carrying the sample left NeuroOmega.
+typedef struct BiomarkerSample
+{
+    float value = 0;
+    qint64 arrivalTime = 0;
+} BiomarkerSample;
+
+class ClosedLoopController : public WorkerThread
+{
+    Q_OBJECT
+
+public:
+    explicit ClosedLoopController(QObject *parent = nullptr);
+    ~ClosedLoopController();
+
+    static bool loadParameters(QString filename, QList<ElectrodeInformation> electrodes, ClosedLoopParameters *parameters, QString *errorMessage);
+
+    bool configure(ClosedLoopParameters parameters, QString *errorMessage);
+    bool attach(FilterGraph *graph);
+    void detach();
+    void stopController();
+
+    bool isStimulating() const;
+    QJsonObject report();
+
+signals:
+    void stimulationStateChanged(bool stimulationOn, double biomarker);
+    void safetyLimitReached(QString message);
+
+protected:
+    void run() override;
+
+private:
+    void pushBiomarker(const SignalBlock &block);
+    bool safetyAllowsStart(qint64 now, QString *reason);
+    bool startClosedLoopStimulation(const BiomarkerSample &sample);
+    bool stopClosedLoopStimulation(double biomarker);
+
+    ClosedLoopParameters parameters;
+    FilterGraph *filterGraph = nullptr;
+    int sinkID = 0;
+    int biomarkerIndex = -1;
+
+    QMutex queueMutex;
+    QWaitCondition queueCondition;
+    QVector<BiomarkerSample> pendingSamples;
+    QVector<BiomarkerSample> processingSamples;
+
+    QAtomicInt stimulating;
+
+    // State machine and safety bookkeeping, only touched by the controller thread.
+    qint64 aboveThresholdSince = -1;
+    qint64 stimulationStartTime = 0;
+    qint64 stimulationStopTime = -1;
+    qint64 totalStimulationTime = 0;
+    QList<qint64> triggerTimes;
+    int numTriggers = 0;
+    int numSafetyStops = 0;
+    int numRejectedTriggers = 0;
+    int numFailedTriggers = 0;
+
+    // Both latencies include the wait for the SDK lock, kept apart per trigger in startLockWait and stopLockWait
+    LatencyHistogram senseToStimulation;
+    LatencyHistogram stimulationToStop;
+    LatencyHistogram startLockWait;
+    LatencyHistogram stopLockWait;
+};
+
+#endif // CLOSEDLOOPCONTROLLER_H
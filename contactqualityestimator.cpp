@@ -0,0 +1,191 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#include "contactqualityestimator.h"
+
+ContactQualityEstimator::ContactQualityEstimator(QObject *parent) :
+    WorkerThread(parent)
+{
+}
+
+ContactQualityEstimator::~ContactQualityEstimator()
+{
+    stopEstimator();
+}
+
+bool ContactQualityEstimator::configure(StreamDataHandler *streamDataHandler, double lineFrequency)
+{
+    if (this->isRunning() || streamDataHandler == nullptr || lineFrequency <= 0) return false;
+
+    this->streamDataHandler = streamDataHandler;
+    channelIDs = streamDataHandler->channels();
+    if (channelIDs.isEmpty()) return false;
+
+    int numCycles = qMax(1, (int)floor(windowDuration * lineFrequency));
+    windowSamples = (int)round(numCycles * NEUROOMEGA_SAMPLING_RATE / lineFrequency);
+    windowBuffer.resize(windowSamples);
+    floatBuffer.resize(windowSamples);
+    lineCosine.resize(windowSamples);
+    lineSine.resize(windowSamples);
+    for (int n = 0; n < windowSamples; n++)
+    {
+        double phase = 2 * M_PI * lineFrequency * n / NEUROOMEGA_SAMPLING_RATE;
+        lineCosine[n] = cos(phase);
+        lineSine[n] = sin(phase);
+    }
+
+    channelQuality.resize(channelIDs.size());
+    for (int i = 0; i < channelIDs.size(); i++) channelQuality[i].channelID = channelIDs[i];
+
+    arm();
+    return true;
+}
+
+void ContactQualityEstimator::stopEstimator()
+{
+    disarm(&stopMutex, &stopCondition);
+}
+
+QVector<ChannelQuality> ContactQualityEstimator::quality()
+{
+    QMutexLocker locker(&qualityMutex);
+    return channelQuality;
+}
+
+// Fraction of one core spent computing the estimates since start().
+double ContactQualityEstimator::estimatorLoad()
+{
+    QMutexLocker locker(&qualityMutex);
+    if (wallNanoseconds <= 0) return 0;
+    return (double)computeNanoseconds / wallNanoseconds;
+}
+
+QString ContactQualityEstimator::stateName(int state)
+{
+    switch (state)
+    {
+        case ContactQualityNoisy:
+            return "Noisy";
+        case ContactQualityFlat:
+            return "Flat";
+        case ContactQualitySaturated:
+            return "Saturated";
+    }
+    return "Good";
+}
+
+QJsonObject ContactQualityEstimator::report()
+{
+    QVector<ChannelQuality> currentQuality = quality();
+
+    QJsonArray channelArray;
+    for (int i = 0; i < currentQuality.size(); i++)
+    {
+        QJsonObject channelObject;
+        channelObject["Channel"] = QJsonValue(currentQuality[i].channelID);
+        channelObject["State"] = QJsonValue(stateName(currentQuality[i].state));
+        channelObject["Variance"] = QJsonValue(currentQuality[i].variance);
+        channelObject["LineNoiseRatio"] = QJsonValue(currentQuality[i].lineNoiseRatio);
+        channelObject["FlatFraction"] = QJsonValue(currentQuality[i].flatFraction);
+        channelObject["SaturationFraction"] = QJsonValue(currentQuality[i].saturationFraction);
+        channelArray.append(channelObject);
+    }
+
+    QJsonObject reportObject;
+    reportObject["Channels"] = channelArray;
+    reportObject["EstimatorLoad"] = QJsonValue(estimatorLoad());
+    return reportObject;
+}
+
+void ContactQualityEstimator::run()
+{
+    qint64 startTime = monotonicNanoseconds();
+    QVector<ChannelQuality> latestQuality(channelIDs.size());
+
+    while (running.loadAcquire())
+    {
+        qint64 computeStart = monotonicNanoseconds();
+        bool updated = false;
+        for (int i = 0; i < channelIDs.size(); i++)
+        {
+            latestQuality[i].channelID = channelIDs[i];
+            if (streamDataHandler->getLatestSamples(channelIDs[i], windowBuffer.data(), windowSamples) != 0) continue;
+            latestQuality[i] = estimate(channelIDs[i], windowBuffer.constData());
+            updated = true;
+        }
+        qint64 computeEnd = monotonicNanoseconds();
+
+        qualityMutex.lock();
+        if (updated) channelQuality = latestQuality;
+        computeNanoseconds += computeEnd - computeStart;
+        wallNanoseconds = computeEnd - startTime;
+        qualityMutex.unlock();
+
+        if (updated) emit qualityUpdated();
+
+        stopMutex.lock();
+        if (running.loadAcquire()) stopCondition.wait(&stopMutex, updateInterval);
+        stopMutex.unlock();
+    }
+}
+
+// Single pass of branch-free reductions over the window so the compiler can vectorize them.
+ChannelQuality ContactQualityEstimator::estimate(int channelID, const int16 *window)
+{
+    qint64 sum = 0;
+    qint64 sumSquares = 0;
+    int saturated = 0;
+    for (int n = 0; n < windowSamples; n++)
+    {
+        int value = window[n];
+        sum += value;
+        sumSquares += value * value;
+        saturated += (value >= saturationLevel) | (value <= -saturationLevel);
+        floatBuffer[n] = value;
+    }
+
+    int flat = 0;
+    for (int n = 1; n < windowSamples; n++) flat += (window[n] == window[n - 1]);
+
+    // Projection onto the line frequency. A sinusoid of amplitude A has power A^2 / 2 = 2 * (I^2 + Q^2) / N^2.
+    const float *x = floatBuffer.constData();
+    const float *c = lineCosine.constData();
+    const float *s = lineSine.constData();
+    float inPhase = 0;
+    float quadrature = 0;
+    for (int n = 0; n < windowSamples; n++)
+    {
+        inPhase += x[n] * c[n];
+        quadrature += x[n] * s[n];
+    }
+
+    ChannelQuality result;
+    result.channelID = channelID;
+
+    double mean = (double)sum / windowSamples;
+    double variance = (double)sumSquares / windowSamples - mean * mean;
+    double linePower = 2.0 * ((double)inPhase * inPhase + (double)quadrature * quadrature) / ((double)windowSamples * windowSamples);
+    result.variance = variance;
+    result.lineNoiseRatio = (variance > 0) ? qMin(1.0, linePower / variance) : 0;
+    result.flatFraction = (double)flat / (windowSamples - 1);
+    result.saturationFraction = (double)saturated / windowSamples;
+
+    if (result.saturationFraction > saturationThreshold) result.state = ContactQualitySaturated;
+    else if (result.flatFraction > flatThreshold || variance <= 0) result.state = ContactQualityFlat;
+    else if (result.lineNoiseRatio > lineNoiseThreshold) result.state = ContactQualityNoisy;
+    else result.state = ContactQualityGood;
+    return result;
+}
@@ -0,0 +1,107 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#ifndef CONTACTQUALITYESTIMATOR_H
+#define CONTACTQUALITYESTIMATOR_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QVector>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include <cmath>
+
+#include "workerthread.h"
+#include "streamdatahandler.h"
+
+// Ordered by severity, the electrode layout and channel table color by this value.
+enum ContactQualityState
+{
+    ContactQualityGood = 0,
+    ContactQualityNoisy = 1,
+    ContactQualityFlat = 2,
+    ContactQualitySaturated = 3
+};
+
+typedef struct ChannelQuality
+{
+    int channelID = 0;
+    float variance = 0;
+    float lineNoiseRatio = 0;
+    float flatFraction = 0;
+    float saturationFraction = 0;
+    int state = ContactQualityGood;
+} ChannelQuality;
+
+// Periodically pulls a short window of every streamed channel from the acquisition rings and computes
+// line-noise ratio, flat-line and saturation fractions and variance. Results are published as one
+// ChannelQuality per channel, in StreamDataHandler::channels() order.
+class ContactQualityEstimator : public WorkerThread
+{
+    Q_OBJECT
+
+public:
+    explicit ContactQualityEstimator(QObject *parent = nullptr);
+    ~ContactQualityEstimator();
+
+    bool configure(StreamDataHandler *streamDataHandler, double lineFrequency = 60);
+    void stopEstimator();
+
+    QVector<ChannelQuality> quality();
+    double estimatorLoad();
+    QJsonObject report();
+
+    static QString stateName(int state);
+
+signals:
+    void qualityUpdated();
+
+protected:
+    void run() override;
+
+private:
+    ChannelQuality estimate(int channelID, const int16 *window);
+
+    StreamDataHandler *streamDataHandler = nullptr;
+    QVector<int> channelIDs;
+
+    // Window holds a whole number of line cycles so the line projection is orthogonal to DC.
+    double windowDuration = 0.25;
+    int windowSamples = 0;
+    int updateInterval = 1000;
+    QVector<int16> windowBuffer;
+    QVector<float> floatBuffer;
+    QVector<float> lineCosine;
+    QVector<float> lineSine;
+
+    // Classification thresholds
+    int saturationLevel = 32000;
+    float flatThreshold = 0.5;
+    float saturationThreshold = 0.01;
+    float lineNoiseThreshold = 0.5;
+
+    QMutex stopMutex;
+    QWaitCondition stopCondition;
+
+    QMutex qualityMutex;
+    QVector<ChannelQuality> channelQuality;
+    qint64 computeNanoseconds = 0;
+    qint64 wallNanoseconds = 0;
+};
+
+#endif // CONTACTQUALITYESTIMATOR_H
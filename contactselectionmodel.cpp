@@ -0,0 +1,241 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "contactselectionmodel.h"
+
+ContactSelectionModel::ContactSelectionModel(QObject *parent) :
+    QObject(parent)
+{
+
+}
+
+// New lead. Every contact starts unselected, so views only need to draw the layout once.
+// "rings" lists the contact indexes that the ring selectors toggle together.
+void ContactSelectionModel::setLayout(QVector<int> channelIDs, QStringList labels, QList<QVector<int>> rings)
+{
+    this->channelIDs = channelIDs;
+    this->labels = labels;
+    this->rings = rings;
+    while (this->labels.size() < channelIDs.size()) this->labels.append(QString::number(channelIDs[this->labels.size()]));
+
+    contactIndex.clear();
+    for (int i = 0; i < channelIDs.size(); i++) contactIndex.insert(channelIDs[i], i);
+
+    anodes = QBitArray(channelIDs.size(), false);
+    numAnodes = 0;
+    cathode = -1;
+    unboundAnodes.clear();
+    setGlobalReturn(false);
+    emit selectionChanged();
+}
+
+void ContactSelectionModel::clear()
+{
+    for (int i = 0; i < anodes.size() && numAnodes > 0; i++) setAnode(i, false);
+    setCathode(-1);
+    setGlobalReturn(false);
+    unboundAnodes.clear();
+    emit selectionChanged();
+}
+
+// Contact button click: None -> Anode -> Cathode (or None when the Global Return is selected) -> None.
+void ContactSelectionModel::cycleContact(int index)
+{
+    if (index < 0 || index >= channelIDs.size()) return;
+
+    unboundAnodes.clear();
+    if (index == cathode)
+    {
+        setCathode(-1);
+    }
+    else if (anodes.testBit(index))
+    {
+        if (globalReturnSelected) setAnode(index, false);
+        else setCathode(index);
+    }
+    else
+    {
+        setAnode(index, true);
+    }
+    emit selectionChanged();
+}
+
+// Ring selector: select the ring as the only anodes, or clear it when the whole ring is already selected.
+void ContactSelectionModel::toggleRing(int ringIndex)
+{
+    if (ringIndex < 0 || ringIndex >= rings.size()) return;
+    const QVector<int> &ring = rings[ringIndex];
+
+    bool ringSelected = true;
+    for (int i = 0; i < ring.size(); i++) ringSelected = ringSelected && anodes.testBit(ring[i]);
+
+    unboundAnodes.clear();
+    if (ringSelected)
+    {
+        for (int i = 0; i < ring.size(); i++) setAnode(ring[i], false);
+    }
+    else
+    {
+        for (int i = 0; i < anodes.size() && numAnodes > 0; i++)
+        {
+            if (!ring.contains(i)) setAnode(i, false);
+        }
+        for (int i = 0; i < ring.size(); i++)
+        {
+            if (ring[i] == cathode) setCathode(-1);
+            setAnode(ring[i], true);
+        }
+    }
+    emit selectionChanged();
+}
+
+void ContactSelectionModel::toggleGlobalReturn()
+{
+    if (!globalReturnSelected) setCathode(-1);
+    setGlobalReturn(!globalReturnSelected);
+    emit selectionChanged();
+}
+
+// Restore a selection by NeuroOmega channel ID (session replay). Anodes outside the current lead are kept
+// so that stimulation can still be re-applied, cathode -1 is the Global Return.
+void ContactSelectionModel::setSelection(QList<int> anodeChannelIDs, int cathodeChannelID)
+{
+    QBitArray requested(channelIDs.size(), false);
+    unboundAnodes.clear();
+    for (int i = 0; i < anodeChannelIDs.size(); i++)
+    {
+        int index = contactIndex.value(anodeChannelIDs[i], -1);
+        if (index >= 0) requested.setBit(index);
+        else if (!unboundAnodes.contains(anodeChannelIDs[i])) unboundAnodes.append(anodeChannelIDs[i]);
+    }
+
+    setCathode(cathodeChannelID > 0 ? contactIndex.value(cathodeChannelID, -1) : -1);
+    setGlobalReturn(cathodeChannelID == -1);
+    for (int i = 0; i < requested.size(); i++) setAnode(i, requested.testBit(i));
+    emit selectionChanged();
+}
+
+int ContactSelectionModel::size() const
+{
+    return channelIDs.size();
+}
+
+int ContactSelectionModel::indexOf(int channelID) const
+{
+    return contactIndex.value(channelID, -1);
+}
+
+int ContactSelectionModel::channelID(int index) const
+{
+    if (index < 0 || index >= channelIDs.size()) return 0;
+    return channelIDs[index];
+}
+
+QString ContactSelectionModel::label(int index) const
+{
+    if (index < 0 || index >= labels.size()) return "";
+    return labels[index];
+}
+
+ContactState ContactSelectionModel::state(int index) const
+{
+    if (index < 0 || index >= channelIDs.size()) return ContactNone;
+    if (index == cathode) return ContactCathode;
+    if (anodes.testBit(index)) return ContactAnode;
+    return ContactNone;
+}
+
+QList<int> ContactSelectionModel::anodeChannels() const
+{
+    QList<int> channels;
+    for (int i = 0; i < anodes.size() && channels.size() < numAnodes; i++)
+    {
+        if (anodes.testBit(i)) channels.append(channelIDs[i]);
+    }
+    return channels + unboundAnodes;
+}
+
+QStringList ContactSelectionModel::anodeLabels() const
+{
+    QStringList anodeLabels;
+    for (int i = 0; i < anodes.size() && anodeLabels.size() < numAnodes; i++)
+    {
+        if (anodes.testBit(i)) anodeLabels.append(labels[i]);
+    }
+    return anodeLabels;
+}
+
+int ContactSelectionModel::anodeCount() const
+{
+    return numAnodes + unboundAnodes.size();
+}
+
+// NeuroOmega return channel: contact channel ID, -1 for the Global Return, 0 if no return is selected.
+int ContactSelectionModel::cathodeChannel() const
+{
+    if (globalReturnSelected) return -1;
+    if (cathode >= 0) return channelIDs[cathode];
+    return 0;
+}
+
+int ContactSelectionModel::cathodeIndex() const
+{
+    return cathode;
+}
+
+bool ContactSelectionModel::globalReturn() const
+{
+    return globalReturnSelected;
+}
+
+bool ContactSelectionModel::isComplete() const
+{
+    return anodeCount() > 0 && cathodeChannel() != 0;
+}
+
+void ContactSelectionModel::setAnode(int index, bool selected)
+{
+    if (anodes.testBit(index) == selected || (selected && index == cathode)) return;
+    anodes.setBit(index, selected);
+    numAnodes += selected ? 1 : -1;
+    emit contactChanged(index, selected ? ContactAnode : ContactNone);
+}
+
+// Only one return at a time, so the previous cathode goes back to None.
+void ContactSelectionModel::setCathode(int index)
+{
+    if (index == cathode) return;
+    int previous = cathode;
+    cathode = index;
+    if (previous >= 0) emit contactChanged(previous, state(previous));
+    if (cathode >= 0)
+    {
+        if (anodes.testBit(cathode))
+        {
+            anodes.clearBit(cathode);
+            numAnodes--;
+        }
+        emit contactChanged(cathode, ContactCathode);
+    }
+}
+
+void ContactSelectionModel::setGlobalReturn(bool selected)
+{
+    if (globalReturnSelected == selected) return;
+    globalReturnSelected = selected;
+    emit globalReturnChanged(selected);
+}
@@ -0,0 +1,87 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef CONTACTSELECTIONMODEL_H
+#define CONTACTSELECTIONMODEL_H
+
+#include <QObject>
+#include <QBitArray>
+#include <QHash>
+#include <QVector>
+#include <QList>
+#include <QStringList>
+
+enum ContactState { ContactNone = 0, ContactAnode, ContactCathode };
+
+// Stimulation contact selection for the current lead. Anode is "-", cathode is "+" and there is only one return,
+// either a contact of the lead or the Global Return (cathodeChannel() == -1).
+// This is the single source of truth for the selection: views bind to contactChanged() and only redraw the
+// contacts whose state actually changed.
+class ContactSelectionModel : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ContactSelectionModel(QObject *parent = nullptr);
+
+    void setLayout(QVector<int> channelIDs, QStringList labels, QList<QVector<int>> rings = QList<QVector<int>>());
+    void clear();
+
+    void cycleContact(int index);
+    void toggleRing(int ringIndex);
+    void toggleGlobalReturn();
+    void setSelection(QList<int> anodeChannelIDs, int cathodeChannelID);
+
+    int size() const;
+    int indexOf(int channelID) const;
+    int channelID(int index) const;
+    QString label(int index) const;
+    ContactState state(int index) const;
+
+    QList<int> anodeChannels() const;
+    QStringList anodeLabels() const;
+    int anodeCount() const;
+    int cathodeChannel() const;
+    int cathodeIndex() const;
+    bool globalReturn() const;
+    bool isComplete() const;
+
+signals:
+    void contactChanged(int index, int state);
+    void globalReturnChanged(bool selected);
+    void selectionChanged();
+
+private:
+    void setAnode(int index, bool selected);
+    void setCathode(int index);
+    void setGlobalReturn(bool selected);
+
+    QVector<int> channelIDs;
+    QStringList labels;
+    QList<QVector<int>> rings;
+    QHash<int, int> contactIndex;
+
+    QBitArray anodes;
+    int numAnodes = 0;
+    int cathode = -1;
+    bool globalReturnSelected = false;
+
+    // Anodes restored by setSelection() that are not contacts of the current lead (session replay)
+    QList<int> unboundAnodes;
+};
+
+#endif // CONTACTSELECTIONMODEL_H
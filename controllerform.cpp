@@ -39,6 +39,23 @@ ControllerForm::ControllerForm(QWidget *parent) :
     electrodeLayout = new QGridLayout();
     ui->ElectrodeLayoutWidget->setLayout(electrodeLayout);
 
+    contactSelection = new ContactSelectionModel(this);
+    connect(contactSelection, &ContactSelectionModel::contactChanged, this, &ControllerForm::contactStateChanged);
+    connect(contactSelection, &ContactSelectionModel::globalReturnChanged, this, &ControllerForm::globalReturnChanged);
+
+    // ECoG grids and strips are drawn by one painted widget instead of a button per contact.
+    electrodeGrid = new ElectrodeGridWidget();
+    electrodeGrid->setBackground(QDir::currentPath() + "/resources/ECoG_Background.png");
+    electrodeGrid->setOverlayNames(QStringList() << "Beta Power" << "Gamma Power" << "Line Noise");
+    electrodeGrid->setHidden(true);
+    electrodeLayout->addWidget(electrodeGrid);
+    connect(electrodeGrid, &ElectrodeGridWidget::contactClicked, this, &ControllerForm::stimulationContactSelected);
+    connect(electrodeGrid, &ElectrodeGridWidget::overlaySelected, this, &ControllerForm::electrodeOverlaySelected);
+
+    overlayTimer = new QTimer(this);
+    overlayTimer->setInterval(33);
+    connect(overlayTimer, &QTimer::timeout, this, &ControllerForm::updateElectrodeOverlay);
+
     naturalButtonStyle = "QPushButton {";
     naturalButtonStyle += "border-style: outset;";
     naturalButtonStyle += "border-width: 2px;";
@@ -47,6 +64,15 @@ ControllerForm::ControllerForm(QWidget *parent) :
     naturalButtonStyle += "background-color: [COLOR];";
     naturalButtonStyle += "}";
 
+    // Contact selection is shown through the "ContactState" property, so a selection change only re-polishes the changed buttons.
+    naturalButtonStyle += "QPushButton[ContactState=\"1\"] {background-color: rgb(255, 88, 99);}";
+    naturalButtonStyle += "QPushButton[ContactState=\"2\"] {background-color: rgb(83, 175, 255);}";
+
+    // Contact quality from the streaming estimator is shown as border color through the "ContactQuality" property.
+    naturalButtonStyle += "QPushButton[ContactQuality=\"1\"] {border-color: rgb(255, 190, 0); border-width: 3px;}";
+    naturalButtonStyle += "QPushButton[ContactQuality=\"2\"] {border-color: gray; border-style: dashed; border-width: 3px;}";
+    naturalButtonStyle += "QPushButton[ContactQuality=\"3\"] {border-color: red; border-width: 3px;}";
+
     ui->SequenceDisplayTable->setVisible(false);
     ui->SequenceDisplayTable->setColumnWidth(0, 60);
     ui->SequenceDisplayTable->setColumnWidth(1, 90);
@@ -55,48 +81,12 @@ ControllerForm::ControllerForm(QWidget *parent) :
 
     stimulationStateTimer = new QTimer(this);
 
-    this->applicationConfiguration = new QSettings(QDir::currentPath() + "/defaultSettings.ini", QSettings::IniFormat);
-
-    if (!this->applicationConfiguration->value("LastNovelStimulation").isNull())
-    {
-        QFile file(this->applicationConfiguration->value("LastNovelStimulation").toString());
-        if (!file.open(QIODevice::ReadOnly))
-        {
-            return;
-        }
-
-        char *data = file.readAll().data();
-        int16 *stimulationVector = (int16*) data;
-        QString wavename = QFileInfo(this->applicationConfiguration->value("LastNovelStimulation").toString()).fileName().split(".").first();
-
-        if (file.size() % 88000 == 0)
-        {
-            int result = LoadWaveToEmbedded(stimulationVector, file.size() / 2, 1, (cChar*) wavename.toStdString().c_str());
-            if (result == eAO_OK) this->waveformList.append(wavename);
-        }
-    }
-
-    if (!this->applicationConfiguration->value("LastStimulationConfiguration").isNull())
-    {
-        QFile file(this->applicationConfiguration->value("LastStimulationConfiguration").toString());
-        if (!file.open(QIODevice::ReadOnly))
-        {
-            return;
-        }
+    this->applicationConfiguration = InterfaceConfiguration::instance()->settings();
+    connect(InterfaceConfiguration::instance(), &InterfaceConfiguration::configurationChanged, this, &ControllerForm::updateRecordingLabels);
 
-        QByteArray sequenceData = file.readAll();
-        QJsonDocument loadedDocument = QJsonDocument::fromJson(sequenceData);
-        if (loadedDocument.isObject())
-        {
-            QJsonObject stimulationConfiguration = loadedDocument.object();
-            if (stimulationConfiguration.contains("StimulationName"))
-            {
-                this->stimulationConfigurations = loadedDocument;
-                loadAnalogWaveform(stimulationConfiguration["AnalogWaveforms"].toArray());
-                ui->SequenceFilename->setText(this->stimulationConfigurations.object()["StimulationName"].toString());
-            }
-        }
-    }
+    startupWarmup = new StartupWarmup(this);
+    connect(startupWarmup, &StartupWarmup::progress, this, &ControllerForm::startupWarmupProgress);
+    connect(startupWarmup, &StartupWarmup::ready, this, &ControllerForm::startupResourcesReady);
 }
 
 ControllerForm::~ControllerForm()
@@ -121,12 +111,11 @@ void ControllerForm::controllerInitialization(string patientID, string diagnosis
     QDateTime currentTime;
     statusObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
 
-    // Identify the most recently created folder in SurgicalLogFolder
-
-    QDir SurgicalLogFolder(applicationConfiguration->value("SurgicalLogFolder").toString(), "", QDir::Time, QDir::Dirs);
-    if (SurgicalLogFolder.count() > 2)
+    // Identify the most recently modified folder in SurgicalLogFolder. "." and ".." are not guaranteed to sort first.
+    QDir SurgicalLogFolder(applicationConfiguration->value("SurgicalLogFolder").toString(), "", QDir::Time, QDir::Dirs | QDir::NoDotAndDotDot);
+    if (SurgicalLogFolder.count() > 0)
     {
-        patientDirectory = SurgicalLogFolder[2];
+        patientDirectory = SurgicalLogFolder[0];
     }
     else
     {
@@ -136,15 +125,46 @@ void ControllerForm::controllerInitialization(string patientID, string diagnosis
     // Create JSON Storage File. This is stored in the SurgicalLogFolder defined in "defaultConfiguration.ini:
     jsonStorage = new JSONStorage(applicationConfiguration->value("SurgicalLogFolder").toString() + "\\" + patientDirectory + "\\", currentTime.currentDateTime().toString("[yyyyMMdd_HH-mm-ss]") + " " + statusObject["Name"].toString() + ".json");
     jsonStorage->addJSON(statusObject);
+    QTimer::singleShot(0, this, &ControllerForm::startStartupWarmup);
+
+    // Bring the session catalog up to date with earlier sessions in the background
+    if (!replayMode)
+    {
+        sessionCatalogIndexer = new SessionCatalogIndexer(this);
+        connect(sessionCatalogIndexer, &SessionCatalogIndexer::indexingFinished, this, &ControllerForm::sessionCatalogIndexed);
+        QString logFolder = applicationConfiguration->value("SurgicalLogFolder").toString();
+        sessionCatalogIndexer->startIndexing(logFolder, applicationConfiguration->value("SessionCatalog", logFolder + "/SessionCatalog.sqlite").toString(),
+                                             InterfaceConfiguration::instance()->electrodeDefinitions());
+    }
+
+    // Every log entry from here on carries the NeuroOmega sample it happened at ("DeviceSample"), once the clock fit converges.
+    clockSynchronizer = new ClockSynchronizer(this);
+    clockSynchronizer->configure(applicationConfiguration->value("ClockSyncInterval", 100).toInt());
+    connect(clockSynchronizer, &ClockSynchronizer::synchronizationLost, this, &ControllerForm::clockSynchronizationLost);
+    jsonStorage->setEventTagger([this](QJsonObject &event) { clockSynchronizer->tagEvent(event); });
+    clockSynchronizer->start(QThread::HighPriority);
+
+    // Labels are timestamped at the click and sent to NeuroOmega in the background
+    labelDispatcher = new LabelDispatcher(this);
+    labelDispatcher->configure(clockSynchronizer, applicationConfiguration->value("LabelCoalesceLatency", 50).toInt());
+    connect(labelDispatcher, &LabelDispatcher::labelDispatched, this, &ControllerForm::labelDispatched);
+    connect(labelDispatcher, &LabelDispatcher::labelFailed, this, &ControllerForm::labelDispatchFailed);
+    labelDispatcher->start(QThread::HighPriority);
     sideEffectNotes = new QFile(applicationConfiguration->value("SurgicalLogFolder").toString() + "\\" + patientDirectory + "\\" + currentTime.currentDateTime().toString("[yyyyMMdd_HH-mm-ss]") + " " + statusObject["Name"].toString() + ".txt");
     sideEffectNotes->open(QIODevice::WriteOnly | QIODevice::Text);
 
+    // Recording start waits on NeuroOmega from the event loop instead of sleeping.
+    // Created before the SetSaveFileName check below, since the Record button needs it even if that call fails.
+    recordingStartStateMachine = new RecordingStartStateMachine(this);
+    connect(recordingStartStateMachine, &RecordingStartStateMachine::started, this, &ControllerForm::recordingStarted);
+    connect(recordingStartStateMachine, &RecordingStartStateMachine::failed, this, &ControllerForm::recordingStartFailed);
+
     // Reset the filename to MER. This is because NeuroOmega actually keep track of the filename previously set.
     // If we get a new patient we should at least reset it once before actual program starting
     QString filename = "";
     filename = filename + currentTime.currentDateTime().toString("yyyyMMdd") + "_" + QString::fromStdString(this->diagnosis) + "_" + QString::fromStdString(this->patientID) + "_MER_";
 
-    int result = SetSaveFileName((char*)filename.toStdString().c_str(), filename.length());
+    int result = AO_CALL(SetSaveFileName)((char*)filename.toStdString().c_str(), filename.length());
     if (result != eAO_OK)
     {
         QString messsage = getErrorLog();
@@ -157,88 +177,101 @@ void ControllerForm::controllerInitialization(string patientID, string diagnosis
     connect(connectionCheck, &QTimer::timeout, this, &ControllerForm::checkStatus);
     connectionCheck->start(1000);
 
-    QFile file;
-    file.setFileName(QDir::currentPath() + "/InterfaceConfigurations.json");
-    if (!file.open(QIODevice::ReadOnly)) return;
-    QByteArray configurationData = file.readAll();
-
+    updateRecordingLabels();
+}
 
-    QJsonDocument loadedDocument = QJsonDocument::fromJson(configurationData);
-    if (loadedDocument.isObject())
+void ControllerForm::updateRecordingLabels()
+{
+    const QStringList &recordingLabels = InterfaceConfiguration::instance()->recordingLabels();
+    QPushButton* RecordingLabelButtons[5] = {ui->RecordingLabels_1, ui->RecordingLabels_2, ui->RecordingLabels_3, ui->RecordingLabels_4, ui->RecordingLabels_5};
+    for (int i = 0; i < recordingLabels.size() && i < 5; i++)
     {
-        QJsonObject documentObject = loadedDocument.object();
-        if (documentObject.contains("RecordingLabels"))
-        {
-            QJsonObject interfaceConfigurations = loadedDocument.object();
-            QJsonArray recordingLabels = interfaceConfigurations["RecordingLabels"].toArray();
-            QPushButton* RecordingLabelButtons[5] = {ui->RecordingLabels_1, ui->RecordingLabels_2, ui->RecordingLabels_3, ui->RecordingLabels_4, ui->RecordingLabels_5};
-            for (int i = 0; i < recordingLabels.count(); i++)
-            {
-                if (i < 5) RecordingLabelButtons[i]->setText(recordingLabels[i].toString());
-            }
-        }
+        RecordingLabelButtons[i]->setText(recordingLabels[i]);
     }
-
 }
 
 // Clean-up after Form is closed
 void ControllerForm::closeEvent(QCloseEvent *event)
 {
+    PROFILE_SCOPE("ControllerForm::closeEvent");
+
     // Clean-up Step 1: Rename all channel name to default.
     // Default ECOG HF channel name are ECOG HF 01 / 01 - Array / 01
-    uint32 channelCount = 0;
-    GetChannelsCount(&channelCount);
-    SInformation channelsInfo[channelCount];
-    GetAllChannels(channelsInfo, channelCount);
-    for (unsigned i = 0; i < channelCount; i++)
+    ChannelConfigurationEngine *channelConfiguration = ChannelConfigurationEngine::instance();
+    if (ChannelCatalog::instance()->refresh())
     {
-        if (channelsInfo[i].channelID >= 10272 && channelsInfo[i].channelID <= 10335)
-        {
-            int boxID = (channelsInfo[i].channelID - 10272) / 16;
-            int channelID = (channelsInfo[i].channelID - 10272) % 16;
-            QString defaultChannelName = "ECOG HF " + QString::number(boxID+1) + " / " + QStringLiteral("%1").arg(channelID+1, 2, 10, QLatin1Char('0')) + " - Array " + QString::number(boxID+1) + " / " + QStringLiteral("%1").arg(channelID+1, 2, 10, QLatin1Char('0'));
-            SetChannelName(channelsInfo[i].channelID, (char*)defaultChannelName.toStdString().c_str(), defaultChannelName.length());
-        }
+        channelConfiguration->beginConfiguration();
+        channelConfiguration->setDefaultNames(ECOG_FIRST_CHANNEL, ECOG_LAST_CHANNEL);
+        channelConfiguration->apply();
     }
 
-    // Clean-up Step 2: If recording is on-going, Stop recording
+    // Clean-up Step 2: Stop live streaming and keep the DSP timing with the session log
+    stopStreaming();
+    startupWarmup->cancel();
+    if (sessionCatalogIndexer != nullptr) sessionCatalogIndexer->stopIndexing();
+
+    // Clean-up Step 3: If recording is on-going, Stop recording
+    if (recordingStartStateMachine != nullptr) recordingStartStateMachine->cancel();
     if (recordingStatus) on_NeuroOmega_RecordingStop_clicked();
 
-    // Clean-up Step 3: If stimulation is on-going, stop stimualtion.
+    // Clean-up Step 4: If stimulation is on-going, stop stimualtion.
     if (currentStimulationState) on_StimulationControl_Stop_clicked();
 
-    // Clean-up Step 4: Save the JSON and Note File
+    // Clean-up Step 5: Send the labels still queued and deliver their log entries before the log is saved
+    labelDispatcher->stopDispatcher();
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+
+    // Clean-up Step 6: Keep the label timing, clock fit and SDK call statistics with the session log, then save the JSON and Note File
+    QJsonObject labelDispatchObject = labelDispatcher->report();
+    labelDispatchObject["ObjectType"] = QJsonValue("LabelDispatch");
+    QDateTime currentTime;
+    labelDispatchObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+    jsonStorage->addJSON(labelDispatchObject);
+
+    clockSynchronizer->stopSynchronizer();
+    QJsonObject clockObject = clockSynchronizer->report();
+    clockObject["ObjectType"] = QJsonValue("ClockSynchronization");
+    clockObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+    jsonStorage->addJSON(clockObject);
+
+    QJsonObject instrumentationObject = SDKInstrumentation::instance()->toJson();
+    instrumentationObject["ObjectType"] = QJsonValue("SDKInstrumentation");
+    instrumentationObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+    jsonStorage->addJSON(instrumentationObject);
+
+    // GUI stall summary goes to the session log, the folded-stack trace next to the note file
+    QJsonObject profilerObject = EventLoopProfiler::instance()->report();
+    profilerObject["ObjectType"] = QJsonValue("EventLoopProfile");
+    profilerObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+    jsonStorage->addJSON(profilerObject);
+
+    QString traceFilename = sideEffectNotes->fileName();
+    traceFilename.chop(4);
+    EventLoopProfiler::instance()->writeTrace(traceFilename + " EventLoop.folded");
+
     jsonStorage->saveJSON();
     sideEffectNotes->close();
 
     // Closing NeuroOmega Connection
-    CloseConnection();
+    AO_CALL(CloseConnection)();
     emit connectionChanged();
 }
 
 // Generic Error Log Reporting Function to extract NeuroOmega error message for display
 QString ControllerForm::getErrorLog()
 {
-    char errorString[1000] = {0};
-    int nErrorCount = 0;
-    int result = ErrorHandlingfunc(&nErrorCount, errorString, 1000);
-
-    switch (result)
-    {
-        case eAO_ARG_NULL:
-            printf("ErrorHandlingfunc: NULL Argument Error\n");
-            break;
-        case eAO_BAD_ARG:
-            printf("ErrorHandlingfunc: Bad Argument\n");
-            break;
-    }
-
-    return QString(errorString);
+    return sdkErrorLog();
 }
 
 // Standard error display using QMessageBox
 void ControllerForm::displayError(int errorLevel, QString message)
 {
+    if (replayMode)
+    {
+        replayErrors.append(message);
+        return;
+    }
+
     if (errorLevel == QMessageBox::Critical)
     {
         QMessageBox::critical(this, "Error", message, QMessageBox::Close);
@@ -252,8 +285,10 @@ void ControllerForm::displayError(int errorLevel, QString message)
 // Periodic task that check NeuroOmega connectivity
 void ControllerForm::checkStatus()
 {
+    PROFILE_SCOPE("ControllerForm::checkStatus");
+
     // If NeuroOmega is closed, request closing of the current controller form.
-    int result = isConnected();
+    int result = AO_CALL(isConnected)();
     if (result != eAO_CONNECTED)
     {
         displayError(QMessageBox::Critical, "The connection with NeuroOmega is disconnected.");
@@ -267,7 +302,7 @@ void ControllerForm::checkStatus()
     int connectionQuality = 0;
     real32 percentThroughput = 0;
 
-    result = CheckQualityConnection(&connectionQuality, &percentThroughput);
+    result = AO_CALL(CheckQualityConnection)(&connectionQuality, &percentThroughput);
     if (result != eAO_OK)
     {
         QString messsage = getErrorLog();
@@ -291,7 +326,7 @@ void ControllerForm::checkStatus()
 
     // Note is that NeuroOmega timestamp is reported as number of clock, divided by 44k to get actual seconds since NeuroOmega started.
     ulong timestamp = 0;
-    result = GetLatestTimeStamp(&timestamp);
+    result = AO_CALL(GetLatestTimeStamp)(&timestamp);
     if (result != eAO_OK)
     {
         QString messsage = getErrorLog();
@@ -312,17 +347,17 @@ void ControllerForm::checkStatus()
     jsonObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
 
     int32 motorDepth = 0;
-    result = GetDriveDepth(&motorDepth);
+    result = AO_CALL(GetDriveDepth)(&motorDepth);
     if (result == eAO_OK)
     {
         jsonObject["CurrentDepth"] = QJsonValue((qint64)motorDepth);
         uint32 motorStopTimer = 0, motorStartTimer = 0;
-        result = GetMoveMotorTS(&motorStartTimer);
+        result = AO_CALL(GetMoveMotorTS)(&motorStartTimer);
         if (result == eAO_OK)
         {
             jsonObject["LastMoveTS"] = QJsonValue((qint64)motorStartTimer);
         }
-        result = GetStopMotorTS(&motorStopTimer);
+        result = AO_CALL(GetStopMotorTS)(&motorStopTimer);
         if (result == eAO_OK)
         {
             jsonObject["LastStopTS"] = QJsonValue((qint64)motorStopTimer);
@@ -337,6 +372,8 @@ void ControllerForm::checkStatus()
 // The main electrode loading process.
 void ControllerForm::configureElectrodes(QList<ElectrodeInformation> electrodeInformations)
 {
+    PROFILE_SCOPE("ControllerForm::configureElectrodes");
+
     electrodeConfigurations = electrodeInformations;
 
     // Configure the selected channel for recording. See detail function "configureRecordingChannels()" on how this process work.
@@ -359,6 +396,11 @@ void ControllerForm::configureElectrodes(QList<ElectrodeInformation> electrodeIn
         {
             ui->StimulationControl_Electrode->addItem("Lead #" + QString::number(i+1) + " " + electrodeConfigurations[i].hemisphere + " " + electrodeConfigurations[i].target);
             jsonObject["Lead" + QString::number(i+1)] = QJsonValue(electrodeConfigurations[i].electrodeType + " " + electrodeConfigurations[i].hemisphere + " " + electrodeConfigurations[i].target);
+
+            // Channel IDs let the session catalog map logged stimulation channels back to lead contacts
+            QJsonArray channelArray;
+            for (int j = 0; j < electrodeConfigurations[i].numContacts && j < electrodeConfigurations[i].channelIDs.size(); j++) channelArray.append(electrodeConfigurations[i].channelIDs[j]);
+            jsonObject["Lead" + QString::number(i+1) + "Channels"] = channelArray;
         }
     }
 
@@ -393,6 +435,353 @@ void ControllerForm::configureElectrodes(QList<ElectrodeInformation> electrodeIn
     {
         sideEffectsBtns[i]->setEnabled(true);
     }
+
+    startStreaming();
+}
+
+// Stream every configured contact from NeuroOmega and run the filter graph selected in defaultSettings.ini ("FilterGraph", default "Default").
+void ControllerForm::startStreaming()
+{
+    PROFILE_SCOPE("ControllerForm::startStreaming");
+
+    QVector<int> streamChannels;
+    for (int i = 0; i < this->electrodeConfigurations.size(); i++)
+    {
+        for (int j = 0; j < this->electrodeConfigurations[i].channelIDs.size(); j++)
+        {
+            if (this->electrodeConfigurations[i].channelIDs[j] > 0) streamChannels.append(this->electrodeConfigurations[i].channelIDs[j]);
+        }
+    }
+
+    // Microelectrode channels for the depth profile are listed in defaultSettings.ini ("MERChannels", e.g. 10000,10001)
+    MERProfileParameters merParameters;
+    QStringList merChannels = applicationConfiguration->value("MERChannels").toStringList();
+    for (int i = 0; i < merChannels.size(); i++)
+    {
+        int channelID = merChannels[i].trimmed().toInt();
+        if (channelID <= 0) continue;
+        merParameters.channelIDs.append(channelID);
+        if (!streamChannels.contains(channelID)) streamChannels.append(channelID);
+    }
+    merParameters.binSize = applicationConfiguration->value("MERDepthBin", 100).toInt();
+
+    streamDataHandler = new StreamDataHandler(this);
+    if (!streamDataHandler->configureChannels(streamChannels))
+    {
+        delete(streamDataHandler);
+        streamDataHandler = nullptr;
+        displayError(QMessageBox::Warning, "No channels available for live streaming.");
+        return;
+    }
+
+    // The filter graph is optional. Streaming to the rings continues without it.
+    filterGraph = new FilterGraph();
+    filterGraph->setParameter("LineFrequency", applicationConfiguration->value("LineFrequency", 60).toDouble());
+    QString graphName = applicationConfiguration->value("FilterGraph", "Default").toString();
+    if (filterGraph->loadConfiguration(QDir::currentPath() + "/FilterGraphs.json", graphName))
+    {
+        filterGraph->setElectrodeLayouts(this->electrodeConfigurations);
+        filterGraph->prepare(streamDataHandler->channels().size(), streamDataHandler->maxBlockSamples(), NEUROOMEGA_SAMPLING_RATE, streamDataHandler->channels());
+        streamDataHandler->addConsumer(filterGraph);
+        ui->StimulationControl_ClosedLoop->setEnabled(true);
+    }
+    else
+    {
+        QJsonObject graphObject;
+        graphObject["ObjectType"] = QJsonValue("FilterGraphError");
+        graphObject["FilterGraph"] = QJsonValue(graphName);
+        graphObject["Message"] = QJsonValue(filterGraph->errorMessage());
+
+        QDateTime currentTime;
+        graphObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+        jsonStorage->addJSON(graphObject);
+
+        displayError(QMessageBox::Warning, "Filter graph \"" + graphName + "\" not loaded: " + filterGraph->errorMessage());
+        delete(filterGraph);
+        filterGraph = nullptr;
+    }
+
+    if (!merParameters.channelIDs.isEmpty())
+    {
+        merProfileBuilder = new MERProfileBuilder(this);
+        if (merProfileBuilder->configure(merParameters, streamDataHandler->channels()))
+        {
+            streamDataHandler->addConsumer(merProfileBuilder);
+            merProfileBuilder->start(QThread::LowPriority);
+        }
+        else
+        {
+            delete(merProfileBuilder);
+            merProfileBuilder = nullptr;
+        }
+    }
+
+    // Gapless capture of every streamed channel next to the NeuroOmega MPX files ("ShadowRecording", default on).
+    // Chunks are "ShadowChunkDuration" seconds long and live in a folder next to the session log.
+    if (applicationConfiguration->value("ShadowRecording", true).toBool() && !replayMode)
+    {
+        QDateTime currentTime;
+        QString shadowDirectory = applicationConfiguration->value("SurgicalLogFolder").toString() + "\\" + patientDirectory + "\\" + currentTime.currentDateTime().toString("[yyyyMMdd_HH-mm-ss]") + " " + QString::fromStdString(this->patientID) + " Shadow";
+        shadowRecordingWriter = new ShadowRecordingWriter(this);
+        if (shadowRecordingWriter->configure(shadowDirectory, streamDataHandler->channels(), applicationConfiguration->value("ShadowChunkDuration", 60).toInt()))
+        {
+            connect(shadowRecordingWriter, &ShadowRecordingWriter::writerError, this, &ControllerForm::shadowRecordingFailed);
+            streamDataHandler->addConsumer(shadowRecordingWriter);
+            shadowRecordingWriter->start(QThread::HighPriority);
+        }
+        else
+        {
+            QString message = "Shadow recording not started: " + shadowRecordingWriter->errorMessage();
+            delete(shadowRecordingWriter);
+            shadowRecordingWriter = nullptr;
+            shadowRecordingFailed(message);
+        }
+    }
+
+    streamDataHandler->start(QThread::HighPriority);
+
+    contactQualityEstimator = new ContactQualityEstimator(this);
+    if (contactQualityEstimator->configure(streamDataHandler, applicationConfiguration->value("LineFrequency", 60).toDouble()))
+    {
+        connect(contactQualityEstimator, &ContactQualityEstimator::qualityUpdated, this, &ControllerForm::contactQualityUpdated);
+        contactQualityEstimator->start(QThread::LowPriority);
+    }
+}
+
+void ControllerForm::stopStreaming()
+{
+    PROFILE_SCOPE("ControllerForm::stopStreaming");
+
+    if (streamDataHandler == nullptr) return;
+    stopClosedLoop();
+    electrodeOverlaySelected("");
+    electrodeGrid->clearOverlay();
+
+    if (contactQualityEstimator != nullptr)
+    {
+        contactQualityEstimator->stopEstimator();
+
+        QJsonObject qualityObject = contactQualityEstimator->report();
+        qualityObject["ObjectType"] = QJsonValue("ContactQuality");
+
+        QDateTime currentTime;
+        qualityObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+        jsonStorage->addJSON(qualityObject);
+
+        delete(contactQualityEstimator);
+        contactQualityEstimator = nullptr;
+    }
+
+    streamDataHandler->stopStreaming();
+
+    if (traceViewer != nullptr)
+    {
+        QJsonObject viewerObject = traceViewer->report();
+        viewerObject["ObjectType"] = QJsonValue("TraceViewerTiming");
+
+        QDateTime currentTime;
+        viewerObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+        jsonStorage->addJSON(viewerObject);
+
+        traceViewer->setStream(nullptr);
+        traceViewer->close();
+    }
+
+    if (spectrogramView != nullptr)
+    {
+        QJsonObject viewerObject = spectrogramView->report();
+        viewerObject["ObjectType"] = QJsonValue("SpectrogramTiming");
+
+        QDateTime currentTime;
+        viewerObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+        jsonStorage->addJSON(viewerObject);
+
+        spectrogramView->setFilterGraph(nullptr, QVector<int>(), QStringList());
+        spectrogramView->close();
+    }
+
+    if (filterGraph != nullptr)
+    {
+        QJsonObject timingObject;
+        timingObject["ObjectType"] = QJsonValue("FilterGraphTiming");
+        timingObject["Nodes"] = filterGraph->timingReport();
+
+        QDateTime currentTime;
+        timingObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+        jsonStorage->addJSON(timingObject);
+
+        streamDataHandler->removeConsumer(filterGraph);
+        delete(filterGraph);
+        filterGraph = nullptr;
+    }
+
+    if (shadowRecordingWriter != nullptr)
+    {
+        streamDataHandler->removeConsumer(shadowRecordingWriter);
+        shadowRecordingWriter->endSegment();
+        shadowRecordingWriter->stopWriter();
+
+        QJsonObject shadowObject = shadowRecordingWriter->report();
+        shadowObject["ObjectType"] = QJsonValue("ShadowRecording");
+
+        QDateTime currentTime;
+        shadowObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+        jsonStorage->addJSON(shadowObject);
+
+        delete(shadowRecordingWriter);
+        shadowRecordingWriter = nullptr;
+    }
+
+    if (merProfileBuilder != nullptr)
+    {
+        streamDataHandler->removeConsumer(merProfileBuilder);
+        merProfileBuilder->stopBuilder();
+
+        QJsonObject profileObject = merProfileBuilder->report();
+        profileObject["ObjectType"] = QJsonValue("MERProfile");
+
+        QDateTime currentTime;
+        profileObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+        jsonStorage->addJSON(profileObject);
+
+        delete(merProfileBuilder);
+        merProfileBuilder = nullptr;
+    }
+}
+
+// Shadow recording write failures (disk full, drive removed) do not affect the NeuroOmega MPX files.
+void ControllerForm::shadowRecordingFailed(QString message)
+{
+    QJsonObject shadowObject;
+    shadowObject["ObjectType"] = QJsonValue("ShadowRecordingError");
+    shadowObject["Message"] = QJsonValue(message);
+
+    QDateTime currentTime;
+    shadowObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+    jsonStorage->addJSON(shadowObject);
+
+    displayError(QMessageBox::Warning, message);
+}
+
+// Tag every contact of the current lead with its channel quality, through the "ContactQuality" property for
+// contact buttons and directly on the electrode grid.
+void ControllerForm::contactQualityUpdated()
+{
+    PROFILE_SCOPE("ControllerForm::contactQualityUpdated");
+
+    if (contactQualityEstimator == nullptr) return;
+    QVector<ChannelQuality> quality = contactQualityEstimator->quality();
+
+    for (int i = 0; i < contactSelection->size(); i++)
+    {
+        int channelID = contactSelection->channelID(i);
+        int state = ContactQualityGood;
+        QString toolTip = "";
+        for (int j = 0; j < quality.size(); j++)
+        {
+            if (quality[j].channelID != channelID) continue;
+            state = quality[j].state;
+            toolTip = ContactQualityEstimator::stateName(state) + ", Line Noise " + QString::number(quality[j].lineNoiseRatio * 100, 'f', 1) + "%";
+            break;
+        }
+
+        if (electrodeGridActive)
+        {
+            electrodeGrid->setContactQuality(i, state, toolTip);
+            continue;
+        }
+
+        QPushButton *button = contactSelectionButtons[i];
+        if (button->property("ContactQuality").toInt() == state && button->toolTip() == toolTip) continue;
+        button->setProperty("ContactQuality", state);
+        button->setToolTip(toolTip);
+        button->style()->unpolish(button);
+        button->style()->polish(button);
+    }
+}
+
+// Live overlay on the electrode grid. Band power comes from the last sample of a filter graph envelope node,
+// written by the acquisition thread and read by a 30 Hz timer. Line noise comes from the contact quality estimator.
+void ControllerForm::electrodeOverlaySelected(QString name)
+{
+    overlayTimer->stop();
+    if (overlaySinkID != 0)
+    {
+        if (filterGraph != nullptr) filterGraph->removeSink(overlaySinkID);
+        overlaySinkID = 0;
+    }
+    if (name.isEmpty()) return;
+
+    if (streamDataHandler == nullptr || !streamDataHandler->isRunning())
+    {
+        electrodeGrid->clearOverlay();
+        displayError(QMessageBox::Warning, "Live overlays require NeuroOmega streaming.");
+        return;
+    }
+
+    if (name != "Line Noise")
+    {
+        QString nodeName = name == "Beta Power" ? "BetaEnvelope" : "GammaEnvelope";
+        if (filterGraph != nullptr)
+        {
+            overlaySinkID = filterGraph->addSink(nodeName, [this](const SignalBlock &block) {
+                if (block.numSamples <= 0) return;
+                QMutexLocker locker(&overlayMutex);
+                if (overlayChannelIDs != block.channelIDs)
+                {
+                    overlayChannelIDs = block.channelIDs;
+                    overlayLatest.fill(NAN, block.numChannels);
+                }
+                for (int i = 0; i < block.numChannels; i++) overlayLatest[i] = block.channel(i)[block.numSamples - 1];
+            });
+        }
+        if (overlaySinkID == 0)
+        {
+            electrodeGrid->clearOverlay();
+            displayError(QMessageBox::Warning, "The filter graph has no " + nodeName + " node.");
+            return;
+        }
+    }
+    overlayTimer->start();
+}
+
+void ControllerForm::updateElectrodeOverlay()
+{
+    PROFILE_SCOPE("ControllerForm::updateElectrodeOverlay");
+
+    QString name = electrodeGrid->overlayName();
+    QVector<float> values((int)contactSelection->size(), NAN);
+    if (name == "Line Noise")
+    {
+        if (contactQualityEstimator == nullptr) return;
+        QVector<ChannelQuality> quality = contactQualityEstimator->quality();
+        for (int i = 0; i < quality.size(); i++)
+        {
+            int index = contactSelection->indexOf(quality[i].channelID);
+            if (index >= 0) values[index] = quality[i].lineNoiseRatio;
+        }
+        electrodeGrid->setOverlayValues(values, 0, 1);
+        return;
+    }
+
+    overlayMutex.lock();
+    for (int i = 0; i < overlayChannelIDs.size(); i++)
+    {
+        int index = contactSelection->indexOf(overlayChannelIDs[i]);
+        if (index >= 0) values[index] = overlayLatest[i];
+    }
+    overlayMutex.unlock();
+
+    // Band power is scaled to the contacts of the current lead
+    float minimum = INFINITY;
+    float maximum = -INFINITY;
+    for (int i = 0; i < values.size(); i++)
+    {
+        if (std::isnan(values[i])) continue;
+        minimum = qMin(minimum, values[i]);
+        maximum = qMax(maximum, values[i]);
+    }
+    electrodeGrid->setOverlayValues(values, minimum, maximum);
 }
 
 ////////////////////////////////////
@@ -403,15 +792,12 @@ void ControllerForm::setupElectrodeButtons(QString electrodeName)
 {
     ui->ElectrodeLayoutWidget->setStyleSheet("");
 
-    noneStyle = naturalButtonStyle;
-    cathodeStyle = naturalButtonStyle;
-    anodeStyle = naturalButtonStyle;
-    noneStyle.replace("[COLOR]","transparent");
-    cathodeStyle.replace("[COLOR]","rgb(83, 175, 255)");
-    anodeStyle.replace("[COLOR]","rgb(255, 88, 99)");
+    contactStyle = naturalButtonStyle;
+    contactStyle.replace("[COLOR]","transparent");
+    QList<QVector<int>> rings;
 
-    for (int i = 0; i < displayChannelButtons.size(); i++) delete(displayChannelButtons[i]);
-    displayChannelButtons.clear();
+    contactSelectionButtons.clear();
+    electrodeGridActive = false;
 
     // UI update, reset all contacts to hidden
     QPushButton *allButtons[] = {ui->StimulationContact_E00,
@@ -421,6 +807,7 @@ void ControllerForm::setupElectrodeButtons(QString electrodeName)
     for (int i = 0; i < 8; i++)
     {
         allButtons[i]->setHidden(true);
+        allButtons[i]->setProperty("ContactIndex", -1);
     }
 
     // Default Display for Micro/Macro Electrode. We currently hard-coded the program to handle up to 2 Microelectrode Arrays.
@@ -431,15 +818,17 @@ void ControllerForm::setupElectrodeButtons(QString electrodeName)
         ui->StimulationContact_Ring01->setHidden(true);
         ui->StimulationContact_Ring02->setHidden(true);
 
+        // Save states come from the channel catalog instead of one SDK call per channel.
+        ChannelCatalog *channelCatalog = ChannelCatalog::instance();
+        if (!channelCatalog->isValid()) channelCatalog->refresh();
+
         // NeuroOmega Channel 10000 - MicroElectrode 01
         // If the channel is enabled. Display MicroElectrode 1 for Stimulation
-        int saveState = 0;
-        GetChannelSaveState(10000, &saveState);
-        if (saveState != 0)
+        bool saveState = channelCatalog->saveState(10000);
+        if (saveState)
         {
             ui->StimulationContact_E01_1->setText("Micro\n01");
-            ui->StimulationContact_E01_1->setProperty("ChannelID", 10000);
-            ui->StimulationContact_E01_1->setStyleSheet(noneStyle);
+            bindContactButton(ui->StimulationContact_E01_1, 10000);
             ui->StimulationContact_E01_1->setHidden(false);
             this->currentElectrodeConfiguration.channelIDs.append(10000);
             channelIndex++;
@@ -447,12 +836,11 @@ void ControllerForm::setupElectrodeButtons(QString electrodeName)
 
         // NeuroOmega Channel 10005 - Macroelectrode 01
         // If the channel is enabled. Display Macroelectrode 1 for Stimulation
-        GetChannelSaveState(10005, &saveState);
-        if (saveState != 0)
+        saveState = channelCatalog->saveState(10005);
+        if (saveState)
         {
             ui->StimulationContact_E02_1->setText("Macro\n01");
-            ui->StimulationContact_E02_1->setProperty("ChannelID", 10005);
-            ui->StimulationContact_E02_1->setStyleSheet(noneStyle);
+            bindContactButton(ui->StimulationContact_E02_1, 10005);
             ui->StimulationContact_E02_1->setHidden(false);
             this->currentElectrodeConfiguration.channelIDs.append(10005);
             channelIndex++;
@@ -460,12 +848,11 @@ void ControllerForm::setupElectrodeButtons(QString electrodeName)
 
         // NeuroOmega Channel 10001 - MicroElectrode 02
         // If the channel is enabled. Display MicroElectrode 2 for Stimulation
-        GetChannelSaveState(10001, &saveState);
-        if (saveState != 0)
+        saveState = channelCatalog->saveState(10001);
+        if (saveState)
         {
             ui->StimulationContact_E01_3->setText("Micro\n02");
-            ui->StimulationContact_E01_3->setProperty("ChannelID", 10001);
-            ui->StimulationContact_E01_3->setStyleSheet(noneStyle);
+            bindContactButton(ui->StimulationContact_E01_3, 10001);
             ui->StimulationContact_E01_3->setHidden(false);
             this->currentElectrodeConfiguration.channelIDs.append(10001);
             channelIndex++;
@@ -473,12 +860,11 @@ void ControllerForm::setupElectrodeButtons(QString electrodeName)
 
         // NeuroOmega Channel 10006 - Macroelectrode 02
         // If the channel is enabled. Display Macroelectrode 2 for Stimulation
-        GetChannelSaveState(10006, &saveState);
-        if (saveState != 0)
+        saveState = channelCatalog->saveState(10006);
+        if (saveState)
         {
             ui->StimulationContact_E02_3->setText("Macro\n02");
-            ui->StimulationContact_E02_3->setProperty("ChannelID", 10006);
-            ui->StimulationContact_E02_3->setStyleSheet(noneStyle);
+            bindContactButton(ui->StimulationContact_E02_3, 10006);
             ui->StimulationContact_E02_3->setHidden(false);
             this->currentElectrodeConfiguration.channelIDs.append(10006);
             channelIndex++;
@@ -502,28 +888,11 @@ void ControllerForm::setupElectrodeButtons(QString electrodeName)
         {
             ui->StimulationContact_Ring01->setHidden(true);
             ui->StimulationContact_Ring02->setHidden(true);
-            ui->ElectrodeLayoutWidget->setStyleSheet("#ElectrodeLayoutWidget {background-image: url(" + QDir::currentPath() + "/resources/ECoG_Background.png);}");
-
-            int estimatedHeight = 500/this->electrodeConfigurations[electrodeID].layoutSize[1]*0.8;
-
-            noneStyle.replace("[RADIUS]",QString::number(estimatedHeight/2));
-            cathodeStyle.replace("[RADIUS]",QString::number(estimatedHeight/2));
-            anodeStyle.replace("[RADIUS]",QString::number(estimatedHeight/2));
-
-            for (int i = 0; i < this->electrodeConfigurations[electrodeID].numContacts; i++)
-            {
-                QPushButton *button = new QPushButton();
-                button->setFixedSize(estimatedHeight,estimatedHeight);
-                button->setStyleSheet(noneStyle);
-                button->setFlat(true);
-                button->setText(QString::number(i));
-                button->setProperty("ChannelID", this->electrodeConfigurations[electrodeID].channelIDs[i]);
-                button->connect(button, &QPushButton::clicked, this, &ControllerForm::on_StimulationContactClicked);
-                electrodeLayout->addWidget(button, i % this->electrodeConfigurations[electrodeID].layoutSize[1], i / this->electrodeConfigurations[electrodeID].layoutSize[1]);
-                displayChannelButtons.append(button);
-            }
-            ui->StimulationContact_GlobalCAN->setStyleSheet(noneStyle);
 
+            QStringList labels;
+            for (int i = 0; i < this->electrodeConfigurations[electrodeID].numContacts; i++) labels.append(QString::number(i));
+            electrodeGrid->setElectrodeLayout(this->electrodeConfigurations[electrodeID].layoutSize[1], this->electrodeConfigurations[electrodeID].numContacts, labels);
+            electrodeGridActive = true;
         }
         else if (this->electrodeConfigurations[electrodeID].numContacts == 4)
         {
@@ -533,8 +902,7 @@ void ControllerForm::setupElectrodeButtons(QString electrodeName)
             for (int i = 0; i < 4; i++)
             {
                 contactButtons[i]->setText("Contact\n" + QString::number(i));
-                contactButtons[i]->setProperty("ChannelID", this->electrodeConfigurations[electrodeID].channelIDs[i]);
-                contactButtons[i]->setStyleSheet(noneStyle);
+                bindContactButton(contactButtons[i], this->electrodeConfigurations[electrodeID].channelIDs[i]);
                 contactButtons[i]->setHidden(false);
             }
         }
@@ -549,189 +917,117 @@ void ControllerForm::setupElectrodeButtons(QString electrodeName)
             {
                 int ringID = ((i - 1) / 3) + 1;
                 contactButtons[i]->setText("Contact\n" + QString::number(ringID) + "." + QString::number(i - (ringID - 1) * 3));
-                contactButtons[i]->setProperty("ChannelID", this->electrodeConfigurations[electrodeID].channelIDs[i]);
-                contactButtons[i]->setStyleSheet(noneStyle);
                 contactButtons[i]->setHidden(false);
             }
             contactButtons[0]->setText("Contact\n" + QString::number(0));
             contactButtons[7]->setText("Contact\n" + QString::number(3));
+            for (int i = 0; i < 8; i++) bindContactButton(contactButtons[i], this->electrodeConfigurations[electrodeID].channelIDs[i]);
+            rings << QVector<int>{1, 2, 3} << QVector<int>{4, 5, 6};
         }
     }
-}
 
-// UI update for stimulation electrodes
-void ControllerForm::on_StimulationControl_Electrode_currentTextChanged(const QString &electrodeName)
-{
-    setupElectrodeButtons(electrodeName);
-    StimulationAnode.clear();
-    StimulationCathode = 0;
-    ui->StimulationContact_GlobalCAN->setStyleSheet(noneStyle);
-}
+    ui->StimulationContact_GlobalCAN->setProperty("ContactState", ContactNone);
+    ui->StimulationContact_GlobalCAN->setStyleSheet(contactStyle);
 
-// Quick reset for all electrode cathodes. This will be execute every time electrode selector changes.
-void ControllerForm::resetCathodeSelection()
-{
-    if (displayChannelButtons.size() > 0)
+    QVector<int> channelIDs;
+    QStringList labels;
+    if (electrodeGridActive)
     {
-        for (int i = 0; i < displayChannelButtons.size(); i++)
-        {
-            if (displayChannelButtons[i]->styleSheet() == cathodeStyle)
-            {
-                displayChannelButtons[i]->setStyleSheet(noneStyle);
-            }
-        }
+        channelIDs = this->currentElectrodeConfiguration.channelIDs.mid(0, this->currentElectrodeConfiguration.numContacts);
+        for (int i = 0; i < channelIDs.size(); i++) labels.append(QString::number(i));
     }
     else
     {
-        QPushButton *contactButtons[] = {ui->StimulationContact_E00, ui->StimulationContact_E01_1, ui->StimulationContact_E01_2, ui->StimulationContact_E01_3, ui->StimulationContact_E02_1, ui->StimulationContact_E02_2, ui->StimulationContact_E02_3, ui->StimulationContact_E03};
-        for (int i = 0; i < 8; i++)
+        for (int i = 0; i < contactSelectionButtons.size(); i++)
         {
-            if (contactButtons[i]->styleSheet() == cathodeStyle)
-            {
-                contactButtons[i]->setStyleSheet(noneStyle);
-            }
+            channelIDs.append(contactSelectionButtons[i]->property("ChannelID").toInt());
+            labels.append(contactSelectionButtons[i]->text());
         }
     }
+    electrodeGrid->setHidden(!electrodeGridActive);
+    contactSelection->setLayout(channelIDs, labels, rings);
 }
 
-// UI updates
-void ControllerForm::on_StimulationContact_GlobalCAN_clicked()
+// Attach a contact button to the next index of the contact selection model.
+void ControllerForm::bindContactButton(QPushButton *button, int channelID)
 {
-    if (StimulationCathode == -1)
-    {
-        StimulationCathode = 0;
-        ui->StimulationContact_GlobalCAN->setStyleSheet(noneStyle);
-    }
-    else
-    {
-        StimulationCathode = -1;
-        resetCathodeSelection();
-        ui->StimulationContact_GlobalCAN->setStyleSheet(cathodeStyle);
-    }
+    button->setProperty("ChannelID", channelID);
+    button->setProperty("ContactIndex", contactSelectionButtons.size());
+    button->setProperty("ContactState", ContactNone);
+    button->setStyleSheet(contactStyle);
+    contactSelectionButtons.append(button);
 }
 
-// UI updates for ring selection
-void ControllerForm::on_StimulationContact_Ring01_clicked()
+// UI update for stimulation electrodes
+void ControllerForm::on_StimulationControl_Electrode_currentTextChanged(const QString &electrodeName)
 {
-    if (ui->StimulationContact_E01_1->styleSheet() == anodeStyle && ui->StimulationContact_E01_2->styleSheet() == anodeStyle && ui->StimulationContact_E01_3->styleSheet() == anodeStyle)
-    {
-        int electrodeID = ui->StimulationContact_E01_1->property("ChannelID").toInt();
-        ui->StimulationContact_E01_1->setStyleSheet(noneStyle);
-        StimulationAnode.removeAt(StimulationAnode.indexOf(electrodeID));
-
-        electrodeID = ui->StimulationContact_E01_2->property("ChannelID").toInt();
-        ui->StimulationContact_E01_2->setStyleSheet(noneStyle);
-        StimulationAnode.removeAt(StimulationAnode.indexOf(electrodeID));
+    PROFILE_SCOPE("ControllerForm::on_StimulationControl_Electrode_currentTextChanged");
 
-        electrodeID = ui->StimulationContact_E01_3->property("ChannelID").toInt();
-        ui->StimulationContact_E01_3->setStyleSheet(noneStyle);
-        StimulationAnode.removeAt(StimulationAnode.indexOf(electrodeID));
-        return;
-    }
-
-    QPushButton *allButtons[] = {ui->StimulationContact_E00,
-                                 ui->StimulationContact_E01_1, ui->StimulationContact_E01_2, ui->StimulationContact_E01_3,
-                                 ui->StimulationContact_E02_1, ui->StimulationContact_E02_2, ui->StimulationContact_E02_3,
-                                 ui->StimulationContact_E03,
-                                 ui->StimulationContact_GlobalCAN};
+    setupElectrodeButtons(electrodeName);
+    updateTraceChannels();
+    updateSpectrogramSources();
+}
 
-    for (int i = 0; i < 9; i++)
+// View binding for the contact selection model. Only the button whose state changed is re-polished.
+void ControllerForm::contactStateChanged(int index, int state)
+{
+    if (electrodeGridActive)
     {
-        if (allButtons[i]->styleSheet() == anodeStyle)
-        {
-            allButtons[i]->setStyleSheet(noneStyle);
-        }
+        electrodeGrid->setContactState(index, state);
+        return;
     }
-    ui->StimulationContact_E01_1->setStyleSheet(anodeStyle);
-    ui->StimulationContact_E01_2->setStyleSheet(anodeStyle);
-    ui->StimulationContact_E01_3->setStyleSheet(anodeStyle);
+    if (index < 0 || index >= contactSelectionButtons.size()) return;
 
-    StimulationAnode.clear();
-    QPushButton *ring1Buttons[] = {ui->StimulationContact_E01_1, ui->StimulationContact_E01_2, ui->StimulationContact_E01_3};
-    for (int i = 0; i < 3; i++)
-    {
-        int electrodeID = ring1Buttons[i]->property("ChannelID").toInt();
-        StimulationAnode << electrodeID;
-    }
+    QPushButton *button = contactSelectionButtons[index];
+    button->setProperty("ContactState", state);
+    button->style()->unpolish(button);
+    button->style()->polish(button);
 }
 
-// UI updates for ring selection
-void ControllerForm::on_StimulationContact_Ring02_clicked()
+void ControllerForm::globalReturnChanged(bool selected)
 {
-    if (ui->StimulationContact_E02_1->styleSheet() == anodeStyle && ui->StimulationContact_E02_2->styleSheet() == anodeStyle && ui->StimulationContact_E02_3->styleSheet() == anodeStyle)
-    {
-        int electrodeID = ui->StimulationContact_E02_1->property("ChannelID").toInt();
-        ui->StimulationContact_E02_1->setStyleSheet(noneStyle);
-        StimulationAnode.removeAt(StimulationAnode.indexOf(electrodeID));
+    ui->StimulationContact_GlobalCAN->setProperty("ContactState", selected ? ContactCathode : ContactNone);
+    ui->StimulationContact_GlobalCAN->style()->unpolish(ui->StimulationContact_GlobalCAN);
+    ui->StimulationContact_GlobalCAN->style()->polish(ui->StimulationContact_GlobalCAN);
+}
 
-        electrodeID = ui->StimulationContact_E02_2->property("ChannelID").toInt();
-        ui->StimulationContact_E02_2->setStyleSheet(noneStyle);
-        StimulationAnode.removeAt(StimulationAnode.indexOf(electrodeID));
+// UI updates
+void ControllerForm::on_StimulationContact_GlobalCAN_clicked()
+{
+    PROFILE_SCOPE("ControllerForm::on_StimulationContact_GlobalCAN_clicked");
 
-        electrodeID = ui->StimulationContact_E02_3->property("ChannelID").toInt();
-        ui->StimulationContact_E02_3->setStyleSheet(noneStyle);
-        StimulationAnode.removeAt(StimulationAnode.indexOf(electrodeID));
-        return;
-    }
+    contactSelection->toggleGlobalReturn();
+}
 
-    QPushButton *allButtons[] = {ui->StimulationContact_E00,
-                                 ui->StimulationContact_E01_1, ui->StimulationContact_E01_2, ui->StimulationContact_E01_3,
-                                 ui->StimulationContact_E02_1, ui->StimulationContact_E02_2, ui->StimulationContact_E02_3,
-                                 ui->StimulationContact_E03,
-                                 ui->StimulationContact_GlobalCAN};
+// UI updates for ring selection
+void ControllerForm::on_StimulationContact_Ring01_clicked()
+{
+    PROFILE_SCOPE("ControllerForm::on_StimulationContact_Ring01_clicked");
 
-    for (int i = 0; i < 9; i++)
-    {
-        if (allButtons[i]->styleSheet() == anodeStyle)
-        {
-            allButtons[i]->setStyleSheet(noneStyle);
-        }
-    }
+    contactSelection->toggleRing(0);
+}
 
-    ui->StimulationContact_E02_1->setStyleSheet(anodeStyle);
-    ui->StimulationContact_E02_2->setStyleSheet(anodeStyle);
-    ui->StimulationContact_E02_3->setStyleSheet(anodeStyle);
+// UI updates for ring selection
+void ControllerForm::on_StimulationContact_Ring02_clicked()
+{
+    PROFILE_SCOPE("ControllerForm::on_StimulationContact_Ring02_clicked");
 
-    StimulationAnode.clear();
-    QPushButton *ring1Buttons[] = {ui->StimulationContact_E02_1, ui->StimulationContact_E02_2, ui->StimulationContact_E02_3};
-    for (int i = 0; i < 3; i++)
-    {
-        int electrodeID = ring1Buttons[i]->property("ChannelID").toInt();
-        StimulationAnode << electrodeID;
-    }
+    contactSelection->toggleRing(1);
 }
 
 // UI updates for contact selection
 void ControllerForm::on_StimulationContactClicked()
 {
+    PROFILE_SCOPE("ControllerForm::on_StimulationContactClicked");
+
     QPushButton* button = qobject_cast<QPushButton*>(sender());
-    int electrodeID = button->property("ChannelID").toInt();
+    stimulationContactSelected(button->property("ContactIndex").toInt());
+}
 
-    if (button->styleSheet() == noneStyle)
-    {
-        button->setStyleSheet(anodeStyle);
-        StimulationAnode << electrodeID;
-    }
-    else if (button->styleSheet() == anodeStyle)
-    {
-        if (ui->StimulationContact_GlobalCAN->styleSheet() == cathodeStyle)
-        {
-            StimulationAnode.removeAt(StimulationAnode.indexOf(electrodeID));
-            button->setStyleSheet(noneStyle);
-        }
-        else
-        {
-            StimulationAnode.removeAt(StimulationAnode.indexOf(electrodeID));
-            StimulationCathode = electrodeID;
-            resetCathodeSelection();
-            button->setStyleSheet(cathodeStyle);
-        }
-    }
-    else
-    {
-        StimulationCathode = 0;
-        button->setStyleSheet(noneStyle);
-    }
+// Contact selection from either the contact buttons or the electrode grid
+void ControllerForm::stimulationContactSelected(int index)
+{
+    contactSelection->cycleContact(index);
 
     if (ui->StimulationControl_Stop->isEnabled())
     {
@@ -742,6 +1038,8 @@ void ControllerForm::on_StimulationContactClicked()
 // Standard Pipeline for handling Stimulation On
 void ControllerForm::on_StimulationControl_Start_clicked()
 {
+    PROFILE_SCOPE("ControllerForm::on_StimulationControl_Start_clicked");
+
     // First establish the timer to upate Stimulation State.
     connect(stimulationStateTimer, &QTimer::timeout, this, &ControllerForm::stimulationStateUpdate);
 
@@ -761,7 +1059,9 @@ void ControllerForm::on_StimulationControl_Start_clicked()
     rechargeAmplitude = (amplitude * pulsewidth) / rechargePulse;
 
     // Display error if no stimualtion contacts were selected, or return is not defined
-    if (StimulationAnode.size() == 0 || StimulationCathode == 0)
+    QList<int> stimulationAnodes = contactSelection->anodeChannels();
+    int stimulationReturn = contactSelection->cathodeChannel();
+    if (!contactSelection->isComplete())
     {
         displayError(QMessageBox::Warning, "No stimulation contacts selected, or the return contact is not defined");
         return;
@@ -771,16 +1071,10 @@ void ControllerForm::on_StimulationControl_Start_clicked()
     QJsonObject stimulationObject;
     QJsonArray anodeArray;
     QJsonArray anodeArrayName;
-    QPushButton *allButtons[] = {ui->StimulationContact_E00,
-                                 ui->StimulationContact_E01_1, ui->StimulationContact_E01_2, ui->StimulationContact_E01_3,
-                                 ui->StimulationContact_E02_1, ui->StimulationContact_E02_2, ui->StimulationContact_E02_3,
-                                 ui->StimulationContact_E03,
-                                 ui->StimulationContact_GlobalCAN};
-    for (int i = 0; i < 9; i++)
-    {
-        if (allButtons[i]->styleSheet() == anodeStyle) anodeArrayName.append(QJsonValue(ui->StimulationControl_Electrode->currentText() + " " + allButtons[i]->text()));
-        if (allButtons[i]->styleSheet() == cathodeStyle) stimulationObject["StimulationReturnName"] = QJsonValue(ui->StimulationControl_Electrode->currentText() + " " + allButtons[i]->text());
-    }
+    QStringList anodeLabels = contactSelection->anodeLabels();
+    for (int i = 0; i < anodeLabels.size(); i++) anodeArrayName.append(QJsonValue(ui->StimulationControl_Electrode->currentText() + " " + anodeLabels[i]));
+    if (contactSelection->globalReturn()) stimulationObject["StimulationReturnName"] = QJsonValue(ui->StimulationControl_Electrode->currentText() + " " + ui->StimulationContact_GlobalCAN->text());
+    else if (contactSelection->cathodeIndex() >= 0) stimulationObject["StimulationReturnName"] = QJsonValue(ui->StimulationControl_Electrode->currentText() + " " + contactSelection->label(contactSelection->cathodeIndex()));
 
     if (this->currentWaveformID != -1)
     {
@@ -797,18 +1091,18 @@ void ControllerForm::on_StimulationControl_Start_clicked()
     }
 
     // NeuroOmega Stimulation Setup: Each Anode is configured separately for multi-contact stimulation.
-    for (int i = 0; i < StimulationAnode.size(); i++)
+    for (int i = 0; i < stimulationAnodes.size(); i++)
     {
         if (this->currentWaveformID == -1)
         {
             int result;
             if (!ui->StimulationControl_PassiveRecharge->isChecked())
             {
-                result = SetStimulationParameters(amplitude / StimulationAnode.size(), pulsewidth, -amplitude / StimulationAnode.size(), pulsewidth, frequency, duration, StimulationCathode, StimulationAnode.at(i), 0, 0);
+                result = AO_CALL(SetStimulationParameters)(amplitude / stimulationAnodes.size(), pulsewidth, -amplitude / stimulationAnodes.size(), pulsewidth, frequency, duration, stimulationReturn, stimulationAnodes.at(i), 0, 0);
             }
             else
             {
-                result = SetStimulationParameters(amplitude / StimulationAnode.size(), pulsewidth, 0, pulsewidth, frequency, duration, StimulationCathode, StimulationAnode.at(i), 0, 0);
+                result = AO_CALL(SetStimulationParameters)(amplitude / stimulationAnodes.size(), pulsewidth, 0, pulsewidth, frequency, duration, stimulationReturn, stimulationAnodes.at(i), 0, 0);
             }
             if (result != eAO_OK)
             {
@@ -816,18 +1110,18 @@ void ControllerForm::on_StimulationControl_Start_clicked()
                 displayError(QMessageBox::Warning, messsage);
                 return;
             }
-            anodeArray.append(QJsonValue(StimulationAnode.at(i)));
+            anodeArray.append(QJsonValue(stimulationAnodes.at(i)));
 
         }
     }
 
     // A separate loop is used to start stimulation because "SetStimulationParameters" has a significant delay.
     // If we request start right after configure each contact, stimulations from all contaccts will not be aligned.
-    for (int i = 0; i <StimulationAnode.size(); i++)
+    for (int i = 0; i <stimulationAnodes.size(); i++)
     {
         if (this->currentWaveformID == -1)
         {
-            int result = StartStimulation(StimulationAnode.at(i));
+            int result = AO_CALL(StartStimulation)(stimulationAnodes.at(i));
             if (result != eAO_OK)
             {
                 QString messsage = getErrorLog();
@@ -837,7 +1131,7 @@ void ControllerForm::on_StimulationControl_Start_clicked()
         }
         else
         {
-            int result = StartAnalogStimulation(StimulationAnode.at(i), this->currentWaveformID, -1, duration, StimulationCathode);
+            int result = AO_CALL(StartAnalogStimulation)(stimulationAnodes.at(i), this->currentWaveformID, -1, duration, stimulationReturn);
             if (result != eAO_OK)
             {
                 QString messsage = getErrorLog();
@@ -855,7 +1149,7 @@ void ControllerForm::on_StimulationControl_Start_clicked()
     // Save all configurations to JSON
     stimulationObject["StimulationChannel"] = anodeArray;
     stimulationObject["StimulationChannelName"] = anodeArrayName;
-    stimulationObject["StimulationReturn"] = QJsonValue(StimulationCathode);
+    stimulationObject["StimulationReturn"] = QJsonValue(stimulationReturn);
 
     QDateTime currentTime;
     stimulationObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
@@ -869,6 +1163,8 @@ void ControllerForm::on_StimulationControl_Start_clicked()
 // Update Stimulation State and UIs
 void ControllerForm::stimulationStateUpdate()
 {
+    PROFILE_SCOPE("ControllerForm::stimulationStateUpdate");
+
     // See documentation on how SequenceStimulation is handled.
     if (novelStimulationStatus) startSequentialStimulation();
 
@@ -888,6 +1184,8 @@ void ControllerForm::stimulationStateUpdate()
 // This function operate on a simple sequential logic for starting and stopping stimulation. The full process is lengthy to describe, please refer to the documentation.
 void ControllerForm::startSequentialStimulation()
 {
+    PROFILE_SCOPE("ControllerForm::startSequentialStimulation");
+
     QJsonArray stimulationSequences = stimulationConfigurations.object()["StimulationSequence"].toArray();
 
     double phaseTimer = 0;
@@ -951,7 +1249,7 @@ void ControllerForm::startSequentialStimulation()
 
                     if (stimulationSequences[i].toObject()["RecordingFilename"].toString() != currentProgrammedFilename)
                     {
-                        int result = StopSave();
+                        int result = AO_CALL(StopSave)();
                         if (result != eAO_OK)
                         {
                             QString messsage = getErrorLog();
@@ -962,7 +1260,7 @@ void ControllerForm::startSequentialStimulation()
                         updateAnnotation("Research_" + stimulationSequences[i].toObject()["RecordingFilename"].toString(), QJsonDocument());
                         currentProgrammedFilename = stimulationSequences[i].toObject()["RecordingFilename"].toString();
 
-                        result = StartSave();
+                        result = AO_CALL(StartSave)();
                         if (result != eAO_OK)
                         {
                             QString messsage = getErrorLog();
@@ -974,22 +1272,30 @@ void ControllerForm::startSequentialStimulation()
                     if (stimulationSequences[i].toObject()["StimulationType"].toString().contains("Novel"))
                     {
 
-                        int16_t* stimulationVector = this->preloadedAnalogWaveforms[stimulationSequences[i].toObject()["StimulationIndex"].toInt()];
-                        AnalogWaveformDescriptor overview = analogWaveformDescriptor[stimulationSequences[i].toObject()["StimulationIndex"].toInt()];
+                        int waveformIndex = stimulationSequences[i].toObject()["StimulationIndex"].toInt();
+                        int16_t* stimulationVector = this->preloadedAnalogWaveforms[waveformIndex];
+                        AnalogWaveformDescriptor overview = analogWaveformDescriptor[waveformIndex];
 
-                        int result = LoadWaveToEmbedded(stimulationVector, overview.filesize, 1, (cChar*)overview.wavename.toStdString().c_str());
-                        if (result != eAO_OK)
+                        // The waveform is still embedded from the previous stage unless something else uploaded since
+                        bool waveformEmbedded = this->sequenceWaveformIndex == waveformIndex && this->waveformList.size() == 1 && this->waveformList[0] == overview.wavename;
+                        if (!waveformEmbedded)
                         {
-                            QString messsage = getErrorLog();
-                            displayError(QMessageBox::Warning, messsage);
-                            on_StimulationControl_Stop_clicked();
-                            return;
-                        }
-                        else
-                        {
-                            this->waveformList.clear();
-                            this->waveformList.append(overview.wavename);
-                            this->currentWaveformID = 0;
+                            int result = AO_CALL(LoadWaveToEmbedded)(stimulationVector, overview.filesize, 1, (cChar*)overview.wavename.toStdString().c_str());
+                            if (result != eAO_OK)
+                            {
+                                QString messsage = getErrorLog();
+                                displayError(QMessageBox::Warning, messsage);
+                                this->sequenceWaveformIndex = -1;
+                                on_StimulationControl_Stop_clicked();
+                                return;
+                            }
+                            else
+                            {
+                                this->waveformList.clear();
+                                this->waveformList.append(overview.wavename);
+                                this->currentWaveformID = 0;
+                                this->sequenceWaveformIndex = waveformIndex;
+                            }
                         }
 
                         QElapsedTimer executionTimer = QElapsedTimer();
@@ -1003,11 +1309,11 @@ void ControllerForm::startSequentialStimulation()
                                 return;
                             }
 
-                            int result = StartAnalogStimulation(electrodeContacts[stimulationContactArray[j].toInt()], this->currentWaveformID, -1, stimulationSequences[i].toObject()["Duration"].toInt(), returnContact);
+                            int result = AO_CALL(StartAnalogStimulation)(electrodeContacts[stimulationContactArray[j].toInt()], this->currentWaveformID, -1, stimulationSequences[i].toObject()["Duration"].toInt(), returnContact);
                             executionTimer.restart();
                             while (executionTimer.elapsed() < 5000 && result != eAO_OK)
                             {
-                                result = StartAnalogStimulation(electrodeContacts[stimulationContactArray[j].toInt()], this->currentWaveformID, -1, stimulationSequences[i].toObject()["Duration"].toInt(), returnContact);
+                                result = AO_CALL(StartAnalogStimulation)(electrodeContacts[stimulationContactArray[j].toInt()], this->currentWaveformID, -1, stimulationSequences[i].toObject()["Duration"].toInt(), returnContact);
                             }
                             if (result != eAO_OK)
                             {
@@ -1039,7 +1345,7 @@ void ControllerForm::startSequentialStimulation()
                                 return;
                             }
 
-                            int result = SetStimulationParameters(-stimulationSequences[i].toObject()["Amplitude"].toDouble() / stimulationContactArray.size(),
+                            int result = AO_CALL(SetStimulationParameters)(-stimulationSequences[i].toObject()["Amplitude"].toDouble() / stimulationContactArray.size(),
                                                                   stimulationSequences[i].toObject()["Pulsewidth"].toDouble() / 1000.0,
                                                                   stimulationSequences[i].toObject()["Amplitude"].toDouble() / stimulationContactArray.size(),
                                                                   stimulationSequences[i].toObject()["Pulsewidth"].toDouble() / 1000.0,
@@ -1059,7 +1365,7 @@ void ControllerForm::startSequentialStimulation()
 
                         for (int j = 0; j < stimulationContactArray.size(); j++)
                         {
-                            int result = StartStimulation(electrodeContacts[stimulationContactArray[j].toInt()]);
+                            int result = AO_CALL(StartStimulation)(electrodeContacts[stimulationContactArray[j].toInt()]);
                             if (result != eAO_OK)
                             {
                                 QString messsage = getErrorLog();
@@ -1070,14 +1376,39 @@ void ControllerForm::startSequentialStimulation()
                         }
 
                     }
-                    this->currentStimulationState = true;
+                    this->currentStimulationState = true;
+                    if (spectrogramView != nullptr) spectrogramView->addMarker(QString("Stage %1 %2").arg(i + 1).arg(stimulationSequences[i].toObject()["StimulationType"].toString()));
+
+                    // JSON logging of the stage, so sequences can be found per recording, lead and contact later
+                    QJsonObject stageObject;
+                    stageObject["ObjectType"] = QJsonValue("SequenceStage");
+                    stageObject["Stage"] = QJsonValue(i + 1);
+                    stageObject["StimulationType"] = stimulationSequences[i].toObject()["StimulationType"];
+                    stageObject["RecordingFilename"] = stimulationSequences[i].toObject()["RecordingFilename"];
+                    stageObject["StimulationLead"] = stimulationSequences[i].toObject()["StimulationLead"];
+                    stageObject["StimulationContacts"] = stimulationContactArray;
+                    stageObject["StimulationReturn"] = stimulationSequences[i].toObject()["StimulationReturn"];
+                    stageObject["Duration"] = stimulationSequences[i].toObject()["Duration"];
+                    if (stimulationSequences[i].toObject()["StimulationType"].toString().contains("Novel"))
+                    {
+                        stageObject["WaveName"] = QJsonValue(analogWaveformDescriptor[stimulationSequences[i].toObject()["StimulationIndex"].toInt()].wavename);
+                    }
+                    else if (stimulationSequences[i].toObject()["StimulationType"].toString().contains("Standard"))
+                    {
+                        stageObject["Amplitude"] = stimulationSequences[i].toObject()["Amplitude"];
+                        stageObject["PulseWidth"] = QJsonValue(stimulationSequences[i].toObject()["Pulsewidth"].toDouble() / 1000.0);
+                        stageObject["Frequency"] = stimulationSequences[i].toObject()["Frequency"];
+                    }
+                    QDateTime currentTime;
+                    stageObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+                    jsonStorage->addJSON(stageObject);
                 }
             }
             else
             {
                 if (stimulationElapsedTime.elapsed() / 1000.0 >= phaseTimer + stimulationSequences[i].toObject()["Duration"].toDouble())
                 {
-                    int result = StopStimulation(-1);
+                    int result = AO_CALL(StopStimulation)(-1);
                     if (result != eAO_OK)
                     {
                         QString messsage = getErrorLog();
@@ -1088,6 +1419,7 @@ void ControllerForm::startSequentialStimulation()
 
                     ui->SequenceDisplayTable->setRowHidden(this->currentStimulationStage, true);
                     this->currentStimulationState = false;
+                    if (spectrogramView != nullptr) spectrogramView->addMarker(QString("Stage %1 End").arg(i + 1));
                     this->currentStimulationStage = i+1;
                 }
             }
@@ -1106,8 +1438,13 @@ void ControllerForm::startSequentialStimulation()
 // Stopping Stimulation
 void ControllerForm::on_StimulationControl_Stop_clicked()
 {
+    PROFILE_SCOPE("ControllerForm::on_StimulationControl_Stop_clicked");
+
+    // Any manual stop also disarms the closed-loop controller.
+    stopClosedLoop();
+
     // Request Stimulation Stop. One function will handle all multi-contact stimulations
-    int result = StopStimulation(-1);
+    int result = AO_CALL(StopStimulation)(-1);
     if (result != eAO_OK)
     {
         QString messsage = getErrorLog();
@@ -1144,11 +1481,14 @@ void ControllerForm::on_StimulationControl_Stop_clicked()
 // A special case of stimulation start. This is to start stimulation in sequential mode described in documentation.
 void ControllerForm::on_StimulationControl_Novel_Start_clicked()
 {
+    PROFILE_SCOPE("ControllerForm::on_StimulationControl_Novel_Start_clicked");
+
     on_StimulationControl_Stop_clicked();
 
     if (this->waveformList.size() == 0)
     {
-        displayError(QMessageBox::Warning, "Novel Waveform not yet loaded");
+        if (startupWarmup->isRunning()) displayError(QMessageBox::Warning, "Novel Waveform still loading");
+        else displayError(QMessageBox::Warning, "Novel Waveform not yet loaded");
         return;
     }
 
@@ -1158,6 +1498,8 @@ void ControllerForm::on_StimulationControl_Novel_Start_clicked()
         return;
     }
 
+    if (!compileStimulationProtocol()) return;
+
     if (!stimulationConfigurations.object().contains("StimulationSequence"))
     {
         displayError(QMessageBox::Warning, "Bad Stimulation Configuration");
@@ -1172,61 +1514,164 @@ void ControllerForm::on_StimulationControl_Novel_Start_clicked()
     ui->StimulationControl_Stop->setEnabled(true);
 
     novelStimulationStatus = true;
+    this->sequenceWaveformIndex = -1;
+    logProtocolTimeline();
     startSequentialStimulation();
 }
 
 // Stop stimulation if any of the parameter changed.
 void ControllerForm::on_StimulationControlConfigurationChanged(double value)
 {
+    PROFILE_SCOPE("ControllerForm::on_StimulationControlConfigurationChanged");
+
     // Suppress Unsed Parameter Warning. This Slot is used to turn off stimulation only.
     // Potential use of this slot is to update stimulation in real-time, by turning off stimulation -> change stimulation setting -> turn on stimulation.
     (void)value;
     if (ui->StimulationControl_Stop->isEnabled()) on_StimulationControl_Stop_clicked();
 }
 
-////////////////////////////////////
-/////// Recording Callbacks ////////
-////////////////////////////////////
-
-// Reset all NeuroOmega Channels to disable saving to minimize storage. Only record the channels used in the surgery.
-void ControllerForm::resetSaveStates()
+// Closed-loop stimulation. The biomarker, thresholds and safety limits are read from the JSON file set as
+// "ClosedLoopConfiguration" in defaultSettings.ini (ClosedLoopConfiguration.json in the working directory by default).
+void ControllerForm::on_StimulationControl_ClosedLoop_clicked()
 {
-    // Get all channels available on NeuroOmega
-    uint32 channelCount = 0;
-    int result = GetChannelsCount(&channelCount);
-    if (result != eAO_OK)
+    PROFILE_SCOPE("ControllerForm::on_StimulationControl_ClosedLoop_clicked");
+
+    if (closedLoopController != nullptr && closedLoopController->isRunning())
     {
-        QString messsage = getErrorLog();
-        displayError(QMessageBox::Warning, messsage);
+        stopClosedLoop();
+        on_StimulationControl_Stop_clicked();
         return;
     }
 
-    // Loading channel information
-    SInformation channelsInfo[channelCount];
-    result = GetAllChannels(channelsInfo, channelCount);
-    if (result != eAO_OK)
+    if (filterGraph == nullptr || streamDataHandler == nullptr || !streamDataHandler->isRunning())
     {
-        QString messsage = getErrorLog();
-        displayError(QMessageBox::Warning, messsage);
+        displayError(QMessageBox::Warning, "Closed-loop stimulation requires live streaming with a filter graph.");
         return;
     }
 
-    // Turn off all saving states.
-    for (int i = 0; i < channelCount; i++)
+    QString configurationFile = applicationConfiguration->value("ClosedLoopConfiguration", QDir::currentPath() + "/ClosedLoopConfiguration.json").toString();
+    ClosedLoopParameters parameters;
+    QString errorMessage;
+    if (!ClosedLoopController::loadParameters(configurationFile, this->electrodeConfigurations, &parameters, &errorMessage))
     {
-        if (channelsInfo[i].channelID >= 10272 && channelsInfo[i].channelID <= 10335)
-        result = SetChannelSaveState(channelsInfo[i].channelID, false);
-        if (result != eAO_OK)
-        {
-            QString messsage = getErrorLog();
-            displayError(QMessageBox::Warning, messsage);
-            return;
-        }
+        displayError(QMessageBox::Warning, errorMessage);
+        return;
+    }
+
+    // The controller owns the stimulator while it runs, so stop anything that is currently on.
+    if (ui->StimulationControl_Stop->isEnabled()) on_StimulationControl_Stop_clicked();
+
+    if (closedLoopController == nullptr)
+    {
+        closedLoopController = new ClosedLoopController(this);
+        connect(closedLoopController, &ClosedLoopController::stimulationStateChanged, this, &ControllerForm::closedLoopStimulationChanged);
+        connect(closedLoopController, &ClosedLoopController::safetyLimitReached, this, &ControllerForm::closedLoopSafetyEvent);
+    }
+
+    if (!closedLoopController->configure(parameters, &errorMessage))
+    {
+        displayError(QMessageBox::Warning, errorMessage);
+        return;
+    }
+
+    if (!closedLoopController->attach(filterGraph))
+    {
+        closedLoopController->stopController();
+        displayError(QMessageBox::Warning, filterGraph->errorMessage());
+        return;
     }
+    closedLoopController->start(QThread::TimeCriticalPriority);
+
+    QJsonObject closedLoopObject;
+    closedLoopObject["ObjectType"] = QJsonValue("ClosedLoopStart");
+    closedLoopObject["Configuration"] = QJsonValue(configurationFile);
+    closedLoopObject["BiomarkerNode"] = QJsonValue(parameters.biomarkerNode);
+    closedLoopObject["BiomarkerChannel"] = QJsonValue(parameters.biomarkerChannelID);
+    closedLoopObject["OnThreshold"] = QJsonValue(parameters.onThreshold);
+    closedLoopObject["OffThreshold"] = QJsonValue(parameters.offThreshold);
+    closedLoopObject["Amplitude"] = QJsonValue(parameters.amplitude);
+
+    QDateTime currentTime;
+    closedLoopObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+    jsonStorage->addJSON(closedLoopObject);
+
+    ui->StimulationControl_ClosedLoop->setText("Stop Closed\nLoop");
+    ui->StimulationControl_Start->setEnabled(false);
+    ui->StimulationControl_Novel_Start->setEnabled(false);
+}
+
+void ControllerForm::stopClosedLoop()
+{
+    if (closedLoopController == nullptr || !closedLoopController->isRunning()) return;
+
+    // The controller thread stops stimulation itself on exit.
+    closedLoopController->stopController();
+    closedLoopController->detach();
+
+    QJsonObject closedLoopObject = closedLoopController->report();
+    closedLoopObject["ObjectType"] = QJsonValue("ClosedLoopStop");
+
+    QDateTime currentTime;
+    closedLoopObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+    jsonStorage->addJSON(closedLoopObject);
+
+    ui->StimulationControl_ClosedLoop->setText("Start Closed\nLoop");
+    ui->StimulationControl_Start->setEnabled(true);
+    ui->StimulationControl_Novel_Start->setEnabled(true);
+}
+
+void ControllerForm::closedLoopStimulationChanged(bool stimulationOn, double biomarker)
+{
+    PROFILE_SCOPE("ControllerForm::closedLoopStimulationChanged");
+
+    QJsonObject stimulationObject;
+    stimulationObject["ObjectType"] = QJsonValue(stimulationOn ? "ClosedLoopStimulationOn" : "ClosedLoopStimulationOff");
+    stimulationObject["Biomarker"] = QJsonValue(biomarker);
+
+    QDateTime currentTime;
+    stimulationObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+    jsonStorage->addJSON(stimulationObject);
+}
+
+void ControllerForm::closedLoopSafetyEvent(QString message)
+{
+    PROFILE_SCOPE("ControllerForm::closedLoopSafetyEvent");
+
+    QJsonObject safetyObject;
+    safetyObject["ObjectType"] = QJsonValue("ClosedLoopSafety");
+    safetyObject["Message"] = QJsonValue(message);
+
+    QDateTime currentTime;
+    safetyObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+    jsonStorage->addJSON(safetyObject);
+
+    ui->NeuroOmega_StatusString->setText(message);
+}
+
+////////////////////////////////////
+/////// Recording Callbacks ////////
+////////////////////////////////////
+
+// Reset all NeuroOmega Channels to disable saving to minimize storage. Only record the channels used in the surgery.
+// Only stages the change; configureRecordingChannels() applies it together with the new configuration.
+void ControllerForm::resetSaveStates()
+{
+    ChannelConfigurationEngine::instance()->setSaveStates(ECOG_FIRST_CHANNEL, ECOG_LAST_CHANNEL, false);
 }
 
+// Channel names are refreshed from the catalog; each configuration only sends the names and save states that differ.
 bool ControllerForm::configureRecordingChannels()
 {
+    PROFILE_SCOPE("ControllerForm::configureRecordingChannels");
+
+    ChannelConfigurationEngine *channelConfiguration = ChannelConfigurationEngine::instance();
+    if (!ChannelCatalog::instance()->refresh())
+    {
+        displayError(QMessageBox::Warning, ChannelCatalog::instance()->errorMessage());
+        return false;
+    }
+    channelConfiguration->beginConfiguration();
+
     // Turn Save State to False for all channels
     resetSaveStates();
 
@@ -1237,41 +1682,19 @@ bool ControllerForm::configureRecordingChannels()
         {
             if (this->electrodeConfigurations[i].channelIDs[j] > 0)
             {
-                int result = SetChannelName(this->electrodeConfigurations[i].channelIDs[j], "temp", 4);
-                if (result != eAO_OK)
-                {
-                    QString messsage = getErrorLog();
-                    displayError(QMessageBox::Warning, messsage);
-                    return false;
-                }
-
                 QString channelName = "Lead_" + QString::number(i+1) + "_" + this->electrodeConfigurations[i].hemisphere + "_" + this->electrodeConfigurations[i].target + "_" + QString::number(j);
-
-                result = SetChannelName(this->electrodeConfigurations[i].channelIDs[j], (char*)channelName.toStdString().c_str(), channelName.length());
-                if (result != eAO_OK)
-                {
-                    QString messsage = getErrorLog();
-                    displayError(QMessageBox::Warning, messsage);
-                    return false;
-                }
-
-                result = SetChannelSaveState(this->electrodeConfigurations[i].channelIDs[j], true);
-                if (result != eAO_OK)
-                {
-                    QString messsage = getErrorLog();
-                    displayError(QMessageBox::Warning, messsage);
-                    return false;
-                }
+                channelConfiguration->setChannelName(this->electrodeConfigurations[i].channelIDs[j], channelName);
+                channelConfiguration->setSaveState(this->electrodeConfigurations[i].channelIDs[j], true);
             }
         }
     }
 
     // Stim Marker Channel
-    int result = SetChannelSaveState(11221, true);
-    if (result != eAO_OK)
+    channelConfiguration->setSaveState(11221, true);
+
+    if (!channelConfiguration->apply())
     {
-        QString messsage = getErrorLog();
-        displayError(QMessageBox::Warning, messsage);
+        displayError(QMessageBox::Warning, channelConfiguration->errorMessage());
         return false;
     }
 
@@ -1283,6 +1706,8 @@ bool ControllerForm::configureRecordingChannels()
 //      As an example, we used "4 Contacts\nResearch Stim" and "8 Contacts\nResearch Stim" to start the NovelStimulation.
 void ControllerForm::updateAnnotation(QString annotations, QJsonDocument loadedDocument)
 {
+    PROFILE_SCOPE("ControllerForm::updateAnnotation");
+
     // 4-Contact Electrode (i.e. Medtronic 3387, 3389)
     if (!loadedDocument.isEmpty())
     {
@@ -1299,10 +1724,13 @@ void ControllerForm::updateAnnotation(QString annotations, QJsonDocument loadedD
         // Notify user if stimulation JSON file is not valid.
         if (!stimulationConfigurations.isObject())
         {
-            displayError(QMessageBox::Warning, "Stimulation Configuration not imported");
+            if (startupWarmup->isRunning()) displayError(QMessageBox::Warning, "Stimulation Configuration still loading");
+            else displayError(QMessageBox::Warning, "Stimulation Configuration not imported");
             return;
         }
 
+        if (!compileStimulationProtocol()) return;
+
         // Notify user if the JSON is not in the correct format
         if (!stimulationConfigurations.object().contains("StimulationSequence"))
         {
@@ -1405,7 +1833,8 @@ void ControllerForm::updateAnnotation(QString annotations, QJsonDocument loadedD
         // Notify user if no novel waveform loaded.
         if (analogWaveformNeeded && this->preloadedAnalogWaveforms.count() == 0)
         {
-            displayError(QMessageBox::Warning, "Novel Waveform not yet loaded");
+            if (startupWarmup->isRunning()) displayError(QMessageBox::Warning, "Novel Waveform still loading");
+            else displayError(QMessageBox::Warning, "Novel Waveform not yet loaded");
             return;
         }
 
@@ -1422,6 +1851,8 @@ void ControllerForm::updateAnnotation(QString annotations, QJsonDocument loadedD
         ui->StimulationControl_Stop->setEnabled(true);
         this->currentStimulationStage = 0;
         novelStimulationStatus = true;
+        this->sequenceWaveformIndex = -1;
+        logProtocolTimeline();
         startSequentialStimulation();
         ui->SequenceDisplayTable->setVisible(true);
     }
@@ -1438,7 +1869,7 @@ void ControllerForm::updateAnnotation(QString annotations, QJsonDocument loadedD
 
         // Update NeuroOmega SaveFile name.
         //      IMPORTANT: This will not work if you set NeuroOmega to automatically update filename. We cannot overwrite configuration in NeuroOmega Application Interface.
-        int result = SetSaveFileName((char*)filename.toStdString().c_str(), filename.length());
+        int result = AO_CALL(SetSaveFileName)((char*)filename.toStdString().c_str(), filename.length());
         if (result != eAO_OK)
         {
             QString messsage = getErrorLog();
@@ -1446,6 +1877,9 @@ void ControllerForm::updateAnnotation(QString annotations, QJsonDocument loadedD
             return;
         }
 
+        // The shadow recording is not interrupted; the new filename only starts a new segment in its index.
+        if (shadowRecordingWriter != nullptr) shadowRecordingWriter->markSegment(filename);
+
         // Making this recording infinite recording. This is configured to prevent "Stop Stimulation" from turning off recording.
         if (!novelStimulationStatus) infiniteRecording = true;
     }
@@ -1454,6 +1888,8 @@ void ControllerForm::updateAnnotation(QString annotations, QJsonDocument loadedD
 
 void ControllerForm::on_NeuroOmega_RecordingStart_clicked()
 {
+    PROFILE_SCOPE("ControllerForm::on_NeuroOmega_RecordingStart_clicked");
+
     // Pop-up dialog to request user to indicate which type of recording is this. Theoretical sequential program to run next is UpdateAnnotation().
     RecordingAnnotation annotationSelection;
     annotationSelection.setFixedSize(annotationSelection.size());
@@ -1461,33 +1897,18 @@ void ControllerForm::on_NeuroOmega_RecordingStart_clicked()
     annotationSelection.exec();
 
     // If we closed the annotation window without choosing recording type, or there are errors in the configuration, the recordingStatus will not be set to True.
-    // Wait for 3 seconds, or if recordingStatus is true, we immediately proceed to the new
+    // Saving starts as soon as recordingStatus is set and NeuroOmega confirms the connection; the event loop keeps running meanwhile.
+    ui->NeuroOmega_RecordingStart->setEnabled(false);
     recordingElapsedTime.restart();
-    for (int i = 0; i < 3; i++)
-    {
-        if (!recordingStatus) Sleep(1000);
-        else break;
-    }
-
-    // if recordingStatus is not true, we immediately return.
-    if (!recordingStatus)
-    {
-        displayError(QMessageBox::Critical, "Recording cannot start in 10 seconds. Check NeuroOmega Connection.");
-        return;
-    }
+    recordingStartStateMachine->start([this]() { return recordingStatus; }, applicationConfiguration->value("RecordingStartTimeout", 3000).toInt());
+}
 
-    // Request NeuroOmega to start saving files
-    int result = StartSave();
-    if (result != eAO_OK)
-    {
-        QString messsage = getErrorLog();
-        displayError(QMessageBox::Warning, messsage);
-        return;
-    }
+void ControllerForm::recordingStarted()
+{
+    PROFILE_SCOPE("ControllerForm::recordingStarted");
 
     // Update UIs
     recordingElapsedTime.restart();
-    ui->NeuroOmega_RecordingStart->setEnabled(false);
     ui->NeuroOmega_RecordingStop->setEnabled(true);
     ui->RecordingLabels_1->setEnabled(true);
     ui->RecordingLabels_2->setEnabled(true);
@@ -1497,17 +1918,25 @@ void ControllerForm::on_NeuroOmega_RecordingStart_clicked()
     ui->RecordingLabels_6->setEnabled(true);
 }
 
+void ControllerForm::recordingStartFailed(QString message, bool timedOut)
+{
+    ui->NeuroOmega_RecordingStart->setEnabled(true);
+    displayError(timedOut ? QMessageBox::Critical : QMessageBox::Warning, message);
+}
 
 void ControllerForm::on_NeuroOmega_RecordingStop_clicked()
 {
+    PROFILE_SCOPE("ControllerForm::on_NeuroOmega_RecordingStop_clicked");
+
     // Request NeuroOmega to stop recording. Notify user if failed.
-    int result = StopSave();
+    int result = AO_CALL(StopSave)();
     if (result != eAO_OK)
     {
         QString messsage = getErrorLog();
         displayError(QMessageBox::Warning, messsage);
         return;
     }
+    if (shadowRecordingWriter != nullptr) shadowRecordingWriter->endSegment();
 
     // If this is a NovelStimulation Recording. Stop the NovelStimulation as well (unless it is infinite streaming)
     if (novelStimulationStatus && !infiniteRecording) on_StimulationControl_Stop_clicked();
@@ -1531,6 +1960,8 @@ void ControllerForm::on_NeuroOmega_RecordingStop_clicked()
 // General Slot() for clicking recording labels. Update UI file to make them your favourite texts to label during recording.
 void ControllerForm::on_RecordingLabelClicked()
 {
+    PROFILE_SCOPE("ControllerForm::on_RecordingLabelClicked");
+
     QPushButton* buttonClicked = qobject_cast<QPushButton*>(sender());
     sendLabelMessages(buttonClicked->text());
 }
@@ -1538,6 +1969,8 @@ void ControllerForm::on_RecordingLabelClicked()
 // Or just use the custom label button to put your own texts.
 void ControllerForm::on_CustomLabelClicked()
 {
+    PROFILE_SCOPE("ControllerForm::on_CustomLabelClicked");
+
     ManualLabelEntry labelEntryDialog;
     labelEntryDialog.setFixedSize(labelEntryDialog.size());
     connect(&labelEntryDialog, &ManualLabelEntry::labelComplete, this, &ControllerForm::sendLabelMessages);
@@ -1546,25 +1979,26 @@ void ControllerForm::on_CustomLabelClicked()
 
 void ControllerForm::sendLabelMessages(QString messages)
 {
+    PROFILE_SCOPE("ControllerForm::sendLabelMessages");
+
     // Empty message can be due to clicking "Cancel" on ManualLabelEntry dialog
     if (messages == "") return;
 
-    // Attempt sending message to NeuroOmega, notify user if failed.
-    int result = SendText((char*)messages.toStdString().c_str(), messages.length());
-    if (result != eAO_OK)
-    {
-        QString messsage = getErrorLog();
-        displayError(QMessageBox::Warning, messsage);
-        return;
-    }
+    // The dispatcher timestamps the click now and sends to NeuroOmega in the background. The label is logged once acknowledged.
+    labelDispatcher->enqueue(messages);
+}
 
-    // If not failed, log the label externally as text for reading
-    QJsonObject jsonObject;
-    jsonObject["ObjectType"] = QJsonValue("Label");
-    jsonObject["LabelText"] = QJsonValue(messages);
-    QDateTime currentTime;
-    jsonObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
-    jsonStorage->addJSON(jsonObject);
+// Log the label externally as text for reading, with the click time and the delay until NeuroOmega acknowledged it.
+void ControllerForm::labelDispatched(QJsonObject labelObject)
+{
+    labelObject["ObjectType"] = QJsonValue("Label");
+    jsonStorage->addJSON(labelObject);
+}
+
+// Notify user if the label could not be sent after all retries.
+void ControllerForm::labelDispatchFailed(QString text, QString message)
+{
+    displayError(QMessageBox::Warning, "Label \"" + text + "\" not sent: " + message);
 }
 
 ////////////////////////////////////////////////////////
@@ -1573,6 +2007,8 @@ void ControllerForm::sendLabelMessages(QString messages)
 // We send benefit scores to NeuroOmega log. Note that the message we send are based on Object Names.
 void ControllerForm::on_BenefitsClicked()
 {
+    PROFILE_SCOPE("ControllerForm::on_BenefitsClicked");
+
     QPushButton* buttonClicked = qobject_cast<QPushButton*>(sender());
     sendLabelMessages(buttonClicked->objectName());
 }
@@ -1580,6 +2016,8 @@ void ControllerForm::on_BenefitsClicked()
 // Similarly, we send side effects to NeuroOmega log, but this time we send them based on Object Text.
 void ControllerForm::on_SideEffectsClicked()
 {
+    PROFILE_SCOPE("ControllerForm::on_SideEffectsClicked");
+
     QPushButton* buttonClicked = qobject_cast<QPushButton*>(sender());
     sendLabelMessages(buttonClicked->text());
     if (buttonClicked->text() == "Persistent" || buttonClicked->text() == "Transient") writeSideEffectNotes(buttonClicked->text());
@@ -1591,26 +2029,23 @@ void ControllerForm::writeSideEffectNotes(QString sideEffectType)
     // Writer Class
     QTextStream textOutstream(this->sideEffectNotes);
 
-    QPushButton *allButtons[] = {ui->StimulationContact_E00,
-                                 ui->StimulationContact_E01_1, ui->StimulationContact_E01_2, ui->StimulationContact_E01_3,
-                                 ui->StimulationContact_E02_1, ui->StimulationContact_E02_2, ui->StimulationContact_E02_3,
-                                 ui->StimulationContact_E03,
-                                 ui->StimulationContact_GlobalCAN};
     textOutstream << ui->StimulationControl_Electrode->currentText() << "\n";
-    for (int i = 0; i < 9; i++)
+    QStringList anodeLabels = contactSelection->anodeLabels();
+    for (int i = 0; i < anodeLabels.size(); i++)
     {
-        if (allButtons[i]->styleSheet() == anodeStyle)
-        {
-            QString str = allButtons[i]->text();
-            str = str.replace("Contact\n","");
-            textOutstream << str << "- ";
-        }
-        if (allButtons[i]->styleSheet() == cathodeStyle)
-        {
-            QString str = allButtons[i]->text();
-            str = str.replace("Contact\n","");
-            textOutstream << allButtons[i]->text() << "+ ";
-        }
+        QString str = anodeLabels[i];
+        str = str.replace("Contact\n","");
+        textOutstream << str << "- ";
+    }
+    if (contactSelection->globalReturn())
+    {
+        textOutstream << ui->StimulationContact_GlobalCAN->text() << "+ ";
+    }
+    else if (contactSelection->cathodeIndex() >= 0)
+    {
+        QString str = contactSelection->label(contactSelection->cathodeIndex());
+        str = str.replace("Contact\n","");
+        textOutstream << str << "+ ";
     }
     textOutstream << "\n" << sideEffectType << " side effects\n";
 
@@ -1625,6 +2060,8 @@ void ControllerForm::writeSideEffectNotes(QString sideEffectType)
 // Novel Stimulation Configuration Window
 void ControllerForm::on_StimulationControl_Novel_clicked()
 {
+    PROFILE_SCOPE("ControllerForm::on_StimulationControl_Novel_clicked");
+
     NovelStimulationConfiguration configurationWindow;
     configurationWindow.setupDefault(this->waveformList, this->currentWaveformID, this->stimulationConfigurations);
     configurationWindow.setFixedSize(configurationWindow.size());
@@ -1634,8 +2071,12 @@ void ControllerForm::on_StimulationControl_Novel_clicked()
 
 void ControllerForm::novelStimulationParametersUpdate(QStringList waveformList, int selectedWave, QJsonDocument stimulationJsonDocument)
 {
+    // The operator's choice replaces whatever the startup warm-up was still loading
+    startupWarmup->cancel();
+
     this->currentWaveformID = selectedWave;
     this->waveformList = waveformList;
+    this->sequenceWaveformIndex = -1;
     this->stimulationConfigurations = stimulationJsonDocument;
     ui->SequenceFilename->setText(this->stimulationConfigurations.object()["StimulationName"].toString());
 }
@@ -1643,12 +2084,64 @@ void ControllerForm::novelStimulationParametersUpdate(QStringList waveformList,
 // Pull up advance configuration for channel lists
 void ControllerForm::on_Electrodes_AdvanceConfiguration_clicked()
 {
+    PROFILE_SCOPE("ControllerForm::on_Electrodes_AdvanceConfiguration_clicked");
+
     DetailChannelsList channelListView;
     channelListView.setFixedSize(channelListView.size());
     channelListView.setupChannels();
+    if (contactQualityEstimator != nullptr)
+    {
+        channelListView.setChannelQuality(contactQualityEstimator->quality());
+        connect(contactQualityEstimator, &ContactQualityEstimator::qualityUpdated, &channelListView, [this, &channelListView]() {
+            channelListView.setChannelQuality(contactQualityEstimator->quality());
+        });
+    }
     channelListView.exec();
 }
 
+// Declarative sweeps ("Sweeps") are compiled into a StimulationSequence ordered for the fewest waveform uploads and file switches,
+// using the SDK call latencies measured so far in this session.
+bool ControllerForm::compileStimulationProtocol()
+{
+    if (!ProtocolCompiler::isSweep(stimulationConfigurations.object())) return true;
+
+    ProtocolCompiler compiler;
+    compiler.setCosts(ProtocolCompiler::measuredCosts());
+    if (!compiler.compile(stimulationConfigurations.object()))
+    {
+        displayError(QMessageBox::Warning, "Bad Stimulation Sweep: " + compiler.errorMessage());
+        return false;
+    }
+    this->stimulationConfigurations = compiler.compiledDocument();
+
+    // The stage timeline is logged when the sequence starts
+    QJsonObject compilationObject = compiler.report();
+    compilationObject.remove("Timeline");
+    compilationObject["ObjectType"] = QJsonValue("ProtocolCompilation");
+    QDateTime currentTime;
+    compilationObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+    jsonStorage->addJSON(compilationObject);
+    return true;
+}
+
+// Predicted start, overhead and effective duration of every stage of the sequence about to run.
+void ControllerForm::logProtocolTimeline()
+{
+    ProtocolTimeline timeline = ProtocolCompiler::predictTimeline(stimulationConfigurations.object()["StimulationSequence"].toArray(), ProtocolCompiler::measuredCosts());
+
+    QJsonObject timelineObject;
+    timelineObject["ObjectType"] = QJsonValue("ProtocolTimeline");
+    QDateTime currentTime;
+    timelineObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+    timelineObject["StimulationName"] = stimulationConfigurations.object()["StimulationName"].toString();
+    timelineObject["ScheduledTime"] = timeline.scheduledTime;
+    timelineObject["OverheadTime"] = timeline.overheadTime;
+    timelineObject["WaveformUploads"] = timeline.waveformUploads;
+    timelineObject["FileSwitches"] = timeline.fileSwitches;
+    timelineObject["Timeline"] = ProtocolCompiler::timelineToJson(timeline);
+    jsonStorage->addJSON(timelineObject);
+}
+
 void ControllerForm::loadAnalogWaveform(QJsonArray filenameArray)
 {
     if (!this->preloadedAnalogWaveforms.isEmpty())
@@ -1696,3 +2189,208 @@ void ControllerForm::loadAnalogWaveform(QJsonArray filenameArray)
     }
 
 }
+
+// The last novel waveform and stimulation protocol are loaded off the GUI thread. Deferred to the event loop so the
+// window is painted first; until the warm-up is ready the sequence label shows its progress.
+void ControllerForm::startStartupWarmup()
+{
+    QString lastNovelStimulation = this->applicationConfiguration->value("LastNovelStimulation").toString();
+    QString lastStimulationConfiguration = this->applicationConfiguration->value("LastStimulationConfiguration").toString();
+    if (lastNovelStimulation.isEmpty() && lastStimulationConfiguration.isEmpty()) return;
+
+    startupWarmup->start(lastNovelStimulation, lastStimulationConfiguration, qApp->applicationDirPath());
+}
+
+// NeuroOmega restarted or the clock fit stopped matching. Entries are untagged until the fit converges again.
+void ControllerForm::clockSynchronizationLost()
+{
+    QJsonObject clockObject;
+    clockObject["ObjectType"] = QJsonValue("ClockSynchronizationLost");
+    QDateTime currentTime;
+    clockObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+    jsonStorage->addJSON(clockObject);
+}
+
+void ControllerForm::sessionCatalogIndexed(int indexed, int failed, int elapsed)
+{
+    Q_UNUSED(indexed);
+    Q_UNUSED(failed);
+    Q_UNUSED(elapsed);
+
+    // JSON Object Loggings
+    QJsonObject catalogObject = sessionCatalogIndexer->report();
+    catalogObject["ObjectType"] = QJsonValue("SessionCatalogIndex");
+    QDateTime currentTime;
+    catalogObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+    jsonStorage->addJSON(catalogObject);
+}
+
+void ControllerForm::startupWarmupProgress(QString message, int completed, int total)
+{
+    if (!startupWarmup->isRunning()) return;
+    ui->SequenceFilename->setText(QString("%1 (%2/%3)").arg(message).arg(completed).arg(total));
+}
+
+void ControllerForm::startupResourcesReady(int elapsed)
+{
+    StartupResources resources = startupWarmup->takeResources();
+
+    if (!resources.novelWaveform.isEmpty()) this->waveformList.append(resources.novelWaveform);
+    if (resources.stimulationConfiguration.isObject())
+    {
+        for (int i = 0; i < this->preloadedAnalogWaveforms.count(); i++) free(this->preloadedAnalogWaveforms[i]);
+        this->stimulationConfigurations = resources.stimulationConfiguration;
+        this->preloadedAnalogWaveforms = resources.analogWaveforms;
+        this->analogWaveformDescriptor = resources.analogWaveformDescriptor;
+    }
+    ui->SequenceFilename->setText(this->stimulationConfigurations.object()["StimulationName"].toString());
+
+    // JSON Object Loggings
+    QJsonObject warmupObject;
+    warmupObject["ObjectType"] = QJsonValue("StartupWarmup");
+    warmupObject["Elapsed"] = QJsonValue(elapsed);
+    warmupObject["NovelWaveform"] = QJsonValue(resources.novelWaveform);
+    warmupObject["StimulationName"] = QJsonValue(resources.stimulationConfiguration.object()["StimulationName"].toString());
+    warmupObject["AnalogWaveforms"] = QJsonValue(resources.analogWaveforms.count());
+    warmupObject["Errors"] = QJsonArray::fromStringList(resources.errors);
+    QDateTime currentTime;
+    warmupObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+    jsonStorage->addJSON(warmupObject);
+}
+
+// Live per-function SDK call statistics
+void ControllerForm::on_NeuroOmega_SDKDiagnostics_clicked()
+{
+    SDKDiagnosticsDialog diagnosticsView;
+    diagnosticsView.setFixedSize(diagnosticsView.size());
+    diagnosticsView.exec();
+}
+
+// Live traces of the contacts of the electrode selected for stimulation. The window follows the electrode selector.
+void ControllerForm::on_NeuroOmega_TraceViewer_clicked()
+{
+    PROFILE_SCOPE("ControllerForm::on_NeuroOmega_TraceViewer_clicked");
+
+    if (streamDataHandler == nullptr)
+    {
+        displayError(QMessageBox::Warning, "Live streaming is not running.");
+        return;
+    }
+
+    if (traceViewer == nullptr)
+    {
+        traceViewer = new TraceViewer(this);
+        traceViewer->setWindowFlags(Qt::Window);
+    }
+    traceViewer->setStream(streamDataHandler);
+    updateTraceChannels();
+    traceViewer->show();
+    traceViewer->raise();
+}
+
+void ControllerForm::updateTraceChannels()
+{
+    if (traceViewer == nullptr) return;
+
+    QVector<int> channelIDs;
+    QStringList labels;
+    for (int i = 0; i < this->currentElectrodeConfiguration.channelIDs.size(); i++)
+    {
+        int channelID = this->currentElectrodeConfiguration.channelIDs[i];
+        if (channelID <= 0 || streamDataHandler == nullptr || streamDataHandler->channelIndex(channelID) < 0) continue;
+
+        channelIDs.append(channelID);
+        QString channelName = ChannelCatalog::instance()->channelName(channelID);
+        labels.append(channelName.isEmpty() ? QString::number(channelID) : channelName);
+    }
+    traceViewer->setChannels(channelIDs, labels);
+}
+
+void ControllerForm::on_NeuroOmega_Spectrogram_clicked()
+{
+    PROFILE_SCOPE("ControllerForm::on_NeuroOmega_Spectrogram_clicked");
+
+    if (streamDataHandler == nullptr || filterGraph == nullptr)
+    {
+        displayError(QMessageBox::Warning, "Live streaming is not running.");
+        return;
+    }
+
+    if (spectrogramView == nullptr)
+    {
+        spectrogramView = new SpectrogramView(this);
+        spectrogramView->setWindowFlags(Qt::Window);
+        spectrogramView->setHistory(applicationConfiguration->value("SpectrogramHistory", 60).toDouble());
+    }
+    updateSpectrogramSources();
+    spectrogramView->show();
+    spectrogramView->raise();
+}
+
+// Spectrogram sources follow the current stimulation lead
+void ControllerForm::updateSpectrogramSources()
+{
+    if (spectrogramView == nullptr || filterGraph == nullptr) return;
+
+    QVector<int> channelIDs;
+    QStringList labels;
+    for (int i = 0; i < contactSelection->size(); i++)
+    {
+        int channelID = contactSelection->channelID(i);
+        QString channelName = ChannelCatalog::instance()->channelName(channelID);
+        channelIDs.append(channelID);
+        labels.append(channelName.isEmpty() ? QString::number(channelID) : channelName);
+    }
+    spectrogramView->setFilterGraph(filterGraph, channelIDs, labels);
+}
+
+void ControllerForm::setReplayMode(bool enabled)
+{
+    replayMode = enabled;
+    replayErrors.clear();
+}
+
+int ControllerForm::replayErrorCount() const
+{
+    return replayErrors.size();
+}
+
+QStringList ControllerForm::replayErrorMessages() const
+{
+    return replayErrors;
+}
+
+// Re-apply one operator action from a recorded session log. Logged objects that are outputs of the
+// controller (motor status, quality, timing...) are not actions and return false.
+bool ControllerForm::replaySessionEvent(QJsonObject event, double stimulationDuration)
+{
+    QString objectType = event["ObjectType"].toString();
+    if (objectType == "StimulationOn")
+    {
+        if (ui->StimulationControl_Stop->isEnabled()) on_StimulationControl_Stop_clicked();
+
+        // The log keeps the NeuroOmega channel IDs, so contacts are restored without going through the buttons
+        QList<int> anodes;
+        QJsonArray anodeArray = event["StimulationChannel"].toArray();
+        for (int i = 0; i < anodeArray.size(); i++) anodes.append(anodeArray[i].toInt());
+        contactSelection->setSelection(anodes, event["StimulationReturn"].toInt());
+
+        ui->StimulationControl_Amplitude->setValue(-event["Amplitude"].toDouble());
+        ui->StimulationControl_Pulsewidth->setValue(event["PulseWidth"].toDouble() * 1000);
+        ui->StimulationControl_Frequency->setValue(event["Frequency"].toInt());
+        ui->StimulationControl_Duration->setValue(qMax(1.0, ceil(stimulationDuration)));
+        on_StimulationControl_Start_clicked();
+        return true;
+    }
+    else if (objectType == "StimulationOff")
+    {
+        if (ui->StimulationControl_Stop->isEnabled()) on_StimulationControl_Stop_clicked();
+        return true;
+    }
+    else if (objectType == "Label")
+    {
+        sendLabelMessages(event["LabelText"].toString());
+        return true;
+    }
+    return false;
+}
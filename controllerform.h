@@ -39,8 +39,27 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "recordingannotation.h"
 #include "manuallabelentry.h"
 #include "novelstimulationconfiguration.h"
-
-#ifdef QT_DEBUG
+#include "streamdatahandler.h"
+#include "filtergraph.h"
+#include "closedloopcontroller.h"
+#include "merprofilebuilder.h"
+#include "contactqualityestimator.h"
+#include "sdkdiagnosticsdialog.h"
+#include "devicestatemachine.h"
+#include "channelconfigurationengine.h"
+#include "traceviewer.h"
+#include "contactselectionmodel.h"
+#include "electrodegridwidget.h"
+#include "spectrogramview.h"
+#include "interfaceconfiguration.h"
+#include "startupwarmup.h"
+#include "sessioncatalog.h"
+#include "shadowrecordingwriter.h"
+#include "clocksynchronizer.h"
+#include "labeldispatcher.h"
+#include "protocolcompiler.h"
+
+#if defined(QT_DEBUG) || defined(NEUROOMEGA_SIMULATOR)
 #include "AOSystemAPI_TEST.h"
 #else
 #include "AOSystemAPI.h"
@@ -71,8 +90,8 @@ public:
 
     void configureElectrodeConfigurationText(QString electrodeSelectorName, int type);
 
-    void resetCathodeSelection();
     void setupElectrodeButtons(QString electrodeName);
+    void bindContactButton(QPushButton *button, int channelID);
     void updateChannelConfiguration(int *channelIDs, int len, int electrodeID);
     void stimulationContactPressed(QPushButton* button);
     void formatElectrodeConfiguration();
@@ -81,12 +100,39 @@ public:
     bool configureRecordingChannels();
     void stimulationStateUpdate();
     void sendLabelMessages(QString messages);
+    void labelDispatched(QJsonObject labelObject);
+    void labelDispatchFailed(QString text, QString message);
     void updateAnnotation(QString annotation, QJsonDocument loadedDocument);
     void recordingStateUpdate();
+    void recordingStarted();
+    void recordingStartFailed(QString message, bool timedOut);
 
     void novelStimulationParametersUpdate(QStringList waveNames, int selectedWave, QJsonDocument stimulationJsonDocument);
     void startSequentialStimulation();
+    bool compileStimulationProtocol();
+    void logProtocolTimeline();
     void loadAnalogWaveform(QJsonArray filenameArray);
+    void startStartupWarmup();
+    void startupWarmupProgress(QString message, int completed, int total);
+    void startupResourcesReady(int elapsed);
+    void sessionCatalogIndexed(int indexed, int failed, int elapsed);
+    void clockSynchronizationLost();
+
+    void startStreaming();
+    void stopStreaming();
+    void shadowRecordingFailed(QString message);
+    void updateTraceChannels();
+    void updateSpectrogramSources();
+    void contactQualityUpdated();
+
+    void stopClosedLoop();
+    void closedLoopStimulationChanged(bool stimulationOn, double biomarker);
+    void closedLoopSafetyEvent(QString message);
+
+    void setReplayMode(bool enabled);
+    int replayErrorCount() const;
+    QStringList replayErrorMessages() const;
+    bool replaySessionEvent(QJsonObject event, double stimulationDuration);
 
 signals:
     void connectionChanged();
@@ -95,6 +141,11 @@ private slots:
     void on_StimulationControl_Electrode_currentTextChanged(const QString &electrodeName);
 
     void on_StimulationContactClicked();
+    void contactStateChanged(int index, int state);
+    void globalReturnChanged(bool selected);
+    void stimulationContactSelected(int index);
+    void electrodeOverlaySelected(QString name);
+    void updateElectrodeOverlay();
     void on_StimulationContact_GlobalCAN_clicked();
     void on_StimulationControl_Start_clicked();
     void on_StimulationControl_Stop_clicked();
@@ -119,6 +170,13 @@ private slots:
     void on_StimulationControl_Novel_clicked();
     void on_StimulationControl_Novel_Start_clicked();
 
+    void on_StimulationControl_ClosedLoop_clicked();
+
+    void on_NeuroOmega_SDKDiagnostics_clicked();
+    void on_NeuroOmega_TraceViewer_clicked();
+    void on_NeuroOmega_Spectrogram_clicked();
+    void updateRecordingLabels();
+
 private:
     Ui::ControllerForm *ui;
     QSettings *applicationConfiguration;
@@ -128,24 +186,32 @@ private:
 
     // List holding all electrodes
     QList<ElectrodeInformation> electrodeConfigurations;
-    QList<QPushButton*> displayChannelButtons;
     QGridLayout *electrodeLayout;
+    ElectrodeGridWidget *electrodeGrid;
+    bool electrodeGridActive = false;
 
     // Cathode is "+", Anode is "-". The Global Return can only be cathode "+".
     // There can only be 1 return channel in this program to simply things.
-    QList<int> StimulationAnode;
-    int StimulationCathode = 0;
+    // Contact buttons are views of the selection model, in model index order.
+    ContactSelectionModel *contactSelection;
+    QList<QPushButton*> contactSelectionButtons;
 
-    // Pre-defined QPushButton Style for easier visualization of button color. Change the color to your prefer color
-    QString anodeStyle = "QPushButton {background-color: rgb(255, 88, 99); border: none}";
-    QString cathodeStyle = "QPushButton {background-color: rgb(83, 175, 255); border: none}";
-    QString noneStyle = "";
+    // Pre-defined QPushButton Style for easier visualization of button color. Anode and cathode colors are
+    // selected by the "ContactState" property in naturalButtonStyle.
+    QString contactStyle = "";
     QString naturalButtonStyle = "";
 
     // Initialization of QTimer variables. These are used for periodic tasks.
     QTimer *connectionCheck;
     QTimer *stimulationStateTimer;
     QTimer *recordingStateTimer;
+    RecordingStartStateMachine *recordingStartStateMachine = nullptr;
+
+    // Last novel waveform and stimulation protocol, loaded in the background once the window is up
+    StartupWarmup *startupWarmup = nullptr;
+
+    // Background indexer keeping the SQLite session catalog of SurgicalLogFolder up to date
+    SessionCatalogIndexer *sessionCatalogIndexer = nullptr;
 
     // Elapsed Time timer to keep track of task durations.
     QElapsedTimer stimulationElapsedTime;
@@ -153,8 +219,12 @@ private:
     bool infiniteRecording = false;
     bool recordingStatus = false;
 
-    // JSON Storage Class for Loggings
+    // JSON Storage Class for Loggings. Entries are tagged with the device sample estimated by clockSynchronizer.
     JSONStorage *jsonStorage;
+    ClockSynchronizer *clockSynchronizer = nullptr;
+
+    // Background SendText queue for labels, benefit and side effect buttons
+    LabelDispatcher *labelDispatcher = nullptr;
     QFile *sideEffectNotes;
     QString patientDirectory;
 
@@ -166,12 +236,43 @@ private:
     QString currentProgrammedFilename = "";
     QStringList waveformList;
     int currentWaveformID = -1;
+    // StimulationIndex last embedded by the sequencer, so consecutive stages on the same waveform skip the upload
+    int sequenceWaveformIndex = -1;
 
     QList<int16_t*> preloadedAnalogWaveforms;
     QList<AnalogWaveformDescriptor> analogWaveformDescriptor;
 
     // Realtime Stream QT Form
     ElectrodeInformation currentElectrodeConfiguration;
+
+    // Live acquisition of all configured contacts and the DSP graph running on top of it
+    StreamDataHandler *streamDataHandler = nullptr;
+    FilterGraph *filterGraph = nullptr;
+    TraceViewer *traceViewer = nullptr;
+    SpectrogramView *spectrogramView = nullptr;
+
+    // Biomarker-triggered stimulation running on its own high-priority thread
+    ClosedLoopController *closedLoopController = nullptr;
+
+    // Depth-resolved MER features built during trajectory descent
+    MERProfileBuilder *merProfileBuilder = nullptr;
+
+    // Our own chunked capture of the acquisition stream, segmented by recording filename instead of file switches
+    ShadowRecordingWriter *shadowRecordingWriter = nullptr;
+
+    // Per-channel signal quality from the acquisition rings
+    ContactQualityEstimator *contactQualityEstimator = nullptr;
+
+    // Live electrode grid overlay. overlayLatest is written by the filter graph sink on the acquisition thread.
+    QTimer *overlayTimer;
+    int overlaySinkID = 0;
+    QMutex overlayMutex;
+    QVector<int> overlayChannelIDs;
+    QVector<float> overlayLatest;
+
+    // Headless session replay: errors are collected for the replay report instead of shown in modal dialogs
+    bool replayMode = false;
+    QStringList replayErrors;
 };
 
 #endif // CONTROLLERFORM_H
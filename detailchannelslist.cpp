@@ -16,6 +16,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 *********************************************************************************/
 
 #include "detailchannelslist.h"
+#include "sdkinstrumentation.h"
 #include "ui_detailchannelslist.h"
 
 DetailChannelsList::DetailChannelsList(QWidget *parent) :
@@ -24,13 +25,20 @@ DetailChannelsList::DetailChannelsList(QWidget *parent) :
 {
     ui->setupUi(this);
 
-    ui->AllChannelsTable->setColumnWidth(1, 250);
-    ui->AllChannelsTable->setColumnWidth(2, 100);
-    ui->AllChannelsTable->horizontalHeader()->setSectionResizeMode(2, QHeaderView::Fixed);
+    // Rows come straight from the channel catalog; fixed row heights keep layout independent of the channel count.
+    channelModel = new ChannelTableModel(this);
+    channelFilter = new ChannelFilterProxyModel(this);
+    channelFilter->setSourceModel(channelModel);
+    ui->AllChannelsTable->setModel(channelFilter);
+    ui->AllChannelsTable->sortByColumn(ChannelIDColumn, Qt::AscendingOrder);
+
+    ui->AllChannelsTable->setColumnWidth(ChannelNameColumn, 250);
+    ui->AllChannelsTable->setColumnWidth(SaveStateColumn, 100);
+    ui->AllChannelsTable->horizontalHeader()->setSectionResizeMode(SaveStateColumn, QHeaderView::Fixed);
+    ui->AllChannelsTable->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
     ui->AllChannelsTable->verticalHeader()->setHidden(true);
 
-    applicationConfiguration = new QSettings(QDir::currentPath() + "/defaultSettings.ini", QSettings::IniFormat);
-    this->deploymentMode = applicationConfiguration->value("DeploymentMode").toString().toStdString();
+    this->deploymentMode = InterfaceConfiguration::instance()->settings()->value("DeploymentMode").toString().toStdString();
 }
 
 DetailChannelsList::~DetailChannelsList()
@@ -38,61 +46,26 @@ DetailChannelsList::~DetailChannelsList()
     delete ui;
 }
 
+// Only the names and save states edited in the table, and different from the channel catalog, are sent to NeuroOmega.
 void DetailChannelsList::updateChannelInformation()
 {
-    uint32 channelCount = 0;
-    int result = GetChannelsCount(&channelCount);
-    if (result != eAO_OK)
-    {
-        QString messsage = getErrorLog();
-        displayError(QMessageBox::Warning, messsage);
-        return;
-    }
+    if (!channelModel->hasPendingChanges()) return;
 
-    SInformation channelsInfo[channelCount];
-    result = GetAllChannels(channelsInfo, channelCount);
-    if (result != eAO_OK)
-    {
-        QString messsage = getErrorLog();
-        displayError(QMessageBox::Warning, messsage);
-        return;
-    }
+    ChannelConfigurationEngine *channelConfiguration = ChannelConfigurationEngine::instance();
+    channelConfiguration->beginConfiguration();
+    channelModel->stageChanges(channelConfiguration);
 
-    for (int i = 0; i < channelCount; i++)
+    if (!channelConfiguration->apply())
     {
-        if (ui->AllChannelsTable->item(i, 0)->text() != QString(channelsInfo[i].channelName))
-        {
-            SetChannelName(channelsInfo[i].channelID, (char*)ui->AllChannelsTable->item(i, 1)->text().toStdString().c_str(), ui->AllChannelsTable->item(i, 1)->text().length());
-        }
-
-        auto field = ui->AllChannelsTable->cellWidget(i, 2);
-        bool checkState = qobject_cast<QCheckBox*> (field)->isChecked();
-        if (checkState != channelsSaveStates[i])
-        {
-            SetChannelSaveState(channelsInfo[i].channelID, checkState);
-        }
+        displayError(QMessageBox::Warning, channelConfiguration->errorMessage());
     }
 
-    setupChannels();
+    channelModel->refresh();
 }
 
 QString DetailChannelsList::getErrorLog()
 {
-    char errorString[1000] = {0};
-    int nErrorCount = 0;
-    int result = ErrorHandlingfunc(&nErrorCount, errorString, 1000);
-
-    switch (result)
-    {
-        case eAO_ARG_NULL:
-            printf("ErrorHandlingfunc: NULL Argument Error\n");
-            break;
-        case eAO_BAD_ARG:
-            printf("ErrorHandlingfunc: Bad Argument\n");
-            break;
-    }
-
-    return QString(errorString);
+    return sdkErrorLog();
 }
 
 void DetailChannelsList::displayError(int errorLevel, QString message)
@@ -109,53 +82,20 @@ void DetailChannelsList::displayError(int errorLevel, QString message)
 
 void DetailChannelsList::setupChannels()
 {
-
-    uint32 channelCount;
-    SInformation *channelsInfo;
-
-    channelCount = 0;
-    int result = GetChannelsCount(&channelCount);
-    if (result != eAO_OK)
+    // Opening the list re-reads every save state, in case they were changed from the NeuroOmega application.
+    if (!ChannelCatalog::instance()->refresh(true))
     {
-        QString messsage = getErrorLog();
-        displayError(QMessageBox::Warning, messsage);
+        displayError(QMessageBox::Warning, ChannelCatalog::instance()->errorMessage());
         return;
     }
 
-    channelsInfo = new SInformation[channelCount];
-    result = GetAllChannels(channelsInfo, channelCount);
-    if (result != eAO_OK)
-    {
-        QString messsage = getErrorLog();
-        displayError(QMessageBox::Warning, messsage);
-        return;
-    }
-
-    int rowCount = ui->AllChannelsTable->rowCount();
-    for (int i = 0; i < rowCount; i++)
-    {
-        ui->AllChannelsTable->removeRow(0);
-    }
-
-    for (int i = 0; i < channelCount; i++)
-    {
-        ui->AllChannelsTable->insertRow(ui->AllChannelsTable->rowCount());
-
-        ui->AllChannelsTable->setItem(ui->AllChannelsTable->rowCount() - 1, 0, new QTableWidgetItem(QString::number(channelsInfo[i].channelID)));
-        ui->AllChannelsTable->item(ui->AllChannelsTable->rowCount() - 1, 0)->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
-        ui->AllChannelsTable->item(ui->AllChannelsTable->rowCount() - 1, 0)->setTextAlignment(Qt::AlignHCenter);
-
-        ui->AllChannelsTable->setItem(ui->AllChannelsTable->rowCount() - 1, 1, new QTableWidgetItem(channelsInfo[i].channelName));
-
-        int saveState = 0;
-        QCheckBox *checkbox = new QCheckBox();
-        GetChannelSaveState(channelsInfo[i].channelID, &saveState);
-        channelsSaveStates << saveState;
-        checkbox->setChecked(saveState);
+    channelModel->refresh();
+}
 
-        ui->AllChannelsTable->setCellWidget(ui->AllChannelsTable->rowCount() - 1, 2, checkbox);
-        ui->AllChannelsTable->cellWidget(ui->AllChannelsTable->rowCount() - 1, 2)->setStyleSheet("margin-left:40%; margin-right:60%;");
-    }
+// Latest streaming quality estimate. Channels that are not streamed keep the default row color.
+void DetailChannelsList::setChannelQuality(QVector<ChannelQuality> quality)
+{
+    channelModel->setChannelQuality(quality);
 }
 
 void DetailChannelsList::on_UpdateChannelInformation_clicked()
@@ -165,34 +105,23 @@ void DetailChannelsList::on_UpdateChannelInformation_clicked()
 
 void DetailChannelsList::on_ResetChannelInformation_clicked()
 {
-    uint32 channelCount = 0;
-    int result = GetChannelsCount(&channelCount);
-    if (result != eAO_OK)
+    ChannelConfigurationEngine *channelConfiguration = ChannelConfigurationEngine::instance();
+    channelConfiguration->beginConfiguration();
+    channelConfiguration->setDefaultNames(ECOG_FIRST_CHANNEL, ECOG_LAST_CHANNEL);
+    if (!channelConfiguration->apply())
     {
-        QString messsage = getErrorLog();
-        displayError(QMessageBox::Warning, messsage);
-        return;
+        displayError(QMessageBox::Warning, channelConfiguration->errorMessage());
     }
 
-    SInformation channelsInfo[channelCount];
-    result = GetAllChannels(channelsInfo, channelCount);
-    if (result != eAO_OK)
-    {
-        QString messsage = getErrorLog();
-        displayError(QMessageBox::Warning, messsage);
-        return;
-    }
+    channelModel->refresh();
+}
 
-    for (int i = 0; i < channelCount; i++)
-    {
-        if (channelsInfo[i].channelID >= 10272 && channelsInfo[i].channelID <= 10335)
-        {
-            int boxID = (channelsInfo[i].channelID - 10272) / 16;
-            int channelID = (channelsInfo[i].channelID - 10272) % 16;
-            QString defaultChannelName = "ECOG HF " + QString::number(boxID+1) + " / " + QStringLiteral("%1").arg(channelID+1, 2, 10, QLatin1Char('0')) + " - Array " + QString::number(boxID+1) + " / " + QStringLiteral("%1").arg(channelID+1, 2, 10, QLatin1Char('0'));
-            SetChannelName(channelsInfo[i].channelID, (char*)defaultChannelName.toStdString().c_str(), defaultChannelName.length());
-        }
-    }
+void DetailChannelsList::on_ChannelFilter_textChanged(const QString &text)
+{
+    channelFilter->setFilterText(text);
+}
 
-    setupChannels();
+void DetailChannelsList::on_SaveStateFilter_currentIndexChanged(int index)
+{
+    channelFilter->setSaveStateFilter(index);
 }
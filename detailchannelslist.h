@@ -21,18 +21,22 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <QDialog>
 #include <QString>
 #include <QtCore>
-#include <QCheckBox>
 #include <QMessageBox>
 
 #include <cstring>
 
-#ifdef QT_DEBUG
+#if defined(QT_DEBUG) || defined(NEUROOMEGA_SIMULATOR)
 #include "AOSystemAPI_TEST.h"
 #else
 #include "AOSystemAPI.h"
 #endif
 #include "AOTypes.h"
 
+#include "contactqualityestimator.h"
+#include "channelconfigurationengine.h"
+#include "channeltablemodel.h"
+#include "interfaceconfiguration.h"
+
 using namespace std;
 
 namespace Ui {
@@ -51,17 +55,21 @@ public:
     void displayError(int errorLevel, QString message);
     void setupChannels();
     void updateChannelInformation();
+    void setChannelQuality(QVector<ChannelQuality> quality);
 
 private slots:
     void on_UpdateChannelInformation_clicked();
 
     void on_ResetChannelInformation_clicked();
 
+    void on_ChannelFilter_textChanged(const QString &text);
+    void on_SaveStateFilter_currentIndexChanged(int index);
+
 private:
     Ui::DetailChannelsList *ui;
-    QList<int> channelsSaveStates;
+    ChannelTableModel *channelModel;
+    ChannelFilterProxyModel *channelFilter;
 
-    QSettings *applicationConfiguration;
     string deploymentMode;
 };
 
@@ -0,0 +1,183 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "devicestatemachine.h"
+#include "sdkinstrumentation.h"
+
+ConnectionStateMachine::ConnectionStateMachine(QObject *parent) :
+    QObject(parent)
+{
+    connectionResult = eAO_OK;
+    connect(&pollTimer, &QTimer::timeout, this, &ConnectionStateMachine::poll);
+}
+
+// The SDK call cannot be interrupted, so an outstanding connection attempt is allowed to finish.
+ConnectionStateMachine::~ConnectionStateMachine()
+{
+    pollTimer.stop();
+    if (connectionThread != nullptr)
+    {
+        connectionThread->wait();
+        delete connectionThread;
+    }
+}
+
+bool ConnectionStateMachine::start(MAC_ADDR address, int timeout, int pollInterval)
+{
+    if (isRunning()) return false;
+
+    this->timeout = timeout;
+    pollTimer.setInterval(pollInterval);
+    currentState = Connecting;
+    elapsedTimer.start();
+    emit progress("Connecting to NeuroOmega", 0, timeout);
+
+    if (connectionThread != nullptr) delete connectionThread;
+    connectionError = "";
+    connectionThread = QThread::create([this, address]() mutable {
+        connectionResult = AO_CALL(DefaultStartConnection)(&address, NULL);
+        // The error text is kept by the thread that made the call
+        if (connectionResult != eAO_OK) connectionError = sdkErrorLog();
+    });
+    connect(connectionThread, &QThread::finished, this, &ConnectionStateMachine::connectionRequested);
+    connectionThread->start();
+    return true;
+}
+
+ConnectionStateMachine::State ConnectionStateMachine::state() const
+{
+    return currentState;
+}
+
+bool ConnectionStateMachine::isRunning() const
+{
+    return currentState == Connecting || currentState == WaitingForDevice;
+}
+
+void ConnectionStateMachine::connectionRequested()
+{
+    if (currentState != Connecting) return;
+
+    if (connectionResult.loadAcquire() != eAO_OK)
+    {
+        finish(Failed);
+        emit failed(connectionError, false);
+        return;
+    }
+
+    currentState = WaitingForDevice;
+    poll();
+    if (currentState == WaitingForDevice) pollTimer.start();
+}
+
+// eAO_DISCONNECTED is expected while the handshake is still in progress, so only the timeout fails the attempt.
+void ConnectionStateMachine::poll()
+{
+    int elapsed = elapsedTimer.elapsed();
+    if (AO_CALL(isConnected)() == eAO_CONNECTED)
+    {
+        finish(Connected);
+        emit connected(elapsed);
+    }
+    else if (elapsed >= timeout)
+    {
+        finish(Failed);
+        emit failed(QString("NeuroOmega has not responded in %1 seconds. Please check if the NeuroOmega Application is running.").arg(timeout / 1000), true);
+    }
+    else
+    {
+        emit progress("Waiting for NeuroOmega", elapsed, timeout);
+    }
+}
+
+void ConnectionStateMachine::finish(State finalState)
+{
+    pollTimer.stop();
+    currentState = finalState;
+}
+
+RecordingStartStateMachine::RecordingStartStateMachine(QObject *parent) :
+    QObject(parent)
+{
+    connect(&pollTimer, &QTimer::timeout, this, &RecordingStartStateMachine::poll);
+}
+
+// The first check runs immediately; recordings that are already configured start without waiting for the timer.
+bool RecordingStartStateMachine::start(ReadinessCheck configured, int timeout, int pollInterval)
+{
+    if (isRunning()) return false;
+
+    this->configured = configured;
+    this->timeout = timeout;
+    pollTimer.setInterval(pollInterval);
+    currentState = WaitingForConfiguration;
+    elapsedTimer.start();
+
+    poll();
+    if (isRunning()) pollTimer.start();
+    return true;
+}
+
+void RecordingStartStateMachine::cancel()
+{
+    if (isRunning()) finish(Idle);
+}
+
+RecordingStartStateMachine::State RecordingStartStateMachine::state() const
+{
+    return currentState;
+}
+
+bool RecordingStartStateMachine::isRunning() const
+{
+    return currentState == WaitingForConfiguration || currentState == WaitingForDevice;
+}
+
+void RecordingStartStateMachine::poll()
+{
+    int elapsed = elapsedTimer.elapsed();
+    if (currentState == WaitingForConfiguration && configured()) currentState = WaitingForDevice;
+
+    if (currentState == WaitingForDevice && AO_CALL(isConnected)() == eAO_CONNECTED)
+    {
+        int result = AO_CALL(StartSave)();
+        if (result != eAO_OK)
+        {
+            finish(Failed);
+            emit failed(sdkErrorLog(), false);
+            return;
+        }
+
+        finish(Recording);
+        emit started(elapsed);
+    }
+    else if (elapsed >= timeout)
+    {
+        finish(Failed);
+        emit failed(QString("Recording cannot start in %1 seconds. Check NeuroOmega Connection.").arg(timeout / 1000), true);
+    }
+    else
+    {
+        emit progress(elapsed, timeout);
+    }
+}
+
+void RecordingStartStateMachine::finish(State finalState)
+{
+    pollTimer.stop();
+    currentState = finalState;
+}
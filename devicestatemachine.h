@@ -0,0 +1,105 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef DEVICESTATEMACHINE_H
+#define DEVICESTATEMACHINE_H
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QString>
+
+#include <functional>
+
+#if defined(QT_DEBUG) || defined(NEUROOMEGA_SIMULATOR)
+#include "AOSystemAPI_TEST.h"
+#else
+#include "AOSystemAPI.h"
+#endif
+#include "AOTypes.h"
+
+// Connects to NeuroOmega without blocking the GUI thread. DefaultStartConnection runs on a worker thread,
+// then isConnected is polled from the event loop until the device reports eAO_CONNECTED or the timeout expires.
+class ConnectionStateMachine : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum State { Idle, Connecting, WaitingForDevice, Connected, Failed };
+
+    explicit ConnectionStateMachine(QObject *parent = nullptr);
+    ~ConnectionStateMachine();
+
+    bool start(MAC_ADDR address, int timeout = 10000, int pollInterval = 100);
+    State state() const;
+    bool isRunning() const;
+
+signals:
+    void progress(QString message, int elapsed, int timeout);
+    void connected(int elapsed);
+    void failed(QString message, bool timedOut);
+
+private:
+    void connectionRequested();
+    void poll();
+    void finish(State finalState);
+
+    State currentState = Idle;
+    QThread *connectionThread = nullptr;
+    QAtomicInt connectionResult;
+    QString connectionError;
+    QTimer pollTimer;
+    QElapsedTimer elapsedTimer;
+    int timeout = 10000;
+};
+
+// Starts NeuroOmega saving as soon as the recording is configured and the device confirms the connection,
+// instead of sleeping in whole seconds. "configured" is checked on every poll from the GUI thread.
+class RecordingStartStateMachine : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum State { Idle, WaitingForConfiguration, WaitingForDevice, Recording, Failed };
+    typedef std::function<bool()> ReadinessCheck;
+
+    explicit RecordingStartStateMachine(QObject *parent = nullptr);
+
+    bool start(ReadinessCheck configured, int timeout = 3000, int pollInterval = 20);
+    void cancel();
+    State state() const;
+    bool isRunning() const;
+
+signals:
+    void progress(int elapsed, int timeout);
+    void started(int elapsed);
+    void failed(QString message, bool timedOut);
+
+private:
+    void poll();
+    void finish(State finalState);
+
+    State currentState = Idle;
+    ReadinessCheck configured;
+    QTimer pollTimer;
+    QElapsedTimer elapsedTimer;
+    int timeout = 3000;
+};
+
+#endif // DEVICESTATEMACHINE_H
@@ -24,33 +24,10 @@ ElectrodeConfigurations::ElectrodeConfigurations(QWidget *parent) :
 {
     ui->setupUi(this);
 
-    QFile file;
-    file.setFileName(QDir::currentPath() + "/InterfaceConfigurations.json");
-    if (!file.open(QIODevice::ReadOnly)) return;
-    QByteArray configurationData = file.readAll();
-
-    QJsonDocument loadedDocument = QJsonDocument::fromJson(configurationData);
-    if (loadedDocument.isObject())
-    {
-        QJsonObject documentObject = loadedDocument.object();
-        if (documentObject.contains("ElectrodeDefinitions")) interfaceConfiguration = loadedDocument.object();
-    }
-
-    // Load Electrode Names
+    // Electrode and target names come from the shared, already parsed InterfaceConfigurations.json
     availableElectrodeNames.append("None");
-    QJsonArray electrodeDefinitions = interfaceConfiguration["ElectrodeDefinitions"].toArray();
-    for (int i = 0; i < electrodeDefinitions.size(); i++)
-    {
-        availableElectrodeNames.append(electrodeDefinitions[i].toObject()["ElectrodeName"].toString());
-        for (int j = 0; j < 2; j++) electrodeDefinitions[i].toObject()["layoutSize"].toArray()[j].toInt();
-    }
-
-    // Load Target Names
-    QJsonArray targetDefinitions = interfaceConfiguration["TargetDefinitions"].toArray();
-    for (int i = 0; i < targetDefinitions.size(); i++)
-    {
-        availableTargetNames.append(targetDefinitions[i].toString());
-    }
+    availableElectrodeNames.append(InterfaceConfiguration::instance()->electrodeNames());
+    availableTargetNames = InterfaceConfiguration::instance()->targets();
 
     scrollAreaLayout = new QGridLayout();
     ui->ScrollAreaWidget->setLayout(scrollAreaLayout);
@@ -165,16 +142,13 @@ void ElectrodeConfigurations::on_electrodeNameChanged()
     electrodeInfoCollection[channelID].channelIDs.clear();
     electrodeInfoCollection[channelID].numContacts = 0;
 
-    QJsonArray electrodeDefinitions = interfaceConfiguration["ElectrodeDefinitions"].toArray();
-    for (int i = 0; i < electrodeDefinitions.size(); i++)
+    const ElectrodeDefinition *definition = InterfaceConfiguration::instance()->electrodeDefinition(electrodeNameWidget->currentText());
+    if (definition != nullptr)
     {
-        if (electrodeDefinitions[i].toObject()["ElectrodeName"].toString() == electrodeWidgetsCollection[channelID].electrodeName->currentText())
+        electrodeInfoCollection[channelID].numContacts = definition->channelCount;
+        if (definition->electrodeName.contains("ECoG") || definition->electrodeName.contains("EMG"))
         {
-            electrodeInfoCollection[channelID].numContacts = electrodeDefinitions[i].toObject()["ChannelCount"].toInt();
-            if (electrodeWidgetsCollection[channelID].electrodeName->currentText().contains("ECoG") || electrodeWidgetsCollection[channelID].electrodeName->currentText().contains("EMG"))
-            {
-                for (int j = 0; j < 2; j++) electrodeInfoCollection[channelID].layoutSize[j] = electrodeDefinitions[i].toObject()["Arrange"].toArray()[j].toInt();
-            }
+            for (int j = 0; j < 2; j++) electrodeInfoCollection[channelID].layoutSize[j] = definition->arrange[j];
         }
     }
 
@@ -295,3 +269,38 @@ void ElectrodeConfigurations::on_ChannelConfirm_clicked()
     }
 }
 
+
+// Lead descriptions are logged as "<electrode> <hemisphere> <target>" and electrode names may contain spaces, so the
+// longest known electrode name that prefixes the description is taken. An unknown electrode is everything before the
+// last two words and leaves definition null.
+bool ElectrodeConfigurations::parseLead(QString description, const QList<ElectrodeDefinition> &electrodeDefinitions, QString &electrode,
+                                        QString &hemisphere, QString &target, const ElectrodeDefinition **definition)
+{
+    electrode = "";
+    *definition = nullptr;
+    for (int i = 0; i < electrodeDefinitions.size(); i++)
+    {
+        QString electrodeName = electrodeDefinitions[i].electrodeName;
+        if (description.startsWith(electrodeName + " ") && electrodeName.length() > electrode.length())
+        {
+            electrode = electrodeName;
+            *definition = &electrodeDefinitions[i];
+        }
+    }
+
+    QStringList placement;
+    if (!electrode.isEmpty())
+    {
+        placement = description.mid(electrode.length() + 1).split(" ");
+    }
+    else
+    {
+        QStringList words = description.split(" ");
+        if (words.size() < 3) return false;
+        placement = words.mid(words.size() - 2);
+        electrode = words.mid(0, words.size() - 2).join(" ");
+    }
+    hemisphere = placement.value(0);
+    target = placement.value(1);
+    return true;
+}
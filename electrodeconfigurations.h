@@ -31,6 +31,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <QJsonObject>
 
 #include "channelselectiondialog.h"
+#include "interfaceconfiguration.h"
 
 namespace Ui {
 class ElectrodeConfigurations;
@@ -67,6 +68,9 @@ public:
     void addNewElectrodeRow(int rowID);
     void displayError(int errorLevel, QString message);
 
+    static bool parseLead(QString description, const QList<ElectrodeDefinition> &electrodeDefinitions, QString &electrode,
+                          QString &hemisphere, QString &target, const ElectrodeDefinition **definition);
+
     QList<ElectrodeInformation> electrodeInfoCollection;
 
 private slots:
@@ -83,7 +87,6 @@ private:
     QGridLayout *scrollAreaLayout;
     QList<ElectrodeConfigurationUIWidgets> electrodeWidgetsCollection;
 
-    QJsonObject interfaceConfiguration;
     QStringList availableElectrodeNames;
     QStringList availableTargetNames;
 };
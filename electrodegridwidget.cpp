@@ -0,0 +1,245 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "electrodegridwidget.h"
+
+ElectrodeGridWidget::ElectrodeGridWidget(QWidget *parent) :
+    QWidget(parent)
+{
+    // Dark blue to teal to yellow, readable on the grid background and in grayscale print-outs
+    const double stops[3][3] = {{68, 1, 84}, {33, 145, 140}, {253, 231, 37}};
+    overlayColors.resize(ELECTRODE_OVERLAY_LEVELS);
+    for (int i = 0; i < ELECTRODE_OVERLAY_LEVELS; i++)
+    {
+        double position = 2.0 * i / (ELECTRODE_OVERLAY_LEVELS - 1);
+        int segment = qMin((int)position, 1);
+        double fraction = position - segment;
+        overlayColors[i] = QColor((int)(stops[segment][0] + fraction * (stops[segment + 1][0] - stops[segment][0])),
+                                  (int)(stops[segment][1] + fraction * (stops[segment + 1][1] - stops[segment][1])),
+                                  (int)(stops[segment][2] + fraction * (stops[segment + 1][2] - stops[segment][2])));
+    }
+}
+
+// Switching leads only resizes the state vectors and recomputes the geometry, no widgets are created.
+void ElectrodeGridWidget::setElectrodeLayout(int rows, int numContacts, QStringList labels)
+{
+    this->numContacts = numContacts;
+    this->rows = rows > 0 ? rows : qMax(numContacts, 1);
+    this->columns = qMax((numContacts + this->rows - 1) / this->rows, 1);
+    this->labels = labels;
+
+    contactStates.fill(ContactNone, numContacts);
+    contactQuality.fill(ContactQualityGood, numContacts);
+    contactToolTips.clear();
+    for (int i = 0; i < numContacts; i++) contactToolTips.append("");
+    overlayLevels.fill(-1, numContacts);
+
+    layoutContacts();
+    update();
+}
+
+void ElectrodeGridWidget::setBackground(QString filename)
+{
+    background = QPixmap(filename);
+    scaledBackground = background.isNull() ? QPixmap() : background.scaled(size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    update();
+}
+
+void ElectrodeGridWidget::setContactState(int index, int state)
+{
+    if (index < 0 || index >= numContacts || contactStates[index] == state) return;
+    contactStates[index] = state;
+    updateContact(index);
+}
+
+void ElectrodeGridWidget::setContactQuality(int index, int state, QString toolTip)
+{
+    if (index < 0 || index >= numContacts) return;
+    contactToolTips[index] = toolTip;
+    if (contactQuality[index] == state) return;
+    contactQuality[index] = state;
+    updateContact(index);
+}
+
+// Names listed in the context menu. Selecting one emits overlaySelected(), the owner then feeds setOverlayValues().
+void ElectrodeGridWidget::setOverlayNames(QStringList names)
+{
+    overlayNames = names;
+}
+
+// One value per contact, NaN for contacts without data. Values are mapped onto the heatmap between minimum and maximum.
+void ElectrodeGridWidget::setOverlayValues(const QVector<float> &values, float minimum, float maximum)
+{
+    float scale = maximum > minimum ? (ELECTRODE_OVERLAY_LEVELS - 1) / (maximum - minimum) : 0;
+    for (int i = 0; i < numContacts; i++)
+    {
+        int level = -1;
+        if (i < values.size() && !std::isnan(values[i])) level = qBound(0, (int)((values[i] - minimum) * scale), ELECTRODE_OVERLAY_LEVELS - 1);
+        if (level == overlayLevels[i]) continue;
+        overlayLevels[i] = level;
+        updateContact(i);
+    }
+}
+
+void ElectrodeGridWidget::clearOverlay()
+{
+    currentOverlay = "";
+    overlayLevels.fill(-1, numContacts);
+    update();
+}
+
+QString ElectrodeGridWidget::overlayName() const
+{
+    return currentOverlay;
+}
+
+// Contacts sit on a regular grid, so the hit-test is arithmetic instead of a search.
+int ElectrodeGridWidget::contactAt(QPointF position) const
+{
+    if (cellSize <= 0) return -1;
+
+    int column = (int)floor((position.x() - origin.x()) / cellSize);
+    int row = (int)floor((position.y() - origin.y()) / cellSize);
+    if (column < 0 || column >= columns || row < 0 || row >= rows) return -1;
+
+    int index = column * rows + row;
+    if (index >= numContacts || !contactRects[index].contains(position)) return -1;
+    return index;
+}
+
+void ElectrodeGridWidget::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    if (!scaledBackground.isNull()) painter.drawPixmap(event->rect(), scaledBackground, event->rect());
+
+    QPen borderPen(Qt::black, 2);
+    QPen noisyPen(QColor(255, 190, 0), 3);
+    QPen flatPen(Qt::gray, 3, Qt::DashLine);
+    QPen saturatedPen(Qt::red, 3);
+    QColor anodeColor(255, 88, 99);
+    QColor cathodeColor(83, 175, 255);
+
+    QFont font = painter.font();
+    font.setPointSizeF(qMax(6.0, cellSize * 0.2));
+    painter.setFont(font);
+
+    for (int i = 0; i < numContacts; i++)
+    {
+        const QRectF &contact = contactRects[i];
+        if (!event->rect().intersects(contact.toAlignedRect())) continue;
+
+        QColor stateColor = contactStates[i] == ContactAnode ? anodeColor : cathodeColor;
+        bool overlay = overlayLevels[i] >= 0;
+
+        // Without an overlay the selection fills the contact, with one the heatmap does
+        if (overlay) painter.setBrush(overlayColors[overlayLevels[i]]);
+        else if (contactStates[i] != ContactNone) painter.setBrush(stateColor);
+        else painter.setBrush(Qt::NoBrush);
+
+        if (contactQuality[i] == ContactQualityNoisy) painter.setPen(noisyPen);
+        else if (contactQuality[i] == ContactQualityFlat) painter.setPen(flatPen);
+        else if (contactQuality[i] == ContactQualitySaturated) painter.setPen(saturatedPen);
+        else painter.setPen(borderPen);
+        painter.drawEllipse(contact);
+
+        if (overlay && contactStates[i] != ContactNone)
+        {
+            painter.setBrush(Qt::NoBrush);
+            painter.setPen(QPen(stateColor, qMax(3.0, cellSize * 0.08)));
+            double inset = qMax(3.0, cellSize * 0.08);
+            painter.drawEllipse(contact.adjusted(inset, inset, -inset, -inset));
+        }
+
+        painter.setPen(overlay && overlayLevels[i] < ELECTRODE_OVERLAY_LEVELS / 2 ? Qt::white : Qt::black);
+        painter.drawText(contact, Qt::AlignCenter, i < labels.size() ? labels[i] : QString::number(i));
+    }
+}
+
+void ElectrodeGridWidget::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    if (!background.isNull()) scaledBackground = background.scaled(size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    layoutContacts();
+}
+
+void ElectrodeGridWidget::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton) return;
+
+    int index = contactAt(event->position());
+    if (index >= 0) emit contactClicked(index);
+}
+
+void ElectrodeGridWidget::contextMenuEvent(QContextMenuEvent *event)
+{
+    if (overlayNames.isEmpty()) return;
+
+    QMenu menu(this);
+    QStringList names = QStringList() << "None" << overlayNames;
+    for (int i = 0; i < names.size(); i++)
+    {
+        QAction *action = menu.addAction(names[i]);
+        action->setCheckable(true);
+        action->setChecked(names[i] == currentOverlay || (i == 0 && currentOverlay.isEmpty()));
+    }
+
+    QAction *selected = menu.exec(event->globalPos());
+    if (selected == nullptr) return;
+
+    if (selected->text() == "None") clearOverlay();
+    else currentOverlay = selected->text();
+    emit overlaySelected(currentOverlay);
+}
+
+// Per-contact tooltips (contact quality) without a widget per contact
+bool ElectrodeGridWidget::event(QEvent *event)
+{
+    if (event->type() == QEvent::ToolTip)
+    {
+        QHelpEvent *helpEvent = static_cast<QHelpEvent*>(event);
+        int index = contactAt(helpEvent->pos());
+        if (index >= 0 && !contactToolTips[index].isEmpty()) QToolTip::showText(helpEvent->globalPos(), contactToolTips[index], this);
+        else QToolTip::hideText();
+        return true;
+    }
+    return QWidget::event(event);
+}
+
+// Square cells, 80% filled by the contact as with the previous contact buttons, centered in the widget.
+void ElectrodeGridWidget::layoutContacts()
+{
+    contactRects.resize(numContacts);
+    if (numContacts == 0) return;
+
+    cellSize = qMin(width() / (double)columns, height() / (double)rows);
+    origin = QPointF((width() - cellSize * columns) / 2, (height() - cellSize * rows) / 2);
+
+    double diameter = cellSize * 0.8;
+    for (int i = 0; i < numContacts; i++)
+    {
+        double x = origin.x() + (i / rows) * cellSize + (cellSize - diameter) / 2;
+        double y = origin.y() + (i % rows) * cellSize + (cellSize - diameter) / 2;
+        contactRects[i] = QRectF(x, y, diameter, diameter);
+    }
+}
+
+void ElectrodeGridWidget::updateContact(int index)
+{
+    update(contactRects[index].toAlignedRect().adjusted(-2, -2, 2, 2));
+}
@@ -0,0 +1,107 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef ELECTRODEGRIDWIDGET_H
+#define ELECTRODEGRIDWIDGET_H
+
+#include <QWidget>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QMouseEvent>
+#include <QResizeEvent>
+#include <QContextMenuEvent>
+#include <QHelpEvent>
+#include <QToolTip>
+#include <QMenu>
+#include <QPixmap>
+#include <QColor>
+#include <QRectF>
+#include <QVector>
+#include <QStringList>
+
+#include <cmath>
+
+#include "contactselectionmodel.h"
+#include "contactqualityestimator.h"
+
+// Number of colors in the overlay heatmap
+#define ELECTRODE_OVERLAY_LEVELS 256
+
+// One painted widget for an ECoG grid or strip, replacing a styled QPushButton per contact.
+// Contacts are laid out down each column of "rows" contacts, as in the Arrange/layoutSize definition.
+// Clicks are hit-tested against the contact geometry, which is only recomputed on resize or layout change.
+// An optional per-contact overlay (live band power, line noise...) fills the contacts as a heatmap, the selection
+// is then drawn as a ring around the contact. Only contacts whose color changed are repainted.
+class ElectrodeGridWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ElectrodeGridWidget(QWidget *parent = nullptr);
+
+    void setElectrodeLayout(int rows, int numContacts, QStringList labels);
+    void setBackground(QString filename);
+    void setContactState(int index, int state);
+    void setContactQuality(int index, int state, QString toolTip);
+
+    void setOverlayNames(QStringList names);
+    void setOverlayValues(const QVector<float> &values, float minimum, float maximum);
+    void clearOverlay();
+    QString overlayName() const;
+
+    int contactAt(QPointF position) const;
+
+signals:
+    void contactClicked(int index);
+    void overlaySelected(QString name);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void contextMenuEvent(QContextMenuEvent *event) override;
+    bool event(QEvent *event) override;
+
+private:
+    void layoutContacts();
+    void updateContact(int index);
+
+    int rows = 1;
+    int columns = 1;
+    int numContacts = 0;
+    QStringList labels;
+
+    // Contact geometry, recomputed on resize
+    double cellSize = 0;
+    QPointF origin;
+    QVector<QRectF> contactRects;
+
+    QVector<int> contactStates;
+    QVector<int> contactQuality;
+    QStringList contactToolTips;
+
+    // Overlay colors as indexes into overlayColors, -1 for contacts without a value
+    QStringList overlayNames;
+    QString currentOverlay = "";
+    QVector<int> overlayLevels;
+    QVector<QColor> overlayColors;
+
+    QPixmap background;
+    QPixmap scaledBackground;
+};
+
+#endif // ELECTRODEGRIDWIDGET_H
@@ -0,0 +1,176 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#include "eventloopprofiler.h"
+
+EventLoopProfiler::EventLoopProfiler()
+{
+    running = 0;
+    scopeDepth = 0;
+    lastHeartbeat = 0;
+}
+
+EventLoopProfiler *EventLoopProfiler::instance()
+{
+    static EventLoopProfiler profiler;
+    return &profiler;
+}
+
+qint64 EventLoopProfiler::nanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Must be called from the GUI thread; that thread becomes the one being profiled.
+void EventLoopProfiler::startProfiler(int stallThreshold, int heartbeatInterval)
+{
+    if (this->isRunning()) return;
+
+    this->stallThreshold = qMax(1, stallThreshold);
+    this->heartbeatInterval = qMax(1, heartbeatInterval);
+    guiThreadId = QThread::currentThreadId();
+    lastHeartbeat.storeRelease(nanoseconds());
+
+    if (heartbeatTimer == nullptr)
+    {
+        heartbeatTimer = new QTimer();
+        heartbeatTimer->setTimerType(Qt::PreciseTimer);
+        connect(heartbeatTimer, &QTimer::timeout, heartbeatTimer, [this]() { heartbeat(); });
+    }
+    heartbeatTimer->start(this->heartbeatInterval);
+
+    running = 1;
+    this->start(QThread::HighPriority);
+}
+
+void EventLoopProfiler::stopProfiler()
+{
+    running = 0;
+    if (this->isRunning()) this->wait();
+    if (heartbeatTimer != nullptr) heartbeatTimer->stop();
+}
+
+// GUI thread. A late heartbeat closes out the stall the watchdog has been sampling.
+void EventLoopProfiler::heartbeat()
+{
+    qint64 now = nanoseconds();
+    qint64 interval = now - lastHeartbeat.loadAcquire();
+    lastHeartbeat.storeRelease(now);
+
+    qint64 lateness = qMax((qint64)0, interval - (qint64)heartbeatInterval * 1000000);
+    heartbeatLatency.record(lateness);
+    if (lateness < (qint64)stallThreshold * 1000000) return;
+
+    stallDuration.record(lateness);
+
+    QMutexLocker locker(&traceMutex);
+    if (stalls.size() < maxStalls)
+    {
+        QJsonObject stallObject;
+        QDateTime currentTime;
+        stallObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss.zzz"));
+        stallObject["DurationMilliseconds"] = QJsonValue(lateness / 1e6);
+        stallObject["Stack"] = QJsonValue(stallStack.isEmpty() ? QString("GUI;[unattributed]") : stallStack);
+        stalls.append(stallObject);
+    }
+    stallStack = "";
+}
+
+QString EventLoopProfiler::currentStack()
+{
+    int depth = qMin(scopeDepth.loadAcquire(), PROFILER_MAX_DEPTH);
+    QString stack = "GUI";
+    if (depth <= 0) return stack + ";[unattributed]";
+    for (int i = 0; i < depth; i++)
+    {
+        const char *name = scopeStack[i].loadAcquire();
+        stack += ";";
+        stack += (name != nullptr ? name : "?");
+    }
+    return stack;
+}
+
+// Watchdog. While the heartbeat is overdue, the GUI thread's scope stack is sampled every millisecond.
+void EventLoopProfiler::run()
+{
+    qint64 lastSample = 0;
+    bool inStall = false;
+    while (running.loadAcquire())
+    {
+        QThread::msleep(1);
+
+        qint64 now = nanoseconds();
+        qint64 silence = now - lastHeartbeat.loadAcquire();
+        if (silence < (qint64)(stallThreshold + heartbeatInterval) * 1000000)
+        {
+            inStall = false;
+            continue;
+        }
+
+        QString stack = currentStack();
+        QMutexLocker locker(&traceMutex);
+        if (!inStall)
+        {
+            // The time before the stall was detected is charged to the first sample
+            inStall = true;
+            stallStack = stack;
+            foldedStacks[stack] += silence / 1000;
+        }
+        else
+        {
+            foldedStacks[stack] += (now - lastSample) / 1000;
+        }
+        lastSample = now;
+    }
+}
+
+// Folded-stack trace, one "frame;frame;frame microseconds" line per distinct stack.
+bool EventLoopProfiler::writeTrace(QString filename)
+{
+    QFile file(filename);
+    if (!file.open(QFile::WriteOnly | QFile::Text | QFile::Truncate)) return false;
+
+    QMutexLocker locker(&traceMutex);
+    QTextStream stream(&file);
+    for (QHash<QString, qint64>::const_iterator it = foldedStacks.constBegin(); it != foldedStacks.constEnd(); ++it)
+    {
+        stream << it.key() << " " << it.value() << "\n";
+    }
+    file.close();
+    return true;
+}
+
+QJsonObject EventLoopProfiler::report()
+{
+    QJsonObject reportObject;
+    reportObject["StallThresholdMilliseconds"] = QJsonValue(stallThreshold);
+    reportObject["HeartbeatIntervalMilliseconds"] = QJsonValue(heartbeatInterval);
+    reportObject["EventLoopLatency"] = heartbeatLatency.toJson();
+    reportObject["StallDuration"] = stallDuration.toJson();
+
+    QMutexLocker locker(&traceMutex);
+    reportObject["Stalls"] = stalls;
+
+    // Stall time per outermost profiled scope, the quickest way to see which slot to fix first
+    QJsonObject scopeTotals;
+    for (QHash<QString, qint64>::const_iterator it = foldedStacks.constBegin(); it != foldedStacks.constEnd(); ++it)
+    {
+        QString scope = it.key().section(';', 1, 1);
+        scopeTotals[scope] = QJsonValue(scopeTotals[scope].toDouble() + it.value() / 1000.0);
+    }
+    reportObject["StallMillisecondsByScope"] = scopeTotals;
+    return reportObject;
+}
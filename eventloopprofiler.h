@@ -0,0 +1,118 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#ifndef EVENTLOOPPROFILER_H
+#define EVENTLOOPPROFILER_H
+
+#include <QThread>
+#include <QTimer>
+#include <QMutex>
+#include <QHash>
+#include <QList>
+#include <QFile>
+#include <QTextStream>
+#include <QDateTime>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include <chrono>
+
+#include "latencyhistogram.h"
+
+#define PROFILER_MAX_DEPTH 32
+
+// GUI-thread responsiveness profiler. A heartbeat timer on the GUI thread measures event-loop latency; a
+// watchdog thread notices when the heartbeat stops for longer than the stall threshold and samples the
+// PROFILE_SCOPE stack of the GUI thread every millisecond until it resumes. Samples are kept as folded
+// stacks ("GUI;Slot;SDKFunction microseconds"), the input format of flamegraph.pl and speedscope.
+class EventLoopProfiler : public QThread
+{
+    Q_OBJECT
+
+public:
+    static EventLoopProfiler *instance();
+
+    void startProfiler(int stallThreshold = 100, int heartbeatInterval = 10);
+    void stopProfiler();
+    bool writeTrace(QString filename);
+    QJsonObject report();
+
+    bool isGuiThread() const { return guiThreadId != nullptr && QThread::currentThreadId() == guiThreadId; }
+    void pushScope(const char *name)
+    {
+        int depth = scopeDepth.loadRelaxed();
+        if (depth < PROFILER_MAX_DEPTH) scopeStack[depth].storeRelease(name);
+        scopeDepth.storeRelease(depth + 1);
+    }
+    void popScope()
+    {
+        scopeDepth.storeRelease(scopeDepth.loadRelaxed() - 1);
+    }
+
+protected:
+    void run() override;
+
+private:
+    EventLoopProfiler();
+    void heartbeat();
+    QString currentStack();
+    static qint64 nanoseconds();
+
+    QTimer *heartbeatTimer = nullptr;
+    Qt::HANDLE guiThreadId = nullptr;
+    QAtomicInteger<qint64> lastHeartbeat;
+    QAtomicInt running;
+    int stallThreshold = 100;
+    int heartbeatInterval = 10;
+
+    QAtomicPointer<const char> scopeStack[PROFILER_MAX_DEPTH];
+    QAtomicInt scopeDepth;
+
+    LatencyHistogram heartbeatLatency;
+    LatencyHistogram stallDuration;
+
+    // Guarded by traceMutex: written by the watchdog, read and closed out by the heartbeat
+    QMutex traceMutex;
+    QHash<QString, qint64> foldedStacks;
+    QString stallStack = "";
+    QJsonArray stalls;
+    int maxStalls = 500;
+};
+
+// Marks the enclosing scope on the GUI thread so stalls are attributed to it. Costs two atomic stores;
+// does nothing on other threads or while the profiler is stopped.
+class ProfilerScope
+{
+public:
+    explicit ProfilerScope(const char *name)
+    {
+        active = EventLoopProfiler::instance()->isGuiThread();
+        if (active) EventLoopProfiler::instance()->pushScope(name);
+    }
+    ~ProfilerScope()
+    {
+        if (active) EventLoopProfiler::instance()->popScope();
+    }
+
+private:
+    bool active = false;
+};
+
+#define PROFILE_SCOPE(name) ProfilerScope profilerScope(name)
+
+#endif // EVENTLOOPPROFILER_H
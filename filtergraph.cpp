@@ -0,0 +1,850 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "filtergraph.h"
+
+static QVector<double> readFrequencies(QJsonValue value)
+{
+    QVector<double> frequencies;
+    if (value.isArray())
+    {
+        QJsonArray frequencyArray = value.toArray();
+        for (int i = 0; i < frequencyArray.size(); i++) frequencies.append(frequencyArray[i].toDouble());
+    }
+    else if (value.isDouble())
+    {
+        frequencies.append(value.toDouble());
+    }
+    return frequencies;
+}
+
+////////////////////////////////////
+////////// Base FilterNode /////////
+////////////////////////////////////
+FilterNode::FilterNode(QJsonObject definition)
+{
+    this->definition = definition;
+    this->name = definition["Name"].toString();
+    this->input = definition.value("Input").toString("Stream");
+}
+
+FilterNode::~FilterNode()
+{
+
+}
+
+FilterNode *FilterNode::create(QJsonObject definition)
+{
+    QString type = definition["Type"].toString();
+    if (type == "Biquad") return new BiquadFilterNode(definition);
+    if (type == "FIR") return new FIRFilterNode(definition);
+    if (type == "Decimate") return new DecimateNode(definition);
+    if (type == "Rereference") return new RereferenceNode(definition);
+    if (type == "Rectify") return new RectifyNode(definition);
+    if (type == "Envelope") return new EnvelopeNode(definition);
+    return nullptr;
+}
+
+// Timed wrapper around process(). Each node is only ever executed by one thread at a time.
+void FilterNode::execute(const SignalBlock &input)
+{
+    QElapsedTimer executionTimer;
+    executionTimer.start();
+    process(input);
+    qint64 elapsed = executionTimer.nsecsElapsed();
+    outputBlock.hostTimestamp = input.hostTimestamp;
+
+    timing.calls++;
+    timing.totalNanoseconds += elapsed;
+    timing.samplesProcessed += input.numSamples;
+    if (elapsed > timing.maxNanoseconds) timing.maxNanoseconds = elapsed;
+}
+
+const SignalBlock &FilterNode::output() const
+{
+    return outputBlock;
+}
+
+void FilterNode::allocateOutput(int numChannels, int maxSamples, double samplingRate, QVector<int> channelIDs)
+{
+    maxOutputSamples = maxSamples;
+    outputBuffer.fill(0, numChannels * maxSamples);
+
+    outputBlock.data = outputBuffer.data();
+    outputBlock.numChannels = numChannels;
+    outputBlock.numSamples = 0;
+    outputBlock.stride = maxSamples;
+    outputBlock.samplingRate = samplingRate;
+    outputBlock.firstSample = 0;
+    outputBlock.channelIDs = channelIDs;
+}
+
+float *FilterNode::outputChannel(int index)
+{
+    return outputBuffer.data() + (qsizetype)index * outputBlock.stride;
+}
+
+////////////////////////////////////
+///////// IIR Biquad Cascade ///////
+////////////////////////////////////
+BiquadFilterNode::BiquadFilterNode(QJsonObject definition) :
+    FilterNode(definition)
+{
+
+}
+
+// Butterworth lowpass/highpass (Q per section from pole angles), RBJ bandpass and notch sections.
+QVector<BiquadCoefficients> BiquadFilterNode::design(QString design, QVector<double> frequency, int order, double q, double samplingRate)
+{
+    QVector<BiquadCoefficients> sections;
+    if (frequency.isEmpty() || samplingRate <= 0) return sections;
+
+    int numSections = qMax(1, order / 2);
+    double f0 = frequency[0];
+    if (design == "Bandpass")
+    {
+        if (frequency.size() < 2 || frequency[1] <= frequency[0]) return sections;
+        f0 = sqrt(frequency[0] * frequency[1]);
+        if (q <= 0) q = f0 / (frequency[1] - frequency[0]);
+    }
+    else if (design == "Notch")
+    {
+        if (q <= 0) q = 30;
+    }
+    if (f0 <= 0 || f0 >= samplingRate / 2) return sections;
+
+    double w0 = 2 * M_PI * f0 / samplingRate;
+    double cosw0 = cos(w0);
+
+    for (int k = 0; k < numSections; k++)
+    {
+        double sectionQ = q;
+        if (design == "Lowpass" || design == "Highpass") sectionQ = 1.0 / (2 * cos(M_PI * (2 * k + 1) / (4.0 * numSections)));
+        double alpha = sin(w0) / (2 * sectionQ);
+
+        double b0, b1, b2;
+        if (design == "Lowpass")
+        {
+            b0 = (1 - cosw0) / 2;
+            b1 = 1 - cosw0;
+            b2 = (1 - cosw0) / 2;
+        }
+        else if (design == "Highpass")
+        {
+            b0 = (1 + cosw0) / 2;
+            b1 = -(1 + cosw0);
+            b2 = (1 + cosw0) / 2;
+        }
+        else if (design == "Bandpass")
+        {
+            b0 = alpha;
+            b1 = 0;
+            b2 = -alpha;
+        }
+        else if (design == "Notch")
+        {
+            b0 = 1;
+            b1 = -2 * cosw0;
+            b2 = 1;
+        }
+        else
+        {
+            return QVector<BiquadCoefficients>();
+        }
+
+        double a0 = 1 + alpha;
+        BiquadCoefficients section;
+        section.b0 = b0 / a0;
+        section.b1 = b1 / a0;
+        section.b2 = b2 / a0;
+        section.a1 = (-2 * cosw0) / a0;
+        section.a2 = (1 - alpha) / a0;
+        sections.append(section);
+    }
+    return sections;
+}
+
+bool BiquadFilterNode::prepare(const SignalBlock &inputFormat, int maxInputSamples)
+{
+    sections.clear();
+    if (definition.contains("Sections"))
+    {
+        QJsonArray sectionArray = definition["Sections"].toArray();
+        for (int i = 0; i < sectionArray.size(); i++)
+        {
+            QJsonArray coefficients = sectionArray[i].toArray();
+            if (coefficients.size() != 5) return false;
+
+            BiquadCoefficients section;
+            section.b0 = coefficients[0].toDouble();
+            section.b1 = coefficients[1].toDouble();
+            section.b2 = coefficients[2].toDouble();
+            section.a1 = coefficients[3].toDouble();
+            section.a2 = coefficients[4].toDouble();
+            sections.append(section);
+        }
+    }
+    else
+    {
+        sections = design(definition["Design"].toString(), readFrequencies(definition["Frequency"]),
+                          definition.value("Order").toInt(2), definition.value("Q").toDouble(0), inputFormat.samplingRate);
+    }
+    if (sections.isEmpty()) return false;
+
+    state.fill(0, inputFormat.numChannels * sections.size() * 2);
+    allocateOutput(inputFormat.numChannels, maxInputSamples, inputFormat.samplingRate, inputFormat.channelIDs);
+    return true;
+}
+
+void BiquadFilterNode::process(const SignalBlock &input)
+{
+    int numSections = sections.size();
+    for (int i = 0; i < input.numChannels; i++)
+    {
+        filter(sections, state.data() + i * numSections * 2, input.channel(i), outputChannel(i), input.numSamples);
+    }
+    outputBlock.numSamples = input.numSamples;
+    outputBlock.firstSample = input.firstSample;
+}
+
+// Run one channel through the cascade. state holds 2 floats per section, x and y may alias.
+void BiquadFilterNode::filter(const QVector<BiquadCoefficients> &sections, float *state, const float *x, float *y, int numSamples)
+{
+    // First section reads the input, the rest filter the output buffer in place.
+    for (int s = 0; s < sections.size(); s++)
+    {
+        const BiquadCoefficients &c = sections[s];
+        const float *source = (s == 0) ? x : y;
+        float z1 = state[s * 2];
+        float z2 = state[s * 2 + 1];
+        for (int n = 0; n < numSamples; n++)
+        {
+            float value = source[n];
+            float result = c.b0 * value + z1;
+            z1 = c.b1 * value - c.a1 * result + z2;
+            z2 = c.b2 * value - c.a2 * result;
+            y[n] = result;
+        }
+        state[s * 2] = z1;
+        state[s * 2 + 1] = z2;
+    }
+}
+
+////////////////////////////////////
+/////////// FIR Filter /////////////
+////////////////////////////////////
+FIRFilterNode::FIRFilterNode(QJsonObject definition) :
+    FilterNode(definition)
+{
+
+}
+
+// Hamming-windowed sinc. Highpass/Bandstop by spectral inversion, so numTaps is forced odd.
+QVector<float> FIRFilterNode::design(QString design, QVector<double> cutoff, int numTaps, double samplingRate)
+{
+    QVector<float> taps;
+    if (cutoff.isEmpty() || numTaps < 3 || samplingRate <= 0) return taps;
+    if (numTaps % 2 == 0) numTaps++;
+
+    auto lowpass = [numTaps, samplingRate](double frequency) {
+        QVector<double> h(numTaps);
+        double fc = frequency / samplingRate;
+        double sum = 0;
+        int M = numTaps - 1;
+        for (int n = 0; n < numTaps; n++)
+        {
+            double m = n - M / 2.0;
+            double sinc = (m == 0) ? 2 * fc : sin(2 * M_PI * fc * m) / (M_PI * m);
+            double window = 0.54 - 0.46 * cos(2 * M_PI * n / M);
+            h[n] = sinc * window;
+            sum += h[n];
+        }
+        for (int n = 0; n < numTaps; n++) h[n] /= sum;
+        return h;
+    };
+
+    QVector<double> h;
+    if (design == "Lowpass")
+    {
+        h = lowpass(cutoff[0]);
+    }
+    else if (design == "Highpass")
+    {
+        h = lowpass(cutoff[0]);
+        for (int n = 0; n < numTaps; n++) h[n] = -h[n];
+        h[numTaps / 2] += 1;
+    }
+    else if (design == "Bandpass" && cutoff.size() >= 2)
+    {
+        QVector<double> low = lowpass(cutoff[0]);
+        h = lowpass(cutoff[1]);
+        for (int n = 0; n < numTaps; n++) h[n] -= low[n];
+    }
+    else
+    {
+        return taps;
+    }
+
+    taps.resize(numTaps);
+    for (int n = 0; n < numTaps; n++) taps[n] = h[n];
+    return taps;
+}
+
+bool FIRFilterNode::prepare(const SignalBlock &inputFormat, int maxInputSamples)
+{
+    taps.clear();
+    if (definition.contains("Taps"))
+    {
+        QJsonArray tapArray = definition["Taps"].toArray();
+        for (int i = 0; i < tapArray.size(); i++) taps.append(tapArray[i].toDouble());
+    }
+    else
+    {
+        taps = design(definition["Design"].toString(), readFrequencies(definition["Cutoff"]),
+                      definition.value("NumTaps").toInt(101), inputFormat.samplingRate);
+    }
+    if (taps.isEmpty()) return false;
+
+    history.fill(0, inputFormat.numChannels * (taps.size() - 1));
+    workBuffer.fill(0, taps.size() - 1 + maxInputSamples);
+    allocateOutput(inputFormat.numChannels, maxInputSamples, inputFormat.samplingRate, inputFormat.channelIDs);
+    return true;
+}
+
+void FIRFilterNode::process(const SignalBlock &input)
+{
+    int numTaps = taps.size();
+    int historySize = numTaps - 1;
+    const float *h = taps.constData();
+
+    for (int i = 0; i < input.numChannels; i++)
+    {
+        float *channelHistory = history.data() + i * historySize;
+        float *work = workBuffer.data();
+        memcpy(work, channelHistory, sizeof(float) * historySize);
+        memcpy(work + historySize, input.channel(i), sizeof(float) * input.numSamples);
+
+        float *y = outputChannel(i);
+        for (int n = 0; n < input.numSamples; n++)
+        {
+            const float *window = work + n;
+            float sum = 0;
+            for (int k = 0; k < numTaps; k++) sum += h[k] * window[historySize - k];
+            y[n] = sum;
+        }
+
+        memcpy(channelHistory, work + input.numSamples, sizeof(float) * historySize);
+    }
+    outputBlock.numSamples = input.numSamples;
+    outputBlock.firstSample = input.firstSample;
+}
+
+////////////////////////////////////
+//////////// Decimation ////////////
+////////////////////////////////////
+DecimateNode::DecimateNode(QJsonObject definition) :
+    FilterNode(definition)
+{
+    factor = qMax(1, definition.value("Factor").toInt(1));
+}
+
+bool DecimateNode::prepare(const SignalBlock &inputFormat, int maxInputSamples)
+{
+    double outputRate = inputFormat.samplingRate / factor;
+    int numTaps = definition.value("NumTaps").toInt(8 * factor + 1);
+    taps = FIRFilterNode::design("Lowpass", QVector<double>() << 0.4 * outputRate, numTaps, inputFormat.samplingRate);
+    if (taps.isEmpty()) return false;
+
+    phase = 0;
+    outputCounter = 0;
+    history.fill(0, inputFormat.numChannels * (taps.size() - 1));
+    workBuffer.fill(0, taps.size() - 1 + maxInputSamples);
+    allocateOutput(inputFormat.numChannels, maxInputSamples / factor + 1, outputRate, inputFormat.channelIDs);
+    return true;
+}
+
+// Polyphase-equivalent: the anti-aliasing filter is only evaluated at every factor-th input sample.
+void DecimateNode::process(const SignalBlock &input)
+{
+    int numTaps = taps.size();
+    int historySize = numTaps - 1;
+    const float *h = taps.constData();
+
+    int numOutput = 0;
+    for (int i = 0; i < input.numChannels; i++)
+    {
+        float *channelHistory = history.data() + i * historySize;
+        float *work = workBuffer.data();
+        memcpy(work, channelHistory, sizeof(float) * historySize);
+        memcpy(work + historySize, input.channel(i), sizeof(float) * input.numSamples);
+
+        float *y = outputChannel(i);
+        numOutput = 0;
+        for (int n = phase; n < input.numSamples; n += factor)
+        {
+            const float *window = work + n;
+            float sum = 0;
+            for (int k = 0; k < numTaps; k++) sum += h[k] * window[historySize - k];
+            y[numOutput++] = sum;
+        }
+
+        memcpy(channelHistory, work + input.numSamples, sizeof(float) * historySize);
+    }
+
+    // Carry the decimation phase into the next block.
+    int consumed = input.numSamples - phase;
+    if (consumed > 0) phase = (factor - consumed % factor) % factor;
+    else phase = -consumed;
+
+    outputBlock.numSamples = numOutput;
+    outputBlock.firstSample = outputCounter;
+    outputCounter += numOutput;
+}
+
+////////////////////////////////////
+/////////// Rereference ////////////
+////////////////////////////////////
+RereferenceNode::RereferenceNode(QJsonObject definition) :
+    FilterNode(definition)
+{
+
+}
+
+void RereferenceNode::setElectrodes(QList<ElectrodeInformation> electrodes)
+{
+    this->electrodes = electrodes;
+}
+
+const RereferenceMontage &RereferenceNode::montage() const
+{
+    return rereferenceMontage;
+}
+
+bool RereferenceNode::prepare(const SignalBlock &inputFormat, int maxInputSamples)
+{
+    QString montageType = definition.value("Montage").toString("CommonAverage");
+    QString leadFilter = definition.value("Leads").toString("ECoG");
+    if (!rereferenceMontage.build(montageType, inputFormat.channelIDs, electrodes, leadFilter)) return false;
+
+    allocateOutput(rereferenceMontage.numOutputs(), maxInputSamples, inputFormat.samplingRate, rereferenceMontage.channelIDs());
+    return true;
+}
+
+void RereferenceNode::process(const SignalBlock &input)
+{
+    rereferenceMontage.apply(input, outputBuffer.data(), outputBlock.stride);
+    outputBlock.numSamples = input.numSamples;
+    outputBlock.firstSample = input.firstSample;
+}
+
+////////////////////////////////////
+////// Rectify and Envelope ////////
+////////////////////////////////////
+RectifyNode::RectifyNode(QJsonObject definition) :
+    FilterNode(definition)
+{
+    square = definition["Method"].toString() == "Square";
+}
+
+bool RectifyNode::prepare(const SignalBlock &inputFormat, int maxInputSamples)
+{
+    allocateOutput(inputFormat.numChannels, maxInputSamples, inputFormat.samplingRate, inputFormat.channelIDs);
+    return true;
+}
+
+void RectifyNode::process(const SignalBlock &input)
+{
+    for (int i = 0; i < input.numChannels; i++)
+    {
+        const float *x = input.channel(i);
+        float *y = outputChannel(i);
+        if (square) for (int n = 0; n < input.numSamples; n++) y[n] = x[n] * x[n];
+        else for (int n = 0; n < input.numSamples; n++) y[n] = fabsf(x[n]);
+    }
+    outputBlock.numSamples = input.numSamples;
+    outputBlock.firstSample = input.firstSample;
+}
+
+EnvelopeNode::EnvelopeNode(QJsonObject definition) :
+    FilterNode(definition)
+{
+    rms = definition.value("Method").toString("RMS") == "RMS";
+}
+
+bool EnvelopeNode::prepare(const SignalBlock &inputFormat, int maxInputSamples)
+{
+    double cutoff = definition.value("Cutoff").toDouble(5);
+    if (cutoff <= 0 || inputFormat.samplingRate <= 0) return false;
+
+    alpha = 1 - exp(-2 * M_PI * cutoff / inputFormat.samplingRate);
+    state.fill(0, inputFormat.numChannels);
+    allocateOutput(inputFormat.numChannels, maxInputSamples, inputFormat.samplingRate, inputFormat.channelIDs);
+    return true;
+}
+
+void EnvelopeNode::process(const SignalBlock &input)
+{
+    for (int i = 0; i < input.numChannels; i++)
+    {
+        const float *x = input.channel(i);
+        float *y = outputChannel(i);
+        float z = state[i];
+        if (rms)
+        {
+            for (int n = 0; n < input.numSamples; n++)
+            {
+                z += alpha * (x[n] * x[n] - z);
+                y[n] = sqrtf(z);
+            }
+        }
+        else
+        {
+            for (int n = 0; n < input.numSamples; n++)
+            {
+                z += alpha * (fabsf(x[n]) - z);
+                y[n] = z;
+            }
+        }
+        state[i] = z;
+    }
+    outputBlock.numSamples = input.numSamples;
+    outputBlock.firstSample = input.firstSample;
+}
+
+////////////////////////////////////
+/////////// Filter Graph ///////////
+////////////////////////////////////
+FilterGraph::FilterGraph()
+{
+    parameters["LineFrequency"] = 60;
+}
+
+// Site parameters referenced by name from node definitions. Must be set before loading the graph.
+void FilterGraph::setParameter(QString name, double value)
+{
+    parameters[name] = value;
+}
+
+bool FilterGraph::resolveParameters(QJsonObject &nodeDefinition)
+{
+    QStringList keys = nodeDefinition.keys();
+    for (int i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] != "Frequency" && keys[i] != "Cutoff") continue;
+        if (!nodeDefinition[keys[i]].isString()) continue;
+
+        QString parameterName = nodeDefinition[keys[i]].toString();
+        if (!parameters.contains(parameterName))
+        {
+            lastError = "Unknown parameter " + parameterName + " in node " + nodeDefinition["Name"].toString();
+            return false;
+        }
+        nodeDefinition[keys[i]] = parameters[parameterName];
+    }
+    return true;
+}
+
+FilterGraph::~FilterGraph()
+{
+    threadPool.waitForDone();
+    clearNodes();
+}
+
+void FilterGraph::clearNodes()
+{
+    for (int i = 0; i < nodes.size(); i++) delete(nodes[i]);
+    nodes.clear();
+    levels.clear();
+    nodeMap.clear();
+    sinks.clear();
+    prepared = false;
+}
+
+// Load a graph by name from the FilterGraphs array of a JSON file (normally FilterGraphs.json next to InterfaceConfigurations.json).
+bool FilterGraph::loadConfiguration(QString filename, QString graphName)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        lastError = "Cannot open " + filename;
+        return false;
+    }
+
+    QJsonDocument loadedDocument = QJsonDocument::fromJson(file.readAll());
+    if (!loadedDocument.isObject() || !loadedDocument.object().contains("FilterGraphs"))
+    {
+        lastError = "Bad Filter Graph Configuration";
+        return false;
+    }
+
+    QJsonArray graphDefinitions = loadedDocument.object()["FilterGraphs"].toArray();
+    for (int i = 0; i < graphDefinitions.size(); i++)
+    {
+        if (graphDefinitions[i].toObject()["GraphName"].toString() == graphName) return loadDefinition(graphDefinitions[i].toObject());
+    }
+
+    lastError = "Filter Graph " + graphName + " not defined";
+    return false;
+}
+
+bool FilterGraph::loadDefinition(QJsonObject graphDefinition)
+{
+    QMutexLocker locker(&graphMutex);
+    clearNodes();
+
+    graphName = graphDefinition["GraphName"].toString();
+    int threadCount = graphDefinition.value("Threads").toInt(qMax(1, QThread::idealThreadCount() - 1));
+    threadPool.setMaxThreadCount(qMax(1, threadCount));
+
+    QJsonArray nodeDefinitions = graphDefinition["Nodes"].toArray();
+    for (int i = 0; i < nodeDefinitions.size(); i++)
+    {
+        QJsonObject nodeDefinition = nodeDefinitions[i].toObject();
+        if (!resolveParameters(nodeDefinition))
+        {
+            clearNodes();
+            return false;
+        }
+
+        FilterNode *node = FilterNode::create(nodeDefinition);
+        if (node == nullptr)
+        {
+            lastError = "Unknown node type " + nodeDefinitions[i].toObject()["Type"].toString();
+            clearNodes();
+            return false;
+        }
+        if (node->name.isEmpty() || node->name == "Stream" || nodeMap.contains(node->name))
+        {
+            lastError = "Duplicated or empty node name " + node->name;
+            delete(node);
+            clearNodes();
+            return false;
+        }
+        nodes.append(node);
+        nodeMap[node->name] = node;
+    }
+
+    // Assign levels. Nodes may be declared in any order, so iterate until every input is resolved.
+    QHash<QString, int> resolvedLevel;
+    resolvedLevel["Stream"] = 0;
+    int resolved = 0;
+    bool progress = true;
+    while (resolved < nodes.size() && progress)
+    {
+        progress = false;
+        for (int i = 0; i < nodes.size(); i++)
+        {
+            if (resolvedLevel.contains(nodes[i]->name) || !resolvedLevel.contains(nodes[i]->input)) continue;
+            nodes[i]->level = resolvedLevel[nodes[i]->input] + 1;
+            resolvedLevel[nodes[i]->name] = nodes[i]->level;
+            resolved++;
+            progress = true;
+        }
+    }
+    if (resolved < nodes.size())
+    {
+        lastError = "Filter Graph " + graphName + " has unknown inputs or cycles";
+        clearNodes();
+        return false;
+    }
+
+    for (int i = 0; i < nodes.size(); i++)
+    {
+        while (levels.size() < nodes[i]->level) levels.append(QList<FilterNode*>());
+        levels[nodes[i]->level - 1].append(nodes[i]);
+    }
+    return true;
+}
+
+bool FilterGraph::prepare(int numChannels, int maxSamples, double samplingRate, QVector<int> channelIDs)
+{
+    QMutexLocker locker(&graphMutex);
+    return prepareNodes(numChannels, maxSamples, samplingRate, channelIDs);
+}
+
+// Electrode definitions are needed by Rereference nodes to derive grid neighbours. Takes effect at the next prepare.
+void FilterGraph::setElectrodeLayouts(QList<ElectrodeInformation> electrodes)
+{
+    QMutexLocker locker(&graphMutex);
+    electrodeLayouts = electrodes;
+    prepared = false;
+}
+
+bool FilterGraph::prepareNodes(int numChannels, int maxSamples, double samplingRate, QVector<int> channelIDs)
+{
+    prepared = false;
+
+    SignalBlock streamFormat;
+    streamFormat.numChannels = numChannels;
+    streamFormat.stride = maxSamples;
+    streamFormat.samplingRate = samplingRate;
+    streamFormat.channelIDs = channelIDs;
+
+    for (int i = 0; i < levels.size(); i++)
+    {
+        for (int j = 0; j < levels[i].size(); j++)
+        {
+            FilterNode *node = levels[i][j];
+            RereferenceNode *rereferenceNode = dynamic_cast<RereferenceNode*>(node);
+            if (rereferenceNode != nullptr) rereferenceNode->setElectrodes(electrodeLayouts);
+
+            bool success;
+            if (node->input == "Stream") success = node->prepare(streamFormat, maxSamples);
+            else success = node->prepare(nodeMap[node->input]->output(), nodeMap[node->input]->maxOutputSamples);
+
+            if (!success)
+            {
+                lastError = "Cannot prepare node " + node->name;
+                return false;
+            }
+        }
+    }
+
+    preparedChannels = numChannels;
+    preparedSamples = maxSamples;
+    preparedRate = samplingRate;
+    prepared = true;
+    return true;
+}
+
+const SignalBlock *FilterGraph::inputOf(FilterNode *node, const SignalBlock &stream)
+{
+    if (node->input == "Stream") return &stream;
+    return &nodeMap[node->input]->output();
+}
+
+void FilterGraph::processBlock(const SignalBlock &block)
+{
+    QMutexLocker locker(&graphMutex);
+    if (nodes.isEmpty() || block.numSamples <= 0) return;
+
+    if (!prepared || block.numChannels != preparedChannels || block.numSamples > preparedSamples || block.samplingRate != preparedRate)
+    {
+        if (!prepareNodes(block.numChannels, qMax(block.numSamples, preparedSamples), block.samplingRate, block.channelIDs)) return;
+    }
+
+    for (int i = 0; i < levels.size(); i++)
+    {
+        const QList<FilterNode*> &levelNodes = levels[i];
+        for (int j = 1; j < levelNodes.size(); j++)
+        {
+            FilterNode *node = levelNodes[j];
+            const SignalBlock *input = inputOf(node, block);
+            threadPool.start([node, input]() { node->execute(*input); });
+        }
+
+        // The calling (acquisition) thread takes the first node of each level itself.
+        levelNodes[0]->execute(*inputOf(levelNodes[0], block));
+        if (levelNodes.size() > 1) threadPool.waitForDone();
+    }
+
+    for (int i = 0; i < sinks.size(); i++)
+    {
+        const SignalBlock &output = (sinks[i].nodeName == "Stream") ? block : nodeMap[sinks[i].nodeName]->output();
+        if (output.numSamples == 0 || output.numChannels == 0) continue;
+        sinks[i].function(output);
+    }
+}
+
+// Sinks receive a node's output on the acquisition thread right after the graph finishes a block.
+// Returns a sink ID for removeSink(), or 0 if the node does not exist.
+int FilterGraph::addSink(QString nodeName, FilterGraphSink sink)
+{
+    QMutexLocker locker(&graphMutex);
+    if (nodeName != "Stream" && !nodeMap.contains(nodeName))
+    {
+        lastError = "Filter Graph has no node named " + nodeName;
+        return 0;
+    }
+
+    FilterGraphSinkEntry entry;
+    entry.sinkID = nextSinkID++;
+    entry.nodeName = nodeName;
+    entry.function = sink;
+    sinks.append(entry);
+    return entry.sinkID;
+}
+
+// Blocks until any block in flight has finished, so the sink's owner can be destroyed afterwards.
+void FilterGraph::removeSink(int sinkID)
+{
+    QMutexLocker locker(&graphMutex);
+    for (int i = 0; i < sinks.size(); i++)
+    {
+        if (sinks[i].sinkID == sinkID)
+        {
+            sinks.removeAt(i);
+            return;
+        }
+    }
+}
+
+void FilterGraph::clearSinks()
+{
+    QMutexLocker locker(&graphMutex);
+    sinks.clear();
+}
+
+FilterNode *FilterGraph::node(QString nodeName)
+{
+    return nodeMap.value(nodeName, nullptr);
+}
+
+QStringList FilterGraph::nodeNames() const
+{
+    QStringList names;
+    for (int i = 0; i < nodes.size(); i++) names.append(nodes[i]->name);
+    return names;
+}
+
+// RealtimeLoad is processing time divided by the duration of data processed, i.e. the fraction of one core the node uses.
+QJsonArray FilterGraph::timingReport()
+{
+    QMutexLocker locker(&graphMutex);
+
+    QJsonArray report;
+    for (int i = 0; i < nodes.size(); i++)
+    {
+        NodeTiming timing = nodes[i]->timing;
+        double inputRate = (nodes[i]->input == "Stream") ? preparedRate : nodeMap[nodes[i]->input]->output().samplingRate;
+
+        QJsonObject nodeObject;
+        nodeObject["Node"] = QJsonValue(nodes[i]->name);
+        nodeObject["Type"] = QJsonValue(nodes[i]->nodeType());
+        nodeObject["Level"] = QJsonValue(nodes[i]->level);
+        nodeObject["Calls"] = QJsonValue(timing.calls);
+        nodeObject["MeanMicroseconds"] = QJsonValue(timing.calls > 0 ? timing.totalNanoseconds / 1000.0 / timing.calls : 0);
+        nodeObject["MaxMicroseconds"] = QJsonValue(timing.maxNanoseconds / 1000.0);
+        if (timing.samplesProcessed > 0 && inputRate > 0)
+        {
+            nodeObject["RealtimeLoad"] = QJsonValue((timing.totalNanoseconds / 1e9) / (timing.samplesProcessed / inputRate));
+        }
+        report.append(nodeObject);
+    }
+    return report;
+}
+
+void FilterGraph::resetTiming()
+{
+    QMutexLocker locker(&graphMutex);
+    for (int i = 0; i < nodes.size(); i++) nodes[i]->timing = NodeTiming();
+}
+
+QString FilterGraph::errorMessage() const
+{
+    return lastError;
+}
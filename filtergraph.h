@@ -0,0 +1,248 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef FILTERGRAPH_H
+#define FILTERGRAPH_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QList>
+#include <QHash>
+#include <QMutex>
+#include <QFile>
+#include <QDir>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include <functional>
+#include <cmath>
+
+#include "streamdatahandler.h"
+#include "rereferencemontage.h"
+
+// Second-order section, normalized so that a0 = 1. Transposed Direct Form II is used for processing.
+typedef struct BiquadCoefficients
+{
+    float b0 = 1;
+    float b1 = 0;
+    float b2 = 0;
+    float a1 = 0;
+    float a2 = 0;
+} BiquadCoefficients;
+
+typedef struct NodeTiming
+{
+    qint64 calls = 0;
+    qint64 totalNanoseconds = 0;
+    qint64 maxNanoseconds = 0;
+    quint64 samplesProcessed = 0;
+} NodeTiming;
+
+// Base processing block. Every node owns its output buffer, downstream nodes read it in place.
+class FilterNode
+{
+public:
+    FilterNode(QJsonObject definition);
+    virtual ~FilterNode();
+
+    static FilterNode *create(QJsonObject definition);
+
+    virtual QString nodeType() const = 0;
+    virtual bool prepare(const SignalBlock &inputFormat, int maxInputSamples) = 0;
+    virtual void process(const SignalBlock &input) = 0;
+
+    void execute(const SignalBlock &input);
+    const SignalBlock &output() const;
+
+    QString name;
+    QString input;
+    int level = 0;
+    int maxOutputSamples = 0;
+    NodeTiming timing;
+
+protected:
+    void allocateOutput(int numChannels, int maxSamples, double samplingRate, QVector<int> channelIDs);
+    float *outputChannel(int index);
+
+    QJsonObject definition;
+    QVector<float> outputBuffer;
+    SignalBlock outputBlock;
+};
+
+// "Biquad": IIR cascade. Either explicit "Sections" [[b0,b1,b2,a1,a2], ...] or a "Design" of Lowpass/Highpass/Bandpass/Notch.
+class BiquadFilterNode : public FilterNode
+{
+public:
+    BiquadFilterNode(QJsonObject definition);
+    QString nodeType() const override { return "Biquad"; }
+    bool prepare(const SignalBlock &inputFormat, int maxInputSamples) override;
+    void process(const SignalBlock &input) override;
+
+    static QVector<BiquadCoefficients> design(QString design, QVector<double> frequency, int order, double q, double samplingRate);
+    static void filter(const QVector<BiquadCoefficients> &sections, float *state, const float *x, float *y, int numSamples);
+
+private:
+    QVector<BiquadCoefficients> sections;
+    QVector<float> state;
+};
+
+// "FIR": direct-form convolution with per-channel history. Explicit "Taps" or a windowed-sinc "Design".
+class FIRFilterNode : public FilterNode
+{
+public:
+    FIRFilterNode(QJsonObject definition);
+    QString nodeType() const override { return "FIR"; }
+    bool prepare(const SignalBlock &inputFormat, int maxInputSamples) override;
+    void process(const SignalBlock &input) override;
+
+    static QVector<float> design(QString design, QVector<double> cutoff, int numTaps, double samplingRate);
+
+private:
+    QVector<float> taps;
+    QVector<float> history;
+    QVector<float> workBuffer;
+};
+
+// "Decimate": anti-aliasing lowpass evaluated only at the kept samples.
+class DecimateNode : public FilterNode
+{
+public:
+    DecimateNode(QJsonObject definition);
+    QString nodeType() const override { return "Decimate"; }
+    bool prepare(const SignalBlock &inputFormat, int maxInputSamples) override;
+    void process(const SignalBlock &input) override;
+
+private:
+    int factor = 1;
+    int phase = 0;
+    quint64 outputCounter = 0;
+    QVector<float> taps;
+    QVector<float> history;
+    QVector<float> workBuffer;
+};
+
+// "Rereference": "Montage" of CommonAverage, Bipolar or Laplacian over the grids of leads matching "Leads" (default "ECoG").
+// Output channels follow RereferenceMontage::labels().
+class RereferenceNode : public FilterNode
+{
+public:
+    RereferenceNode(QJsonObject definition);
+    QString nodeType() const override { return "Rereference"; }
+    bool prepare(const SignalBlock &inputFormat, int maxInputSamples) override;
+    void process(const SignalBlock &input) override;
+
+    void setElectrodes(QList<ElectrodeInformation> electrodes);
+    const RereferenceMontage &montage() const;
+
+private:
+    QList<ElectrodeInformation> electrodes;
+    RereferenceMontage rereferenceMontage;
+};
+
+// "Rectify": full-wave rectification, or squaring with "Method": "Square".
+class RectifyNode : public FilterNode
+{
+public:
+    RectifyNode(QJsonObject definition);
+    QString nodeType() const override { return "Rectify"; }
+    bool prepare(const SignalBlock &inputFormat, int maxInputSamples) override;
+    void process(const SignalBlock &input) override;
+
+private:
+    bool square = false;
+};
+
+// "Envelope": one-pole smoothing of the rectified ("Rectify") or squared ("RMS") signal.
+class EnvelopeNode : public FilterNode
+{
+public:
+    EnvelopeNode(QJsonObject definition);
+    QString nodeType() const override { return "Envelope"; }
+    bool prepare(const SignalBlock &inputFormat, int maxInputSamples) override;
+    void process(const SignalBlock &input) override;
+
+private:
+    bool rms = true;
+    float alpha = 1;
+    QVector<float> state;
+};
+
+typedef std::function<void(const SignalBlock &block)> FilterGraphSink;
+
+typedef struct FilterGraphSinkEntry
+{
+    int sinkID = 0;
+    QString nodeName = "";
+    FilterGraphSink function;
+} FilterGraphSinkEntry;
+
+// Dataflow graph of FilterNodes declared in FilterGraphs.json. Nodes are grouped into levels by their
+// distance from the "Stream" input; nodes sharing a level run concurrently on the graph's thread pool.
+// A node value may name a site parameter instead of a number (e.g. "Frequency": "LineFrequency"); it is resolved on load.
+class FilterGraph : public StreamConsumer
+{
+public:
+    FilterGraph();
+    ~FilterGraph();
+
+    void setParameter(QString name, double value);
+    bool loadConfiguration(QString filename, QString graphName);
+    bool loadDefinition(QJsonObject graphDefinition);
+    bool prepare(int numChannels, int maxSamples, double samplingRate, QVector<int> channelIDs);
+    void setElectrodeLayouts(QList<ElectrodeInformation> electrodes);
+    void processBlock(const SignalBlock &block) override;
+
+    int addSink(QString nodeName, FilterGraphSink sink);
+    void removeSink(int sinkID);
+    void clearSinks();
+    FilterNode *node(QString nodeName);
+    QStringList nodeNames() const;
+
+    QJsonArray timingReport();
+    void resetTiming();
+    QString errorMessage() const;
+
+private:
+    void clearNodes();
+    bool resolveParameters(QJsonObject &nodeDefinition);
+    bool prepareNodes(int numChannels, int maxSamples, double samplingRate, QVector<int> channelIDs);
+    const SignalBlock *inputOf(FilterNode *node, const SignalBlock &stream);
+
+    QString graphName;
+    QHash<QString, double> parameters;
+    QList<FilterNode*> nodes;
+    QList<QList<FilterNode*>> levels;
+    QHash<QString, FilterNode*> nodeMap;
+    QList<FilterGraphSinkEntry> sinks;
+    int nextSinkID = 1;
+    QList<ElectrodeInformation> electrodeLayouts;
+
+    QThreadPool threadPool;
+    QMutex graphMutex;
+    QString lastError;
+
+    bool prepared = false;
+    int preparedChannels = 0;
+    int preparedSamples = 0;
+    double preparedRate = 0;
+};
+
+#endif // FILTERGRAPH_H
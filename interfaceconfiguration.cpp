@@ -0,0 +1,211 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "interfaceconfiguration.h"
+
+// Parented to the application so the watcher and settings are torn down with it.
+InterfaceConfiguration *InterfaceConfiguration::instance()
+{
+    static InterfaceConfiguration *interfaceConfiguration = new InterfaceConfiguration(QCoreApplication::instance());
+    return interfaceConfiguration;
+}
+
+InterfaceConfiguration::InterfaceConfiguration(QObject *parent) :
+    QObject(parent)
+{
+    applicationConfiguration = new QSettings(QDir::currentPath() + "/defaultSettings.ini", QSettings::IniFormat, this);
+
+    // Editors write in several steps, so changes are coalesced before re-parsing
+    reloadTimer = new QTimer(this);
+    reloadTimer->setSingleShot(true);
+    reloadTimer->setInterval(250);
+    connect(reloadTimer, &QTimer::timeout, this, &InterfaceConfiguration::reload);
+
+    fileWatcher = new QFileSystemWatcher(this);
+    connect(fileWatcher, &QFileSystemWatcher::fileChanged, this, &InterfaceConfiguration::configurationFileChanged);
+
+    load(QDir::currentPath() + "/InterfaceConfigurations.json");
+}
+
+bool InterfaceConfiguration::load(QString filename)
+{
+    configurationFile = filename;
+
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        lastError = "Cannot open " + filename;
+        watchFiles();
+        return false;
+    }
+
+    QJsonParseError parseError;
+    QJsonDocument loadedDocument = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (!loadedDocument.isObject())
+    {
+        lastError = "Cannot parse " + filename + ": " + parseError.errorString();
+        watchFiles();
+        return false;
+    }
+    QJsonObject documentObject = loadedDocument.object();
+
+    QList<ElectrodeDefinition> parsedElectrodes;
+    QJsonArray electrodeArray = documentObject["ElectrodeDefinitions"].toArray();
+    for (int i = 0; i < electrodeArray.size(); i++)
+    {
+        QJsonObject definition = electrodeArray[i].toObject();
+        ElectrodeDefinition electrode;
+        electrode.electrodeName = definition["ElectrodeName"].toString();
+        electrode.channelCount = definition["ChannelCount"].toInt();
+        if (definition.contains("Arrange"))
+        {
+            for (int j = 0; j < 2; j++) electrode.arrange[j] = definition["Arrange"].toArray()[j].toInt();
+        }
+        parsedElectrodes.append(electrode);
+    }
+
+    QStringList parsedTargets;
+    QJsonArray targetArray = documentObject["TargetDefinitions"].toArray();
+    for (int i = 0; i < targetArray.size(); i++) parsedTargets.append(targetArray[i].toString());
+
+    QStringList parsedDiagnoses;
+    QJsonArray diagnosisArray = documentObject["DiagnosisDefinitions"].toArray();
+    for (int i = 0; i < diagnosisArray.size(); i++) parsedDiagnoses.append(diagnosisArray[i].toString());
+
+    QStringList parsedLabels;
+    QJsonArray labelArray = documentObject["RecordingLabels"].toArray();
+    for (int i = 0; i < labelArray.size(); i++) parsedLabels.append(labelArray[i].toString());
+
+    // Task files are small, so they are parsed up front as well. Tasks are listed in key order, as before.
+    QList<TaskDefinition> parsedTasks;
+    QJsonObject taskObject = documentObject["TaskDefinitions"].toObject();
+    QStringList taskNames = taskObject.keys();
+    for (int i = 0; i < taskNames.size(); i++)
+    {
+        TaskDefinition task;
+        task.taskName = taskNames[i];
+        task.configurationFile = QDir::currentPath() + "/" + taskObject[taskNames[i]].toString();
+
+        QFile taskFile(task.configurationFile);
+        if (taskFile.open(QIODevice::ReadOnly)) task.taskDocument = QJsonDocument::fromJson(taskFile.readAll());
+        parsedTasks.append(task);
+    }
+
+    this->electrodes = parsedElectrodes;
+    this->targetNames = parsedTargets;
+    this->diagnosisNames = parsedDiagnoses;
+    this->labels = parsedLabels;
+    this->taskDefinitions = parsedTasks;
+    loaded = true;
+    lastError = "";
+
+    watchFiles();
+    return true;
+}
+
+bool InterfaceConfiguration::reload()
+{
+    if (!load(configurationFile)) return false;
+    emit configurationChanged();
+    return true;
+}
+
+bool InterfaceConfiguration::isLoaded() const
+{
+    return loaded;
+}
+
+QString InterfaceConfiguration::errorMessage() const
+{
+    return lastError;
+}
+
+const QList<ElectrodeDefinition> &InterfaceConfiguration::electrodeDefinitions() const
+{
+    return electrodes;
+}
+
+const ElectrodeDefinition *InterfaceConfiguration::electrodeDefinition(QString electrodeName) const
+{
+    for (int i = 0; i < electrodes.size(); i++)
+    {
+        if (electrodes[i].electrodeName == electrodeName) return &electrodes[i];
+    }
+    return nullptr;
+}
+
+QStringList InterfaceConfiguration::electrodeNames() const
+{
+    QStringList names;
+    for (int i = 0; i < electrodes.size(); i++) names.append(electrodes[i].electrodeName);
+    return names;
+}
+
+const QStringList &InterfaceConfiguration::targets() const
+{
+    return targetNames;
+}
+
+const QStringList &InterfaceConfiguration::diagnoses() const
+{
+    return diagnosisNames;
+}
+
+const QStringList &InterfaceConfiguration::recordingLabels() const
+{
+    return labels;
+}
+
+const QList<TaskDefinition> &InterfaceConfiguration::tasks() const
+{
+    return taskDefinitions;
+}
+
+const TaskDefinition *InterfaceConfiguration::task(QString taskName) const
+{
+    for (int i = 0; i < taskDefinitions.size(); i++)
+    {
+        if (taskDefinitions[i].taskName == taskName) return &taskDefinitions[i];
+    }
+    return nullptr;
+}
+
+// Shared defaultSettings.ini handle, so callers no longer construct their own QSettings.
+QSettings *InterfaceConfiguration::settings()
+{
+    return applicationConfiguration;
+}
+
+void InterfaceConfiguration::configurationFileChanged(QString path)
+{
+    Q_UNUSED(path);
+    reloadTimer->start();
+}
+
+// Saving by replace drops the file from the watcher, so the watch list is rebuilt after every load.
+void InterfaceConfiguration::watchFiles()
+{
+    QStringList watchedFiles = fileWatcher->files();
+    if (!watchedFiles.isEmpty()) fileWatcher->removePaths(watchedFiles);
+
+    QStringList files = {configurationFile};
+    for (int i = 0; i < taskDefinitions.size(); i++) files.append(taskDefinitions[i].configurationFile);
+    for (int i = 0; i < files.size(); i++)
+    {
+        if (QFile::exists(files[i])) fileWatcher->addPath(files[i]);
+    }
+}
@@ -0,0 +1,100 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef INTERFACECONFIGURATION_H
+#define INTERFACECONFIGURATION_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QFile>
+#include <QDir>
+#include <QTimer>
+#include <QSettings>
+#include <QFileSystemWatcher>
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+typedef struct ElectrodeDefinition
+{
+    QString electrodeName = "";
+    int channelCount = 0;
+    int arrange[2] = {0};
+} ElectrodeDefinition;
+
+typedef struct TaskDefinition
+{
+    QString taskName = "";
+    QString configurationFile = "";
+    QJsonDocument taskDocument;
+} TaskDefinition;
+
+// Process-wide parsed copy of InterfaceConfigurations.json (and the task files it points to), plus the shared
+// defaultSettings.ini handle. The files are parsed once and re-parsed when they change on disk; a reload that fails
+// keeps the previous configuration. Dialogs read from here instead of opening the files. Used from the GUI thread only.
+class InterfaceConfiguration : public QObject
+{
+    Q_OBJECT
+
+public:
+    static InterfaceConfiguration *instance();
+
+    bool load(QString filename);
+    bool reload();
+    bool isLoaded() const;
+    QString errorMessage() const;
+
+    const QList<ElectrodeDefinition> &electrodeDefinitions() const;
+    const ElectrodeDefinition *electrodeDefinition(QString electrodeName) const;
+    QStringList electrodeNames() const;
+    const QStringList &targets() const;
+    const QStringList &diagnoses() const;
+    const QStringList &recordingLabels() const;
+    const QList<TaskDefinition> &tasks() const;
+    const TaskDefinition *task(QString taskName) const;
+
+    QSettings *settings();
+
+signals:
+    void configurationChanged();
+
+private slots:
+    void configurationFileChanged(QString path);
+
+private:
+    explicit InterfaceConfiguration(QObject *parent = nullptr);
+    void watchFiles();
+
+    QString configurationFile;
+    bool loaded = false;
+    QString lastError;
+
+    QList<ElectrodeDefinition> electrodes;
+    QStringList targetNames;
+    QStringList diagnosisNames;
+    QStringList labels;
+    QList<TaskDefinition> taskDefinitions;
+
+    QSettings *applicationConfiguration;
+    QFileSystemWatcher *fileWatcher;
+    QTimer *reloadTimer;
+};
+
+#endif // INTERFACECONFIGURATION_H
@@ -38,6 +38,7 @@ JSONStorage::JSONStorage(QString path, QString name)
 
 void JSONStorage::addJSON(QJsonObject newObject)
 {
+    if (eventTagger) eventTagger(newObject);
     jsonArray.append(newObject);
 }
 
@@ -48,9 +49,15 @@ void JSONStorage::addObjectTimestamp(QString key, QString value)
 
     QDateTime currentTime;
     newObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+    if (eventTagger) eventTagger(newObject);
     jsonArray.append(newObject);
 }
 
+void JSONStorage::setEventTagger(std::function<void(QJsonObject &)> tagger)
+{
+    eventTagger = tagger;
+}
+
 void JSONStorage::saveJSON()
 {
     jsonDocument.setArray(jsonArray);
@@ -21,6 +21,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <QtCore>
 #include <QString>
 
+#include <functional>
+
 class JSONStorage
 {
 public:
@@ -29,6 +31,7 @@ public:
     void addJSON(QJsonObject newObject);
     void addObjectTimestamp(QString key, QString value);
     void saveJSON();
+    void setEventTagger(std::function<void(QJsonObject &)> tagger);
 
 private:
     QString filePath;
@@ -37,6 +40,9 @@ private:
     QJsonDocument jsonDocument;
     QJsonObject baseObject;
     QJsonArray jsonArray;
+
+    // Adds fields to every entry as it is logged (e.g. the device sample from ClockSynchronizer)
+    std::function<void(QJsonObject &)> eventTagger;
 };
 
 
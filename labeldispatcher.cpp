@@ -0,0 +1,189 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#include "labeldispatcher.h"
+#include "sdkinstrumentation.h"
+
+LabelDispatcher::LabelDispatcher(QObject *parent) :
+    WorkerThread(parent)
+{
+    sentLabels = 0;
+    sentMessages = 0;
+    retries = 0;
+    failedLabels = 0;
+}
+
+LabelDispatcher::~LabelDispatcher()
+{
+    stopDispatcher();
+}
+
+// coalesceLatency (ms): once a SendText call takes longer than this, queued labels go out together.
+// A label is dropped after maxAttempts sends; the wait between attempts starts at retryDelay (ms) and doubles.
+void LabelDispatcher::configure(ClockSynchronizer *clockSynchronizer, int coalesceLatency, int maxAttempts, int retryDelay)
+{
+    if (this->isRunning()) return;
+
+    this->clockSynchronizer = clockSynchronizer;
+    this->coalesceLatency = qMax(coalesceLatency, 0);
+    this->maxAttempts = qMax(maxAttempts, 1);
+    this->retryDelay = qMax(retryDelay, 1);
+
+    arm();
+}
+
+// GUI thread. The click is timestamped here, before anything can delay it.
+void LabelDispatcher::enqueue(QString text)
+{
+    LabelRequest request;
+    request.text = text;
+    request.clickNanoseconds = monotonicNanoseconds();
+    request.clickTime = QDateTime::currentDateTime();
+    if (clockSynchronizer != nullptr) request.clickDeviceSample = clockSynchronizer->deviceSample(request.clickNanoseconds);
+
+    QMutexLocker locker(&queueMutex);
+    queue.append(request);
+    queueCondition.wakeOne();
+}
+
+// Labels still queued are sent before the thread exits, with a single attempt each.
+void LabelDispatcher::stopDispatcher()
+{
+    disarm(&queueMutex, &queueCondition);
+}
+
+int LabelDispatcher::pending()
+{
+    QMutexLocker locker(&queueMutex);
+    return queue.size();
+}
+
+QString LabelDispatcher::separator()
+{
+    return "; ";
+}
+
+void LabelDispatcher::run()
+{
+    while (true)
+    {
+        queueMutex.lock();
+        if (queue.isEmpty() && running.loadAcquire()) queueCondition.wait(&queueMutex, 500);
+        if (queue.isEmpty())
+        {
+            bool stopping = !running.loadAcquire();
+            queueMutex.unlock();
+            if (stopping) break;
+            continue;
+        }
+
+        // A slow last send means the SDK is backed up; everything waiting goes out as one message.
+        QList<LabelRequest> batch;
+        int batchSize = lastSendNanoseconds > (qint64)coalesceLatency * 1000000 ? qMin(queue.size(), maxCoalesced) : 1;
+        for (int i = 0; i < batchSize; i++) batch.append(queue.takeFirst());
+        bool stopping = !running.loadAcquire();
+        queueMutex.unlock();
+
+        QStringList texts;
+        for (int i = 0; i < batch.size(); i++) texts.append(batch[i].text);
+        QString message = texts.join(separator());
+
+        QString errorMessage = "";
+        int attempts = 0;
+        int delay = retryDelay;
+        bool success = false;
+        while (!success)
+        {
+            attempts++;
+            success = send(message, errorMessage);
+            if (success || attempts >= maxAttempts || stopping) break;
+
+            retries.fetchAndAddRelaxed(1);
+            queueMutex.lock();
+            if (running.loadAcquire()) queueCondition.wait(&queueMutex, delay);
+            stopping = !running.loadAcquire();
+            queueMutex.unlock();
+            delay *= 2;
+        }
+        qint64 acknowledgedNanoseconds = monotonicNanoseconds();
+
+        for (int i = 0; i < batch.size(); i++)
+        {
+            batch[i].attempts = attempts;
+            if (success)
+            {
+                markerLatency.record(acknowledgedNanoseconds - batch[i].clickNanoseconds);
+                emit labelDispatched(labelObject(batch[i], acknowledgedNanoseconds, batch.size()));
+            }
+            else
+            {
+                failedLabels.fetchAndAddRelaxed(1);
+                emit labelFailed(batch[i].text, errorMessage);
+            }
+        }
+        if (success)
+        {
+            sentLabels.fetchAndAddRelaxed(batch.size());
+            sentMessages.fetchAndAddRelaxed(1);
+        }
+    }
+}
+
+bool LabelDispatcher::send(QString text, QString &errorMessage)
+{
+    QByteArray textData = text.toLatin1();
+    qint64 sendStart = monotonicNanoseconds();
+    int result = AO_CALL(SendText)(textData.data(), textData.size());
+    lastSendNanoseconds = monotonicNanoseconds() - sendStart;
+    sendLatency.record(lastSendNanoseconds);
+    sendLockWait.record(SDKInstrumentation::lastLockWait());
+    if (result == eAO_OK) return true;
+
+    errorMessage = sdkErrorLog();
+    if (errorMessage.isEmpty()) errorMessage = QString("SendText failed (%1)").arg(result);
+    return false;
+}
+
+// Same fields as the old synchronous "Label" entry plus the click and acknowledge timing. "DeviceSample" is the click,
+// so the clock tagger of JSONStorage keeps it.
+QJsonObject LabelDispatcher::labelObject(const LabelRequest &request, qint64 acknowledgedNanoseconds, int coalesced)
+{
+    QJsonObject labelObject;
+    labelObject["LabelText"] = QJsonValue(request.text);
+    labelObject["Time"] = QJsonValue(request.clickTime.toString("yyyy/MM/dd HH:mm:ss"));
+    labelObject["ClickTime"] = QJsonValue(request.clickTime.toString("yyyy/MM/dd HH:mm:ss.zzz"));
+    labelObject["MarkerLatency"] = QJsonValue((acknowledgedNanoseconds - request.clickNanoseconds) / 1e6);
+    labelObject["Attempts"] = QJsonValue(request.attempts);
+    labelObject["Coalesced"] = QJsonValue(coalesced);
+
+    if (request.clickDeviceSample >= 0) labelObject["DeviceSample"] = QJsonValue(request.clickDeviceSample);
+    qint64 acknowledgedSample = clockSynchronizer != nullptr ? clockSynchronizer->deviceSample(acknowledgedNanoseconds) : -1;
+    if (acknowledgedSample >= 0) labelObject["AcknowledgedDeviceSample"] = QJsonValue(acknowledgedSample);
+    return labelObject;
+}
+
+QJsonObject LabelDispatcher::report()
+{
+    QJsonObject reportObject;
+    reportObject["SentLabels"] = QJsonValue(sentLabels.loadRelaxed());
+    reportObject["SentMessages"] = QJsonValue(sentMessages.loadRelaxed());
+    reportObject["Retries"] = QJsonValue(retries.loadRelaxed());
+    reportObject["FailedLabels"] = QJsonValue(failedLabels.loadRelaxed());
+    reportObject["MarkerLatency"] = markerLatency.toJson();
+    reportObject["SendLatency"] = sendLatency.toJson();
+    reportObject["SendLockWait"] = sendLockWait.toJson();
+    return reportObject;
+}
@@ -0,0 +1,96 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#ifndef LABELDISPATCHER_H
+#define LABELDISPATCHER_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QList>
+#include <QString>
+#include <QDateTime>
+#include <QJsonObject>
+
+#include "workerthread.h"
+#include "streamdatahandler.h"
+#include "clocksynchronizer.h"
+#include "latencyhistogram.h"
+
+// A label as clicked. Host times are monotonicNanoseconds(); clickDeviceSample is -1 without a clock fit.
+typedef struct LabelRequest
+{
+    QString text = "";
+    QDateTime clickTime;
+    qint64 clickNanoseconds = 0;
+    qint64 clickDeviceSample = -1;
+    int attempts = 0;
+} LabelRequest;
+
+// Sends labels to NeuroOmega (SendText) on its own thread so a slow SDK round trip never blocks the buttons.
+// Failed sends are retried with exponential backoff. While SendText is slow, labels queued behind it are combined into
+// one message. Each label is reported through labelDispatched() with its click and acknowledge times for logging.
+class LabelDispatcher : public WorkerThread
+{
+    Q_OBJECT
+
+public:
+    explicit LabelDispatcher(QObject *parent = nullptr);
+    ~LabelDispatcher();
+
+    void configure(ClockSynchronizer *clockSynchronizer, int coalesceLatency = 50, int maxAttempts = 5, int retryDelay = 50);
+    void enqueue(QString text);
+    void stopDispatcher();
+    int pending();
+    QJsonObject report();
+
+    static QString separator();
+
+signals:
+    void labelDispatched(QJsonObject labelObject);
+    void labelFailed(QString text, QString message);
+
+protected:
+    void run() override;
+
+private:
+    bool send(QString text, QString &errorMessage);
+    QJsonObject labelObject(const LabelRequest &request, qint64 acknowledgedNanoseconds, int coalesced);
+
+    ClockSynchronizer *clockSynchronizer = nullptr;
+    int coalesceLatency = 50;
+    int maxAttempts = 5;
+    int retryDelay = 50;
+    int maxCoalesced = 8;
+
+    QMutex queueMutex;
+    QWaitCondition queueCondition;
+    QList<LabelRequest> queue;
+
+    // Only touched by the dispatcher thread
+    qint64 lastSendNanoseconds = 0;
+
+    LatencyHistogram markerLatency;
+    // SendText shares the SDK lock with every other thread, so sendLatency includes the wait in sendLockWait
+    LatencyHistogram sendLatency;
+    LatencyHistogram sendLockWait;
+    QAtomicInteger<qint64> sentLabels;
+    QAtomicInteger<qint64> sentMessages;
+    QAtomicInteger<qint64> retries;
+    QAtomicInteger<qint64> failedLabels;
+};
+
+#endif // LABELDISPATCHER_H
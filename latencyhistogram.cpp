@@ -0,0 +1,124 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "latencyhistogram.h"
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+// Values below 32 ns get their own bucket. Above that each power of two is split into 16 linear sub-buckets.
+int LatencyHistogram::bucketIndex(quint64 value)
+{
+    if (value < 32) return (int)value;
+
+    int msb = 63;
+    while (!(value >> msb)) msb--;
+    int shift = msb - 4;
+    return 32 + (shift - 1) * SubBuckets + (int)((value >> shift) - SubBuckets);
+}
+
+quint64 LatencyHistogram::bucketLowerBound(int index)
+{
+    if (index < 32) return index;
+
+    int shift = (index - 32) / SubBuckets + 1;
+    quint64 subBucket = (index - 32) % SubBuckets + SubBuckets;
+    return subBucket << shift;
+}
+
+void LatencyHistogram::record(qint64 nanoseconds)
+{
+    if (nanoseconds < 0) nanoseconds = 0;
+
+    buckets[bucketIndex(nanoseconds)].fetchAndAddRelaxed(1);
+    totalCount.fetchAndAddRelaxed(1);
+    totalNanoseconds.fetchAndAddRelaxed(nanoseconds);
+
+    qint64 currentMax = maxNanoseconds.loadRelaxed();
+    while (nanoseconds > currentMax && !maxNanoseconds.testAndSetRelaxed(currentMax, nanoseconds, currentMax));
+}
+
+void LatencyHistogram::reset()
+{
+    for (int i = 0; i < BucketCount; i++) buckets[i].storeRelaxed(0);
+    totalCount.storeRelaxed(0);
+    totalNanoseconds.storeRelaxed(0);
+    maxNanoseconds.storeRelaxed(0);
+}
+
+quint64 LatencyHistogram::count() const
+{
+    return totalCount.loadRelaxed();
+}
+
+qint64 LatencyHistogram::maximum() const
+{
+    return maxNanoseconds.loadRelaxed();
+}
+
+double LatencyHistogram::mean() const
+{
+    quint64 numValues = totalCount.loadRelaxed();
+    if (numValues == 0) return 0;
+    return (double)totalNanoseconds.loadRelaxed() / numValues;
+}
+
+// Lower bound of the bucket holding the requested percentile, so the value is accurate to one bucket width.
+qint64 LatencyHistogram::percentile(double percent) const
+{
+    quint64 numValues = totalCount.loadRelaxed();
+    if (numValues == 0) return 0;
+
+    quint64 target = (quint64)(numValues * percent / 100.0);
+    if (target >= numValues) target = numValues - 1;
+
+    quint64 accumulated = 0;
+    for (int i = 0; i < BucketCount; i++)
+    {
+        accumulated += buckets[i].loadRelaxed();
+        if (accumulated > target) return bucketLowerBound(i);
+    }
+    return maxNanoseconds.loadRelaxed();
+}
+
+QJsonObject LatencyHistogram::toJson() const
+{
+    QJsonObject histogramObject;
+    histogramObject["Count"] = QJsonValue((qint64)count());
+    histogramObject["MeanMicroseconds"] = QJsonValue(mean() / 1000.0);
+    histogramObject["P50Microseconds"] = QJsonValue(percentile(50) / 1000.0);
+    histogramObject["P90Microseconds"] = QJsonValue(percentile(90) / 1000.0);
+    histogramObject["P99Microseconds"] = QJsonValue(percentile(99) / 1000.0);
+    histogramObject["MaxMicroseconds"] = QJsonValue(maximum() / 1000.0);
+
+    // Only non-empty buckets, as [lower bound in microseconds, count] pairs.
+    QJsonArray bucketArray;
+    for (int i = 0; i < BucketCount; i++)
+    {
+        quint64 bucketCount = buckets[i].loadRelaxed();
+        if (bucketCount == 0) continue;
+
+        QJsonArray bucket;
+        bucket.append(QJsonValue(bucketLowerBound(i) / 1000.0));
+        bucket.append(QJsonValue((qint64)bucketCount));
+        bucketArray.append(bucket);
+    }
+    histogramObject["Buckets"] = bucketArray;
+    return histogramObject;
+}
@@ -0,0 +1,55 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QAtomicInteger>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonValue>
+
+// HDR-style log-linear histogram of nanosecond latencies, about 6% bucket resolution from 1 ns to hours.
+// record() is lock-free so it can be called from the acquisition, controller and GUI threads at once.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(qint64 nanoseconds);
+    void reset();
+
+    quint64 count() const;
+    qint64 maximum() const;
+    double mean() const;
+    qint64 percentile(double percent) const;
+    QJsonObject toJson() const;
+
+    static int bucketIndex(quint64 value);
+    static quint64 bucketLowerBound(int index);
+
+    static const int SubBuckets = 16;
+    static const int BucketCount = 32 + 59 * 16;
+
+private:
+    QAtomicInteger<quint64> buckets[BucketCount];
+    QAtomicInteger<quint64> totalCount;
+    QAtomicInteger<quint64> totalNanoseconds;
+    QAtomicInteger<qint64> maxNanoseconds;
+};
+
+#endif // LATENCYHISTOGRAM_H
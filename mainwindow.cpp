@@ -16,6 +16,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 *********************************************************************************/
 
 #include "mainwindow.h"
+#include "sdkinstrumentation.h"
 #include "ui_mainwindow.h"
 
 MainWindow::MainWindow(QWidget *parent) :
@@ -28,32 +29,41 @@ MainWindow::MainWindow(QWidget *parent) :
     diagnosis = "PD";
     patientID = "";
 
-    applicationConfiguration = new QSettings(QDir::currentPath() + "/defaultSettings.ini", QSettings::IniFormat);
-    updateAddresses(applicationConfiguration->value("SystemMACAddress").toString().toStdString(), applicationConfiguration->value("SurgicalLogFolder").toString().toStdString());
-
-    QFile file;
-    file.setFileName(QDir::currentPath() + "/InterfaceConfigurations.json");
-    if (!file.open(QIODevice::ReadOnly)) return;
-    QByteArray configurationData = file.readAll();
+    applicationConfiguration = InterfaceConfiguration::instance()->settings();
 
-    QJsonDocument loadedDocument = QJsonDocument::fromJson(configurationData);
-    if (loadedDocument.isObject())
+    // GUI-thread stall profiling. The trace is written with each session log.
+    if (applicationConfiguration->value("EventLoopProfiler", true).toBool())
     {
-        QJsonObject documentObject = loadedDocument.object();
-        if (documentObject.contains("DiagnosisDefinitions"))
-        {
-            ui->diagnosisSelection->clear();
-            QJsonArray diagnosisArray = loadedDocument.object()["DiagnosisDefinitions"].toArray();
-            for (int i = 0; i < diagnosisArray.size(); i++)
-            {
-                ui->diagnosisSelection->addItem(diagnosisArray[i].toString());
-            }
-        }
+        EventLoopProfiler::instance()->startProfiler(applicationConfiguration->value("StallThreshold", 100).toInt());
     }
 
+    // Connection runs asynchronously; the connect button shows progress until NeuroOmega responds.
+    connectButtonText = ui->NeuroOmega_BtnConnect->text();
+    connectionStateMachine = new ConnectionStateMachine(this);
+    connect(connectionStateMachine, &ConnectionStateMachine::progress, this, &MainWindow::connectionProgress);
+    connect(connectionStateMachine, &ConnectionStateMachine::connected, this, &MainWindow::connectionEstablished);
+    connect(connectionStateMachine, &ConnectionStateMachine::failed, this, &MainWindow::connectionFailed);
+
+    updateAddresses(applicationConfiguration->value("SystemMACAddress").toString().toStdString(), applicationConfiguration->value("SurgicalLogFolder").toString().toStdString());
+
+    updateDiagnosisDefinitions();
+    connect(InterfaceConfiguration::instance(), &InterfaceConfiguration::configurationChanged, this, &MainWindow::updateDiagnosisDefinitions);
+
     this->setFixedSize(this->size());
 }
 
+// Refill the diagnosis list from InterfaceConfigurations.json, keeping the current choice if it is still offered
+void MainWindow::updateDiagnosisDefinitions()
+{
+    const QStringList &diagnoses = InterfaceConfiguration::instance()->diagnoses();
+    if (diagnoses.isEmpty()) return;
+
+    QString currentDiagnosis = ui->diagnosisSelection->currentText();
+    ui->diagnosisSelection->clear();
+    ui->diagnosisSelection->addItems(diagnoses);
+    if (diagnoses.contains(currentDiagnosis)) ui->diagnosisSelection->setCurrentText(currentDiagnosis);
+}
+
 MainWindow::~MainWindow()
 {
     delete ui;
@@ -61,26 +71,13 @@ MainWindow::~MainWindow()
 
 void MainWindow::closeEvent(QCloseEvent *event)
 {
-    AO_Exit();
+    EventLoopProfiler::instance()->stopProfiler();
+    AO_CALL(AO_Exit)();
 }
 
 string MainWindow::getErrorLog()
 {
-    char errorString[1000] = {0};
-    int nErrorCount = 0;
-    int result = ErrorHandlingfunc(&nErrorCount, errorString, 1000);
-
-    switch (result)
-    {
-        case eAO_ARG_NULL:
-            printf("ErrorHandlingfunc: NULL Argument Error\n");
-            break;
-        case eAO_BAD_ARG:
-            printf("ErrorHandlingfunc: Bad Argument\n");
-            break;
-    }
-
-    return string(errorString);
+    return sdkErrorLog().toStdString();
 }
 
 void MainWindow::displayError(int errorLevel, const char* message)
@@ -97,7 +94,7 @@ void MainWindow::displayError(int errorLevel, const char* message)
 
 void MainWindow::checkConnection()
 {
-    int result = isConnected();
+    int result = AO_CALL(isConnected)();
     switch (result)
     {
         case eAO_DISCONNECTED:
@@ -111,6 +108,8 @@ void MainWindow::checkConnection()
 
 void MainWindow::onConnectionUpdate()
 {
+    PROFILE_SCOPE("MainWindow::onConnectionUpdate");
+
     checkConnection();
     if (!connectionStatus)
     {
@@ -130,71 +129,18 @@ MAC_ADDR MainWindow::formMACAddress(string addressString)
 
 void MainWindow::on_NeuroOmega_BtnConnect_clicked()
 {
+    PROFILE_SCOPE("MainWindow::on_NeuroOmega_BtnConnect_clicked");
+
     checkConnection();
 
     if (!connectionStatus)
     {
-        MAC_ADDR sysMACAddress = formMACAddress(applicationConfiguration->value("SystemMACAddress").toString().toStdString());
+        if (connectionStateMachine->isRunning()) return;
 
-        int result = DefaultStartConnection(&sysMACAddress, NULL);
-        if (result != eAO_OK)
-        {
-            displayError(QMessageBox::Critical, getErrorLog().c_str());
-            return;
-        }
-
-        connectionStatus = true;
-        int currentStatus = 0;
-        for (int i = 0; i < 10; i++)
-        {
-            currentStatus = isConnected();
-            if (currentStatus == eAO_DISCONNECTED)
-            {
-                displayError(QMessageBox::Critical, getErrorLog().c_str());
-                return;
-            }
-            else if (currentStatus == eAO_CONNECTED)
-            {
-                connectionStatus = true;
-                break;
-            }
-            if (i == 0)
-            {
-                connectionStatus = true;
-                break;
-            }
-            Sleep(1000);
-        }
-
-        if (connectionStatus)
-        {
-            configurationForm = new ElectrodeConfigurations();
-            configurationForm->setFixedSize(configurationForm->size());
-
-            if (configurationForm->exec() == configurationForm->Accepted)
-            {
-                ui->NeuroOmega_BtnConnect->setEnabled(false);
-                ui->patientID_textEdit->setEnabled(false);
-                ui->diagnosisSelection->setEnabled(false);
-                ui->SystemMacAddressEdit->setEnabled(false);
-
-                controllerForm = new ControllerForm();
-                controllerForm->controllerInitialization(this->patientID, this->diagnosis);
-                controllerForm->configureElectrodes(configurationForm->electrodeInfoCollection);
-                controllerForm->setFixedSize(controllerForm->size());
-                connect(controllerForm, &ControllerForm::connectionChanged, this, &MainWindow::onConnectionUpdate);
-                controllerForm->show();
-            }
-            else
-            {
-                CloseConnection();
-            }
-
-        }
-        else
-        {
-            displayError(QMessageBox::Warning, "NeuroOmega has not responded in 10 seconds. Please check if the NeuroOmega Application is running.");
-        }
+        MAC_ADDR sysMACAddress = formMACAddress(applicationConfiguration->value("SystemMACAddress").toString().toStdString());
+        ui->NeuroOmega_BtnConnect->setEnabled(false);
+        ui->SystemMacAddressEdit->setEnabled(false);
+        connectionStateMachine->start(sysMACAddress, applicationConfiguration->value("ConnectionTimeout", 10000).toInt());
     }
     else
     {
@@ -202,6 +148,53 @@ void MainWindow::on_NeuroOmega_BtnConnect_clicked()
     }
 }
 
+void MainWindow::connectionProgress(QString message, int elapsed, int timeout)
+{
+    ui->NeuroOmega_BtnConnect->setText(QString("%1 (%2 s)").arg(message).arg((timeout - elapsed + 999) / 1000));
+}
+
+void MainWindow::connectionFailed(QString message, bool timedOut)
+{
+    ui->NeuroOmega_BtnConnect->setText(connectButtonText);
+    ui->NeuroOmega_BtnConnect->setEnabled(true);
+    ui->SystemMacAddressEdit->setEnabled(true);
+    displayError(timedOut ? QMessageBox::Warning : QMessageBox::Critical, message.toStdString().c_str());
+}
+
+// NeuroOmega confirmed the connection. Configure electrodes and open the controller.
+void MainWindow::connectionEstablished()
+{
+    PROFILE_SCOPE("MainWindow::connectionEstablished");
+
+    connectionStatus = true;
+    ui->NeuroOmega_BtnConnect->setText(connectButtonText);
+
+    configurationForm = new ElectrodeConfigurations();
+    configurationForm->setFixedSize(configurationForm->size());
+
+    if (configurationForm->exec() == configurationForm->Accepted)
+    {
+        ui->NeuroOmega_BtnConnect->setEnabled(false);
+        ui->patientID_textEdit->setEnabled(false);
+        ui->diagnosisSelection->setEnabled(false);
+        ui->SystemMacAddressEdit->setEnabled(false);
+
+        controllerForm = new ControllerForm();
+        controllerForm->controllerInitialization(this->patientID, this->diagnosis);
+        controllerForm->configureElectrodes(configurationForm->electrodeInfoCollection);
+        controllerForm->setFixedSize(controllerForm->size());
+        connect(controllerForm, &ControllerForm::connectionChanged, this, &MainWindow::onConnectionUpdate);
+        controllerForm->show();
+    }
+    else
+    {
+        AO_CALL(CloseConnection)();
+        connectionStatus = false;
+        ui->NeuroOmega_BtnConnect->setEnabled(true);
+        ui->SystemMacAddressEdit->setEnabled(true);
+    }
+}
+
 void MainWindow::updateAddresses(string address, string targetDirectory)
 {
     string labelText = string("System MAC Address - ") + address;
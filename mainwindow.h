@@ -29,8 +29,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "macaddressdialog.h"
 #include "electrodeconfigurations.h"
 #include "controllerform.h"
+#include "devicestatemachine.h"
 
-#ifdef QT_DEBUG
+#if defined(QT_DEBUG) || defined(NEUROOMEGA_SIMULATOR)
 #include "AOSystemAPI_TEST.h"
 #else
 #include "AOSystemAPI.h"
@@ -56,6 +57,9 @@ public:
     void displayError(int errorLevel, const char *message);
 
     void onConnectionUpdate();
+    void connectionProgress(QString message, int elapsed, int timeout);
+    void connectionEstablished();
+    void connectionFailed(QString message, bool timedOut);
     void checkConnection();
     MAC_ADDR formMACAddress(string addressString);
     void updateAddresses(string address, string targetDirectory);
@@ -65,10 +69,13 @@ private slots:
     void on_SystemMacAddressEdit_clicked();
     void on_patientID_textEdit_textChanged(const QString &text);
     void on_diagnosisSelection_currentTextChanged(const QString &text);
+    void updateDiagnosisDefinitions();
 
 private:
     ElectrodeConfigurations *configurationForm;
     ControllerForm *controllerForm;
+    ConnectionStateMachine *connectionStateMachine;
+    QString connectButtonText;
 
     Ui::MainWindow *ui;
     QSettings *applicationConfiguration;
@@ -0,0 +1,314 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#include "merprofilebuilder.h"
+#include "sdkinstrumentation.h"
+
+MERProfileBuilder::MERProfileBuilder(QObject *parent) :
+    WorkerThread(parent)
+{
+    profileRevision = 0;
+    driveDepth = 0;
+}
+
+MERProfileBuilder::~MERProfileBuilder()
+{
+    stopBuilder();
+}
+
+// Resolve the MER channels against the stream layout and design the feature filters. Must be called before start().
+bool MERProfileBuilder::configure(MERProfileParameters parameters, QVector<int> streamChannels)
+{
+    this->parameters = parameters;
+    this->parameters.channelIDs.clear();
+    streamIndices.clear();
+    for (int i = 0; i < parameters.channelIDs.size(); i++)
+    {
+        int index = streamChannels.indexOf(parameters.channelIDs[i]);
+        if (index < 0) continue;
+        streamIndices.append(index);
+        this->parameters.channelIDs.append(parameters.channelIDs[i]);
+    }
+    if (streamIndices.isEmpty() || parameters.binSize <= 0) return false;
+
+    double lfpRate = (double)NEUROOMEGA_SAMPLING_RATE / lfpFactor;
+    spikeBandSections = BiquadFilterNode::design("Highpass", {300}, 4, 0, NEUROOMEGA_SAMPLING_RATE);
+    spikeBandSections.append(BiquadFilterNode::design("Lowpass", {5000}, 4, 0, NEUROOMEGA_SAMPLING_RATE));
+    antiAliasSections = BiquadFilterNode::design("Lowpass", {lfpRate * 0.4}, 4, 0, NEUROOMEGA_SAMPLING_RATE);
+    betaSections = BiquadFilterNode::design("Bandpass", {13, 30}, 2, 0, lfpRate);
+    gammaSections = BiquadFilterNode::design("Bandpass", {60, 90}, 2, 0, lfpRate);
+
+    int numChannels = streamIndices.size();
+    spikeBandState.fill(0, numChannels * spikeBandSections.size() * 2);
+    antiAliasState.fill(0, numChannels * antiAliasSections.size() * 2);
+    betaState.fill(0, numChannels * betaSections.size() * 2);
+    gammaState.fill(0, numChannels * gammaSections.size() * 2);
+
+    noiseRMS.fill(0, numChannels);
+    lastSpikeSample.fill(-NEUROOMEGA_SAMPLING_RATE, numChannels);
+    baselineSquares.fill(0, numChannels);
+    baselineSamples.fill(0, numChannels);
+    sampleCounter = 0;
+    depthKnown = false;
+
+    pendingSamples.resize(numChannels);
+    processingSamples.resize(numChannels);
+    depthBins.clear();
+
+    arm();
+    return true;
+}
+
+// Acquisition thread. Copy the MER channels and hand them to the builder thread.
+void MERProfileBuilder::processBlock(const SignalBlock &block)
+{
+    if (!running.loadAcquire() || streamIndices.isEmpty()) return;
+
+    QMutexLocker locker(&queueMutex);
+    if (pendingSamples[0].size() + block.numSamples > maxPendingSamples)
+    {
+        droppedSamples += block.numSamples;
+        return;
+    }
+
+    for (int i = 0; i < streamIndices.size(); i++)
+    {
+        QVector<float> &pending = pendingSamples[i];
+        int offset = pending.size();
+        pending.resize(offset + block.numSamples);
+        memcpy(pending.data() + offset, block.channel(streamIndices[i]), sizeof(float) * block.numSamples);
+    }
+    queueCondition.wakeOne();
+}
+
+void MERProfileBuilder::stopBuilder()
+{
+    disarm(&queueMutex, &queueCondition);
+}
+
+int MERProfileBuilder::revision() const
+{
+    return profileRevision.loadAcquire();
+}
+
+int MERProfileBuilder::currentDepth() const
+{
+    return driveDepth.loadAcquire();
+}
+
+void MERProfileBuilder::run()
+{
+    while (running.loadAcquire())
+    {
+        queueMutex.lock();
+        if (pendingSamples[0].isEmpty()) queueCondition.wait(&queueMutex, 50);
+        processingSamples.swap(pendingSamples);
+        for (int i = 0; i < pendingSamples.size(); i++) pendingSamples[i].clear();
+        queueMutex.unlock();
+
+        updateDepth();
+        if (processingSamples[0].isEmpty()) continue;
+
+        // Motor movement corrupts the recording, so data is only binned once the drive has settled.
+        bool stationary = depthKnown && monotonicNanoseconds() - lastMoveTime >= parameters.settleTime * 1e9;
+        processChunk(stationary);
+    }
+}
+
+// The drive is polled here at 20 Hz rather than through the 1 s status timer so that movement is caught promptly.
+void MERProfileBuilder::updateDepth()
+{
+    qint64 now = monotonicNanoseconds();
+    if (now - lastDepthPoll < 50000000) return;
+    lastDepthPoll = now;
+
+    int32 depth = 0;
+    if (AO_CALL(GetDriveDepth)(&depth) != eAO_OK) return;
+
+    if (!depthKnown || depth != driveDepth.loadRelaxed())
+    {
+        driveDepth.storeRelease(depth);
+        lastMoveTime = now;
+        depthKnown = true;
+    }
+}
+
+void MERProfileBuilder::processChunk(bool stationary)
+{
+    int numChannels = processingSamples.size();
+    int numSamples = processingSamples[0].size();
+    if (workBuffer.size() < numSamples) workBuffer.resize(numSamples);
+    if (lfpBuffer.size() < numSamples / lfpFactor + 1) lfpBuffer.resize(numSamples / lfpFactor + 1);
+
+    int refractory = NEUROOMEGA_SAMPLING_RATE / 1000;
+    int firstLFP = (lfpFactor - sampleCounter % lfpFactor) % lfpFactor;
+    QVector<MERChannelAccumulator> chunk(numChannels);
+
+    for (int c = 0; c < numChannels; c++)
+    {
+        const float *x = processingSamples[c].constData();
+        float *y = workBuffer.data();
+        MERChannelAccumulator &accumulator = chunk[c];
+
+        // Spike band (300-5000 Hz): RMS and negative threshold crossings with a 1 ms refractory period
+        BiquadFilterNode::filter(spikeBandSections, spikeBandState.data() + c * spikeBandSections.size() * 2, x, y, numSamples);
+        double threshold = -parameters.spikeThreshold * noiseRMS[c];
+        double squares = 0;
+        for (int n = 0; n < numSamples; n++)
+        {
+            squares += y[n] * y[n];
+            if (noiseRMS[c] > 0 && y[n] < threshold && sampleCounter + n - lastSpikeSample[c] > refractory)
+            {
+                accumulator.spikes++;
+                lastSpikeSample[c] = sampleCounter + n;
+            }
+        }
+        accumulator.spikeBandSquares = squares;
+        accumulator.samples = numSamples;
+
+        // Noise level for the spike threshold tracks the spike band RMS with a ~1 s time constant
+        double chunkRMS = sqrt(squares / numSamples);
+        double weight = qMin(1.0, (double)numSamples / NEUROOMEGA_SAMPLING_RATE);
+        noiseRMS[c] = (noiseRMS[c] > 0) ? noiseRMS[c] + weight * (chunkRMS - noiseRMS[c]) : chunkRMS;
+
+        // LFP: anti-alias, keep every lfpFactor-th sample (1 kHz), then beta and gamma band power
+        BiquadFilterNode::filter(antiAliasSections, antiAliasState.data() + c * antiAliasSections.size() * 2, x, y, numSamples);
+        int numLFP = 0;
+        for (int n = firstLFP; n < numSamples; n += lfpFactor) lfpBuffer[numLFP++] = y[n];
+
+        BiquadFilterNode::filter(betaSections, betaState.data() + c * betaSections.size() * 2, lfpBuffer.constData(), y, numLFP);
+        for (int n = 0; n < numLFP; n++) accumulator.betaSquares += y[n] * y[n];
+        BiquadFilterNode::filter(gammaSections, gammaState.data() + c * gammaSections.size() * 2, lfpBuffer.constData(), y, numLFP);
+        for (int n = 0; n < numLFP; n++) accumulator.gammaSquares += y[n] * y[n];
+        accumulator.lfpSamples = numLFP;
+    }
+    sampleCounter += numSamples;
+
+    if (!stationary) return;
+
+    int depth = driveDepth.loadRelaxed();
+    int binDepth = (int)floor((double)depth / parameters.binSize) * parameters.binSize;
+    qint64 baselineLength = parameters.baselineDuration * NEUROOMEGA_SAMPLING_RATE;
+
+    profileMutex.lock();
+    MERDepthBin &bin = depthBins[binDepth];
+    if (bin.channels.isEmpty())
+    {
+        bin.depth = binDepth;
+        bin.channels.resize(numChannels);
+    }
+
+    for (int c = 0; c < numChannels; c++)
+    {
+        MERChannelAccumulator &total = bin.channels[c];
+        total.spikeBandSquares += chunk[c].spikeBandSquares;
+        total.betaSquares += chunk[c].betaSquares;
+        total.gammaSquares += chunk[c].gammaSquares;
+        total.samples += chunk[c].samples;
+        total.lfpSamples += chunk[c].lfpSamples;
+        total.spikes += chunk[c].spikes;
+
+        // NRMS reference: the first stationary seconds of the trajectory, above the target
+        if (baselineSamples[c] < baselineLength)
+        {
+            baselineSquares[c] += chunk[c].spikeBandSquares;
+            baselineSamples[c] += chunk[c].samples;
+        }
+    }
+    bin.revision = profileRevision.fetchAndAddRelease(1) + 1;
+    profileMutex.unlock();
+
+    // Views redraw only the bins returned by profile(channel, lastRevision)
+    emit profileUpdated(binDepth);
+}
+
+MERDepthFeatures MERProfileBuilder::features(const MERDepthBin &bin, int channelIndex) const
+{
+    const MERChannelAccumulator &accumulator = bin.channels[channelIndex];
+
+    MERDepthFeatures depthFeatures;
+    depthFeatures.depth = bin.depth;
+    depthFeatures.revision = bin.revision;
+    depthFeatures.duration = (double)accumulator.samples / NEUROOMEGA_SAMPLING_RATE;
+    if (accumulator.samples > 0)
+    {
+        depthFeatures.rms = sqrt(accumulator.spikeBandSquares / accumulator.samples);
+        depthFeatures.spikeRate = accumulator.spikes / depthFeatures.duration;
+    }
+    if (accumulator.lfpSamples > 0)
+    {
+        depthFeatures.betaPower = accumulator.betaSquares / accumulator.lfpSamples;
+        depthFeatures.gammaPower = accumulator.gammaSquares / accumulator.lfpSamples;
+    }
+    if (baselineSamples[channelIndex] > 0 && baselineSquares[channelIndex] > 0)
+    {
+        depthFeatures.nrms = depthFeatures.rms / sqrt(baselineSquares[channelIndex] / baselineSamples[channelIndex]);
+    }
+    return depthFeatures;
+}
+
+// Depth-ordered features for one MER channel. Pass the last seen revision to only get the bins that changed since then.
+QVector<MERDepthFeatures> MERProfileBuilder::profile(int channelIndex, int sinceRevision)
+{
+    QVector<MERDepthFeatures> depthProfile;
+    if (channelIndex < 0 || channelIndex >= streamIndices.size()) return depthProfile;
+
+    QMutexLocker locker(&profileMutex);
+    for (QMap<int, MERDepthBin>::const_iterator it = depthBins.constBegin(); it != depthBins.constEnd(); ++it)
+    {
+        if (it.value().revision <= sinceRevision) continue;
+        depthProfile.append(features(it.value(), channelIndex));
+    }
+    return depthProfile;
+}
+
+QJsonObject MERProfileBuilder::report()
+{
+    QJsonObject reportObject;
+    reportObject["BinSize"] = QJsonValue(parameters.binSize);
+    reportObject["SettleTime"] = QJsonValue(parameters.settleTime);
+    reportObject["SpikeThreshold"] = QJsonValue(parameters.spikeThreshold);
+
+    QJsonArray channelArray;
+    for (int c = 0; c < parameters.channelIDs.size(); c++)
+    {
+        QVector<MERDepthFeatures> depthProfile = profile(c);
+        QJsonArray binArray;
+        for (int i = 0; i < depthProfile.size(); i++)
+        {
+            QJsonObject binObject;
+            binObject["Depth"] = QJsonValue(depthProfile[i].depth);
+            binObject["Duration"] = QJsonValue(depthProfile[i].duration);
+            binObject["RMS"] = QJsonValue(depthProfile[i].rms);
+            binObject["NRMS"] = QJsonValue(depthProfile[i].nrms);
+            binObject["SpikeRate"] = QJsonValue(depthProfile[i].spikeRate);
+            binObject["BetaPower"] = QJsonValue(depthProfile[i].betaPower);
+            binObject["GammaPower"] = QJsonValue(depthProfile[i].gammaPower);
+            binArray.append(binObject);
+        }
+
+        QJsonObject channelObject;
+        channelObject["Channel"] = QJsonValue(parameters.channelIDs[c]);
+        channelObject["Bins"] = binArray;
+        channelArray.append(channelObject);
+    }
+    reportObject["Channels"] = channelArray;
+
+    queueMutex.lock();
+    reportObject["DroppedSamples"] = QJsonValue(droppedSamples);
+    queueMutex.unlock();
+    return reportObject;
+}
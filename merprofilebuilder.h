@@ -0,0 +1,143 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#ifndef MERPROFILEBUILDER_H
+#define MERPROFILEBUILDER_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QVector>
+#include <QMap>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "workerthread.h"
+#include "streamdatahandler.h"
+#include "filtergraph.h"
+
+// Depth is in GetDriveDepth() units (micrometers).
+typedef struct MERProfileParameters
+{
+    QVector<int> channelIDs;
+    int binSize = 100;
+    double settleTime = 1.0;
+    double spikeThreshold = 4.5;
+    double baselineDuration = 5.0;
+} MERProfileParameters;
+
+// Running sums for one channel in one depth bin. Only stationary (drive not moving) data is accumulated.
+typedef struct MERChannelAccumulator
+{
+    double spikeBandSquares = 0;
+    double betaSquares = 0;
+    double gammaSquares = 0;
+    qint64 samples = 0;
+    qint64 lfpSamples = 0;
+    int spikes = 0;
+} MERChannelAccumulator;
+
+typedef struct MERDepthBin
+{
+    int depth = 0;
+    int revision = 0;
+    QVector<MERChannelAccumulator> channels;
+} MERDepthBin;
+
+typedef struct MERDepthFeatures
+{
+    int depth = 0;
+    int revision = 0;
+    double duration = 0;
+    double rms = 0;
+    double nrms = 0;
+    double spikeRate = 0;
+    double betaPower = 0;
+    double gammaPower = 0;
+} MERDepthFeatures;
+
+// Joins the live microelectrode stream with drive depth and keeps an incremental per-depth feature profile.
+// processBlock() only copies the MER channels; filtering and feature accumulation run on this thread.
+class MERProfileBuilder : public WorkerThread, public StreamConsumer
+{
+    Q_OBJECT
+
+public:
+    explicit MERProfileBuilder(QObject *parent = nullptr);
+    ~MERProfileBuilder();
+
+    bool configure(MERProfileParameters parameters, QVector<int> streamChannels);
+    void processBlock(const SignalBlock &block) override;
+    void stopBuilder();
+
+    int revision() const;
+    int currentDepth() const;
+    QVector<MERDepthFeatures> profile(int channelIndex, int sinceRevision = -1);
+    QJsonObject report();
+
+signals:
+    void profileUpdated(int depth);
+
+protected:
+    void run() override;
+
+private:
+    void updateDepth();
+    void processChunk(bool stationary);
+    MERDepthFeatures features(const MERDepthBin &bin, int channelIndex) const;
+
+    MERProfileParameters parameters;
+    QVector<int> streamIndices;
+
+    QMutex queueMutex;
+    QWaitCondition queueCondition;
+    QVector<QVector<float>> pendingSamples;
+    QVector<QVector<float>> processingSamples;
+    int maxPendingSamples = NEUROOMEGA_SAMPLING_RATE * 2;
+    qint64 droppedSamples = 0;
+
+    QAtomicInt profileRevision;
+    QAtomicInt driveDepth;
+
+    // Filters, only touched by the builder thread. Spike band runs at the stream rate, beta/gamma on the decimated LFP.
+    QVector<BiquadCoefficients> spikeBandSections;
+    QVector<BiquadCoefficients> antiAliasSections;
+    QVector<BiquadCoefficients> betaSections;
+    QVector<BiquadCoefficients> gammaSections;
+    QVector<float> spikeBandState;
+    QVector<float> antiAliasState;
+    QVector<float> betaState;
+    QVector<float> gammaState;
+    QVector<float> workBuffer;
+    QVector<float> lfpBuffer;
+    int lfpFactor = 44;
+
+    QVector<double> noiseRMS;
+    QVector<qint64> lastSpikeSample;
+    qint64 sampleCounter = 0;
+
+    qint64 lastDepthPoll = 0;
+    qint64 lastMoveTime = 0;
+    bool depthKnown = false;
+
+    QVector<double> baselineSquares;
+    QVector<qint64> baselineSamples;
+
+    QMutex profileMutex;
+    QMap<int, MERDepthBin> depthBins;
+};
+
+#endif // MERPROFILEBUILDER_H
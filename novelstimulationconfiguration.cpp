@@ -16,6 +16,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 *********************************************************************************/
 
 #include "novelstimulationconfiguration.h"
+#include "sdkinstrumentation.h"
 #include "ui_novelstimulationconfiguration.h"
 
 NovelStimulationConfiguration::NovelStimulationConfiguration(QWidget *parent) :
@@ -84,14 +85,13 @@ void NovelStimulationConfiguration::on_chooseNovelWaveform_clicked()
 
         if (file.size() % 88000 == 0)
         {
-            QSettings *applicationConfiguration = new QSettings(QDir::currentPath() + "/defaultSettings.ini", QSettings::IniFormat);
-            applicationConfiguration->setValue("LastNovelStimulation", fileName.first());
+            InterfaceConfiguration::instance()->settings()->setValue("LastNovelStimulation", fileName.first());
 
             char *data = file.readAll().data();
             int16 *stimulationVector = (int16*) data;
             QString wavename = QFileInfo(fileName.first()).fileName().split(".").first();
 
-            int result = LoadWaveToEmbedded(stimulationVector, file.size() / 2, 1, (cChar*) wavename.toStdString().c_str());
+            int result = AO_CALL(LoadWaveToEmbedded)(stimulationVector, file.size() / 2, 1, (cChar*) wavename.toStdString().c_str());
 
             if (result == eAO_OK)
             {
@@ -145,8 +145,7 @@ void NovelStimulationConfiguration::on_chooseStimulationSequence_clicked()
             QJsonObject stimulationConfiguration = loadedDocument.object();
             if (stimulationConfiguration.contains("StimulationName"))
             {
-                QSettings *applicationConfiguration = new QSettings(QDir::currentPath() + "/defaultSettings.ini", QSettings::IniFormat);
-                applicationConfiguration->setValue("LastStimulationConfiguration", fileName.first());
+                InterfaceConfiguration::instance()->settings()->setValue("LastStimulationConfiguration", fileName.first());
 
                 stimulationJsonDocument = loadedDocument;
                 ui->SequenceFilename->setText(this->stimulationJsonDocument.object()["StimulationName"].toString());
@@ -29,12 +29,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <QJsonObject>
 #include <QJsonArray>
 
-#ifdef QT_DEBUG
+#if defined(QT_DEBUG) || defined(NEUROOMEGA_SIMULATOR)
 #include "AOSystemAPI_TEST.h"
 #else
 #include "AOSystemAPI.h"
 #endif
 
+#include "interfaceconfiguration.h"
+
 namespace Ui {
 class NovelStimulationConfiguration;
 }
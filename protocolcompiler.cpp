@@ -0,0 +1,554 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#include "protocolcompiler.h"
+
+#include <algorithm>
+
+ProtocolCompiler::ProtocolCompiler()
+{
+
+}
+
+void ProtocolCompiler::setCosts(ProtocolCosts costs)
+{
+    this->costs = costs;
+}
+
+bool ProtocolCompiler::isSweep(QJsonObject definition)
+{
+    return definition.contains("Sweeps") && !definition.contains("StimulationSequence");
+}
+
+// Replace the default costs with the mean latency of the SDK calls the sequencer makes, where they have been observed.
+ProtocolCosts ProtocolCompiler::measuredCosts(ProtocolCosts fallback)
+{
+    ProtocolCosts measured = fallback;
+    double fileSwitch = 0;
+    int fileSwitchCalls = 0;
+
+    QList<SDKFunctionStatistics*> functions = SDKInstrumentation::instance()->functions();
+    for (int i = 0; i < functions.size(); i++)
+    {
+        if (functions[i]->latency.count() == 0) continue;
+
+        double seconds = functions[i]->latency.mean() / 1e9;
+        if (functions[i]->name == "LoadWaveToEmbedded") measured.waveformUpload = seconds;
+        else if (functions[i]->name == "StartAnalogStimulation" || functions[i]->name == "StartDigitalStimulation") measured.contactStart = qMax(measured.contactStart, seconds);
+        else if (functions[i]->name == "StopSave" || functions[i]->name == "SetSaveFileName" || functions[i]->name == "StartSave")
+        {
+            fileSwitch += seconds;
+            fileSwitchCalls++;
+        }
+    }
+
+    // A file switch is StopSave, SetSaveFileName and StartSave; only trust the sum once all three were seen.
+    if (fileSwitchCalls == 3) measured.fileSwitch = fileSwitch;
+    return measured;
+}
+
+// Walk a StimulationSequence the way startSequentialStimulation does: a file switch whenever RecordingFilename changes,
+// an upload whenever a Novel stage needs a different StimulationIndex than the one already embedded.
+ProtocolTimeline ProtocolCompiler::predictTimeline(QJsonArray stimulationSequence, ProtocolCosts costs)
+{
+    ProtocolTimeline timeline;
+    QString currentFile = "";
+    bool fileOpen = false;
+    int currentWaveform = -1;
+
+    for (int i = 0; i < stimulationSequence.size(); i++)
+    {
+        QJsonObject stage = stimulationSequence[i].toObject();
+
+        ProtocolTimelineEntry entry;
+        entry.stage = i;
+        entry.stimulationType = stage["StimulationType"].toString();
+        entry.start = timeline.scheduledTime;
+        entry.duration = stage["Duration"].toDouble();
+
+        if (!fileOpen || stage["RecordingFilename"].toString() != currentFile)
+        {
+            entry.fileSwitch = true;
+            entry.overhead += costs.fileSwitch;
+            currentFile = stage["RecordingFilename"].toString();
+            fileOpen = true;
+        }
+
+        if (entry.stimulationType.contains("Novel") && stage["StimulationIndex"].toInt() != currentWaveform)
+        {
+            entry.waveformUpload = true;
+            entry.overhead += costs.waveformUpload;
+            currentWaveform = stage["StimulationIndex"].toInt();
+        }
+
+        if (entry.stimulationType.contains("Novel") || entry.stimulationType == "Standard")
+        {
+            entry.overhead += costs.contactStart * stage["StimulationChannel"].toArray().size();
+        }
+
+        timeline.scheduledTime += entry.duration;
+        timeline.overheadTime += qMin(entry.overhead, entry.duration);
+        timeline.waveformUploads += entry.waveformUpload;
+        timeline.fileSwitches += entry.fileSwitch;
+        timeline.entries.append(entry);
+    }
+    return timeline;
+}
+
+QJsonArray ProtocolCompiler::timelineToJson(const ProtocolTimeline &timeline)
+{
+    QJsonArray entries;
+    for (int i = 0; i < timeline.entries.size(); i++)
+    {
+        QJsonObject entry;
+        entry["Stage"] = timeline.entries[i].stage;
+        entry["StimulationType"] = timeline.entries[i].stimulationType;
+        entry["Start"] = timeline.entries[i].start;
+        entry["Overhead"] = timeline.entries[i].overhead;
+        entry["EffectiveDuration"] = timeline.entries[i].effectiveDuration();
+        entry["WaveformUpload"] = timeline.entries[i].waveformUpload;
+        entry["FileSwitch"] = timeline.entries[i].fileSwitch;
+        entries.append(entry);
+    }
+    return entries;
+}
+
+bool ProtocolCompiler::compile(QJsonObject sweepDefinition)
+{
+    lastError = "";
+    compiled = QJsonDocument();
+    declaredSequence = QJsonArray();
+    numTrials = 0;
+    numBlocks = 0;
+
+    if (!sweepDefinition.contains("StimulationName"))
+    {
+        lastError = "Sweep definition has no StimulationName";
+        return false;
+    }
+
+    QJsonArray sweeps = sweepDefinition["Sweeps"].toArray();
+    if (sweeps.isEmpty())
+    {
+        lastError = "Sweep definition has no Sweeps";
+        return false;
+    }
+
+    numWaveforms = sweepDefinition.contains("AnalogWaveforms") ? sweepDefinition["AnalogWaveforms"].toArray().size() : -1;
+
+    QList<ProtocolTrial> trials;
+    for (int i = 0; i < sweeps.size(); i++)
+    {
+        if (!expandSweep(sweeps[i].toObject(), i, trials)) return false;
+    }
+
+    int repetitions = sweepDefinition["Repetitions"].toInt(1);
+    if (repetitions < 1)
+    {
+        lastError = "Repetitions must be at least 1";
+        return false;
+    }
+    double blockRest = sweepDefinition["BlockRest"].toDouble(0);
+
+    randomize.clear();
+    QJsonArray randomizeArray = sweepDefinition["Randomize"].toArray();
+    for (int i = 0; i < randomizeArray.size(); i++) randomize.append(randomizeArray[i].toString());
+
+    // Without a Seed a fresh one is drawn and written into the compiled protocol, so the order can be reproduced.
+    // The seed is logged as a 64-bit integer; toInt() would turn seeds above 2^31 into 0.
+    quint32 seed = sweepDefinition.contains("Seed") ? (quint32)sweepDefinition["Seed"].toVariant().toLongLong() : QRandomGenerator::global()->generate();
+    random.seed(seed);
+
+    // Preamble stages (e.g. a resting Baseline) run as written and set the state the first block starts from.
+    QJsonArray sequence;
+    QString currentFile = "";
+    int currentWaveform = -1;
+    QJsonArray preamble = sweepDefinition["Preamble"].toArray();
+    for (int i = 0; i < preamble.size(); i++)
+    {
+        QJsonObject stage = preamble[i].toObject();
+        sequence.append(stage);
+        declaredSequence.append(stage);
+        currentFile = stage["RecordingFilename"].toString();
+        if (stage["StimulationType"].toString().contains("Novel")) currentWaveform = stage["StimulationIndex"].toInt();
+    }
+
+    for (int block = 0; block < repetitions; block++)
+    {
+        QList<ProtocolTrial> ordered = orderBlock(trials, currentFile, currentWaveform);
+        for (int i = 0; i < ordered.size(); i++) appendTrial(sequence, ordered[i]);
+        for (int i = 0; i < trials.size(); i++) appendTrial(declaredSequence, trials[i]);
+
+        if (blockRest > 0 && block < repetitions - 1)
+        {
+            sequence.append(restStage(ordered.last(), blockRest));
+            declaredSequence.append(restStage(trials.last(), blockRest));
+        }
+    }
+
+    numTrials = trials.size() * repetitions;
+    numBlocks = repetitions;
+
+    QJsonObject protocol;
+    protocol["StimulationName"] = sweepDefinition["StimulationName"];
+    if (sweepDefinition.contains("AnalogWaveforms")) protocol["AnalogWaveforms"] = sweepDefinition["AnalogWaveforms"];
+    protocol["StimulationSequence"] = sequence;
+    protocol["Seed"] = (qint64)seed;
+    compiled = QJsonDocument(protocol);
+    return true;
+}
+
+// Expand one sweep into a trial per contact and waveform (Novel) or per contact and parameter set (Standard),
+// in declaration order: contacts outermost, as the existing protocol scripts write them.
+bool ProtocolCompiler::expandSweep(QJsonObject sweep, int sweepIndex, QList<ProtocolTrial> &trials)
+{
+    QString stimulationType = sweep["StimulationType"].toString("Novel");
+    if (stimulationType != "Novel" && stimulationType != "Standard")
+    {
+        lastError = QString("Sweep %1: StimulationType must be Novel or Standard").arg(sweepIndex + 1);
+        return false;
+    }
+
+    if (!sweep.contains("RecordingFilename") || !sweep.contains("StimulationLead") || !sweep.contains("Contacts") || !sweep.contains("Duration"))
+    {
+        lastError = QString("Sweep %1: RecordingFilename, StimulationLead, Contacts and Duration are required").arg(sweepIndex + 1);
+        return false;
+    }
+
+    double duration = sweep["Duration"].toDouble();
+    double rest = sweep["Rest"].toDouble(0);
+    if (duration <= 0 || rest < 0)
+    {
+        lastError = QString("Sweep %1: Duration must be positive and Rest not negative").arg(sweepIndex + 1);
+        return false;
+    }
+
+    // Contacts are either single contact numbers or arrays of contacts stimulated together.
+    QList<QJsonArray> contacts;
+    QJsonArray contactArray = sweep["Contacts"].toArray();
+    for (int i = 0; i < contactArray.size(); i++)
+    {
+        if (contactArray[i].isArray()) contacts.append(contactArray[i].toArray());
+        else contacts.append(QJsonArray({contactArray[i].toInt()}));
+    }
+    if (contacts.isEmpty())
+    {
+        lastError = QString("Sweep %1: no Contacts").arg(sweepIndex + 1);
+        return false;
+    }
+
+    QList<QJsonObject> conditions;
+    if (stimulationType == "Novel")
+    {
+        QJsonArray waveforms = sweep["Waveforms"].toArray();
+        for (int i = 0; i < waveforms.size(); i++)
+        {
+            int waveform = waveforms[i].toInt(-1);
+            if (waveform < 0 || (numWaveforms >= 0 && waveform >= numWaveforms))
+            {
+                lastError = QString("Sweep %1: Waveform %2 is not in AnalogWaveforms").arg(sweepIndex + 1).arg(waveforms[i].toInt(-1));
+                return false;
+            }
+
+            QJsonObject condition;
+            condition["StimulationIndex"] = waveform;
+            conditions.append(condition);
+        }
+    }
+    else
+    {
+        QJsonArray amplitudes = sweep["Amplitudes"].toArray();
+        QJsonArray pulsewidths = sweep["Pulsewidths"].toArray();
+        QJsonArray frequencies = sweep["Frequencies"].toArray();
+        for (int i = 0; i < amplitudes.size(); i++)
+        {
+            for (int j = 0; j < pulsewidths.size(); j++)
+            {
+                for (int k = 0; k < frequencies.size(); k++)
+                {
+                    QJsonObject condition;
+                    condition["Amplitude"] = amplitudes[i];
+                    condition["Pulsewidth"] = pulsewidths[j];
+                    condition["Frequency"] = frequencies[k];
+                    conditions.append(condition);
+                }
+            }
+        }
+    }
+
+    if (conditions.isEmpty())
+    {
+        lastError = QString("Sweep %1: no Waveforms or stimulation parameters").arg(sweepIndex + 1);
+        return false;
+    }
+
+    for (int i = 0; i < contacts.size(); i++)
+    {
+        for (int j = 0; j < conditions.size(); j++)
+        {
+            ProtocolTrial trial;
+            trial.stage = conditions[j];
+            trial.stage["StimulationType"] = stimulationType;
+            trial.stage["RecordingFilename"] = sweep["RecordingFilename"].toString();
+            trial.stage["StimulationLead"] = sweep["StimulationLead"].toInt();
+            trial.stage["StimulationChannel"] = contacts[i];
+            trial.stage["StimulationReturn"] = sweep["StimulationReturn"].toInt(-1);
+            trial.stage["Duration"] = duration;
+
+            trial.recordingFilename = sweep["RecordingFilename"].toString();
+            trial.waveform = stimulationType == "Novel" ? conditions[j]["StimulationIndex"].toInt() : -1;
+            trial.contactIndex = i;
+            trial.declarationIndex = trials.size();
+            trial.rest = rest;
+            trials.append(trial);
+        }
+    }
+    return true;
+}
+
+// Order one randomization block. Trials of a recording file stay contiguous (one StopSave/StartSave each), and the
+// file order is chosen so the waveform left embedded by one file is the first one the next file needs.
+QList<ProtocolTrial> ProtocolCompiler::orderBlock(QList<ProtocolTrial> trials, QString &currentFile, int &currentWaveform)
+{
+    QList<ProtocolTrial> ordered;
+    if (randomize.contains("Trials"))
+    {
+        ordered = trials;
+        shuffle(ordered);
+    }
+    else
+    {
+        QStringList filenames;
+        QList<QList<ProtocolTrial>> files;
+        for (int i = 0; i < trials.size(); i++)
+        {
+            int index = filenames.indexOf(trials[i].recordingFilename);
+            if (index < 0)
+            {
+                filenames.append(trials[i].recordingFilename);
+                files.append(QList<ProtocolTrial>());
+                index = filenames.size() - 1;
+            }
+            files[index].append(trials[i]);
+        }
+
+        QList<int> order;
+        for (int i = 0; i < files.size(); i++) order.append(i);
+
+        // Few files: try every order. Otherwise continue the current file first and keep declaration order after it.
+        QList<int> bestOrder = order;
+        if (files.size() <= 6)
+        {
+            double bestCost = -1;
+            do
+            {
+                double cost = transitionCost(orderFiles(files, order, currentWaveform, false), currentFile, currentWaveform);
+                if (bestCost < 0 || cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestOrder = order;
+                }
+            } while (std::next_permutation(order.begin(), order.end()));
+        }
+        else if (filenames.contains(currentFile))
+        {
+            bestOrder.removeAll(filenames.indexOf(currentFile));
+            bestOrder.prepend(filenames.indexOf(currentFile));
+        }
+
+        ordered = orderFiles(files, bestOrder, currentWaveform, true);
+    }
+
+    for (int i = 0; i < ordered.size(); i++)
+    {
+        currentFile = ordered[i].recordingFilename;
+        if (ordered[i].waveform >= 0) currentWaveform = ordered[i].waveform;
+    }
+    return ordered;
+}
+
+QList<ProtocolTrial> ProtocolCompiler::orderFiles(const QList<QList<ProtocolTrial>> &files, QList<int> order, int currentWaveform, bool applyRandomization)
+{
+    QList<ProtocolTrial> ordered;
+    for (int i = 0; i < order.size(); i++)
+    {
+        QList<int> nextWaveforms;
+        if (i + 1 < order.size())
+        {
+            const QList<ProtocolTrial> &nextFile = files[order[i + 1]];
+            for (int j = 0; j < nextFile.size(); j++)
+            {
+                if (nextFile[j].waveform >= 0 && !nextWaveforms.contains(nextFile[j].waveform)) nextWaveforms.append(nextFile[j].waveform);
+            }
+        }
+
+        QList<ProtocolTrial> fileTrials = orderFile(files[order[i]], currentWaveform, nextWaveforms, applyRandomization);
+        for (int j = 0; j < fileTrials.size(); j++)
+        {
+            if (fileTrials[j].waveform >= 0) currentWaveform = fileTrials[j].waveform;
+            ordered.append(fileTrials[j]);
+        }
+    }
+    return ordered;
+}
+
+// Within a file, Standard trials need no upload and go first; Novel trials are grouped by waveform so each waveform is
+// uploaded once. The embedded waveform is reused first and one the next file needs is left embedded last.
+QList<ProtocolTrial> ProtocolCompiler::orderFile(QList<ProtocolTrial> trials, int entryWaveform, QList<int> nextWaveforms, bool applyRandomization)
+{
+    QList<ProtocolTrial> standardTrials;
+    QList<int> waveforms;
+    QList<QList<ProtocolTrial>> waveformGroups;
+    for (int i = 0; i < trials.size(); i++)
+    {
+        if (trials[i].waveform < 0)
+        {
+            standardTrials.append(trials[i]);
+            continue;
+        }
+
+        int index = waveforms.indexOf(trials[i].waveform);
+        if (index < 0)
+        {
+            waveforms.append(trials[i].waveform);
+            waveformGroups.append(QList<ProtocolTrial>());
+            index = waveforms.size() - 1;
+        }
+        waveformGroups[index].append(trials[i]);
+    }
+
+    if (applyRandomization && (randomize.contains("Contacts") || randomize.contains("Amplitudes"))) shuffle(standardTrials);
+    if (applyRandomization && randomize.contains("Contacts"))
+    {
+        for (int i = 0; i < waveformGroups.size(); i++) shuffle(waveformGroups[i]);
+    }
+
+    QList<int> order;
+    for (int i = 0; i < waveforms.size(); i++) order.append(i);
+
+    if (applyRandomization && randomize.contains("Waveforms"))
+    {
+        for (int i = order.size() - 1; i > 0; i--) order.swapItemsAt(i, random.bounded(i + 1));
+    }
+    else
+    {
+        int first = waveforms.indexOf(entryWaveform);
+        if (first >= 0)
+        {
+            order.removeAll(first);
+            order.prepend(first);
+        }
+
+        for (int i = 0; i < nextWaveforms.size(); i++)
+        {
+            int last = waveforms.indexOf(nextWaveforms[i]);
+            if (last < 0 || (last == first && order.size() > 1)) continue;
+            order.removeAll(last);
+            order.append(last);
+            break;
+        }
+    }
+
+    QList<ProtocolTrial> ordered = standardTrials;
+    for (int i = 0; i < order.size(); i++) ordered.append(waveformGroups[order[i]]);
+    return ordered;
+}
+
+double ProtocolCompiler::transitionCost(const QList<ProtocolTrial> &trials, QString currentFile, int currentWaveform) const
+{
+    double cost = 0;
+    for (int i = 0; i < trials.size(); i++)
+    {
+        if (trials[i].recordingFilename != currentFile) cost += costs.fileSwitch;
+        if (trials[i].waveform >= 0 && trials[i].waveform != currentWaveform) cost += costs.waveformUpload;
+
+        currentFile = trials[i].recordingFilename;
+        if (trials[i].waveform >= 0) currentWaveform = trials[i].waveform;
+    }
+    return cost;
+}
+
+void ProtocolCompiler::shuffle(QList<ProtocolTrial> &trials)
+{
+    for (int i = trials.size() - 1; i > 0; i--) trials.swapItemsAt(i, random.bounded(i + 1));
+}
+
+void ProtocolCompiler::appendTrial(QJsonArray &sequence, const ProtocolTrial &trial) const
+{
+    sequence.append(trial.stage);
+    if (trial.rest > 0) sequence.append(restStage(trial, trial.rest));
+}
+
+// Rest is a Baseline on the same lead and file, so it never costs a file switch.
+QJsonObject ProtocolCompiler::restStage(const ProtocolTrial &trial, double duration) const
+{
+    QJsonObject stage;
+    stage["StimulationType"] = "Baseline";
+    stage["RecordingFilename"] = trial.recordingFilename;
+    stage["StimulationLead"] = trial.stage["StimulationLead"];
+    stage["StimulationChannel"] = trial.stage["StimulationChannel"];
+    stage["StimulationReturn"] = trial.stage["StimulationReturn"];
+    stage["Duration"] = duration;
+    return stage;
+}
+
+QJsonDocument ProtocolCompiler::compiledDocument() const
+{
+    return compiled;
+}
+
+ProtocolTimeline ProtocolCompiler::timeline() const
+{
+    return predictTimeline(compiled.object()["StimulationSequence"].toArray(), costs);
+}
+
+ProtocolTimeline ProtocolCompiler::declaredTimeline() const
+{
+    return predictTimeline(declaredSequence, costs);
+}
+
+QJsonObject ProtocolCompiler::report() const
+{
+    ProtocolTimeline optimized = timeline();
+    ProtocolTimeline declared = declaredTimeline();
+
+    QJsonObject costObject;
+    costObject["WaveformUpload"] = costs.waveformUpload;
+    costObject["FileSwitch"] = costs.fileSwitch;
+    costObject["ContactStart"] = costs.contactStart;
+
+    QJsonObject report;
+    report["StimulationName"] = compiled.object()["StimulationName"].toString();
+    report["Seed"] = compiled.object()["Seed"];
+    report["Blocks"] = numBlocks;
+    report["Trials"] = numTrials;
+    report["Stages"] = optimized.entries.size();
+    report["ScheduledTime"] = optimized.scheduledTime;
+    report["WaveformUploads"] = optimized.waveformUploads;
+    report["FileSwitches"] = optimized.fileSwitches;
+    report["OverheadTime"] = optimized.overheadTime;
+    report["DeclaredWaveformUploads"] = declared.waveformUploads;
+    report["DeclaredFileSwitches"] = declared.fileSwitches;
+    report["DeclaredOverheadTime"] = declared.overheadTime;
+    report["Costs"] = costObject;
+    report["Timeline"] = timelineToJson(optimized);
+    return report;
+}
+
+QString ProtocolCompiler::errorMessage() const
+{
+    return lastError;
+}
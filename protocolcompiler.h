@@ -0,0 +1,119 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#ifndef PROTOCOLCOMPILER_H
+#define PROTOCOLCOMPILER_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QVector>
+#include <QRandomGenerator>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "sdkinstrumentation.h"
+
+// Seconds spent outside stimulation by the sequencer. Defaults are used until the SDK call statistics have samples.
+typedef struct ProtocolCosts
+{
+    double waveformUpload = 0.5;
+    double fileSwitch = 1.0;
+    double contactStart = 0.02;
+} ProtocolCosts;
+
+// One stimulation condition of a sweep and the rest that follows it. waveform is the StimulationIndex of Novel trials, -1 otherwise.
+typedef struct ProtocolTrial
+{
+    QJsonObject stage;
+    QString recordingFilename = "";
+    int waveform = -1;
+    int contactIndex = 0;
+    int declarationIndex = 0;
+    double rest = 0;
+} ProtocolTrial;
+
+// The sequencer schedules stages on cumulative durations, so overhead spent starting a stage is taken out of that stage.
+typedef struct ProtocolTimelineEntry
+{
+    int stage = 0;
+    QString stimulationType = "";
+    double start = 0;
+    double overhead = 0;
+    double duration = 0;
+    bool waveformUpload = false;
+    bool fileSwitch = false;
+
+    double effectiveDuration() const { return qMax(0.0, duration - overhead); }
+} ProtocolTimelineEntry;
+
+typedef struct ProtocolTimeline
+{
+    QList<ProtocolTimelineEntry> entries;
+    double scheduledTime = 0;
+    double overheadTime = 0;
+    int waveformUploads = 0;
+    int fileSwitches = 0;
+} ProtocolTimeline;
+
+// Compiles a declarative sweep ("Sweeps": contacts x waveforms or amplitudes, "Repetitions", "Randomize", rests) into the
+// "StimulationSequence" the sequencer runs. Each repetition is a randomization block; inside a block, trials sharing a
+// recording file and waveform are kept together and files and waveforms are ordered so that the fewest LoadWaveToEmbedded
+// uploads and StopSave/StartSave switches are needed. "Randomize" shuffles, with "Seed", only inside those groups:
+// "Contacts", "Amplitudes" and "Waveforms" (the waveform order within a file), or "Trials" for a full shuffle of the block.
+class ProtocolCompiler
+{
+public:
+    ProtocolCompiler();
+
+    void setCosts(ProtocolCosts costs);
+    bool compile(QJsonObject sweepDefinition);
+
+    QJsonDocument compiledDocument() const;
+    ProtocolTimeline timeline() const;
+    ProtocolTimeline declaredTimeline() const;
+    QJsonObject report() const;
+    QString errorMessage() const;
+
+    static bool isSweep(QJsonObject definition);
+    static ProtocolCosts measuredCosts(ProtocolCosts fallback = ProtocolCosts());
+    static ProtocolTimeline predictTimeline(QJsonArray stimulationSequence, ProtocolCosts costs);
+    static QJsonArray timelineToJson(const ProtocolTimeline &timeline);
+
+private:
+    bool expandSweep(QJsonObject sweep, int sweepIndex, QList<ProtocolTrial> &trials);
+    QList<ProtocolTrial> orderBlock(QList<ProtocolTrial> trials, QString &currentFile, int &currentWaveform);
+    QList<ProtocolTrial> orderFiles(const QList<QList<ProtocolTrial>> &files, QList<int> order, int currentWaveform, bool applyRandomization);
+    QList<ProtocolTrial> orderFile(QList<ProtocolTrial> trials, int entryWaveform, QList<int> nextWaveforms, bool applyRandomization);
+    double transitionCost(const QList<ProtocolTrial> &trials, QString currentFile, int currentWaveform) const;
+    void shuffle(QList<ProtocolTrial> &trials);
+    void appendTrial(QJsonArray &sequence, const ProtocolTrial &trial) const;
+    QJsonObject restStage(const ProtocolTrial &trial, double duration) const;
+
+    ProtocolCosts costs;
+    QStringList randomize;
+    QRandomGenerator random;
+
+    QJsonDocument compiled;
+    QJsonArray declaredSequence;
+    int numWaveforms = -1;
+    int numTrials = 0;
+    int numBlocks = 0;
+    QString lastError;
+};
+
+#endif // PROTOCOLCOMPILER_H
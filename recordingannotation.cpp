@@ -24,18 +24,8 @@ RecordingAnnotation::RecordingAnnotation(QWidget *parent) :
 {
     ui->setupUi(this);
 
-    QFile file;
-    file.setFileName(QDir::currentPath() + "/InterfaceConfigurations.json");
-    if (!file.open(QIODevice::ReadOnly)) return;
-    QByteArray configurationData = file.readAll();
-
-    QJsonDocument loadedDocument = QJsonDocument::fromJson(configurationData);
-    if (loadedDocument.isObject())
-    {
-        QJsonObject documentObject = loadedDocument.object();
-        if (documentObject.contains("TaskDefinitions")) taskDefinitions = loadedDocument.object()["TaskDefinitions"].toObject();
-    }
-
+    // Task names and documents are parsed once by InterfaceConfiguration, so opening this dialog reads no files
+    const QList<TaskDefinition> &taskDefinitions = InterfaceConfiguration::instance()->tasks();
     if (!taskDefinitions.isEmpty())
     {
         QPushButton* buttons[6] = {ui->RecordingAnnotationSelect, ui->RecordingAnnotationSelect_2, ui->RecordingAnnotationSelect_3,
@@ -43,9 +33,9 @@ RecordingAnnotation::RecordingAnnotation(QWidget *parent) :
         for (int i = 0; i < 6; i++)
         {
             buttons[i]->setVisible(false);
-            if (i < taskDefinitions.keys().size())
+            if (i < taskDefinitions.size())
             {
-                buttons[i]->setText(taskDefinitions.keys()[i]);
+                buttons[i]->setText(taskDefinitions[i].taskName);
                 buttons[i]->setVisible(true);
             }
         }
@@ -68,16 +58,8 @@ void RecordingAnnotation::on_RecordingAnnotation_clicked()
     annotation = buttonClicked->text();
 
     QJsonDocument loadedDocument = QJsonDocument();
-    if (!taskDefinitions.isEmpty())
-    {
-        QFile file;
-        file.setFileName(QDir::currentPath() + "/" + taskDefinitions[annotation].toString());
-        if (file.open(QIODevice::ReadOnly))
-        {
-            QByteArray configurationData = file.readAll();
-            loadedDocument = QJsonDocument::fromJson(configurationData);
-        }
-    }
+    const TaskDefinition *task = InterfaceConfiguration::instance()->task(annotation);
+    if (task != nullptr) loadedDocument = task->taskDocument;
 
     emit channelIDsUpdate(annotation, loadedDocument);
     this->close();
@@ -24,6 +24,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <QJsonDocument>
 #include <QJsonObject>
 
+#include "interfaceconfiguration.h"
+
 namespace Ui {
 class RecordingAnnotation;
 }
@@ -45,7 +47,6 @@ signals:
 
 private:
     Ui::RecordingAnnotation *ui;
-    QJsonObject taskDefinitions;
 
     QString annotation = "No Annotation";
 };
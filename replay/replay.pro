@@ -0,0 +1,110 @@
+#-------------------------------------------------
+#
+# Headless session replay harness. Drives ControllerForm from a recorded
+# JSONStorage session log against the simulator SDK:
+#   qmake replay.pro && make
+#   ./NeuroOmega_Replay --speed 10 --output ReplayReport.json session.json
+# Run it from a directory holding defaultSettings.ini, InterfaceConfigurations.json
+# and SimulatorConfiguration.json, as for the application itself.
+#
+#-------------------------------------------------
+
+QT       += core gui widgets sql
+
+TARGET = NeuroOmega_Replay
+TEMPLATE = app
+CONFIG += c++17
+
+DEFINES += QT_DEPRECATED_WARNINGS NEUROOMEGA_SIMULATOR
+
+INCLUDEPATH += $$PWD/.. \
+    $$PWD/../NeuroOmega_SDK/Include \
+    $$PWD/../NeuroOmega_Simulator
+!win32: INCLUDEPATH += $$PWD/../NeuroOmega_Simulator/compat
+win32: LIBS += -lpsapi
+
+SOURCES += replaymain.cpp \
+    sessionreplay.cpp \
+    ../NeuroOmega_Simulator/neuroomegasimulator.cpp \
+    ../electrodeconfigurations.cpp \
+    ../jsonstorage.cpp \
+    ../controllerform.cpp \
+    ../channelselectiondialog.cpp \
+    ../detailchannelslist.cpp \
+    ../recordingannotation.cpp \
+    ../manuallabelentry.cpp \
+    ../novelstimulationconfiguration.cpp \
+    ../filtergraph.cpp \
+    ../workerthread.cpp \
+    ../rereferencemontage.cpp \
+    ../latencyhistogram.cpp \
+    ../closedloopcontroller.cpp \
+    ../merprofilebuilder.cpp \
+    ../contactqualityestimator.cpp \
+    ../sdkinstrumentation.cpp \
+    ../sdkdiagnosticsdialog.cpp \
+    ../eventloopprofiler.cpp \
+    ../devicestatemachine.cpp \
+    ../channelcatalog.cpp \
+    ../channelconfigurationengine.cpp \
+    ../channeltablemodel.cpp \
+    ../traceviewer.cpp \
+    ../contactselectionmodel.cpp \
+    ../electrodegridwidget.cpp \
+    ../streamingstft.cpp \
+    ../spectrogramview.cpp \
+    ../interfaceconfiguration.cpp \
+    ../startupwarmup.cpp \
+    ../sessioncatalog.cpp \
+    ../shadowrecordingwriter.cpp \
+    ../clocksynchronizer.cpp \
+    ../labeldispatcher.cpp \
+    ../protocolcompiler.cpp \
+    ../streamdatahandler.cpp
+
+HEADERS += sessionreplay.h \
+    ../NeuroOmega_Simulator/neuroomegasimulator.h \
+    ../electrodeconfigurations.h \
+    ../jsonstorage.h \
+    ../controllerform.h \
+    ../channelselectiondialog.h \
+    ../detailchannelslist.h \
+    ../recordingannotation.h \
+    ../manuallabelentry.h \
+    ../novelstimulationconfiguration.h \
+    ../filtergraph.h \
+    ../workerthread.h \
+    ../rereferencemontage.h \
+    ../latencyhistogram.h \
+    ../closedloopcontroller.h \
+    ../merprofilebuilder.h \
+    ../contactqualityestimator.h \
+    ../sdkinstrumentation.h \
+    ../sdkdiagnosticsdialog.h \
+    ../eventloopprofiler.h \
+    ../devicestatemachine.h \
+    ../channelcatalog.h \
+    ../channelconfigurationengine.h \
+    ../channeltablemodel.h \
+    ../traceviewer.h \
+    ../contactselectionmodel.h \
+    ../electrodegridwidget.h \
+    ../streamingstft.h \
+    ../spectrogramview.h \
+    ../interfaceconfiguration.h \
+    ../startupwarmup.h \
+    ../sessioncatalog.h \
+    ../shadowrecordingwriter.h \
+    ../clocksynchronizer.h \
+    ../labeldispatcher.h \
+    ../protocolcompiler.h \
+    ../streamdatahandler.h
+
+FORMS += ../electrodeconfigurations.ui \
+    ../controllerform.ui \
+    ../channelselectiondialog.ui \
+    ../detailchannelslist.ui \
+    ../recordingannotation.ui \
+    ../manuallabelentry.ui \
+    ../novelstimulationconfiguration.ui \
+    ../sdkdiagnosticsdialog.ui
@@ -0,0 +1,92 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+
+#include "sessionreplay.h"
+#include "sdkinstrumentation.h"
+
+// Headless replay of a recorded session against the simulator:
+//   NeuroOmega_Replay [--speed 10] [--output ReplayReport.json] [--show] session.json
+int main(int argc, char *argv[])
+{
+    bool showController = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (QString(argv[i]) == "--show") showController = true;
+    }
+    if (!showController && !qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication application(argc, argv);
+    QCoreApplication::setApplicationName("NeuroOmega_Replay");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays a JSONStorage session log through ControllerForm against the simulated NeuroOmega.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("session", "Session JSON written by the application.");
+    parser.addOption(QCommandLineOption("speed", "Replay speed, 1 is real time.", "factor", "1"));
+    parser.addOption(QCommandLineOption("output", "Replay report file.", "file", "ReplayReport.json"));
+    parser.addOption(QCommandLineOption("memory-interval", "Seconds between memory samples.", "seconds", "10"));
+    parser.addOption(QCommandLineOption("show", "Show the controller window instead of rendering offscreen."));
+    parser.process(application);
+
+    if (parser.positionalArguments().isEmpty()) parser.showHelp(1);
+
+    SessionReplay sessionReplay;
+    if (!sessionReplay.loadSession(parser.positionalArguments().first()))
+    {
+        QTextStream(stderr) << sessionReplay.errorMessage() << Qt::endl;
+        return 1;
+    }
+
+    MAC_ADDR sysMACAddress = {0};
+    if (AO_CALL(DefaultStartConnection)(&sysMACAddress, nullptr) != eAO_OK)
+    {
+        QTextStream(stderr) << "Cannot connect to the simulator" << Qt::endl;
+        return 1;
+    }
+
+    ControllerForm *controllerForm = new ControllerForm();
+    controllerForm->setReplayMode(true);
+    controllerForm->controllerInitialization("Replay", sessionReplay.sessionDiagnosis().toStdString());
+    controllerForm->configureElectrodes(sessionReplay.electrodeConfiguration());
+    if (showController) controllerForm->show();
+
+    QString outputFilename = parser.value("output");
+    QObject::connect(&sessionReplay, &SessionReplay::finished, &application, [&]() {
+        // Closing runs the controller's own clean-up, including the session log save
+        controllerForm->close();
+
+        QFile file(outputFilename);
+        if (file.open(QFile::WriteOnly | QFile::Truncate))
+        {
+            file.write(QJsonDocument(sessionReplay.report()).toJson());
+            file.close();
+        }
+
+        AO_CALL(AO_Exit)();
+        application.quit();
+    });
+
+    sessionReplay.start(controllerForm, parser.value("speed").toDouble(), parser.value("memory-interval").toDouble());
+    int result = application.exec();
+    delete controllerForm;
+    return result;
+}
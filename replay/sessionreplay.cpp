@@ -0,0 +1,309 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#include "sessionreplay.h"
+#include "sdkinstrumentation.h"
+
+#include <algorithm>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+SessionReplay::SessionReplay(QObject *parent) :
+    QObject(parent)
+{
+    eventLoopStall = new LatencyHistogram();
+    eventDispatch = new LatencyHistogram();
+
+    eventTimer.setSingleShot(true);
+    eventTimer.setTimerType(Qt::PreciseTimer);
+    stallTimer.setTimerType(Qt::PreciseTimer);
+    connect(&eventTimer, &QTimer::timeout, this, &SessionReplay::dispatchEvents);
+    connect(&stallTimer, &QTimer::timeout, this, &SessionReplay::checkEventLoop);
+    connect(&memoryTimer, &QTimer::timeout, this, &SessionReplay::sampleMemory);
+}
+
+SessionReplay::~SessionReplay()
+{
+    delete eventLoopStall;
+    delete eventDispatch;
+}
+
+// Read a session written by JSONStorage. Entries are ordered by their "Time" stamp (one second resolution),
+// keeping file order within the same second. Entries tagged with a "DeviceSample" are placed at sample resolution
+// relative to the first tagged entry.
+bool SessionReplay::loadSession(QString filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        lastError = "Cannot open " + filename;
+        return false;
+    }
+
+    QJsonDocument loadedDocument = QJsonDocument::fromJson(file.readAll());
+    if (!loadedDocument.isArray())
+    {
+        lastError = "Session log is not a JSON array";
+        return false;
+    }
+
+    sessionFilename = filename;
+    events.clear();
+    QJsonArray sessionArray = loadedDocument.array();
+    QDateTime sessionStart;
+    qint64 deviceAnchor = -1;
+    qint64 deviceAnchorOffset = 0;
+    for (int i = 0; i < sessionArray.size(); i++)
+    {
+        QJsonObject entry = sessionArray[i].toObject();
+        QDateTime entryTime = QDateTime::fromString(entry["Time"].toString(), "yyyy/MM/dd HH:mm:ss");
+        if (!entryTime.isValid()) continue;
+        if (!sessionStart.isValid()) sessionStart = entryTime;
+
+        if (entry.contains("Diagnosis")) diagnosis = entry["Diagnosis"].toString();
+        if (entry["ObjectType"].toString() == "ElectrodeConfigurations" && electrodeObject.isEmpty()) electrodeObject = entry;
+
+        ReplayEvent replayEvent;
+        replayEvent.offset = qMax((qint64)0, sessionStart.msecsTo(entryTime));
+        if (entry["ObjectType"].toString() == "ClockSynchronizationLost") deviceAnchor = -1;
+        if (entry.contains("DeviceSample"))
+        {
+            qint64 deviceSample = entry["DeviceSample"].toVariant().toLongLong();
+            if (deviceAnchor < 0)
+            {
+                deviceAnchor = deviceSample;
+                deviceAnchorOffset = replayEvent.offset;
+            }
+            replayEvent.offset = qMax((qint64)0, deviceAnchorOffset + (deviceSample - deviceAnchor) * 1000 / NEUROOMEGA_SAMPLING_RATE);
+        }
+        replayEvent.event = entry;
+        events.append(replayEvent);
+    }
+    std::stable_sort(events.begin(), events.end(), [](const ReplayEvent &a, const ReplayEvent &b) {
+        return a.offset < b.offset;
+    });
+
+    // Stimulation duration is not logged; it is the time until the next stimulation change.
+    for (int i = 0; i < events.size(); i++)
+    {
+        if (events[i].event["ObjectType"].toString() != "StimulationOn") continue;
+        events[i].stimulationDuration = 30;
+        for (int j = i + 1; j < events.size(); j++)
+        {
+            QString objectType = events[j].event["ObjectType"].toString();
+            if (objectType == "StimulationOff" || objectType == "StimulationOn")
+            {
+                events[i].stimulationDuration = (events[j].offset - events[i].offset) / 1000.0 + 1;
+                break;
+            }
+        }
+    }
+
+    if (events.isEmpty())
+    {
+        lastError = "Session log has no timestamped entries";
+        return false;
+    }
+    return true;
+}
+
+// The session log only keeps "Type Hemisphere Target" per lead, so channels are re-assigned in lead order
+// from the first ECoG HF input, and layouts come from the ElectrodeDefinitions in InterfaceConfigurations.json.
+QList<ElectrodeInformation> SessionReplay::electrodeConfiguration()
+{
+    const QList<ElectrodeDefinition> &electrodeDefinitions = InterfaceConfiguration::instance()->electrodeDefinitions();
+
+    int numLeads = 0;
+    QStringList leadKeys = electrodeObject.keys();
+    for (int i = 0; i < leadKeys.size(); i++)
+    {
+        if (leadKeys[i].startsWith("Lead")) numLeads = qMax(numLeads, leadKeys[i].mid(4).toInt());
+    }
+
+    QList<ElectrodeInformation> electrodes;
+    int nextChannelID = 10272;
+    for (int i = 0; i < numLeads; i++)
+    {
+        ElectrodeInformation electrode;
+        electrode.electrodeType = "None";
+        electrode.verified = true;
+
+        // Only known electrodes are replayed; their contact count and layout come from the definition
+        QString electrodeName, hemisphere, target;
+        const ElectrodeDefinition *definition = nullptr;
+        QString leadDescription = electrodeObject["Lead" + QString::number(i+1)].toString();
+        if (ElectrodeConfigurations::parseLead(leadDescription, electrodeDefinitions, electrodeName, hemisphere, target, &definition) && definition != nullptr)
+        {
+            electrode.electrodeType = electrodeName;
+            electrode.hemisphere = hemisphere;
+            electrode.target = target;
+            electrode.numContacts = definition->channelCount;
+            for (int k = 0; k < 2; k++) electrode.layoutSize[k] = definition->arrange[k];
+        }
+
+        electrode.channelIDs.clear();
+        for (int j = 0; j < electrode.numContacts; j++) electrode.channelIDs.append(nextChannelID++);
+        electrodes.append(electrode);
+    }
+    return electrodes;
+}
+
+QString SessionReplay::sessionDiagnosis() const
+{
+    return diagnosis;
+}
+
+QString SessionReplay::errorMessage() const
+{
+    return lastError;
+}
+
+void SessionReplay::start(ControllerForm *controllerForm, double speed, double memoryInterval)
+{
+    this->controllerForm = controllerForm;
+    this->speed = qMax(0.001, speed);
+    nextEvent = 0;
+    replayedEvents = 0;
+    skippedEvents = 0;
+    eventLoopStall->reset();
+    eventDispatch->reset();
+    memorySamples = QJsonArray();
+    peakMemory = 0;
+
+    replayClock.start();
+    lastStallCheck = replayClock.nsecsElapsed();
+    sampleMemory();
+
+    stallTimer.start(stallInterval);
+    memoryTimer.start((int)(memoryInterval * 1000));
+    eventTimer.start(0);
+}
+
+// Dispatch every event that is due, then sleep until the next one.
+void SessionReplay::dispatchEvents()
+{
+    while (nextEvent < events.size() && replayClock.elapsed() >= events[nextEvent].offset / speed)
+    {
+        qint64 dispatchStart = monotonicNanoseconds();
+        bool applied = controllerForm->replaySessionEvent(events[nextEvent].event, events[nextEvent].stimulationDuration / speed);
+        if (applied)
+        {
+            eventDispatch->record(monotonicNanoseconds() - dispatchStart);
+            replayedEvents++;
+        }
+        else
+        {
+            skippedEvents++;
+        }
+        nextEvent++;
+    }
+
+    if (nextEvent >= events.size())
+    {
+        stallTimer.stop();
+        memoryTimer.stop();
+        sampleMemory();
+        emit finished();
+        return;
+    }
+
+    qint64 untilNext = (qint64)(events[nextEvent].offset / speed) - replayClock.elapsed();
+    eventTimer.start((int)qBound((qint64)0, untilNext, (qint64)1000));
+}
+
+void SessionReplay::checkEventLoop()
+{
+    qint64 now = replayClock.nsecsElapsed();
+    qint64 lateness = now - lastStallCheck - (qint64)stallInterval * 1000000;
+    eventLoopStall->record(qMax((qint64)0, lateness));
+    lastStallCheck = now;
+}
+
+void SessionReplay::sampleMemory()
+{
+    qint64 memory = residentMemory();
+    peakMemory = qMax(peakMemory, memory);
+    memorySamples.append(QJsonArray{replayClock.elapsed() / 1000.0, memory / 1048576.0});
+}
+
+// Resident set size of this process in bytes, 0 where it cannot be read.
+qint64 SessionReplay::residentMemory()
+{
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS memoryCounters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &memoryCounters, sizeof(memoryCounters))) return (qint64) memoryCounters.WorkingSetSize;
+    return 0;
+#else
+    QFile file("/proc/self/statm");
+    if (!file.open(QIODevice::ReadOnly)) return 0;
+    QList<QByteArray> fields = file.readAll().split(' ');
+    if (fields.size() < 2) return 0;
+    return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+QJsonObject SessionReplay::report()
+{
+    QJsonObject reportObject;
+    reportObject["ObjectType"] = QJsonValue("SessionReplay");
+    reportObject["Session"] = QJsonValue(sessionFilename);
+    reportObject["Speed"] = QJsonValue(speed);
+    reportObject["Events"] = QJsonValue(events.size());
+    reportObject["ReplayedEvents"] = QJsonValue(replayedEvents);
+    reportObject["SkippedEvents"] = QJsonValue(skippedEvents);
+    reportObject["SessionSeconds"] = QJsonValue(events.isEmpty() ? 0 : events.last().offset / 1000.0);
+    reportObject["WallSeconds"] = QJsonValue(replayClock.elapsed() / 1000.0);
+    if (controllerForm != nullptr)
+    {
+        reportObject["ControllerErrors"] = QJsonValue(controllerForm->replayErrorCount());
+        reportObject["ReplayErrors"] = QJsonArray::fromStringList(controllerForm->replayErrorMessages());
+    }
+
+    reportObject["EventLoopStall"] = eventLoopStall->toJson();
+    reportObject["EventDispatch"] = eventDispatch->toJson();
+
+    // Growth is the least-squares slope of resident memory over the replay, in MB per hour of wall time
+    QJsonObject memoryObject;
+    double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    int numSamples = memorySamples.size();
+    for (int i = 0; i < numSamples; i++)
+    {
+        double x = memorySamples[i].toArray()[0].toDouble() / 3600.0;
+        double y = memorySamples[i].toArray()[1].toDouble();
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+    }
+    double denominator = numSamples * sumXX - sumX * sumX;
+    memoryObject["GrowthMBPerHour"] = QJsonValue(numSamples > 1 && denominator > 0 ? (numSamples * sumXY - sumX * sumY) / denominator : 0);
+    memoryObject["StartMB"] = QJsonValue(numSamples > 0 ? memorySamples.first().toArray()[1].toDouble() : 0);
+    memoryObject["EndMB"] = QJsonValue(numSamples > 0 ? memorySamples.last().toArray()[1].toDouble() : 0);
+    memoryObject["PeakMB"] = QJsonValue(peakMemory / 1048576.0);
+    memoryObject["Samples"] = memorySamples;
+    reportObject["Memory"] = memoryObject;
+
+    reportObject["SDKInstrumentation"] = SDKInstrumentation::instance()->toJson();
+
+    QDateTime currentTime;
+    reportObject["Time"] = QJsonValue(currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss"));
+    return reportObject;
+}
@@ -0,0 +1,95 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#ifndef SESSIONREPLAY_H
+#define SESSIONREPLAY_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "controllerform.h"
+#include "latencyhistogram.h"
+
+// One operator action from a JSONStorage session log. Offset is milliseconds of session time from the first entry.
+typedef struct ReplayEvent
+{
+    qint64 offset = 0;
+    double stimulationDuration = 0;
+    QJsonObject event;
+} ReplayEvent;
+
+// Feeds a recorded session back through ControllerForm at real-time or accelerated speed while measuring
+// GUI event-loop stalls, event handling time and process memory. SDK latency comes from SDKInstrumentation.
+class SessionReplay : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SessionReplay(QObject *parent = nullptr);
+    ~SessionReplay();
+
+    bool loadSession(QString filename);
+    QList<ElectrodeInformation> electrodeConfiguration();
+    QString sessionDiagnosis() const;
+    QString errorMessage() const;
+
+    void start(ControllerForm *controllerForm, double speed, double memoryInterval = 10);
+    QJsonObject report();
+
+    static qint64 residentMemory();
+
+signals:
+    void finished();
+
+private slots:
+    void dispatchEvents();
+    void checkEventLoop();
+    void sampleMemory();
+
+private:
+    ControllerForm *controllerForm = nullptr;
+    QString sessionFilename = "";
+    QString diagnosis = "";
+    QJsonObject electrodeObject;
+    QList<ReplayEvent> events;
+    int nextEvent = 0;
+    int replayedEvents = 0;
+    int skippedEvents = 0;
+    double speed = 1;
+    QString lastError = "";
+
+    QTimer eventTimer;
+    QTimer stallTimer;
+    QTimer memoryTimer;
+    QElapsedTimer replayClock;
+    qint64 lastStallCheck = 0;
+
+    // Expected period of the stall probe. Anything the GUI thread spends beyond it is counted as a stall.
+    int stallInterval = 10;
+
+    LatencyHistogram *eventLoopStall;
+    LatencyHistogram *eventDispatch;
+    QJsonArray memorySamples;
+    qint64 peakMemory = 0;
+};
+
+#endif // SESSIONREPLAY_H
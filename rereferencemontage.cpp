@@ -0,0 +1,239 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "rereferencemontage.h"
+
+RereferenceMontage::RereferenceMontage()
+{
+
+}
+
+// Contacts are laid out the same way as the ECoG contacts on the ControllerForm electrode grid: down each column of layoutSize[1] rows.
+bool RereferenceMontage::gridPosition(const ElectrodeInformation &electrode, int contact, int *row, int *column)
+{
+    int rowsPerColumn = electrode.layoutSize[1] > 0 ? electrode.layoutSize[1] : electrode.numContacts;
+    if (contact < 0 || contact >= electrode.numContacts || rowsPerColumn <= 0) return false;
+
+    *row = contact % rowsPerColumn;
+    *column = contact / rowsPerColumn;
+    return true;
+}
+
+int RereferenceMontage::gridContact(const ElectrodeInformation &electrode, int row, int column)
+{
+    int rowsPerColumn = electrode.layoutSize[1] > 0 ? electrode.layoutSize[1] : electrode.numContacts;
+    if (row < 0 || column < 0 || row >= rowsPerColumn) return -1;
+
+    int contact = column * rowsPerColumn + row;
+    if (contact >= electrode.numContacts) return -1;
+    return contact;
+}
+
+// Build the montage for every lead whose electrodeType contains leadFilter. Contacts that are not in the stream are skipped.
+// Without electrode definitions the montage falls back to the whole stream as one strip. A case without any matching
+// lead gives an empty montage, which is valid. Only an unknown montage type is an error.
+bool RereferenceMontage::build(QString montageType, QVector<int> streamChannels, QList<ElectrodeInformation> electrodes, QString leadFilter)
+{
+    this->type = montageType;
+    rows.clear();
+    referenceGroups.clear();
+
+    if (electrodes.isEmpty())
+    {
+        ElectrodeInformation wholeStream;
+        wholeStream.electrodeType = leadFilter;
+        wholeStream.channelIDs = streamChannels;
+        wholeStream.numContacts = streamChannels.size();
+        electrodes.append(wholeStream);
+    }
+
+    for (int i = 0; i < electrodes.size(); i++)
+    {
+        if (!electrodes[i].electrodeType.contains(leadFilter)) continue;
+
+        if (montageType == "CommonAverage") addCommonAverage(electrodes[i], i, streamChannels);
+        else if (montageType == "Bipolar") addBipolar(electrodes[i], i, streamChannels);
+        else if (montageType == "Laplacian") addLaplacian(electrodes[i], i, streamChannels);
+        else return false;
+    }
+
+    groupMeans.fill(0, referenceGroups.size() * tileSamples);
+    return true;
+}
+
+void RereferenceMontage::addCommonAverage(const ElectrodeInformation &electrode, int leadID, QVector<int> streamChannels)
+{
+    QVector<int> group;
+    for (int j = 0; j < electrode.channelIDs.size() && j < electrode.numContacts; j++)
+    {
+        int index = streamChannels.indexOf(electrode.channelIDs[j]);
+        if (index >= 0) group.append(index);
+    }
+    if (group.size() < 2) return;
+
+    referenceGroups.append(group);
+    for (int j = 0; j < electrode.channelIDs.size() && j < electrode.numContacts; j++)
+    {
+        int index = streamChannels.indexOf(electrode.channelIDs[j]);
+        if (index < 0) continue;
+
+        MontageRow row;
+        row.inputs.append(index);
+        row.weights.append(1);
+        row.referenceGroup = referenceGroups.size() - 1;
+        row.channelID = electrode.channelIDs[j];
+        row.label = QString("Lead_%1_%2-CAR").arg(leadID + 1).arg(j);
+        rows.append(row);
+    }
+}
+
+// Nearest neighbours down each column first, then across columns. Column pairs keep the anchor contact's channelID,
+// row pairs are offset by MONTAGE_ROW_PAIR_CHANNEL_OFFSET.
+void RereferenceMontage::addBipolar(const ElectrodeInformation &electrode, int leadID, QVector<int> streamChannels)
+{
+    const int offsets[2][2] = {{1, 0}, {0, 1}};
+    for (int k = 0; k < 2; k++)
+    {
+        for (int j = 0; j < electrode.channelIDs.size() && j < electrode.numContacts; j++)
+        {
+            int row, column;
+            if (!gridPosition(electrode, j, &row, &column)) continue;
+
+            int neighbour = gridContact(electrode, row + offsets[k][0], column + offsets[k][1]);
+            if (neighbour < 0 || neighbour >= electrode.channelIDs.size()) continue;
+
+            int index = streamChannels.indexOf(electrode.channelIDs[j]);
+            int neighbourIndex = streamChannels.indexOf(electrode.channelIDs[neighbour]);
+            if (index < 0 || neighbourIndex < 0) continue;
+
+            MontageRow montageRow;
+            montageRow.inputs << index << neighbourIndex;
+            montageRow.weights << 1 << -1;
+            montageRow.channelID = electrode.channelIDs[j] + k * MONTAGE_ROW_PAIR_CHANNEL_OFFSET;
+            montageRow.label = QString("Lead_%1_%2-%3").arg(leadID + 1).arg(j).arg(neighbour);
+            rows.append(montageRow);
+        }
+    }
+}
+
+// Small Laplacian: contact minus the mean of its 4-connected neighbours that are present on the grid.
+void RereferenceMontage::addLaplacian(const ElectrodeInformation &electrode, int leadID, QVector<int> streamChannels)
+{
+    const int offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    for (int j = 0; j < electrode.channelIDs.size() && j < electrode.numContacts; j++)
+    {
+        int row, column;
+        if (!gridPosition(electrode, j, &row, &column)) continue;
+
+        int index = streamChannels.indexOf(electrode.channelIDs[j]);
+        if (index < 0) continue;
+
+        QVector<int> neighbours;
+        for (int k = 0; k < 4; k++)
+        {
+            int neighbour = gridContact(electrode, row + offsets[k][0], column + offsets[k][1]);
+            if (neighbour < 0 || neighbour >= electrode.channelIDs.size()) continue;
+
+            int neighbourIndex = streamChannels.indexOf(electrode.channelIDs[neighbour]);
+            if (neighbourIndex >= 0) neighbours.append(neighbourIndex);
+        }
+        if (neighbours.isEmpty()) continue;
+
+        MontageRow montageRow;
+        montageRow.inputs.append(index);
+        montageRow.weights.append(1);
+        for (int k = 0; k < neighbours.size(); k++)
+        {
+            montageRow.inputs.append(neighbours[k]);
+            montageRow.weights.append(-1.0f / neighbours.size());
+        }
+        montageRow.channelID = electrode.channelIDs[j];
+        montageRow.label = QString("Lead_%1_%2-LAP").arg(leadID + 1).arg(j);
+        rows.append(montageRow);
+    }
+}
+
+// Blocked sparse matrix-vector kernel. The block is processed in tiles of tileSamples so the group means and the
+// handful of input rows touched by each output stay cache resident; every output sample is written exactly once.
+void RereferenceMontage::apply(const SignalBlock &input, float *output, int outputStride)
+{
+    for (int tileStart = 0; tileStart < input.numSamples; tileStart += tileSamples)
+    {
+        int length = qMin(tileSamples, input.numSamples - tileStart);
+
+        for (int g = 0; g < referenceGroups.size(); g++)
+        {
+            float *mean = groupMeans.data() + g * tileSamples;
+            const QVector<int> &group = referenceGroups[g];
+            memset(mean, 0, sizeof(float) * length);
+            for (int k = 0; k < group.size(); k++)
+            {
+                const float *x = input.channel(group[k]) + tileStart;
+                for (int n = 0; n < length; n++) mean[n] += x[n];
+            }
+            float scale = 1.0f / group.size();
+            for (int n = 0; n < length; n++) mean[n] *= scale;
+        }
+
+        for (int r = 0; r < rows.size(); r++)
+        {
+            const MontageRow &row = rows[r];
+            float *y = output + (qsizetype)r * outputStride + tileStart;
+
+            const float *x = input.channel(row.inputs[0]) + tileStart;
+            float weight = row.weights[0];
+            for (int n = 0; n < length; n++) y[n] = weight * x[n];
+
+            for (int k = 1; k < row.inputs.size(); k++)
+            {
+                x = input.channel(row.inputs[k]) + tileStart;
+                weight = row.weights[k];
+                for (int n = 0; n < length; n++) y[n] += weight * x[n];
+            }
+
+            if (row.referenceGroup >= 0)
+            {
+                const float *mean = groupMeans.constData() + row.referenceGroup * tileSamples;
+                for (int n = 0; n < length; n++) y[n] -= mean[n];
+            }
+        }
+    }
+}
+
+int RereferenceMontage::numOutputs() const
+{
+    return rows.size();
+}
+
+QVector<int> RereferenceMontage::channelIDs() const
+{
+    QVector<int> channelIDs;
+    for (int i = 0; i < rows.size(); i++) channelIDs.append(rows[i].channelID);
+    return channelIDs;
+}
+
+QStringList RereferenceMontage::labels() const
+{
+    QStringList labels;
+    for (int i = 0; i < rows.size(); i++) labels.append(rows[i].label);
+    return labels;
+}
+
+QString RereferenceMontage::montageType() const
+{
+    return type;
+}
@@ -0,0 +1,76 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef REREFERENCEMONTAGE_H
+#define REREFERENCEMONTAGE_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QList>
+
+#include "electrodeconfigurations.h"
+#include "streamdatahandler.h"
+
+// Bipolar pairs across columns are numbered from this offset, so they never share a channelID with the pair down the
+// column from the same anchor contact (stream channel IDs stay well below it).
+#define MONTAGE_ROW_PAIR_CHANNEL_OFFSET 100000
+
+// One derived channel: a sparse weighted sum of stream channels, optionally minus the mean of a reference group.
+typedef struct MontageRow
+{
+    QVector<int> inputs;
+    QVector<float> weights;
+    int referenceGroup = -1;
+    int channelID = 0;
+    QString label = "";
+} MontageRow;
+
+// Re-referencing montage for ECoG grids recorded monopolar on channels 10272-10335.
+// The montage is a (derived x stream) matrix stored in sparse rows, with common-average references
+// factored out as shared group means so the cost stays O(contacts) per sample instead of O(contacts^2).
+class RereferenceMontage
+{
+public:
+    RereferenceMontage();
+
+    bool build(QString montageType, QVector<int> streamChannels, QList<ElectrodeInformation> electrodes, QString leadFilter = "ECoG");
+    void apply(const SignalBlock &input, float *output, int outputStride);
+
+    int numOutputs() const;
+    QVector<int> channelIDs() const;
+    QStringList labels() const;
+    QString montageType() const;
+
+    static bool gridPosition(const ElectrodeInformation &electrode, int contact, int *row, int *column);
+    static int gridContact(const ElectrodeInformation &electrode, int row, int column);
+
+private:
+    void addCommonAverage(const ElectrodeInformation &electrode, int leadID, QVector<int> streamChannels);
+    void addBipolar(const ElectrodeInformation &electrode, int leadID, QVector<int> streamChannels);
+    void addLaplacian(const ElectrodeInformation &electrode, int leadID, QVector<int> streamChannels);
+
+    QString type;
+    QList<MontageRow> rows;
+    QList<QVector<int>> referenceGroups;
+
+    // Samples per tile. 128 samples x 64 channels of float stays inside L2 while the tile is re-read per output row.
+    int tileSamples = 128;
+    QVector<float> groupMeans;
+};
+
+#endif // REREFERENCEMONTAGE_H
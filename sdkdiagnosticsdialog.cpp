@@ -0,0 +1,85 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#include "sdkdiagnosticsdialog.h"
+#include "ui_sdkdiagnosticsdialog.h"
+
+SDKDiagnosticsDialog::SDKDiagnosticsDialog(QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::SDKDiagnosticsDialog)
+{
+    ui->setupUi(this);
+
+    QStringList headerNames = {"Function", "Calls", "Rate (/s)", "Errors", "Mean (ms)", "P50 (ms)", "P99 (ms)", "Max (ms)"};
+    ui->FunctionStatisticsTable->setColumnCount(headerNames.size());
+    ui->FunctionStatisticsTable->setHorizontalHeaderLabels(headerNames);
+    ui->FunctionStatisticsTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+
+    connect(&refreshTimer, &QTimer::timeout, this, &SDKDiagnosticsDialog::refreshStatistics);
+    refreshTimer.start(1000);
+    refreshStatistics();
+}
+
+SDKDiagnosticsDialog::~SDKDiagnosticsDialog()
+{
+    refreshTimer.stop();
+    delete ui;
+}
+
+void SDKDiagnosticsDialog::refreshStatistics()
+{
+    QList<SDKFunctionStatistics*> functionList = SDKInstrumentation::instance()->functions();
+    double duration = SDKInstrumentation::instance()->uptime();
+
+    ui->FunctionStatisticsTable->setRowCount(functionList.size());
+    for (int i = 0; i < functionList.size(); i++)
+    {
+        SDKFunctionStatistics *statistics = functionList[i];
+        qint64 calls = statistics->latency.count();
+
+        QStringList cells;
+        cells << statistics->name;
+        cells << QString::number(calls);
+        cells << QString::number(duration > 0 ? calls / duration : 0, 'f', 1);
+        cells << QString::number(statistics->errors.loadRelaxed());
+        cells << QString::number(statistics->latency.mean() / 1e6, 'f', 3);
+        cells << QString::number(statistics->latency.percentile(50) / 1e6, 'f', 3);
+        cells << QString::number(statistics->latency.percentile(99) / 1e6, 'f', 3);
+        cells << QString::number(statistics->latency.maximum() / 1e6, 'f', 3);
+
+        for (int j = 0; j < cells.size(); j++)
+        {
+            QTableWidgetItem *item = ui->FunctionStatisticsTable->item(i, j);
+            if (item == nullptr)
+            {
+                item = new QTableWidgetItem();
+                item->setFlags(item->flags() & ~Qt::ItemIsEditable);
+                ui->FunctionStatisticsTable->setItem(i, j, item);
+            }
+            item->setText(cells[j]);
+        }
+
+        // Highlight functions that have returned errors
+        QColor rowColor = statistics->errors.loadRelaxed() > 0 ? QColor(255, 220, 220) : QColor(255, 255, 255);
+        for (int j = 0; j < cells.size(); j++) ui->FunctionStatisticsTable->item(i, j)->setBackground(rowColor);
+    }
+}
+
+void SDKDiagnosticsDialog::on_ResetStatistics_clicked()
+{
+    SDKInstrumentation::instance()->reset();
+    refreshStatistics();
+}
@@ -0,0 +1,49 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#ifndef SDKDIAGNOSTICSDIALOG_H
+#define SDKDIAGNOSTICSDIALOG_H
+
+#include <QDialog>
+#include <QTimer>
+#include <QTableWidget>
+#include <QHeaderView>
+
+#include "sdkinstrumentation.h"
+
+namespace Ui {
+class SDKDiagnosticsDialog;
+}
+
+// Live view of SDKInstrumentation: call counts, rates, errors and latency percentiles per SDK function.
+class SDKDiagnosticsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit SDKDiagnosticsDialog(QWidget *parent = nullptr);
+    ~SDKDiagnosticsDialog();
+
+private slots:
+    void refreshStatistics();
+    void on_ResetStatistics_clicked();
+
+private:
+    Ui::SDKDiagnosticsDialog *ui;
+    QTimer refreshTimer;
+};
+
+#endif // SDKDIAGNOSTICSDIALOG_H
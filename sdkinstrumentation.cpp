@@ -0,0 +1,147 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#include "sdkinstrumentation.h"
+
+// Per thread, so a worker's failure text is never handed to another thread's error dialog.
+static thread_local QString capturedError;
+static thread_local qint64 capturedLockWait = 0;
+
+SDKInstrumentation::SDKInstrumentation()
+{
+    startTime = monotonicNanoseconds();
+}
+
+SDKInstrumentation *SDKInstrumentation::instance()
+{
+    static SDKInstrumentation instrumentation;
+    return &instrumentation;
+}
+
+// Call sites of the same function share one entry. Entries are never freed, so the pointers stay valid.
+// The name must outlive the registry; AO_CALL passes a string literal.
+SDKFunctionStatistics *SDKInstrumentation::registerFunction(const char *name)
+{
+    QMutexLocker locker(&registryMutex);
+    QString functionName(name);
+    for (int i = 0; i < registry.size(); i++)
+    {
+        if (registry[i]->name == functionName) return registry[i];
+    }
+
+    SDKFunctionStatistics *statistics = new SDKFunctionStatistics();
+    statistics->name = functionName;
+    statistics->functionName = name;
+    statistics->errors = 0;
+    statistics->lastError = eAO_OK;
+
+    // isConnected reports the connection state rather than eAO_OK
+    if (functionName == "isConnected") statistics->successCode = eAO_CONNECTED;
+    registry.append(statistics);
+    return statistics;
+}
+
+QList<SDKFunctionStatistics*> SDKInstrumentation::functions()
+{
+    QMutexLocker locker(&registryMutex);
+    return registry;
+}
+
+// Seconds since the instrumentation started or was last reset, used for call rates.
+double SDKInstrumentation::uptime() const
+{
+    return (monotonicNanoseconds() - startTime) / 1e9;
+}
+
+QJsonObject SDKInstrumentation::toJson()
+{
+    QList<SDKFunctionStatistics*> functionList = functions();
+    double duration = uptime();
+
+    QJsonArray functionArray;
+    for (int i = 0; i < functionList.size(); i++)
+    {
+        QJsonObject functionObject = functionList[i]->latency.toJson();
+        functionObject["Function"] = QJsonValue(functionList[i]->name);
+        functionObject["Errors"] = QJsonValue((qint64)functionList[i]->errors.loadRelaxed());
+        functionObject["LastError"] = QJsonValue(functionList[i]->lastError.loadRelaxed());
+        functionObject["LockWait"] = functionList[i]->lockWait.toJson();
+        functionObject["CallsPerSecond"] = QJsonValue(duration > 0 ? functionList[i]->latency.count() / duration : 0);
+        functionArray.append(functionObject);
+    }
+
+    QJsonObject instrumentationObject;
+    instrumentationObject["Duration"] = QJsonValue(duration);
+    instrumentationObject["Functions"] = functionArray;
+    return instrumentationObject;
+}
+
+void SDKInstrumentation::reset()
+{
+    QList<SDKFunctionStatistics*> functionList = functions();
+    for (int i = 0; i < functionList.size(); i++)
+    {
+        functionList[i]->latency.reset();
+        functionList[i]->lockWait.reset();
+        functionList[i]->errors = 0;
+        functionList[i]->lastError = eAO_OK;
+    }
+    startTime = monotonicNanoseconds();
+}
+
+QMutex *SDKInstrumentation::callMutex()
+{
+    static QMutex mutex;
+    return &mutex;
+}
+
+// Called by AO_CALL with callMutex() held. The raw function is used since the lock is not recursive.
+void SDKInstrumentation::captureError()
+{
+    char errorString[1000] = {0};
+    int nErrorCount = 0;
+    int result = ErrorHandlingfunc(&nErrorCount, errorString, 1000);
+
+    switch (result)
+    {
+        case eAO_ARG_NULL:
+            printf("ErrorHandlingfunc: NULL Argument Error\n");
+            break;
+        case eAO_BAD_ARG:
+            printf("ErrorHandlingfunc: Bad Argument\n");
+            break;
+    }
+
+    capturedError = QString(errorString);
+}
+
+void SDKInstrumentation::recordLockWait(qint64 nanoseconds)
+{
+    capturedLockWait = nanoseconds;
+}
+
+// Time the calling thread's last AO_CALL waited for callMutex(), in nanoseconds.
+qint64 SDKInstrumentation::lastLockWait()
+{
+    return capturedLockWait;
+}
+
+QString sdkErrorLog()
+{
+    QString errorText = capturedError;
+    capturedError.clear();
+    return errorText;
+}
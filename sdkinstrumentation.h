@@ -0,0 +1,128 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#ifndef SDKINSTRUMENTATION_H
+#define SDKINSTRUMENTATION_H
+
+#include <QString>
+#include <QList>
+#include <QMutex>
+#include <QAtomicInteger>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "latencyhistogram.h"
+#include "eventloopprofiler.h"
+#include "streamdatahandler.h"
+
+// Statistics of one SDK function. Only the latency histograms and counters are touched on the call path.
+// "latency" is the SDK call alone; the wait for the SDK lock is kept apart in "lockWait".
+typedef struct SDKFunctionStatistics
+{
+    QString name = "";
+    const char *functionName = "";
+    int successCode = eAO_OK;
+    LatencyHistogram latency;
+    LatencyHistogram lockWait;
+    QAtomicInteger<quint64> errors;
+    QAtomicInteger<int> lastError;
+
+    void record(qint64 nanoseconds, qint64 lockNanoseconds, int result)
+    {
+        latency.record(nanoseconds);
+        lockWait.record(lockNanoseconds);
+        if (result != successCode)
+        {
+            errors.fetchAndAddRelaxed(1);
+            lastError.storeRelaxed(result);
+        }
+    }
+} SDKFunctionStatistics;
+
+// Registry of per-function statistics for every NeuroOmega SDK call made through AO_CALL.
+class SDKInstrumentation
+{
+public:
+    static SDKInstrumentation *instance();
+
+    SDKFunctionStatistics *registerFunction(const char *name);
+    QList<SDKFunctionStatistics*> functions();
+    double uptime() const;
+    QJsonObject toJson();
+    void reset();
+
+    // Every AO_CALL holds this lock. The SDK keeps one global error queue, so a failed call's error text
+    // is fetched before the lock is released; otherwise another thread could drain it first.
+    static QMutex *callMutex();
+    static void captureError();
+    static void recordLockWait(qint64 nanoseconds);
+    static qint64 lastLockWait();
+
+private:
+    SDKInstrumentation();
+
+    QMutex registryMutex;
+    QList<SDKFunctionStatistics*> registry;
+    qint64 startTime = 0;
+};
+
+template<typename Function>
+class SDKInstrumentedCall;
+
+// Takes the SDK parameter types verbatim, so arguments convert exactly as in a direct call.
+template<typename Result, typename... Parameters>
+class SDKInstrumentedCall<Result (*)(Parameters...)>
+{
+public:
+    typedef Result (*Function)(Parameters...);
+
+    SDKInstrumentedCall(SDKFunctionStatistics *statistics, Function function) :
+        statistics(statistics), function(function) {}
+
+    Result operator()(Parameters... arguments)
+    {
+        ProfilerScope scope(statistics->functionName);
+        qint64 lockStart = monotonicNanoseconds();
+        QMutexLocker locker(SDKInstrumentation::callMutex());
+        qint64 callStart = monotonicNanoseconds();
+        Result result = function(arguments...);
+        qint64 callEnd = monotonicNanoseconds();
+        if ((int) result != statistics->successCode) SDKInstrumentation::captureError();
+        locker.unlock();
+
+        SDKInstrumentation::recordLockWait(callStart - lockStart);
+        statistics->record(callEnd - callStart, callStart - lockStart, (int) result);
+        return result;
+    }
+
+private:
+    SDKFunctionStatistics *statistics;
+    Function function;
+};
+
+// NeuroOmega error text of the last failed AO_CALL on the calling thread, empty if there is none. Reading clears it.
+QString sdkErrorLog();
+
+// Usage: int result = AO_CALL(GetDriveDepth)(&motorDepth);
+// Each call site resolves its statistics once, so a call costs the SDK lock, three clock reads and a few relaxed atomics.
+// The lock is held for the whole call, so a blocking call such as DefaultStartConnection stalls the other threads' calls.
+#define AO_CALL(function) \
+    SDKInstrumentedCall<decltype(&function)>([]() { \
+        static SDKFunctionStatistics *statistics = SDKInstrumentation::instance()->registerFunction(#function); \
+        return statistics; \
+    }(), &function)
+
+#endif // SDKINSTRUMENTATION_H
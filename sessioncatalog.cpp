@@ -0,0 +1,604 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "sessioncatalog.h"
+#include "channelcatalog.h"
+
+SessionCatalog::SessionCatalog(QString connectionName)
+{
+    this->connectionName = connectionName;
+}
+
+SessionCatalog::~SessionCatalog()
+{
+    close();
+}
+
+bool SessionCatalog::open(QString databaseFile)
+{
+    close();
+
+    database = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+    database.setDatabaseName(databaseFile);
+    if (!database.open())
+    {
+        lastError = database.lastError().text();
+        return false;
+    }
+
+    // WAL lets the GUI query while the indexer writes
+    execute("PRAGMA journal_mode=WAL");
+    execute("PRAGMA synchronous=NORMAL");
+    return createSchema();
+}
+
+void SessionCatalog::close()
+{
+    if (!database.isValid()) return;
+    database.close();
+    database = QSqlDatabase();
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
+bool SessionCatalog::isOpen() const
+{
+    return database.isOpen();
+}
+
+QString SessionCatalog::errorMessage() const
+{
+    return lastError;
+}
+
+void SessionCatalog::setElectrodeDefinitions(QList<ElectrodeDefinition> electrodeDefinitions)
+{
+    this->electrodeDefinitions = electrodeDefinitions;
+}
+
+// Times are stored as seconds since epoch, parsed from the "Time" strings of the session log.
+qint64 SessionCatalog::logTime(QString timeString)
+{
+    QDateTime time = QDateTime::fromString(timeString, "yyyy/MM/dd HH:mm:ss");
+    if (!time.isValid()) return -1;
+    return time.toMSecsSinceEpoch() / 1000;
+}
+
+bool SessionCatalog::createSchema()
+{
+    QStringList statements = {
+        "CREATE TABLE IF NOT EXISTS files (path TEXT PRIMARY KEY, kind TEXT, size INTEGER, modified INTEGER, session_id INTEGER, start_time INTEGER, end_time INTEGER)",
+        "CREATE TABLE IF NOT EXISTS patients (patient_id TEXT PRIMARY KEY, diagnosis TEXT)",
+        "CREATE TABLE IF NOT EXISTS sessions (id INTEGER PRIMARY KEY, log_file TEXT UNIQUE, directory TEXT, patient_id TEXT, diagnosis TEXT, start_time INTEGER, end_time INTEGER)",
+        "CREATE TABLE IF NOT EXISTS leads (session_id INTEGER, lead INTEGER, electrode TEXT, hemisphere TEXT, target TEXT, PRIMARY KEY (session_id, lead))",
+        "CREATE TABLE IF NOT EXISTS stimulation_events (id INTEGER PRIMARY KEY, session_id INTEGER, time INTEGER, type TEXT, stage INTEGER, recording_name TEXT, lead INTEGER, "
+            "amplitude REAL, pulsewidth REAL, frequency REAL, duration REAL, waveform TEXT)",
+        "CREATE TABLE IF NOT EXISTS stimulation_contacts (event_id INTEGER, contact INTEGER, PRIMARY KEY (event_id, contact)) WITHOUT ROWID",
+        "CREATE TABLE IF NOT EXISTS labels (session_id INTEGER, time INTEGER, text TEXT)",
+        "CREATE INDEX IF NOT EXISTS sessions_patient ON sessions (patient_id)",
+        "CREATE INDEX IF NOT EXISTS leads_target ON leads (target, hemisphere)",
+        "CREATE INDEX IF NOT EXISTS events_session ON stimulation_events (session_id, time)",
+        "CREATE INDEX IF NOT EXISTS events_recording ON stimulation_events (recording_name, type)",
+        "CREATE INDEX IF NOT EXISTS contacts_contact ON stimulation_contacts (contact, event_id)",
+        "CREATE INDEX IF NOT EXISTS labels_session ON labels (session_id, time)",
+        "CREATE INDEX IF NOT EXISTS files_time ON files (start_time, end_time)"
+    };
+
+    for (int i = 0; i < statements.size(); i++)
+    {
+        if (!execute(statements[i])) return false;
+    }
+    return true;
+}
+
+bool SessionCatalog::execute(QSqlQuery &query)
+{
+    if (query.exec()) return true;
+    lastError = query.lastError().text();
+    return false;
+}
+
+bool SessionCatalog::execute(QString statement)
+{
+    QSqlQuery query(database);
+    if (query.exec(statement)) return true;
+    lastError = query.lastError().text();
+    return false;
+}
+
+bool SessionCatalog::isIndexed(const QFileInfo &fileInfo)
+{
+    QSqlQuery query(database);
+    query.prepare("SELECT size, modified FROM files WHERE path = ?");
+    query.addBindValue(fileInfo.absoluteFilePath());
+    if (!execute(query) || !query.next()) return false;
+    return query.value(0).toLongLong() == fileInfo.size() && query.value(1).toLongLong() == fileInfo.lastModified().toMSecsSinceEpoch();
+}
+
+bool SessionCatalog::updateFile(const QFileInfo &fileInfo, QString kind, qint64 sessionID, qint64 startTime, qint64 endTime)
+{
+    QSqlQuery query(database);
+    query.prepare("INSERT OR REPLACE INTO files (path, kind, size, modified, session_id, start_time, end_time) VALUES (?, ?, ?, ?, ?, ?, ?)");
+    query.addBindValue(fileInfo.absoluteFilePath());
+    query.addBindValue(kind);
+    query.addBindValue(fileInfo.size());
+    query.addBindValue(fileInfo.lastModified().toMSecsSinceEpoch());
+    query.addBindValue(sessionID > 0 ? QVariant(sessionID) : QVariant());
+    query.addBindValue(startTime);
+    query.addBindValue(endTime);
+    return execute(query);
+}
+
+void SessionCatalog::removeSession(QString logFile)
+{
+    QSqlQuery query(database);
+    query.prepare("SELECT id FROM sessions WHERE log_file = ?");
+    query.addBindValue(logFile);
+    if (!execute(query) || !query.next()) return;
+    qint64 sessionID = query.value(0).toLongLong();
+
+    QStringList statements = {
+        "DELETE FROM stimulation_contacts WHERE event_id IN (SELECT id FROM stimulation_events WHERE session_id = ?)",
+        "DELETE FROM stimulation_events WHERE session_id = ?",
+        "DELETE FROM leads WHERE session_id = ?",
+        "DELETE FROM labels WHERE session_id = ?",
+        "UPDATE files SET session_id = NULL WHERE session_id = ?",
+        "DELETE FROM sessions WHERE id = ?"
+    };
+    for (int i = 0; i < statements.size(); i++)
+    {
+        QSqlQuery deleteQuery(database);
+        deleteQuery.prepare(statements[i]);
+        deleteQuery.addBindValue(sessionID);
+        execute(deleteQuery);
+    }
+}
+
+// Lead descriptions are "Type Hemisphere Target"; electrode names may contain spaces, so the longest known name wins.
+// Re-index one JSON session log. The previous rows of the log are replaced in a single transaction.
+bool SessionCatalog::indexSessionLog(QString filename)
+{
+    QFileInfo fileInfo(filename);
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        lastError = "Cannot open " + filename;
+        return false;
+    }
+
+    QJsonParseError parseError;
+    QJsonDocument loadedDocument = QJsonDocument::fromJson(file.readAll(), &parseError);
+    QJsonArray logArray = loadedDocument.array();
+
+    // Other JSON files in the log folder are remembered, so they are not parsed again until they change
+    if (!loadedDocument.isArray() || logArray.isEmpty() || !logArray[0].toObject().contains("Name"))
+    {
+        return updateFile(fileInfo, "Other", 0, -1, -1);
+    }
+
+    database.transaction();
+    QString logFile = fileInfo.absoluteFilePath();
+    removeSession(logFile);
+
+    QJsonObject statusObject = logArray[0].toObject();
+    qint64 startTime = logTime(statusObject["Time"].toString());
+    qint64 endTime = startTime;
+
+    QSqlQuery sessionQuery(database);
+    sessionQuery.prepare("INSERT INTO sessions (log_file, directory, patient_id, diagnosis, start_time, end_time) VALUES (?, ?, ?, ?, ?, ?)");
+    sessionQuery.addBindValue(logFile);
+    sessionQuery.addBindValue(fileInfo.absolutePath());
+    sessionQuery.addBindValue(statusObject["Name"].toString());
+    sessionQuery.addBindValue(statusObject["Diagnosis"].toString());
+    sessionQuery.addBindValue(startTime);
+    sessionQuery.addBindValue(startTime);
+    if (!execute(sessionQuery))
+    {
+        database.rollback();
+        return false;
+    }
+    qint64 sessionID = sessionQuery.lastInsertId().toLongLong();
+
+    QSqlQuery patientQuery(database);
+    patientQuery.prepare("INSERT OR REPLACE INTO patients (patient_id, diagnosis) VALUES (?, ?)");
+    patientQuery.addBindValue(statusObject["Name"].toString());
+    patientQuery.addBindValue(statusObject["Diagnosis"].toString());
+    execute(patientQuery);
+
+    QSqlQuery leadQuery(database);
+    leadQuery.prepare("INSERT OR REPLACE INTO leads (session_id, lead, electrode, hemisphere, target) VALUES (?, ?, ?, ?, ?)");
+    QSqlQuery eventQuery(database);
+    eventQuery.prepare("INSERT INTO stimulation_events (session_id, time, type, stage, recording_name, lead, amplitude, pulsewidth, frequency, duration, waveform) "
+                       "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    QSqlQuery contactQuery(database);
+    contactQuery.prepare("INSERT OR IGNORE INTO stimulation_contacts (event_id, contact) VALUES (?, ?)");
+    QSqlQuery labelQuery(database);
+    labelQuery.prepare("INSERT INTO labels (session_id, time, text) VALUES (?, ?, ?)");
+
+    // NeuroOmega channel ID -> (lead, contact). Older logs do not list channels, so they are assumed to follow
+    // the lead order from the first ECoG HF input, as in session replay.
+    QHash<int, QPair<int, int>> channelContacts;
+    QString recordingName = "";
+
+    for (int i = 1; i < logArray.size(); i++)
+    {
+        QJsonObject event = logArray[i].toObject();
+        QString objectType = event["ObjectType"].toString();
+        qint64 time = logTime(event["Time"].toString());
+        if (time > endTime) endTime = time;
+
+        if (objectType == "ElectrodeConfigurations")
+        {
+            channelContacts.clear();
+            int numLeads = 0;
+            QStringList keys = event.keys();
+            for (int j = 0; j < keys.size(); j++)
+            {
+                if (keys[j].startsWith("Lead") && !keys[j].endsWith("Channels")) numLeads = qMax(numLeads, keys[j].mid(4).toInt());
+            }
+
+            int nextChannelID = ECOG_FIRST_CHANNEL;
+            for (int lead = 1; lead <= numLeads; lead++)
+            {
+                QString key = "Lead" + QString::number(lead);
+                QString electrode, hemisphere, target;
+                const ElectrodeDefinition *definition = nullptr;
+                if (!event.contains(key) || !ElectrodeConfigurations::parseLead(event[key].toString(), electrodeDefinitions, electrode, hemisphere, target, &definition)) continue;
+                int numContacts = definition != nullptr ? definition->channelCount : 0;
+
+                leadQuery.addBindValue(sessionID);
+                leadQuery.addBindValue(lead);
+                leadQuery.addBindValue(electrode);
+                leadQuery.addBindValue(hemisphere);
+                leadQuery.addBindValue(target);
+                execute(leadQuery);
+
+                if (event.contains(key + "Channels"))
+                {
+                    QJsonArray channelArray = event[key + "Channels"].toArray();
+                    for (int j = 0; j < channelArray.size(); j++) channelContacts[channelArray[j].toInt()] = qMakePair(lead, j);
+                }
+                else
+                {
+                    for (int j = 0; j < numContacts; j++) channelContacts[nextChannelID++] = qMakePair(lead, j);
+                }
+            }
+        }
+        else if (objectType == "StimulationOn" || objectType == "Novel Stimulation" || objectType == "SequenceStage" || objectType == "ClosedLoopStimulationOn")
+        {
+            int lead = 0;
+            QList<int> contacts;
+            if (objectType == "SequenceStage")
+            {
+                lead = event["StimulationLead"].toInt() + 1;
+                QJsonArray contactArray = event["StimulationContacts"].toArray();
+                for (int j = 0; j < contactArray.size(); j++) contacts.append(contactArray[j].toInt());
+                recordingName = event["RecordingFilename"].toString();
+            }
+            else
+            {
+                QJsonArray channelArray = event["StimulationChannel"].toArray();
+                for (int j = 0; j < channelArray.size(); j++)
+                {
+                    if (!channelContacts.contains(channelArray[j].toInt())) continue;
+                    lead = channelContacts[channelArray[j].toInt()].first;
+                    contacts.append(channelContacts[channelArray[j].toInt()].second);
+                }
+            }
+
+            eventQuery.addBindValue(sessionID);
+            eventQuery.addBindValue(time);
+            eventQuery.addBindValue(objectType == "SequenceStage" ? event["StimulationType"].toString() : objectType);
+            eventQuery.addBindValue(event.contains("Stage") ? QVariant(event["Stage"].toInt()) : QVariant());
+            eventQuery.addBindValue(recordingName);
+            eventQuery.addBindValue(lead > 0 ? QVariant(lead) : QVariant());
+            eventQuery.addBindValue(event.contains("Amplitude") ? QVariant(event["Amplitude"].toDouble()) : QVariant());
+            eventQuery.addBindValue(event.contains("PulseWidth") ? QVariant(event["PulseWidth"].toDouble()) : QVariant());
+            eventQuery.addBindValue(event.contains("Frequency") ? QVariant(event["Frequency"].toDouble()) : QVariant());
+            eventQuery.addBindValue(event.contains("Duration") ? QVariant(event["Duration"].toDouble()) : QVariant());
+            eventQuery.addBindValue(event["WaveName"].toString());
+            if (!execute(eventQuery)) continue;
+
+            qint64 eventID = eventQuery.lastInsertId().toLongLong();
+            for (int j = 0; j < contacts.size(); j++)
+            {
+                contactQuery.addBindValue(eventID);
+                contactQuery.addBindValue(contacts[j]);
+                execute(contactQuery);
+            }
+        }
+        else if (objectType == "StimulationOff" || objectType == "ClosedLoopStop")
+        {
+            recordingName = "";
+        }
+        else if (objectType == "Label")
+        {
+            labelQuery.addBindValue(sessionID);
+            labelQuery.addBindValue(time);
+            labelQuery.addBindValue(event["LabelText"].toString());
+            execute(labelQuery);
+        }
+    }
+
+    QSqlQuery endQuery(database);
+    endQuery.prepare("UPDATE sessions SET end_time = ? WHERE id = ?");
+    endQuery.addBindValue(endTime);
+    endQuery.addBindValue(sessionID);
+    execute(endQuery);
+
+    if (!updateFile(fileInfo, "SessionLog", sessionID, startTime, endTime) || !database.commit())
+    {
+        lastError = database.lastError().text();
+        database.rollback();
+        return false;
+    }
+    return true;
+}
+
+// Recordings are mapped to time by their file times, and to the session logged in the same folder over that span.
+bool SessionCatalog::indexRecording(QString filename)
+{
+    QFileInfo fileInfo(filename);
+    if (!fileInfo.exists())
+    {
+        lastError = "Cannot find " + filename;
+        return false;
+    }
+
+    qint64 endTime = fileInfo.lastModified().toMSecsSinceEpoch() / 1000;
+    qint64 startTime = fileInfo.birthTime().isValid() ? fileInfo.birthTime().toMSecsSinceEpoch() / 1000 : endTime;
+
+    QSqlQuery sessionQuery(database);
+    sessionQuery.prepare("SELECT id FROM sessions WHERE directory = ? AND start_time <= ? AND end_time >= ? ORDER BY start_time DESC LIMIT 1");
+    sessionQuery.addBindValue(fileInfo.absolutePath());
+    sessionQuery.addBindValue(endTime);
+    sessionQuery.addBindValue(startTime);
+    qint64 sessionID = 0;
+    if (execute(sessionQuery) && sessionQuery.next()) sessionID = sessionQuery.value(0).toLongLong();
+
+    return updateFile(fileInfo, "Recording", sessionID, startTime, endTime);
+}
+
+bool SessionCatalog::removeMissingFiles(QString rootFolder)
+{
+    QSqlQuery query(database);
+    query.prepare("SELECT path FROM files WHERE path LIKE ?");
+    query.addBindValue(QDir(rootFolder).absolutePath() + "%");
+    if (!execute(query)) return false;
+
+    QStringList missingFiles;
+    while (query.next())
+    {
+        if (!QFile::exists(query.value(0).toString())) missingFiles.append(query.value(0).toString());
+    }
+    if (missingFiles.isEmpty()) return true;
+
+    database.transaction();
+    for (int i = 0; i < missingFiles.size(); i++)
+    {
+        removeSession(missingFiles[i]);
+        QSqlQuery deleteQuery(database);
+        deleteQuery.prepare("DELETE FROM files WHERE path = ?");
+        deleteQuery.addBindValue(missingFiles[i]);
+        execute(deleteQuery);
+    }
+    return database.commit();
+}
+
+QJsonArray SessionCatalog::rows(QSqlQuery &query)
+{
+    QJsonArray result;
+    while (query.next())
+    {
+        QJsonObject row;
+        QSqlRecord record = query.record();
+        for (int i = 0; i < record.count(); i++) row[record.fieldName(i)] = QJsonValue::fromVariant(query.value(i));
+        result.append(row);
+    }
+    return result;
+}
+
+QJsonArray SessionCatalog::patients()
+{
+    QSqlQuery query(database);
+    query.prepare("SELECT p.patient_id, p.diagnosis, COUNT(s.id) AS sessions, MIN(s.start_time) AS first_session, MAX(s.end_time) AS last_session "
+                  "FROM patients p LEFT JOIN sessions s ON s.patient_id = p.patient_id GROUP BY p.patient_id ORDER BY last_session DESC");
+    if (!execute(query)) return QJsonArray();
+    return rows(query);
+}
+
+QJsonArray SessionCatalog::sessions(QString patientID)
+{
+    QSqlQuery query(database);
+    query.prepare("SELECT id, log_file, directory, patient_id, diagnosis, start_time, end_time FROM sessions "
+                  "WHERE (? = '' OR patient_id = ?) ORDER BY start_time");
+    query.addBindValue(patientID);
+    query.addBindValue(patientID);
+    if (!execute(query)) return QJsonArray();
+    return rows(query);
+}
+
+// e.g. every ERNA stage on STN contact 2 across cases: recordingName "ERNA", target "STN", contact 2.
+QJsonArray SessionCatalog::stimulationEvents(StimulationEventQuery filter)
+{
+    QStringList conditions = {"1 = 1"};
+    QVariantList values;
+    QList<QPair<QString, QString>> textFilters = {
+        qMakePair(QString("s.patient_id = ?"), filter.patientID),
+        qMakePair(QString("e.recording_name = ?"), filter.recordingName),
+        qMakePair(QString("e.type = ?"), filter.stimulationType),
+        qMakePair(QString("l.hemisphere = ?"), filter.hemisphere),
+        qMakePair(QString("l.target = ?"), filter.target)
+    };
+    for (int i = 0; i < textFilters.size(); i++)
+    {
+        if (textFilters[i].second.isEmpty()) continue;
+        conditions.append(textFilters[i].first);
+        values.append(textFilters[i].second);
+    }
+
+    // The contact index keeps this a lookup instead of a scan of every event
+    if (filter.contact >= 0)
+    {
+        conditions.append("EXISTS (SELECT 1 FROM stimulation_contacts m WHERE m.event_id = e.id AND m.contact = ?)");
+        values.append(QVariant(filter.contact));
+    }
+    if (filter.startTime >= 0)
+    {
+        conditions.append("e.time >= ?");
+        values.append(QVariant(filter.startTime));
+    }
+    if (filter.endTime >= 0)
+    {
+        conditions.append("e.time <= ?");
+        values.append(QVariant(filter.endTime));
+    }
+
+    QSqlQuery query(database);
+    query.prepare("SELECT e.id AS event_id, s.patient_id, s.diagnosis, s.log_file, e.time, e.type, e.stage, e.recording_name, e.lead, "
+                  "l.electrode, l.hemisphere, l.target, e.amplitude, e.pulsewidth, e.frequency, e.duration, e.waveform, "
+                  "(SELECT group_concat(c.contact) FROM stimulation_contacts c WHERE c.event_id = e.id) AS contacts "
+                  "FROM stimulation_events e JOIN sessions s ON s.id = e.session_id "
+                  "LEFT JOIN leads l ON l.session_id = e.session_id AND l.lead = e.lead "
+                  "WHERE " + conditions.join(" AND ") + " ORDER BY e.time");
+    for (int i = 0; i < values.size(); i++) query.addBindValue(values[i]);
+    if (!execute(query)) return QJsonArray();
+    return rows(query);
+}
+
+QJsonArray SessionCatalog::labels(QString patientID, QString text)
+{
+    QSqlQuery query(database);
+    query.prepare("SELECT s.patient_id, s.log_file, b.time, b.text FROM labels b JOIN sessions s ON s.id = b.session_id "
+                  "WHERE (? = '' OR s.patient_id = ?) AND (? = '' OR b.text LIKE ?) ORDER BY b.time");
+    query.addBindValue(patientID);
+    query.addBindValue(patientID);
+    query.addBindValue(text);
+    query.addBindValue("%" + text + "%");
+    if (!execute(query)) return QJsonArray();
+    return rows(query);
+}
+
+// Session logs and recordings whose span covers "time" (seconds since epoch).
+QJsonArray SessionCatalog::filesAt(qint64 time)
+{
+    QSqlQuery query(database);
+    query.prepare("SELECT path, kind, session_id, start_time, end_time FROM files WHERE kind != 'Other' AND start_time <= ? AND end_time >= ? ORDER BY start_time");
+    query.addBindValue(time);
+    query.addBindValue(time);
+    if (!execute(query)) return QJsonArray();
+    return rows(query);
+}
+
+SessionCatalogIndexer::SessionCatalogIndexer(QObject *parent) :
+    QThread(parent)
+{
+    running = 0;
+}
+
+SessionCatalogIndexer::~SessionCatalogIndexer()
+{
+    stopIndexing();
+}
+
+bool SessionCatalogIndexer::startIndexing(QString logFolder, QString databaseFile, QList<ElectrodeDefinition> electrodeDefinitions)
+{
+    if (this->isRunning() || logFolder.isEmpty()) return false;
+
+    this->logFolder = logFolder;
+    this->databaseFile = databaseFile;
+    this->electrodeDefinitions = electrodeDefinitions;
+    running = 1;
+    this->start(QThread::LowestPriority);
+    return true;
+}
+
+// Stops between files; the file being indexed is finished so the catalog stays consistent.
+void SessionCatalogIndexer::stopIndexing()
+{
+    running = 0;
+    if (this->isRunning()) this->wait();
+}
+
+QJsonObject SessionCatalogIndexer::report() const
+{
+    QJsonObject reportObject;
+    reportObject["Indexed"] = QJsonValue(indexedFiles);
+    reportObject["Unchanged"] = QJsonValue(unchangedFiles);
+    reportObject["Failed"] = QJsonValue(failedFiles);
+    reportObject["Elapsed"] = QJsonValue(elapsed);
+    if (!lastError.isEmpty()) reportObject["Error"] = QJsonValue(lastError);
+    return reportObject;
+}
+
+void SessionCatalogIndexer::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+    indexedFiles = 0;
+    unchangedFiles = 0;
+    failedFiles = 0;
+    lastError = "";
+
+    {
+        SessionCatalog catalog("SessionCatalogIndexer");
+        if (!catalog.open(databaseFile))
+        {
+            lastError = catalog.errorMessage();
+            failedFiles = 1;
+        }
+        else
+        {
+            catalog.setElectrodeDefinitions(electrodeDefinitions);
+            catalog.removeMissingFiles(logFolder);
+
+            // Session logs first, so recordings can be matched to the session they belong to
+            QStringList sessionLogs;
+            QStringList recordings;
+            QDirIterator iterator(logFolder, {"*.json", "*.mpx"}, QDir::Files, QDirIterator::Subdirectories);
+            while (iterator.hasNext())
+            {
+                QString filename = iterator.next();
+                if (QFileInfo(filename).suffix().toLower() == "json") sessionLogs.append(filename);
+                else recordings.append(filename);
+            }
+            QStringList files = sessionLogs + recordings;
+
+            for (int i = 0; i < files.size() && running.loadAcquire(); i++)
+            {
+                if (catalog.isIndexed(QFileInfo(files[i])))
+                {
+                    unchangedFiles++;
+                }
+                else
+                {
+                    bool indexed = i < sessionLogs.size() ? catalog.indexSessionLog(files[i]) : catalog.indexRecording(files[i]);
+                    if (indexed) indexedFiles++;
+                    else
+                    {
+                        failedFiles++;
+                        lastError = catalog.errorMessage();
+                    }
+                }
+                if (i % 16 == 0 || i == files.size() - 1) emit progress(i + 1, files.size());
+            }
+        }
+    }
+
+    running = 0;
+    elapsed = timer.elapsed();
+    emit indexingFinished(indexedFiles, failedFiles, elapsed);
+}
@@ -0,0 +1,135 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef SESSIONCATALOG_H
+#define SESSIONCATALOG_H
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QPair>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDirIterator>
+#include <QDateTime>
+#include <QVariant>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSqlRecord>
+
+#include "interfaceconfiguration.h"
+#include "electrodeconfigurations.h"
+
+// Filters for SessionCatalog::stimulationEvents(). Empty strings and negative numbers match everything.
+// Contacts are 0-based indices within the lead, as in the stimulation configuration files.
+typedef struct StimulationEventQuery
+{
+    QString patientID = "";
+    QString recordingName = "";
+    QString stimulationType = "";
+    QString hemisphere = "";
+    QString target = "";
+    int contact = -1;
+    qint64 startTime = -1;
+    qint64 endTime = -1;
+} StimulationEventQuery;
+
+// SQLite index over the surgical logs: sessions, patients, leads, stimulation events, labels and the time span of
+// every session log and recording file. Logs are re-indexed only when their size or modification time changes.
+// A QSqlDatabase connection belongs to the thread that opened it, so each thread uses its own SessionCatalog.
+class SessionCatalog
+{
+public:
+    SessionCatalog(QString connectionName);
+    ~SessionCatalog();
+
+    bool open(QString databaseFile);
+    void close();
+    bool isOpen() const;
+    QString errorMessage() const;
+    void setElectrodeDefinitions(QList<ElectrodeDefinition> electrodeDefinitions);
+
+    bool isIndexed(const QFileInfo &fileInfo);
+    bool indexSessionLog(QString filename);
+    bool indexRecording(QString filename);
+    bool removeMissingFiles(QString rootFolder);
+
+    QJsonArray patients();
+    QJsonArray sessions(QString patientID = "");
+    QJsonArray stimulationEvents(StimulationEventQuery query);
+    QJsonArray labels(QString patientID = "", QString text = "");
+    QJsonArray filesAt(qint64 time);
+
+    static qint64 logTime(QString timeString);
+
+private:
+    bool createSchema();
+    bool execute(QSqlQuery &query);
+    bool execute(QString statement);
+    bool updateFile(const QFileInfo &fileInfo, QString kind, qint64 sessionID, qint64 startTime, qint64 endTime);
+    void removeSession(QString logFile);
+    QJsonArray rows(QSqlQuery &query);
+
+    QString connectionName;
+    QSqlDatabase database;
+    QString lastError;
+    QList<ElectrodeDefinition> electrodeDefinitions;
+};
+
+// Walks SurgicalLogFolder on a low-priority thread and brings the catalog up to date with the session logs (*.json)
+// and NeuroOmega recordings (*.mpx) found there.
+class SessionCatalogIndexer : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit SessionCatalogIndexer(QObject *parent = nullptr);
+    ~SessionCatalogIndexer();
+
+    bool startIndexing(QString logFolder, QString databaseFile, QList<ElectrodeDefinition> electrodeDefinitions);
+    void stopIndexing();
+    QJsonObject report() const;
+
+signals:
+    void progress(int completed, int total);
+    void indexingFinished(int indexed, int failed, int elapsed);
+
+protected:
+    void run() override;
+
+private:
+    QString logFolder;
+    QString databaseFile;
+    QList<ElectrodeDefinition> electrodeDefinitions;
+    QAtomicInt running;
+
+    int indexedFiles = 0;
+    int unchangedFiles = 0;
+    int failedFiles = 0;
+    int elapsed = 0;
+    QString lastError;
+};
+
+#endif // SESSIONCATALOG_H
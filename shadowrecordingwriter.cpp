@@ -0,0 +1,547 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#include "shadowrecordingwriter.h"
+#include "sdkinstrumentation.h"
+
+static qint64 alignedSize(qint64 size, qint64 alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+ShadowRecordingWriter::ShadowRecordingWriter(QObject *parent) :
+    QThread(parent)
+{
+    running = 0;
+    indexChanged = 0;
+    latestSample = 0;
+}
+
+ShadowRecordingWriter::~ShadowRecordingWriter()
+{
+    stopWriter();
+    releaseBuffers();
+}
+
+// Size the write buffers and chunks for the stream layout and create the output directory. Must be called before start().
+// chunkDuration and bufferDuration are in seconds of stream data.
+bool ShadowRecordingWriter::configure(QString directory, QVector<int> streamChannels, int chunkDuration, int bufferDuration)
+{
+    if (this->isRunning()) return false;
+
+    if (streamChannels.isEmpty() || streamChannels.size() > SHADOW_MAX_CHANNELS)
+    {
+        lastError = QString("Shadow recording supports 1 to %1 channels").arg(SHADOW_MAX_CHANNELS);
+        return false;
+    }
+    if (!QDir().mkpath(directory))
+    {
+        lastError = "Cannot create shadow recording folder " + directory;
+        return false;
+    }
+
+    releaseBuffers();
+    outputDirectory = directory;
+    channelIDs = streamChannels;
+
+    // A buffer holds bufferDuration seconds and at least one full acquisition block; a chunk holds a whole number of buffers.
+    qint64 bytesPerSecond = (qint64)NEUROOMEGA_SAMPLING_RATE * channelIDs.size() * sizeof(int16);
+    qint64 largestBlock = sizeof(ShadowBlockHeader) + alignedSize((qint64)NEUROOMEGA_SAMPLING_RATE / 10 * channelIDs.size() * sizeof(int16), 8);
+    bufferCapacity = alignedSize(qMax(bytesPerSecond * qMax(bufferDuration, 1), largestBlock * 2), SHADOW_ALIGNMENT);
+    chunkCapacity = SHADOW_ALIGNMENT + bufferCapacity * qMax(chunkDuration / qMax(bufferDuration, 1), 1);
+    flushInterval = qMax(bufferDuration, 1) * 1000;
+
+    // Four buffers give the writer three buffers of slack before the acquisition thread has to drop data.
+    for (int i = 0; i < 4; i++)
+    {
+        char *data = (char*)qMallocAligned(bufferCapacity, SHADOW_ALIGNMENT);
+        if (data == nullptr)
+        {
+            lastError = "Cannot allocate shadow recording buffers";
+            releaseBuffers();
+            return false;
+        }
+        allocatedBuffers.append(data);
+
+        ShadowWriteBuffer buffer;
+        buffer.data = data;
+        freeBuffers.append(buffer);
+    }
+    fillBuffer = freeBuffers.takeFirst();
+
+    chunks.clear();
+    segments.clear();
+    currentChunkIndex = -1;
+    currentChunkBytes = 0;
+    droppedSamples = 0;
+    droppedBlocks = 0;
+    bytesWritten = 0;
+    writeCalls = 0;
+    maxWriteNanoseconds = 0;
+    totalWriteNanoseconds = 0;
+    rotationNanoseconds = 0;
+    latestSample = 0;
+
+    // Blocks are accepted from here on and queue in the buffers until the writer thread starts.
+    running = 1;
+    return true;
+}
+
+void ShadowRecordingWriter::releaseBuffers()
+{
+    QMutexLocker locker(&bufferMutex);
+    for (int i = 0; i < allocatedBuffers.size(); i++) qFreeAligned(allocatedBuffers[i]);
+    allocatedBuffers.clear();
+    freeBuffers.clear();
+    fullBuffers.clear();
+    fillBuffer = ShadowWriteBuffer();
+}
+
+// Acquisition thread. Append the block to the fill buffer as int16, handing the buffer to the writer when it is full.
+void ShadowRecordingWriter::processBlock(const SignalBlock &block)
+{
+    if (!running.loadAcquire() || block.numChannels != channelIDs.size() || block.numSamples <= 0) return;
+
+    qint64 dataSize = (qint64)block.numChannels * block.numSamples * sizeof(int16);
+    qint64 recordSize = sizeof(ShadowBlockHeader) + alignedSize(dataSize, 8);
+
+    QMutexLocker locker(&bufferMutex);
+    if (fillBuffer.data != nullptr && fillBuffer.size + recordSize > bufferCapacity) queueFillBuffer();
+    if (fillBuffer.data == nullptr && !freeBuffers.isEmpty()) fillBuffer = freeBuffers.takeFirst();
+    if (fillBuffer.data == nullptr || fillBuffer.size + recordSize > bufferCapacity)
+    {
+        droppedSamples += block.numSamples;
+        droppedBlocks++;
+        return;
+    }
+
+    if (fillBuffer.size == 0)
+    {
+        fillBuffer.firstSample = block.firstSample;
+        fillBuffer.hostTimestamp = block.hostTimestamp;
+        fillAge.start();
+    }
+
+    ShadowBlockHeader header;
+    header.numSamples = block.numSamples;
+    header.firstSample = block.firstSample;
+    header.hostTimestamp = block.hostTimestamp;
+    header.numChannels = block.numChannels;
+    header.deviceTimestamp = block.deviceTimestamp;
+    memcpy(fillBuffer.data + fillBuffer.size, &header, sizeof(ShadowBlockHeader));
+
+    // Stream samples are int16 converted to float, so the conversion back is exact.
+    int16 *output = (int16*)(fillBuffer.data + fillBuffer.size + sizeof(ShadowBlockHeader));
+    for (int i = 0; i < block.numChannels; i++)
+    {
+        const float *input = block.channel(i);
+        for (int j = 0; j < block.numSamples; j++) output[j] = (int16)input[j];
+        output += block.numSamples;
+    }
+    memset((char*)output, 0, recordSize - sizeof(ShadowBlockHeader) - dataSize);
+
+    fillBuffer.size += recordSize;
+    fillBuffer.lastSample = block.firstSample + block.numSamples;
+    latestSample.storeRelease(fillBuffer.lastSample);
+}
+
+// bufferMutex must be held. Pads the fill buffer to the write alignment and queues it for the writer.
+void ShadowRecordingWriter::queueFillBuffer()
+{
+    if (fillBuffer.data == nullptr || fillBuffer.size == 0) return;
+
+    qint64 paddedSize = alignedSize(fillBuffer.size, SHADOW_ALIGNMENT);
+    memset(fillBuffer.data + fillBuffer.size, 0, paddedSize - fillBuffer.size);
+    fillBuffer.size = paddedSize;
+
+    fullBuffers.append(fillBuffer);
+    fillBuffer = freeBuffers.isEmpty() ? ShadowWriteBuffer() : freeBuffers.takeFirst();
+    bufferCondition.wakeOne();
+}
+
+void ShadowRecordingWriter::stopWriter()
+{
+    running = 0;
+    bufferMutex.lock();
+    bufferCondition.wakeAll();
+    bufferMutex.unlock();
+    if (this->isRunning()) this->wait();
+}
+
+// Start a new logical segment at the latest stream sample, closing the previous one there.
+void ShadowRecordingWriter::markSegment(QString name)
+{
+    QMutexLocker locker(&indexMutex);
+    quint64 sample = latestSample.loadAcquire();
+    if (!segments.isEmpty() && segments.last().endSample == 0) segments.last().endSample = sample;
+
+    ShadowSegment segment;
+    segment.name = name;
+    segment.startSample = sample;
+    QDateTime currentTime;
+    segment.startTime = currentTime.currentDateTime().toString("yyyy/MM/dd HH:mm:ss");
+    segments.append(segment);
+    indexChanged = 1;
+}
+
+void ShadowRecordingWriter::endSegment()
+{
+    QMutexLocker locker(&indexMutex);
+    if (segments.isEmpty() || segments.last().endSample != 0) return;
+    segments.last().endSample = latestSample.loadAcquire();
+    indexChanged = 1;
+}
+
+QString ShadowRecordingWriter::directory() const
+{
+    return outputDirectory;
+}
+
+QString ShadowRecordingWriter::errorMessage()
+{
+    QMutexLocker locker(&indexMutex);
+    return lastError;
+}
+
+void ShadowRecordingWriter::run()
+{
+    bool errorReported = !preallocateChunk();
+    if (errorReported) emit writerError(errorMessage());
+
+    QList<ShadowWriteBuffer> writeQueue;
+    bool stopping = false;
+    while (!stopping)
+    {
+        bufferMutex.lock();
+        if (fullBuffers.isEmpty() && running.loadAcquire()) bufferCondition.wait(&bufferMutex, 100);
+
+        // Partially filled buffers are flushed once they are older than the buffer duration, and on stop.
+        stopping = !running.loadAcquire();
+        if (fillBuffer.size > 0 && (stopping || (fullBuffers.isEmpty() && fillAge.elapsed() >= flushInterval))) queueFillBuffer();
+        writeQueue.swap(fullBuffers);
+        bufferMutex.unlock();
+
+        for (int i = 0; i < writeQueue.size(); i++)
+        {
+            // Only the first failure is reported; later ones usually share its cause (disk full, drive removed).
+            if (!writeBuffer(writeQueue[i]) && !errorReported)
+            {
+                errorReported = true;
+                emit writerError(errorMessage());
+            }
+
+            bufferMutex.lock();
+            writeQueue[i].size = 0;
+            if (fillBuffer.data == nullptr) fillBuffer = writeQueue[i];
+            else freeBuffers.append(writeQueue[i]);
+            bufferMutex.unlock();
+        }
+        writeQueue.clear();
+
+        // The next chunk is created and sized here, between writes, so rotation only has to switch files.
+        if (nextFile == nullptr && currentFile != nullptr && !stopping) preallocateChunk();
+        if (indexChanged.fetchAndStoreOrdered(0)) saveIndex();
+    }
+
+    closeChunk();
+    if (nextFile != nullptr)
+    {
+        nextFile->close();
+        nextFile->remove();
+        delete(nextFile);
+        nextFile = nullptr;
+    }
+    saveIndex();
+}
+
+bool ShadowRecordingWriter::writeBuffer(ShadowWriteBuffer &buffer)
+{
+    if (currentFile == nullptr || currentChunkBytes + buffer.size > chunkCapacity)
+    {
+        qint64 rotationStart = monotonicNanoseconds();
+        closeChunk();
+        if (!openChunk(buffer.firstSample, buffer.hostTimestamp)) return false;
+        rotationNanoseconds = qMax(rotationNanoseconds, monotonicNanoseconds() - rotationStart);
+    }
+
+    qint64 writeStart = monotonicNanoseconds();
+    qint64 written = currentFile->write(buffer.data, buffer.size);
+    qint64 writeTime = monotonicNanoseconds() - writeStart;
+    if (written != buffer.size)
+    {
+        QMutexLocker locker(&indexMutex);
+        lastError = "Shadow recording write failed: " + currentFile->errorString();
+        return false;
+    }
+
+    writeCalls++;
+    bytesWritten += written;
+    totalWriteNanoseconds += writeTime;
+    maxWriteNanoseconds = qMax(maxWriteNanoseconds, writeTime);
+
+    currentChunkBytes += written;
+    chunks.last().numSamples = buffer.lastSample - chunks.last().firstSample;
+    chunks.last().bytes = currentChunkBytes;
+    return true;
+}
+
+bool ShadowRecordingWriter::preallocateChunk()
+{
+    QFile *file = new QFile(chunkFilename(currentChunkIndex + 1));
+    if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered) || !file->resize(chunkCapacity))
+    {
+        QMutexLocker locker(&indexMutex);
+        lastError = "Cannot preallocate " + file->fileName() + ": " + file->errorString();
+        delete(file);
+        return false;
+    }
+    nextFile = file;
+    return true;
+}
+
+bool ShadowRecordingWriter::openChunk(quint64 firstSample, qint64 hostTimestamp)
+{
+    if (nextFile == nullptr && !preallocateChunk()) return false;
+
+    currentFile = nextFile;
+    nextFile = nullptr;
+    currentChunkIndex++;
+
+    ShadowChunkHeader header;
+    header.chunkIndex = currentChunkIndex;
+    header.numChannels = channelIDs.size();
+    header.samplingRate = NEUROOMEGA_SAMPLING_RATE;
+    header.firstSample = firstSample;
+    header.hostTimestamp = hostTimestamp;
+    for (int i = 0; i < channelIDs.size(); i++) header.channelIDs[i] = channelIDs[i];
+
+    currentFile->seek(0);
+    if (currentFile->write((const char*)&header, sizeof(ShadowChunkHeader)) != sizeof(ShadowChunkHeader))
+    {
+        QMutexLocker locker(&indexMutex);
+        lastError = "Shadow recording write failed: " + currentFile->errorString();
+        return false;
+    }
+    currentChunkBytes = sizeof(ShadowChunkHeader);
+
+    ShadowChunkInformation chunk;
+    chunk.filename = QFileInfo(currentFile->fileName()).fileName();
+    chunk.firstSample = firstSample;
+    chunk.bytes = currentChunkBytes;
+    chunks.append(chunk);
+    indexChanged = 1;
+    return true;
+}
+
+// Trim the preallocated space that was not used and close the chunk.
+void ShadowRecordingWriter::closeChunk()
+{
+    if (currentFile == nullptr) return;
+    currentFile->resize(currentChunkBytes);
+    currentFile->close();
+    delete(currentFile);
+    currentFile = nullptr;
+}
+
+QString ShadowRecordingWriter::chunkFilename(int chunkIndex) const
+{
+    return outputDirectory + "/" + QString("Chunk%1.shadow").arg(chunkIndex, 5, 10, QChar('0'));
+}
+
+// Index.json lists the chunks and segments. It is rewritten at every chunk rotation and segment change.
+bool ShadowRecordingWriter::saveIndex()
+{
+    QJsonObject indexObject;
+    indexObject["Version"] = 1;
+    indexObject["SamplingRate"] = NEUROOMEGA_SAMPLING_RATE;
+    indexObject["SampleFormat"] = "int16";
+
+    QJsonArray channelArray;
+    for (int i = 0; i < channelIDs.size(); i++) channelArray.append(channelIDs[i]);
+    indexObject["ChannelIDs"] = channelArray;
+
+    QJsonArray chunkArray;
+    for (int i = 0; i < chunks.size(); i++)
+    {
+        chunkArray.append(QJsonObject{{"Filename", chunks[i].filename}, {"FirstSample", (qint64)chunks[i].firstSample},
+                                      {"NumSamples", (qint64)chunks[i].numSamples}, {"Bytes", chunks[i].bytes}});
+    }
+    indexObject["Chunks"] = chunkArray;
+
+    QJsonArray segmentArray;
+    indexMutex.lock();
+    for (int i = 0; i < segments.size(); i++)
+    {
+        segmentArray.append(QJsonObject{{"Name", segments[i].name}, {"StartSample", (qint64)segments[i].startSample},
+                                        {"EndSample", (qint64)segments[i].endSample}, {"StartTime", segments[i].startTime}});
+    }
+    indexMutex.unlock();
+    indexObject["Segments"] = segmentArray;
+
+    bufferMutex.lock();
+    indexObject["DroppedSamples"] = droppedSamples;
+    bufferMutex.unlock();
+
+    QFile file(outputDirectory + "/Index.json");
+    if (!file.open(QFile::WriteOnly | QFile::Text | QFile::Truncate)) return false;
+    file.write(QJsonDocument(indexObject).toJson());
+    file.close();
+    return true;
+}
+
+// Writer throughput and data loss for the session log. Call after stopWriter().
+QJsonObject ShadowRecordingWriter::report()
+{
+    QJsonObject result;
+    result["Directory"] = outputDirectory;
+    result["Chunks"] = chunks.size();
+    result["BytesWritten"] = bytesWritten;
+    result["WriteCalls"] = writeCalls;
+    result["MeanWriteTime"] = writeCalls > 0 ? totalWriteNanoseconds / writeCalls / 1e6 : 0.0;
+    result["MaxWriteTime"] = maxWriteNanoseconds / 1e6;
+    result["MaxRotationTime"] = rotationNanoseconds / 1e6;
+
+    bufferMutex.lock();
+    result["DroppedSamples"] = droppedSamples;
+    result["DroppedBlocks"] = droppedBlocks;
+    bufferMutex.unlock();
+
+    indexMutex.lock();
+    result["Segments"] = segments.size();
+    indexMutex.unlock();
+    return result;
+}
+
+bool ShadowRecordingReader::open(QString directory)
+{
+    recordingDirectory = directory;
+    channelIDs.clear();
+    segmentList.clear();
+    chunks.clear();
+
+    QFile file(directory + "/Index.json");
+    if (!file.open(QFile::ReadOnly | QFile::Text))
+    {
+        lastError = "Cannot open " + file.fileName();
+        return false;
+    }
+    QJsonParseError parseError;
+    QJsonDocument indexDocument = QJsonDocument::fromJson(file.readAll(), &parseError);
+    file.close();
+    if (!indexDocument.isObject())
+    {
+        lastError = "Bad shadow recording index: " + parseError.errorString();
+        return false;
+    }
+
+    QJsonObject indexObject = indexDocument.object();
+    QJsonArray channelArray = indexObject["ChannelIDs"].toArray();
+    for (int i = 0; i < channelArray.size(); i++) channelIDs.append(channelArray[i].toInt());
+
+    QJsonArray chunkArray = indexObject["Chunks"].toArray();
+    for (int i = 0; i < chunkArray.size(); i++)
+    {
+        ShadowChunkInformation chunk;
+        chunk.filename = chunkArray[i].toObject()["Filename"].toString();
+        chunk.firstSample = chunkArray[i].toObject()["FirstSample"].toVariant().toLongLong();
+        chunk.numSamples = chunkArray[i].toObject()["NumSamples"].toVariant().toLongLong();
+        chunk.bytes = chunkArray[i].toObject()["Bytes"].toVariant().toLongLong();
+        chunks.append(chunk);
+    }
+
+    QJsonArray segmentArray = indexObject["Segments"].toArray();
+    for (int i = 0; i < segmentArray.size(); i++)
+    {
+        ShadowSegment segment;
+        segment.name = segmentArray[i].toObject()["Name"].toString();
+        segment.startSample = segmentArray[i].toObject()["StartSample"].toVariant().toLongLong();
+        segment.endSample = segmentArray[i].toObject()["EndSample"].toVariant().toLongLong();
+        segment.startTime = segmentArray[i].toObject()["StartTime"].toString();
+        segmentList.append(segment);
+    }
+    return true;
+}
+
+QVector<int> ShadowRecordingReader::channels() const
+{
+    return channelIDs;
+}
+
+QList<ShadowSegment> ShadowRecordingReader::segments() const
+{
+    return segmentList;
+}
+
+quint64 ShadowRecordingReader::totalSamples() const
+{
+    if (chunks.isEmpty()) return 0;
+    return chunks.last().firstSample + chunks.last().numSamples;
+}
+
+QString ShadowRecordingReader::errorMessage() const
+{
+    return lastError;
+}
+
+// Copy samples [firstSample, firstSample + numSamples) of one channel. Returns the number of samples copied.
+int ShadowRecordingReader::readSamples(int channelID, quint64 firstSample, int numSamples, int16 *pData)
+{
+    int channelIndex = channelIDs.indexOf(channelID);
+    if (channelIndex < 0 || numSamples <= 0) return 0;
+
+    quint64 endSample = firstSample + numSamples;
+    int copied = 0;
+    for (int i = 0; i < chunks.size(); i++)
+    {
+        if (chunks[i].firstSample + chunks[i].numSamples <= firstSample || chunks[i].firstSample >= endSample) continue;
+
+        QFile file(recordingDirectory + "/" + chunks[i].filename);
+        if (!file.open(QFile::ReadOnly))
+        {
+            lastError = "Cannot open " + file.fileName();
+            return copied;
+        }
+
+        // Walk the block headers, skipping padding and blocks outside the requested range.
+        qint64 position = sizeof(ShadowChunkHeader);
+        while (position + (qint64)sizeof(ShadowBlockHeader) <= chunks[i].bytes)
+        {
+            ShadowBlockHeader header;
+            file.seek(position);
+            if (file.read((char*)&header, sizeof(ShadowBlockHeader)) != sizeof(ShadowBlockHeader)) break;
+            if (header.magic == 0)
+            {
+                position = alignedSize(position + 1, SHADOW_ALIGNMENT);
+                continue;
+            }
+
+            qint64 dataSize = (qint64)header.numChannels * header.numSamples * sizeof(int16);
+            quint64 blockEnd = header.firstSample + header.numSamples;
+            if (blockEnd > firstSample && header.firstSample < endSample)
+            {
+                quint64 start = qMax(firstSample, header.firstSample);
+                quint64 stop = qMin(endSample, blockEnd);
+                file.seek(position + sizeof(ShadowBlockHeader) + ((qint64)channelIndex * header.numSamples + (start - header.firstSample)) * sizeof(int16));
+                file.read((char*)(pData + (start - firstSample)), (stop - start) * sizeof(int16));
+                copied += stop - start;
+            }
+            if (header.firstSample >= endSample) break;
+            position += sizeof(ShadowBlockHeader) + alignedSize(dataSize, 8);
+        }
+        file.close();
+    }
+    return copied;
+}
@@ -0,0 +1,190 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#ifndef SHADOWRECORDINGWRITER_H
+#define SHADOWRECORDINGWRITER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QVector>
+#include <QList>
+#include <QString>
+#include <QFile>
+#include <QDir>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "streamdatahandler.h"
+
+// Writes are issued in multiples of this size, and every chunk starts with a header of exactly this size.
+#define SHADOW_ALIGNMENT 4096
+#define SHADOW_MAX_CHANNELS 1000
+
+// First SHADOW_ALIGNMENT bytes of every chunk file. Chunks are self-describing so a single one can be read without the index.
+typedef struct ShadowChunkHeader
+{
+    char magic[8] = {'N', 'O', 'S', 'H', 'A', 'D', 'O', 'W'};
+    quint32 version = 1;
+    quint32 chunkIndex = 0;
+    quint32 numChannels = 0;
+    quint32 samplingRate = 0;
+    quint64 firstSample = 0;
+    qint64 hostTimestamp = 0;
+    qint64 reserved[3] = {0};
+    qint32 channelIDs[SHADOW_MAX_CHANNELS] = {0};
+    char padding[SHADOW_ALIGNMENT - 64 - sizeof(qint32) * SHADOW_MAX_CHANNELS] = {0};
+} ShadowChunkHeader;
+
+// Each stream block is stored as this header followed by numChannels * numSamples int16, channel-major, padded to 8 bytes.
+// A zero magic means padding up to the next SHADOW_ALIGNMENT boundary.
+typedef struct ShadowBlockHeader
+{
+    quint32 magic = 0x4B4C4253;
+    quint32 numSamples = 0;
+    quint64 firstSample = 0;
+    qint64 hostTimestamp = 0;
+    quint32 numChannels = 0;
+    quint32 deviceTimestamp = 0;
+} ShadowBlockHeader;
+
+// Logical recording segment, in absolute stream samples. endSample is 0 while the segment is still open.
+typedef struct ShadowSegment
+{
+    QString name = "";
+    quint64 startSample = 0;
+    quint64 endSample = 0;
+    QString startTime = "";
+} ShadowSegment;
+
+typedef struct ShadowChunkInformation
+{
+    QString filename = "";
+    quint64 firstSample = 0;
+    quint64 numSamples = 0;
+    qint64 bytes = 0;
+} ShadowChunkInformation;
+
+typedef struct ShadowWriteBuffer
+{
+    char *data = nullptr;
+    qint64 size = 0;
+    quint64 firstSample = 0;
+    quint64 lastSample = 0;
+    qint64 hostTimestamp = 0;
+} ShadowWriteBuffer;
+
+// Second capture path next to the NeuroOmega MPX files. The acquisition thread copies every block into aligned write buffers,
+// and this thread writes full buffers into preallocated chunk files, opening the next chunk ahead of time.
+// Recording filename changes become segment markers in Index.json, so the capture never stops between them.
+class ShadowRecordingWriter : public QThread, public StreamConsumer
+{
+    Q_OBJECT
+
+public:
+    explicit ShadowRecordingWriter(QObject *parent = nullptr);
+    ~ShadowRecordingWriter();
+
+    bool configure(QString directory, QVector<int> streamChannels, int chunkDuration = 60, int bufferDuration = 1);
+    void processBlock(const SignalBlock &block) override;
+    void stopWriter();
+
+    void markSegment(QString name);
+    void endSegment();
+
+    QString directory() const;
+    QString errorMessage();
+    QJsonObject report();
+
+signals:
+    void writerError(QString message);
+
+protected:
+    void run() override;
+
+private:
+    bool writeBuffer(ShadowWriteBuffer &buffer);
+    bool openChunk(quint64 firstSample, qint64 hostTimestamp);
+    bool preallocateChunk();
+    void closeChunk();
+    void releaseBuffers();
+    void queueFillBuffer();
+    bool saveIndex();
+    QString chunkFilename(int chunkIndex) const;
+
+    QString outputDirectory;
+    QVector<int> channelIDs;
+    qint64 bufferCapacity = 0;
+    qint64 chunkCapacity = 0;
+    int flushInterval = 1000;
+
+    // Buffers cycle free -> fill (acquisition thread) -> full -> written (writer thread) -> free
+    QMutex bufferMutex;
+    QWaitCondition bufferCondition;
+    QList<ShadowWriteBuffer> freeBuffers;
+    QList<ShadowWriteBuffer> fullBuffers;
+    ShadowWriteBuffer fillBuffer;
+    QList<char*> allocatedBuffers;
+    QElapsedTimer fillAge;
+    qint64 droppedSamples = 0;
+    qint64 droppedBlocks = 0;
+
+    QAtomicInt running;
+    QAtomicInt indexChanged;
+    QAtomicInteger<quint64> latestSample;
+
+    // Chunk files, only touched by the writer thread. nextFile is already preallocated when currentFile fills up.
+    QFile *currentFile = nullptr;
+    QFile *nextFile = nullptr;
+    int currentChunkIndex = -1;
+    qint64 currentChunkBytes = 0;
+    QList<ShadowChunkInformation> chunks;
+
+    qint64 bytesWritten = 0;
+    qint64 writeCalls = 0;
+    qint64 maxWriteNanoseconds = 0;
+    qint64 totalWriteNanoseconds = 0;
+    qint64 rotationNanoseconds = 0;
+
+    QMutex indexMutex;
+    QList<ShadowSegment> segments;
+    QString lastError;
+};
+
+// Reads samples of one channel back from a shadow recording directory, across chunk boundaries.
+class ShadowRecordingReader
+{
+public:
+    bool open(QString directory);
+    QVector<int> channels() const;
+    QList<ShadowSegment> segments() const;
+    quint64 totalSamples() const;
+    int readSamples(int channelID, quint64 firstSample, int numSamples, int16 *pData);
+    QString errorMessage() const;
+
+private:
+    QString recordingDirectory;
+    QVector<int> channelIDs;
+    QList<ShadowSegment> segmentList;
+    QList<ShadowChunkInformation> chunks;
+    QString lastError;
+};
+
+#endif // SHADOWRECORDINGWRITER_H
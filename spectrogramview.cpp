@@ -0,0 +1,273 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "spectrogramview.h"
+
+SpectrogramView::SpectrogramView(QWidget *parent) :
+    QWidget(parent)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setWindowTitle("Live Spectrogram");
+    setMinimumSize(800, 400);
+
+    sourceSelector = new QComboBox(this);
+    sourceSelector->setGeometry(10, 8, 300, 30);
+    connect(sourceSelector, &QComboBox::currentIndexChanged, this, &SpectrogramView::selectSource);
+
+    // Black, blue, red, yellow, white
+    const double stops[5][3] = {{0, 0, 0}, {30, 40, 200}, {220, 30, 40}, {250, 220, 30}, {255, 255, 255}};
+    colorMap.resize(256);
+    for (int i = 0; i < 256; i++)
+    {
+        double position = 4.0 * i / 255;
+        int segment = qMin((int)position, 3);
+        double fraction = position - segment;
+        colorMap[i] = qRgb((int)(stops[segment][0] + fraction * (stops[segment + 1][0] - stops[segment][0])),
+                           (int)(stops[segment][1] + fraction * (stops[segment + 1][1] - stops[segment][1])),
+                           (int)(stops[segment][2] + fraction * (stops[segment + 1][2] - stops[segment][2])));
+    }
+
+    frameTimer.setInterval(33);
+    connect(&frameTimer, &QTimer::timeout, this, &SpectrogramView::pullColumns);
+}
+
+SpectrogramView::~SpectrogramView()
+{
+    detach();
+}
+
+// Sources are the current lead's contacts from the "Downsample" node and every pair of the "Bipolar" montage.
+// Pass nullptr when streaming stops, the sink is removed before the graph goes away.
+void SpectrogramView::setFilterGraph(FilterGraph *filterGraph, QVector<int> contactChannelIDs, QStringList contactLabels)
+{
+    detach();
+    this->filterGraph = filterGraph;
+    sources.clear();
+
+    if (filterGraph != nullptr)
+    {
+        FilterNode *node = filterGraph->node("Downsample");
+        for (int i = 0; node != nullptr && i < contactChannelIDs.size(); i++)
+        {
+            SpectrogramSource source;
+            source.label = i < contactLabels.size() ? contactLabels[i] : QString::number(contactChannelIDs[i]);
+            source.nodeName = "Downsample";
+            source.channelIndex = node->output().channelIDs.indexOf(contactChannelIDs[i]);
+            if (source.channelIndex >= 0) sources.append(source);
+        }
+
+        RereferenceNode *bipolarNode = dynamic_cast<RereferenceNode*>(filterGraph->node("Bipolar"));
+        if (bipolarNode != nullptr)
+        {
+            QStringList labels = bipolarNode->montage().labels();
+            for (int i = 0; i < labels.size(); i++)
+            {
+                SpectrogramSource source;
+                source.label = "Bipolar " + labels[i];
+                source.nodeName = "Bipolar";
+                source.channelIndex = i;
+                sources.append(source);
+            }
+        }
+    }
+
+    QString currentLabel = sourceSelector->currentText();
+    sourceSelector->blockSignals(true);
+    sourceSelector->clear();
+    for (int i = 0; i < sources.size(); i++) sourceSelector->addItem(sources[i].label);
+    int index = sourceSelector->findText(currentLabel);
+    sourceSelector->setCurrentIndex(index >= 0 ? index : 0);
+    sourceSelector->blockSignals(false);
+
+    selectSource(sourceSelector->currentIndex());
+}
+
+void SpectrogramView::setHistory(double seconds)
+{
+    historySeconds = qMax(1.0, seconds);
+    if (sinkID != 0) selectSource(sourceSelector->currentIndex());
+}
+
+// Applies to columns written from now on, the waterfall keeps colors rather than power values.
+void SpectrogramView::setPowerRange(double minimum, double maximum)
+{
+    if (maximum <= minimum) return;
+    minimumPower = minimum;
+    maximumPower = maximum;
+}
+
+// Stage boundary at the newest STFT frame
+void SpectrogramView::addMarker(QString label)
+{
+    if (sinkID == 0) return;
+
+    SpectrogramMarker marker;
+    marker.column = stft.columnCount();
+    marker.label = label;
+    markers.append(marker);
+    update(plotRect());
+}
+
+QJsonObject SpectrogramView::report() const
+{
+    QJsonObject reportObject;
+    reportObject["Source"] = QJsonValue(sourceSelector->currentText());
+    reportObject["Columns"] = QJsonValue((qint64) totalColumns);
+    reportObject["Paint"] = paintTime.toJson();
+    reportObject["Column"] = columnTime.toJson();
+    return reportObject;
+}
+
+void SpectrogramView::selectSource(int index)
+{
+    detach();
+    if (filterGraph == nullptr || index < 0 || index >= sources.size()) return;
+
+    const SpectrogramSource &source = sources[index];
+    FilterNode *node = filterGraph->node(source.nodeName);
+    if (node == nullptr) return;
+
+    double samplingRate = node->output().samplingRate;
+    int hopSize = qMax(1, (int)round(hopDuration * samplingRate));
+    if (!stft.configure(fftSize, hopSize, samplingRate, maxFrequency)) return;
+    resetImage();
+
+    sinkChannel = source.channelIndex;
+    sinkID = filterGraph->addSink(source.nodeName, [this](const SignalBlock &block) {
+        if (sinkChannel < block.numChannels) stft.push(block.channel(sinkChannel), block.numSamples);
+    });
+    if (sinkID != 0) frameTimer.start();
+}
+
+// Write every new STFT frame into its ring column. Low frequencies at the bottom.
+void SpectrogramView::pullColumns()
+{
+    QElapsedTimer columnTimer;
+    columnTimer.start();
+
+    int bins = stft.bins();
+    int width = waterfall.width();
+    double scale = 255 / (maximumPower - minimumPower);
+    int newColumns = 0;
+    while (true)
+    {
+        int count = stft.takeColumns(columnBuffer.data(), columnBuffer.size() / bins);
+        for (int i = 0; i < count; i++)
+        {
+            const float *column = columnBuffer.constData() + i * bins;
+            int x = totalColumns % width;
+            for (int b = 0; b < bins; b++)
+            {
+                int level = qBound(0, (int)((column[b] - minimumPower) * scale), 255);
+                ((QRgb*)waterfall.scanLine(bins - 1 - b))[x] = colorMap[level];
+            }
+            totalColumns++;
+        }
+        newColumns += count;
+        if (count < columnBuffer.size() / bins) break;
+    }
+    if (newColumns == 0) return;
+
+    while (!markers.isEmpty() && markers.first().column + width < totalColumns) markers.removeFirst();
+
+    columnTime.record(columnTimer.nsecsElapsed());
+    update(plotRect());
+}
+
+void SpectrogramView::paintEvent(QPaintEvent *event)
+{
+    QElapsedTimer paintTimer;
+    paintTimer.start();
+
+    QPainter painter(this);
+    painter.fillRect(event->rect(), QColor(30, 30, 30));
+
+    QRect plot = plotRect();
+    if (waterfall.isNull())
+    {
+        painter.setPen(Qt::white);
+        painter.drawText(plot, Qt::AlignCenter, sources.isEmpty() ? "No streamed contacts available" : "Select a contact");
+        return;
+    }
+
+    // Right-aligned: the newest frame is always at the right edge
+    int width = waterfall.width();
+    int bins = waterfall.height();
+    quint64 first = totalColumns > (quint64)width ? totalColumns - width : 0;
+    int count = (int)(totalColumns - first);
+    int start = (int)(first % width);
+    int firstPart = qMin(count, width - start);
+    double scaleX = plot.width() / (double)width;
+    double left = plot.left() + (width - count) * scaleX;
+
+    if (firstPart > 0) painter.drawImage(QRectF(left, plot.top(), firstPart * scaleX, plot.height()), waterfall, QRectF(start, 0, firstPart, bins));
+    if (firstPart < count) painter.drawImage(QRectF(left + firstPart * scaleX, plot.top(), (count - firstPart) * scaleX, plot.height()), waterfall, QRectF(0, 0, count - firstPart, bins));
+
+    // Frequency axis every 20 Hz, time axis every 10 s
+    painter.setPen(QColor(200, 200, 200));
+    double topFrequency = stft.binFrequency(bins - 1);
+    for (int frequency = 0; frequency <= topFrequency; frequency += 20)
+    {
+        int y = plot.bottom() - (int)(frequency / topFrequency * plot.height());
+        painter.drawLine(plot.left() - 4, y, plot.left(), y);
+        painter.drawText(QRect(0, y - 8, plot.left() - 6, 16), Qt::AlignRight | Qt::AlignVCenter, QString::number(frequency));
+    }
+    double columnDuration = stft.columnDuration();
+    for (int seconds = 0; seconds * 1.0 <= width * columnDuration; seconds += 10)
+    {
+        int x = plot.right() - (int)(seconds / columnDuration * scaleX);
+        painter.drawLine(x, plot.bottom(), x, plot.bottom() + 4);
+        painter.drawText(QRect(x - 30, plot.bottom() + 4, 60, 16), Qt::AlignCenter, QString("-%1 s").arg(seconds));
+    }
+
+    painter.setPen(QPen(Qt::white, 1, Qt::DashLine));
+    for (int i = 0; i < markers.size(); i++)
+    {
+        if (markers[i].column < first) continue;
+        double x = left + (markers[i].column - first) * scaleX;
+        painter.drawLine(QLineF(x, plot.top(), x, plot.bottom()));
+        painter.drawText(QRectF(x + 3, plot.top() + 2, 200, 16), Qt::AlignLeft | Qt::AlignVCenter, markers[i].label);
+    }
+
+    paintTime.record(paintTimer.nsecsElapsed());
+}
+
+void SpectrogramView::detach()
+{
+    frameTimer.stop();
+    if (sinkID != 0 && filterGraph != nullptr) filterGraph->removeSink(sinkID);
+    sinkID = 0;
+    sinkChannel = -1;
+}
+
+// Fixed footprint: historySeconds of STFT frames x bins, 4 bytes per pixel.
+void SpectrogramView::resetImage()
+{
+    int columns = qMax(1, (int)ceil(historySeconds / stft.columnDuration()));
+    waterfall = QImage(columns, stft.bins(), QImage::Format_RGB32);
+    waterfall.fill(Qt::black);
+    totalColumns = 0;
+    markers.clear();
+    columnBuffer.resize(32 * stft.bins());
+    stft.reset();
+    update();
+}
+
+QRect SpectrogramView::plotRect() const
+{
+    return rect().adjusted(50, 48, -10, -24);
+}
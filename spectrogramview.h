@@ -0,0 +1,108 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef SPECTROGRAMVIEW_H
+#define SPECTROGRAMVIEW_H
+
+#include <QWidget>
+#include <QComboBox>
+#include <QTimer>
+#include <QImage>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QColor>
+#include <QVector>
+#include <QList>
+#include <QStringList>
+#include <QJsonObject>
+
+#include "streamingstft.h"
+#include "filtergraph.h"
+#include "latencyhistogram.h"
+
+typedef struct SpectrogramSource
+{
+    QString label = "";
+    QString nodeName = "";
+    int channelIndex = -1;
+} SpectrogramSource;
+
+typedef struct SpectrogramMarker
+{
+    quint64 column = 0;
+    QString label = "";
+} SpectrogramMarker;
+
+// Scrolling spectrogram of one contact or bipolar pair. A filter graph sink feeds a StreamingSTFT on the acquisition
+// thread. A 30 Hz timer writes each new column once into a ring-addressed QImage (one pixel column per STFT frame)
+// and painting blits the two halves of the ring, so the cost does not depend on history length and memory is fixed
+// at historyColumns x bins pixels. Stage markers from the stimulation sequence are kept at their column.
+class SpectrogramView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit SpectrogramView(QWidget *parent = nullptr);
+    ~SpectrogramView();
+
+    void setFilterGraph(FilterGraph *filterGraph, QVector<int> contactChannelIDs, QStringList contactLabels);
+    void setHistory(double seconds);
+    void setPowerRange(double minimum, double maximum);
+    void addMarker(QString label);
+    QJsonObject report() const;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private slots:
+    void selectSource(int index);
+    void pullColumns();
+
+private:
+    void detach();
+    void resetImage();
+    QRect plotRect() const;
+
+    FilterGraph *filterGraph = nullptr;
+    QList<SpectrogramSource> sources;
+    int sinkID = 0;
+    int sinkChannel = -1;
+
+    QComboBox *sourceSelector;
+    QTimer frameTimer;
+
+    StreamingSTFT stft;
+    int fftSize = 1024;
+    double hopDuration = 0.05;
+    double maxFrequency = 100;
+    double historySeconds = 60;
+
+    // Ring-addressed waterfall: column (totalColumns % width) holds the newest frame
+    QImage waterfall;
+    quint64 totalColumns = 0;
+    QVector<float> columnBuffer;
+    QVector<QRgb> colorMap;
+    double minimumPower = -20;
+    double maximumPower = 40;
+
+    QList<SpectrogramMarker> markers;
+
+    LatencyHistogram paintTime;
+    LatencyHistogram columnTime;
+};
+
+#endif // SPECTROGRAMVIEW_H
@@ -0,0 +1,172 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "startupwarmup.h"
+#include "sdkinstrumentation.h"
+
+StartupWarmup::StartupWarmup(QObject *parent) :
+    QObject(parent)
+{
+    cancelled = 0;
+}
+
+// File reads and the SDK upload cannot be interrupted, so an outstanding warm-up is allowed to finish.
+StartupWarmup::~StartupWarmup()
+{
+    cancelled = 1;
+    if (warmupThread != nullptr)
+    {
+        warmupThread->wait();
+        delete warmupThread;
+    }
+    releaseResources(resources);
+}
+
+// A cancelled warm-up stays Loading until its thread has finished, so its thread and resources are never freed while in use.
+bool StartupWarmup::start(QString lastNovelStimulation, QString lastStimulationConfiguration, QString waveformDirectory)
+{
+    if (currentState == Loading) return false;
+
+    releaseResources(resources);
+    cancelled = 0;
+    currentState = Loading;
+    elapsedTimer.start();
+
+    if (warmupThread != nullptr) delete warmupThread;
+    warmupThread = QThread::create([this, lastNovelStimulation, lastStimulationConfiguration, waveformDirectory]() {
+        load(lastNovelStimulation, lastStimulationConfiguration, waveformDirectory);
+    });
+    connect(warmupThread, &QThread::finished, this, &StartupWarmup::warmupFinished);
+    warmupThread->start(QThread::LowPriority);
+    return true;
+}
+
+void StartupWarmup::cancel()
+{
+    if (!isRunning()) return;
+    cancelled = 1;
+}
+
+StartupWarmup::State StartupWarmup::state() const
+{
+    if (currentState == Loading && cancelled.loadRelaxed()) return Cancelled;
+    return currentState;
+}
+
+bool StartupWarmup::isRunning() const
+{
+    return state() == Loading;
+}
+
+StartupResources StartupWarmup::takeResources()
+{
+    StartupResources takenResources = resources;
+    resources = StartupResources();
+    return takenResources;
+}
+
+// Runs on the warm-up thread. Only "resources" is written here, and it is not read until the thread has finished.
+void StartupWarmup::load(QString lastNovelStimulation, QString lastStimulationConfiguration, QString waveformDirectory)
+{
+    int total = 2;
+    int completed = 0;
+
+    if (!lastNovelStimulation.isEmpty())
+    {
+        emit progress("Uploading last novel waveform", completed, total);
+        QFile file(lastNovelStimulation);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            resources.errors.append("Cannot open " + lastNovelStimulation);
+        }
+        else if (file.size() % 88000 == 0)
+        {
+            QByteArray waveformData = file.readAll();
+            QString wavename = QFileInfo(lastNovelStimulation).fileName().split(".").first();
+            int result = AO_CALL(LoadWaveToEmbedded)((int16*) waveformData.data(), waveformData.size() / 2, 1, (cChar*) wavename.toStdString().c_str());
+            if (result == eAO_OK) resources.novelWaveform = wavename;
+            else resources.errors.append("Cannot upload " + wavename);
+        }
+    }
+    completed++;
+
+    if (lastStimulationConfiguration.isEmpty() || cancelled.loadAcquire()) return;
+
+    emit progress("Loading last stimulation configuration", completed, total);
+    QFile file(lastStimulationConfiguration);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        resources.errors.append("Cannot open " + lastStimulationConfiguration);
+        return;
+    }
+
+    QJsonDocument loadedDocument = QJsonDocument::fromJson(file.readAll());
+    if (!loadedDocument.isObject() || !loadedDocument.object().contains("StimulationName")) return;
+    completed++;
+
+    // Analog waveforms are kept in memory for the sequencer; one missing file invalidates the whole set.
+    QJsonArray filenameArray = loadedDocument.object()["AnalogWaveforms"].toArray();
+    total += filenameArray.count();
+    for (int i = 0; i < filenameArray.count(); i++)
+    {
+        if (cancelled.loadAcquire()) return;
+        emit progress("Loading analog waveform " + filenameArray[i].toString(), completed, total);
+
+        QString filename = waveformDirectory + "/" + filenameArray[i].toString();
+        QFile waveformFile(filename);
+        if (!waveformFile.open(QIODevice::ReadOnly))
+        {
+            resources.errors.append("Cannot open " + filename);
+            for (int j = 0; j < resources.analogWaveforms.count(); j++) free(resources.analogWaveforms[j]);
+            resources.analogWaveforms.clear();
+            resources.analogWaveformDescriptor.clear();
+            break;
+        }
+
+        QByteArray byteArray = waveformFile.readAll();
+        AnalogWaveformDescriptor overview;
+        overview.filesize = byteArray.size() / 2;
+        overview.wavename = QFileInfo(filename).fileName().split(".").first();
+        resources.analogWaveformDescriptor.append(overview);
+
+        int16_t *stimulationVector = (int16_t*)malloc(byteArray.size());
+        memcpy(stimulationVector, byteArray.data(), byteArray.size());
+        resources.analogWaveforms.append(stimulationVector);
+        completed++;
+    }
+
+    resources.stimulationConfiguration = loadedDocument;
+}
+
+void StartupWarmup::warmupFinished()
+{
+    if (cancelled.loadAcquire())
+    {
+        releaseResources(resources);
+        currentState = Cancelled;
+        return;
+    }
+
+    currentState = Ready;
+    emit ready(elapsedTimer.elapsed());
+}
+
+void StartupWarmup::releaseResources(StartupResources &resources)
+{
+    for (int i = 0; i < resources.analogWaveforms.count(); i++) free(resources.analogWaveforms[i]);
+    resources = StartupResources();
+}
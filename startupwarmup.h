@@ -0,0 +1,88 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef STARTUPWARMUP_H
+#define STARTUPWARMUP_H
+
+#include <QObject>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QString>
+#include <QStringList>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#if defined(QT_DEBUG) || defined(NEUROOMEGA_SIMULATOR)
+#include "AOSystemAPI_TEST.h"
+#else
+#include "AOSystemAPI.h"
+#endif
+#include "AOTypes.h"
+
+#include "novelstimulationconfiguration.h"
+
+// Resources prepared by the warm-up. analogWaveforms are malloc'd and owned by whoever takes them.
+typedef struct StartupResources
+{
+    QString novelWaveform = "";
+    QJsonDocument stimulationConfiguration;
+    QList<AnalogWaveformDescriptor> analogWaveformDescriptor;
+    QList<int16_t*> analogWaveforms;
+    QStringList errors;
+} StartupResources;
+
+// Uploads the last novel waveform and loads the last stimulation protocol with its analog waveforms on a worker
+// thread, so the controller window does not wait on file I/O or LoadWaveToEmbedded. Progress is reported while loading;
+// ready() is emitted on the GUI thread once takeResources() can hand everything over. A cancelled warm-up drops its results
+// once its thread has finished; start() is refused until then.
+class StartupWarmup : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum State { Idle, Loading, Ready, Cancelled };
+
+    explicit StartupWarmup(QObject *parent = nullptr);
+    ~StartupWarmup();
+
+    bool start(QString lastNovelStimulation, QString lastStimulationConfiguration, QString waveformDirectory);
+    void cancel();
+    State state() const;
+    bool isRunning() const;
+    StartupResources takeResources();
+
+signals:
+    void progress(QString message, int completed, int total);
+    void ready(int elapsed);
+
+private:
+    void load(QString lastNovelStimulation, QString lastStimulationConfiguration, QString waveformDirectory);
+    void warmupFinished();
+    static void releaseResources(StartupResources &resources);
+
+    State currentState = Idle;
+    QThread *warmupThread = nullptr;
+    QAtomicInt cancelled;
+    StartupResources resources;
+    QElapsedTimer elapsedTimer;
+};
+
+#endif // STARTUPWARMUP_H
@@ -16,12 +16,18 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 *********************************************************************************/
 
 #include "streamdatahandler.h"
+#include "sdkinstrumentation.h"
 
 CircularBuffer::CircularBuffer()
 {
 
 }
 
+CircularBuffer::~CircularBuffer()
+{
+    if (this->buffer != nullptr) free(this->buffer);
+}
+
 int CircularBuffer::initiateBuffer(int size)
 {
     if (this->maxSize > 0)
@@ -36,39 +42,243 @@ int CircularBuffer::initiateBuffer(int size)
 
 int CircularBuffer::addBuffer(int16 *pData, int size)
 {
-    // I wonder if memcpy is gonna be faster...
-    for (int i = 0; i < size; i++)
+    if (size <= 0 || this->maxSize == 0) return 1;
+
+    QMutexLocker locker(&bufferMutex);
+
+    // Only the most recent maxSize samples can survive the write anyway.
+    if (size > maxSize)
     {
-        buffer[(writerPointer+i) % maxSize] = pData[i];
+        pData += size - maxSize;
+        writerPointer += size - maxSize;
+        totalWritten += size - maxSize;
+        while (writerPointer >= maxSize * 2) writerPointer -= maxSize;
+        size = maxSize;
     }
+
+    // Write in at most two contiguous pieces instead of one modulo per sample.
+    int start = writerPointer % maxSize;
+    int firstPart = qMin(size, maxSize - start);
+    memcpy(buffer + start, pData, sizeof(int16) * firstPart);
+    if (firstPart < size) memcpy(buffer, pData + firstPart, sizeof(int16) * (size - firstPart));
+
     writerPointer += size;
     if (writerPointer >= maxSize * 2) writerPointer -= maxSize;
+    totalWritten += size;
     return 0;
 }
 
 int CircularBuffer::getBuffer(int16 *pData, int size)
 {
+    QMutexLocker locker(&bufferMutex);
+
     // Give Error. If size > maxSize
-    if (size <= 0 || size > writerPointer) return 1;
+    if (size <= 0 || size > writerPointer || size > maxSize) return 1;
 
     if (writerPointer < maxSize)
     {
-        for (int i = 0; i < size; i++)
-        {
-             pData[i] = buffer[i];
-        }
+        memcpy(pData, buffer, sizeof(int16) * size);
     }
     else
     {
-        for (int i = 0; i < size; i++)
+        int start = writerPointer % maxSize;
+        int firstPart = qMin(size, maxSize - start);
+        memcpy(pData, buffer + start, sizeof(int16) * firstPart);
+        if (firstPart < size) memcpy(pData + firstPart, buffer, sizeof(int16) * (size - firstPart));
+    }
+    return 0;
+}
+
+// Copy the most recent "size" samples, oldest first. Used for sliding-window readers.
+int CircularBuffer::getLatest(int16 *pData, int size)
+{
+    QMutexLocker locker(&bufferMutex);
+
+    if (size <= 0 || size > maxSize || size > writerPointer) return 1;
+
+    int start = (writerPointer - size) % maxSize;
+    int firstPart = qMin(size, maxSize - start);
+    memcpy(pData, buffer + start, sizeof(int16) * firstPart);
+    if (firstPart < size) memcpy(pData + firstPart, buffer, sizeof(int16) * (size - firstPart));
+    return 0;
+}
+
+// Copy up to "size" samples written after absolute sample "position", oldest first, and advance "position".
+// Readers that fell more than a ring behind skip ahead to the oldest sample still held. Returns the number copied.
+int CircularBuffer::getSince(quint64 &position, int16 *pData, int size)
+{
+    QMutexLocker locker(&bufferMutex);
+
+    if (maxSize == 0 || size <= 0) return 0;
+
+    quint64 oldest = totalWritten > (quint64)maxSize ? totalWritten - maxSize : 0;
+    if (position < oldest) position = oldest;
+    if (position >= totalWritten) return 0;
+
+    int count = (int)qMin((quint64)size, totalWritten - position);
+    // writerPointer only moves in steps of maxSize apart from writes, so absolute sample n lives at n % maxSize.
+    int start = (int)(position % maxSize);
+    int firstPart = qMin(count, maxSize - start);
+    memcpy(pData, buffer + start, sizeof(int16) * firstPart);
+    if (firstPart < count) memcpy(pData + firstPart, buffer, sizeof(int16) * (count - firstPart));
+
+    position += count;
+    return count;
+}
+
+int CircularBuffer::available()
+{
+    QMutexLocker locker(&bufferMutex);
+    return qMin(writerPointer, maxSize);
+}
+
+StreamDataHandler::StreamDataHandler(QObject *parent) :
+    WorkerThread(parent)
+{
+    sampleCounter = 0;
+}
+
+StreamDataHandler::~StreamDataHandler()
+{
+    stopStreaming();
+    for (int i = 0; i < channelBuffers.size(); i++) delete(channelBuffers[i]);
+    channelBuffers.clear();
+}
+
+// Register the channels with NeuroOmega buffering and allocate one ring per channel holding "ringDuration" seconds.
+bool StreamDataHandler::configureChannels(QVector<int> channelIDs, int ringDuration)
+{
+    if (this->isRunning()) return false;
+
+    for (int i = 0; i < channelBuffers.size(); i++) delete(channelBuffers[i]);
+    channelBuffers.clear();
+    this->channelIDs.clear();
+
+    AO_CALL(ClearBuffers)();
+    for (int i = 0; i < channelIDs.size(); i++)
+    {
+        if (channelIDs[i] <= 0 || this->channelIDs.contains(channelIDs[i])) continue;
+
+        int result = AO_CALL(AddBufferChannel)(channelIDs[i], ringDuration * 1000);
+        if (result != eAO_OK)
         {
-             pData[i] = buffer[(writerPointer+i) % maxSize];
+            emit streamError(QString("Cannot buffer channel %1").arg(channelIDs[i]));
+            continue;
         }
+
+        CircularBuffer *ring = new CircularBuffer();
+        ring->initiateBuffer(ringDuration * NEUROOMEGA_SAMPLING_RATE);
+        channelBuffers.append(ring);
+        this->channelIDs.append(channelIDs[i]);
     }
-    return 0;
+
+    alignedBuffer.resize(blockSamples * this->channelIDs.size());
+    blockBuffer.resize(blockSamples * this->channelIDs.size());
+    sampleCounter = 0;
+    if (this->channelIDs.isEmpty()) return false;
+
+    arm();
+    return true;
+}
+
+void StreamDataHandler::addConsumer(StreamConsumer *consumer)
+{
+    QMutexLocker locker(&consumerMutex);
+    if (!consumers.contains(consumer)) consumers.append(consumer);
+}
+
+void StreamDataHandler::removeConsumer(StreamConsumer *consumer)
+{
+    QMutexLocker locker(&consumerMutex);
+    consumers.removeAll(consumer);
+}
+
+void StreamDataHandler::stopStreaming()
+{
+    disarm();
+}
+
+QVector<int> StreamDataHandler::channels() const
+{
+    return channelIDs;
+}
+
+int StreamDataHandler::channelIndex(int channelID) const
+{
+    return channelIDs.indexOf(channelID);
+}
+
+int StreamDataHandler::getLatestSamples(int channelID, int16 *pData, int size)
+{
+    int index = channelIndex(channelID);
+    if (index < 0) return 1;
+    return channelBuffers[index]->getLatest(pData, size);
 }
 
-StreamDataHandler::StreamDataHandler()
+int StreamDataHandler::getSamplesSince(int channelID, quint64 &position, int16 *pData, int size)
 {
+    int index = channelIndex(channelID);
+    if (index < 0) return 0;
+    return channelBuffers[index]->getSince(position, pData, size);
+}
+
+quint64 StreamDataHandler::totalSamples() const
+{
+    return sampleCounter.loadAcquire();
+}
 
+int StreamDataHandler::maxBlockSamples() const
+{
+    return blockSamples;
+}
+
+// Acquisition loop. NeuroOmega returns aligned data channel-major, so each poll is split into the
+// per-channel rings and converted once to float for the consumers.
+void StreamDataHandler::run()
+{
+    int numChannels = channelIDs.size();
+    if (numChannels == 0) return;
+
+    while (running.loadAcquire())
+    {
+        int dataCapture = 0;
+        uint32 beginTimestamp = 0;
+        int result = AO_CALL(GetAlignedData)(alignedBuffer.data(), alignedBuffer.size(), &dataCapture, channelIDs.data(), numChannels, &beginTimestamp);
+        qint64 receiveTime = monotonicNanoseconds();
+        if (result != eAO_OK || dataCapture <= 0)
+        {
+            msleep(pollInterval);
+            continue;
+        }
+
+        int numSamples = dataCapture / numChannels;
+        for (int i = 0; i < numChannels; i++)
+        {
+            int16 *channelData = alignedBuffer.data() + i * numSamples;
+            channelBuffers[i]->addBuffer(channelData, numSamples);
+
+            float *channelOutput = blockBuffer.data() + i * numSamples;
+            for (int j = 0; j < numSamples; j++) channelOutput[j] = channelData[j];
+        }
+
+        SignalBlock block;
+        block.data = blockBuffer.data();
+        block.numChannels = numChannels;
+        block.numSamples = numSamples;
+        block.stride = numSamples;
+        block.samplingRate = NEUROOMEGA_SAMPLING_RATE;
+        block.firstSample = sampleCounter.loadAcquire();
+        block.hostTimestamp = receiveTime;
+        block.deviceTimestamp = beginTimestamp;
+        block.channelIDs = channelIDs;
+
+        consumerMutex.lock();
+        for (int i = 0; i < consumers.size(); i++) consumers[i]->processBlock(block);
+        consumerMutex.unlock();
+
+        sampleCounter.fetchAndAddRelease(numSamples);
+
+        // A full block means NeuroOmega has more waiting; otherwise yield until the next poll.
+        if (numSamples < blockSamples) msleep(pollInterval);
+    }
 }
@@ -18,29 +18,126 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef STREAMDATAHANDLER_H
 #define STREAMDATAHANDLER_H
 
+#include <QThread>
+#include <QMutex>
+#include <QVector>
+#include <QList>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+#include <cstring>
+#include <chrono>
+
+#include "workerthread.h"
+
+#if defined(QT_DEBUG) || defined(NEUROOMEGA_SIMULATOR)
+#include "AOSystemAPI_TEST.h"
+#else
+#include "AOSystemAPI.h"
+#endif
 #include "AOTypes.h"
 
+// NeuroOmega ECoG HF / LFP channels are sampled at 44 kHz (same clock as GetLatestTimeStamp).
+#define NEUROOMEGA_SAMPLING_RATE 44000
+
+// A block of samples handed from the acquisition thread to stream consumers.
+// Data is channel-major: channel i starts at data + i * stride. deviceTimestamp is the NeuroOmega 44 kHz tick of the first sample. The memory is owned by the producer
+// and is only valid for the duration of the processBlock() call.
+typedef struct SignalBlock
+{
+    const float *data = nullptr;
+    int numChannels = 0;
+    int numSamples = 0;
+    int stride = 0;
+    double samplingRate = 0;
+    quint64 firstSample = 0;
+    qint64 hostTimestamp = 0;
+    quint32 deviceTimestamp = 0;
+    QVector<int> channelIDs;
+
+    const float *channel(int index) const { return data + (qsizetype)index * stride; }
+} SignalBlock;
+
+// Host monotonic clock in nanoseconds. SignalBlock::hostTimestamp is taken with this clock when the data left NeuroOmega,
+// so any thread can measure latency against it.
+inline qint64 monotonicNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Interface for anything that wants to see the live acquisition stream (filter graphs, estimators, writers).
+// processBlock() is called on the acquisition thread, so implementations must not block.
+class StreamConsumer
+{
+public:
+    virtual ~StreamConsumer() {}
+    virtual void processBlock(const SignalBlock &block) = 0;
+};
+
 class CircularBuffer
 {
 public:
     CircularBuffer();
+    ~CircularBuffer();
     int initiateBuffer(int size);
     int addBuffer(int16 *pData, int size);
     int getBuffer(int16 *pData, int size);
+    int getLatest(int16 *pData, int size);
+    int getSince(quint64 &position, int16 *pData, int size);
+    int available();
 
 private:
-    int16 *buffer;
+    int16 *buffer = nullptr;
+    QMutex bufferMutex;
 
     int readerPointer = 0;
     int writerPointer = 0;
     int maxSize = 0;
+    quint64 totalWritten = 0;
 };
 
 
-class StreamDataHandler
+class StreamDataHandler : public WorkerThread
 {
+    Q_OBJECT
+
 public:
-    StreamDataHandler();
+    explicit StreamDataHandler(QObject *parent = nullptr);
+    ~StreamDataHandler();
+
+    bool configureChannels(QVector<int> channelIDs, int ringDuration = 10);
+    void addConsumer(StreamConsumer *consumer);
+    void removeConsumer(StreamConsumer *consumer);
+    void stopStreaming();
+
+    QVector<int> channels() const;
+    int channelIndex(int channelID) const;
+    int getLatestSamples(int channelID, int16 *pData, int size);
+    int getSamplesSince(int channelID, quint64 &position, int16 *pData, int size);
+    quint64 totalSamples() const;
+    int maxBlockSamples() const;
+
+signals:
+    void streamError(QString message);
+
+protected:
+    void run() override;
+
+private:
+    QVector<int> channelIDs;
+    QList<CircularBuffer*> channelBuffers;
+
+    QMutex consumerMutex;
+    QList<StreamConsumer*> consumers;
+
+    QAtomicInteger<quint64> sampleCounter;
+
+    // Largest block handed to consumers per poll, per channel. 100 ms at 44 kHz.
+    int blockSamples = NEUROOMEGA_SAMPLING_RATE / 10;
+    int pollInterval = 10;
+
+    QVector<int16> alignedBuffer;
+    QVector<float> blockBuffer;
 };
 
 #endif // STREAMDATAHANDLER_H
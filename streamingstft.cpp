@@ -0,0 +1,212 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "streamingstft.h"
+
+StreamingSTFT::StreamingSTFT()
+{
+
+}
+
+// fftSize must be a power of two. Only bins up to maxFrequency (0 for Nyquist) are kept.
+bool StreamingSTFT::configure(int fftSize, int hopSize, double samplingRate, double maxFrequency, int queueColumns)
+{
+    if (fftSize < 4 || (fftSize & (fftSize - 1)) != 0 || hopSize <= 0 || samplingRate <= 0 || queueColumns <= 0) return false;
+
+    size = fftSize;
+    hop = hopSize;
+    rate = samplingRate;
+    numBins = fftSize / 2 + 1;
+    if (maxFrequency > 0) numBins = qMin(numBins, (int)(maxFrequency * fftSize / samplingRate) + 1);
+
+    // One-sided power spectral density scaling, so the dB values do not depend on fftSize
+    window.resize(size);
+    double windowEnergy = 0;
+    for (int i = 0; i < size; i++)
+    {
+        window[i] = 0.5 - 0.5 * cos(2 * M_PI * i / size);
+        windowEnergy += window[i] * window[i];
+    }
+    powerScale = 2.0 / (samplingRate * windowEnergy);
+
+    int bits = 0;
+    while ((1 << bits) < size) bits++;
+    bitReverse.resize(size);
+    for (int i = 0; i < size; i++)
+    {
+        int reversed = 0;
+        for (int b = 0; b < bits; b++) if (i & (1 << b)) reversed |= 1 << (bits - 1 - b);
+        bitReverse[i] = reversed;
+    }
+
+    cosine.resize(size / 2);
+    sine.resize(size / 2);
+    for (int i = 0; i < size / 2; i++)
+    {
+        cosine[i] = cos(2 * M_PI * i / size);
+        sine[i] = -sin(2 * M_PI * i / size);
+    }
+
+    real.resize(size);
+    imaginary.resize(size);
+
+    QMutexLocker locker(&queueMutex);
+    queueCapacity = queueColumns;
+    queue.fill(0, queueCapacity * numBins);
+    locker.unlock();
+
+    reset();
+    return true;
+}
+
+void StreamingSTFT::reset()
+{
+    input.fill(0, size);
+    inputPosition = 0;
+    samplesUntilColumn = size;
+
+    QMutexLocker locker(&queueMutex);
+    queueStart = 0;
+    queueSize = 0;
+    columnsComputed = 0;
+}
+
+void StreamingSTFT::push(const float *data, int numSamples)
+{
+    if (size == 0) return;
+
+    while (numSamples > 0)
+    {
+        int count = qMin(numSamples, qMin(samplesUntilColumn, size - inputPosition));
+        memcpy(input.data() + inputPosition, data, sizeof(float) * count);
+        inputPosition = (inputPosition + count) % size;
+        samplesUntilColumn -= count;
+        data += count;
+        numSamples -= count;
+
+        if (samplesUntilColumn == 0)
+        {
+            computeColumn();
+            samplesUntilColumn = hop;
+        }
+    }
+}
+
+// Copy up to maxColumns queued columns (numBins values each, in dB, oldest first). Returns the number copied.
+int StreamingSTFT::takeColumns(float *columns, int maxColumns)
+{
+    QMutexLocker locker(&queueMutex);
+
+    int count = qMin(maxColumns, queueSize);
+    for (int i = 0; i < count; i++)
+    {
+        memcpy(columns + i * numBins, queue.constData() + ((queueStart + i) % queueCapacity) * numBins, sizeof(float) * numBins);
+    }
+    queueStart = (queueStart + count) % queueCapacity;
+    queueSize -= count;
+    return count;
+}
+
+int StreamingSTFT::bins() const
+{
+    return numBins;
+}
+
+int StreamingSTFT::fftSize() const
+{
+    return size;
+}
+
+double StreamingSTFT::samplingRate() const
+{
+    return rate;
+}
+
+double StreamingSTFT::binFrequency(int bin) const
+{
+    if (size == 0) return 0;
+    return bin * rate / size;
+}
+
+double StreamingSTFT::columnDuration() const
+{
+    if (rate == 0) return 0;
+    return hop / rate;
+}
+
+quint64 StreamingSTFT::columnCount() const
+{
+    return columnsComputed.loadAcquire();
+}
+
+// In-place iterative radix-2 FFT with precomputed bit reversal and twiddles (cosine/sine of -2*pi*k/size).
+void StreamingSTFT::fft(float *real, float *imaginary, int size, const int *bitReverse, const float *cosine, const float *sine)
+{
+    for (int i = 0; i < size; i++)
+    {
+        int j = bitReverse[i];
+        if (j > i)
+        {
+            std::swap(real[i], real[j]);
+            std::swap(imaginary[i], imaginary[j]);
+        }
+    }
+
+    for (int length = 2; length <= size; length <<= 1)
+    {
+        int half = length / 2;
+        int step = size / length;
+        for (int start = 0; start < size; start += length)
+        {
+            for (int k = 0; k < half; k++)
+            {
+                float wr = cosine[k * step];
+                float wi = sine[k * step];
+                int even = start + k;
+                int odd = even + half;
+                float tr = real[odd] * wr - imaginary[odd] * wi;
+                float ti = real[odd] * wi + imaginary[odd] * wr;
+                real[odd] = real[even] - tr;
+                imaginary[odd] = imaginary[even] - ti;
+                real[even] += tr;
+                imaginary[even] += ti;
+            }
+        }
+    }
+}
+
+void StreamingSTFT::computeColumn()
+{
+    // Oldest sample of the frame is at inputPosition
+    for (int i = 0; i < size; i++)
+    {
+        real[i] = input[(inputPosition + i) % size] * window[i];
+        imaginary[i] = 0;
+    }
+    fft(real.data(), imaginary.data(), size, bitReverse.constData(), cosine.constData(), sine.constData());
+
+    QMutexLocker locker(&queueMutex);
+    if (queueSize == queueCapacity)
+    {
+        queueStart = (queueStart + 1) % queueCapacity;
+        queueSize--;
+    }
+    float *column = queue.data() + ((queueStart + queueSize) % queueCapacity) * numBins;
+    for (int i = 0; i < numBins; i++) column[i] = 10 * log10((real[i] * real[i] + imaginary[i] * imaginary[i]) * powerScale + 1e-12f);
+    queueSize++;
+    columnsComputed.fetchAndAddRelease(1);
+}
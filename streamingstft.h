@@ -0,0 +1,81 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef STREAMINGSTFT_H
+#define STREAMINGSTFT_H
+
+#include <QVector>
+#include <QMutex>
+#include <QAtomicInteger>
+
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+// Incremental short-time Fourier transform of one channel. push() is called from a filter graph sink on the
+// acquisition thread; every hopSize samples one Hann-windowed FFT frame is turned into a power spectral density in dB
+// and queued. The GUI thread drains the queue with takeColumns(). The queue has a fixed capacity, so a stalled
+// reader drops the oldest columns instead of growing.
+class StreamingSTFT
+{
+public:
+    StreamingSTFT();
+
+    bool configure(int fftSize, int hopSize, double samplingRate, double maxFrequency = 0, int queueColumns = 256);
+    void reset();
+    void push(const float *data, int numSamples);
+    int takeColumns(float *columns, int maxColumns);
+
+    int bins() const;
+    int fftSize() const;
+    double samplingRate() const;
+    double binFrequency(int bin) const;
+    double columnDuration() const;
+    quint64 columnCount() const;
+
+    static void fft(float *real, float *imaginary, int size, const int *bitReverse, const float *cosine, const float *sine);
+
+private:
+    void computeColumn();
+
+    int size = 0;
+    int hop = 0;
+    int numBins = 0;
+    double rate = 0;
+    float powerScale = 1;
+
+    // Input history, newest sample at inputPosition - 1
+    QVector<float> input;
+    int inputPosition = 0;
+    int samplesUntilColumn = 0;
+
+    QVector<float> window;
+    QVector<int> bitReverse;
+    QVector<float> cosine;
+    QVector<float> sine;
+    QVector<float> real;
+    QVector<float> imaginary;
+
+    QMutex queueMutex;
+    QVector<float> queue;
+    int queueCapacity = 0;
+    int queueStart = 0;
+    int queueSize = 0;
+    QAtomicInteger<quint64> columnsComputed;
+};
+
+#endif // STREAMINGSTFT_H
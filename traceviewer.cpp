@@ -0,0 +1,333 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#include "traceviewer.h"
+
+void TracePyramid::configure(int historySamples)
+{
+    levels.resize(TRACE_PYRAMID_LEVELS);
+    int bucketSize = 1;
+    for (int i = 0; i < levels.size(); i++)
+    {
+        bucketSize *= TRACE_PYRAMID_FACTOR;
+        levels[i] = TraceLevel();
+        levels[i].bucketSize = bucketSize;
+        levels[i].capacity = historySamples / bucketSize + 2;
+        levels[i].minimum.resize(levels[i].capacity);
+        levels[i].maximum.resize(levels[i].capacity);
+    }
+    sampleCount = 0;
+}
+
+void TracePyramid::append(const int16 *data, int numSamples)
+{
+    if (levels.isEmpty()) return;
+
+    TraceLevel &base = levels[0];
+    for (int i = 0; i < numSamples; i++)
+    {
+        if (data[i] < base.pendingMinimum) base.pendingMinimum = data[i];
+        if (data[i] > base.pendingMaximum) base.pendingMaximum = data[i];
+        if (++base.pendingCount == TRACE_PYRAMID_FACTOR)
+        {
+            int16 minimum = base.pendingMinimum;
+            int16 maximum = base.pendingMaximum;
+            base.pendingMinimum = 32767;
+            base.pendingMaximum = -32768;
+            base.pendingCount = 0;
+            appendBucket(0, minimum, maximum);
+        }
+    }
+    sampleCount += numSamples;
+}
+
+// A completed bucket is stored at its level and folded into the pending bucket of the level above.
+void TracePyramid::appendBucket(int level, int16 minimum, int16 maximum)
+{
+    TraceLevel &current = levels[level];
+    int slot = current.buckets % current.capacity;
+    current.minimum[slot] = minimum;
+    current.maximum[slot] = maximum;
+    current.buckets++;
+
+    if (level + 1 >= levels.size()) return;
+
+    TraceLevel &parent = levels[level + 1];
+    if (minimum < parent.pendingMinimum) parent.pendingMinimum = minimum;
+    if (maximum > parent.pendingMaximum) parent.pendingMaximum = maximum;
+    if (++parent.pendingCount == TRACE_PYRAMID_FACTOR)
+    {
+        int16 parentMinimum = parent.pendingMinimum;
+        int16 parentMaximum = parent.pendingMaximum;
+        parent.pendingMinimum = 32767;
+        parent.pendingMaximum = -32768;
+        parent.pendingCount = 0;
+        appendBucket(level + 1, parentMinimum, parentMaximum);
+    }
+}
+
+quint64 TracePyramid::totalSamples() const
+{
+    return sampleCount;
+}
+
+// Coarsest level whose buckets still fit inside one pixel, or -1 when raw samples are needed.
+int TracePyramid::levelFor(double samplesPerPixel) const
+{
+    int level = -1;
+    for (int i = 0; i < levels.size(); i++)
+    {
+        if (levels[i].bucketSize <= samplesPerPixel) level = i;
+    }
+    return level;
+}
+
+// Pixels without data, including those before the first sample, are returned with minimum > maximum.
+void TracePyramid::envelope(int level, qint64 firstSample, qint64 lastSample, int pixels, int16 *minimum, int16 *maximum) const
+{
+    const TraceLevel &current = levels[level];
+    qint64 bucketSize = current.bucketSize;
+    qint64 oldestBucket = current.buckets > (quint64)current.capacity ? current.buckets - current.capacity : 0;
+    qint64 newestBucket = current.buckets;
+    qint64 span = lastSample - firstSample;
+
+    for (int p = 0; p < pixels; p++)
+    {
+        qint64 startSample = firstSample + span * p / pixels;
+        qint64 endSample = firstSample + span * (p + 1) / pixels;
+
+        int16 pixelMinimum = 32767;
+        int16 pixelMaximum = -32768;
+        if (endSample > 0)
+        {
+            startSample = qMax(startSample, (qint64)0);
+            qint64 startBucket = qMax(startSample / bucketSize, oldestBucket);
+            qint64 endBucket = qMin(qMax(startSample / bucketSize + 1, (endSample + bucketSize - 1) / bucketSize), newestBucket);
+            for (qint64 k = startBucket; k < endBucket; k++)
+            {
+                int slot = k % current.capacity;
+                if (current.minimum[slot] < pixelMinimum) pixelMinimum = current.minimum[slot];
+                if (current.maximum[slot] > pixelMaximum) pixelMaximum = current.maximum[slot];
+            }
+        }
+        minimum[p] = pixelMinimum;
+        maximum[p] = pixelMaximum;
+    }
+}
+
+TraceViewer::TraceViewer(QWidget *parent) :
+    QWidget(parent)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setWindowTitle("Live Traces");
+    setMinimumSize(800, 600);
+
+    // Catch-up after (re)configuration is spread over frames: at most 250 ms of samples per channel per frame.
+    readBuffer.resize(NEUROOMEGA_SAMPLING_RATE / 4);
+
+    frameTimer.setTimerType(Qt::PreciseTimer);
+    frameTimer.setInterval(16);
+    connect(&frameTimer, &QTimer::timeout, this, &TraceViewer::pullSamples);
+}
+
+void TraceViewer::setStream(StreamDataHandler *streamDataHandler)
+{
+    this->streamDataHandler = streamDataHandler;
+    resetPyramids();
+}
+
+void TraceViewer::setChannels(QVector<int> channelIDs, QStringList labels)
+{
+    this->channelIDs = channelIDs;
+    this->labels = labels;
+    resetPyramids();
+}
+
+void TraceViewer::setTimeWindow(double seconds)
+{
+    timeWindow = qBound(0.01, seconds, maxTimeWindow);
+    update();
+}
+
+void TraceViewer::setAmplitudeRange(double range)
+{
+    amplitudeRange = qBound(1.0, range, 32768.0);
+    update();
+}
+
+QJsonObject TraceViewer::report() const
+{
+    QJsonObject reportObject;
+    reportObject["Channels"] = QJsonValue((int)channelIDs.size());
+    reportObject["TimeWindow"] = QJsonValue(timeWindow);
+    reportObject["Paint"] = paintTime.toJson();
+    reportObject["Pull"] = pullTime.toJson();
+    return reportObject;
+}
+
+// New pyramids start at the oldest sample still in the rings, so the full history appears within a few frames.
+void TraceViewer::resetPyramids()
+{
+    pyramids.clear();
+    readPositions.fill(0, channelIDs.size());
+    for (int i = 0; i < channelIDs.size(); i++)
+    {
+        TracePyramid pyramid;
+        pyramid.configure((int)(maxTimeWindow * NEUROOMEGA_SAMPLING_RATE));
+        pyramids.append(pyramid);
+    }
+
+    if (streamDataHandler != nullptr && channelIDs.size() > 0) frameTimer.start();
+    else frameTimer.stop();
+    update();
+}
+
+void TraceViewer::pullSamples()
+{
+    if (streamDataHandler == nullptr) return;
+
+    QElapsedTimer pullTimer;
+    pullTimer.start();
+    for (int i = 0; i < channelIDs.size(); i++)
+    {
+        int count = streamDataHandler->getSamplesSince(channelIDs[i], readPositions[i], readBuffer.data(), readBuffer.size());
+        if (count > 0) pyramids[i].append(readBuffer.constData(), count);
+    }
+    pullTime.record(pullTimer.nsecsElapsed());
+
+    if (isVisible()) update();
+}
+
+// Zoomed in far enough that the pyramid is coarser than a pixel: envelope the newest raw samples from the ring.
+int TraceViewer::rawEnvelope(int channelID, int windowSamples, int pixels)
+{
+    if (rawWindow.size() < windowSamples) rawWindow.resize(windowSamples);
+    if (streamDataHandler->getLatestSamples(channelID, rawWindow.data(), windowSamples) != 0) return 0;
+
+    for (int p = 0; p < pixels; p++)
+    {
+        int startSample = (qint64)windowSamples * p / pixels;
+        int endSample = qMax(startSample + 1, (int)((qint64)windowSamples * (p + 1) / pixels));
+
+        int16 pixelMinimum = 32767;
+        int16 pixelMaximum = -32768;
+        for (int k = startSample; k < endSample && k < windowSamples; k++)
+        {
+            if (rawWindow[k] < pixelMinimum) pixelMinimum = rawWindow[k];
+            if (rawWindow[k] > pixelMaximum) pixelMaximum = rawWindow[k];
+        }
+        envelopeMinimum[p] = pixelMinimum;
+        envelopeMaximum[p] = pixelMaximum;
+    }
+    return pixels;
+}
+
+void TraceViewer::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+
+    QElapsedTimer paintTimer;
+    paintTimer.start();
+
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::white);
+
+    int labelWidth = 120;
+    int plotWidth = width() - labelWidth;
+    if (channelIDs.size() == 0 || plotWidth <= 0 || streamDataHandler == nullptr)
+    {
+        painter.setPen(Qt::darkGray);
+        painter.drawText(rect(), Qt::AlignCenter, "No channels streaming");
+        return;
+    }
+
+    if (envelopeMinimum.size() < plotWidth)
+    {
+        envelopeMinimum.resize(plotWidth);
+        envelopeMaximum.resize(plotWidth);
+    }
+
+    double laneHeight = (double)height() / channelIDs.size();
+    double scale = (laneHeight / 2) / amplitudeRange;
+    int windowSamples = timeWindow * NEUROOMEGA_SAMPLING_RATE;
+    double samplesPerPixel = (double)windowSamples / plotWidth;
+
+    for (int i = 0; i < channelIDs.size(); i++)
+    {
+        double laneTop = i * laneHeight;
+        double laneCenter = laneTop + laneHeight / 2;
+
+        painter.setPen(Qt::lightGray);
+        painter.drawLine(QLineF(0, laneTop + laneHeight, width(), laneTop + laneHeight));
+        painter.setPen(Qt::black);
+        painter.drawText(QRectF(4, laneTop, labelWidth - 8, laneHeight), Qt::AlignLeft | Qt::AlignVCenter, i < labels.size() ? labels[i] : QString::number(channelIDs[i]));
+
+        int level = pyramids[i].levelFor(samplesPerPixel);
+        int pixels = plotWidth;
+        if (level >= 0)
+        {
+            qint64 lastSample = pyramids[i].totalSamples();
+            pyramids[i].envelope(level, lastSample - windowSamples, lastSample, pixels, envelopeMinimum.data(), envelopeMaximum.data());
+        }
+        else
+        {
+            pixels = rawEnvelope(channelIDs[i], windowSamples, plotWidth);
+        }
+
+        // One vertical segment per pixel, stretched to touch the previous pixel so the trace stays continuous.
+        segments.clear();
+        double previousTop = 0;
+        double previousBottom = 0;
+        bool previousValid = false;
+        for (int p = 0; p < pixels; p++)
+        {
+            if (envelopeMinimum[p] > envelopeMaximum[p])
+            {
+                previousValid = false;
+                continue;
+            }
+
+            double top = qBound(laneTop, laneCenter - envelopeMaximum[p] * scale, laneTop + laneHeight);
+            double bottom = qBound(laneTop, laneCenter - envelopeMinimum[p] * scale, laneTop + laneHeight);
+            if (previousValid)
+            {
+                top = qMin(top, previousBottom);
+                bottom = qMax(bottom, previousTop);
+            }
+            segments.append(QLineF(labelWidth + p, top, labelWidth + p, qMax(bottom, top + 1)));
+
+            previousTop = top;
+            previousBottom = bottom;
+            previousValid = true;
+        }
+
+        painter.setPen(QColor(20, 60, 160));
+        painter.drawLines(segments.constData(), segments.size());
+    }
+
+    painter.setPen(Qt::darkGray);
+    painter.drawText(QRectF(labelWidth, height() - 20, plotWidth - 4, 20), Qt::AlignRight | Qt::AlignVCenter, QString::number(timeWindow, 'g', 3) + " s / " + QString::number(amplitudeRange, 'g', 4) + " units");
+
+    paintTime.record(paintTimer.nsecsElapsed());
+}
+
+void TraceViewer::wheelEvent(QWheelEvent *event)
+{
+    double factor = event->angleDelta().y() > 0 ? 1 / 1.25 : 1.25;
+    if (event->modifiers() & Qt::ControlModifier) setAmplitudeRange(amplitudeRange * factor);
+    else setTimeWindow(timeWindow * factor);
+}
@@ -0,0 +1,123 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+
+#ifndef TRACEVIEWER_H
+#define TRACEVIEWER_H
+
+#include <QWidget>
+#include <QTimer>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QWheelEvent>
+#include <QLineF>
+#include <QVector>
+#include <QList>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QJsonObject>
+
+#include "streamdatahandler.h"
+#include "latencyhistogram.h"
+
+// Each pyramid level keeps min/max buckets TRACE_PYRAMID_FACTOR times coarser than the one below:
+// 8, 64, 512 and 4096 samples per bucket.
+#define TRACE_PYRAMID_FACTOR 8
+#define TRACE_PYRAMID_LEVELS 4
+
+typedef struct TraceLevel
+{
+    int bucketSize = 0;
+    int capacity = 0;
+    QVector<int16> minimum;
+    QVector<int16> maximum;
+    quint64 buckets = 0;
+
+    int16 pendingMinimum = 32767;
+    int16 pendingMaximum = -32768;
+    int pendingCount = 0;
+} TraceLevel;
+
+// Multi-resolution min/max summary of one channel, built incrementally as samples arrive. Each level is a ring
+// covering the same history, so the envelope of any window inside the history costs at most
+// TRACE_PYRAMID_FACTOR bucket reads per pixel regardless of zoom.
+class TracePyramid
+{
+public:
+    void configure(int historySamples);
+    void append(const int16 *data, int numSamples);
+    quint64 totalSamples() const;
+
+    int levelFor(double samplesPerPixel) const;
+    void envelope(int level, qint64 firstSample, qint64 lastSample, int pixels, int16 *minimum, int16 *maximum) const;
+
+private:
+    void appendBucket(int level, int16 minimum, int16 maximum);
+
+    QVector<TraceLevel> levels;
+    quint64 sampleCount = 0;
+};
+
+// Live view of up to 64 streamed channels, one lane per channel. A 60 Hz timer pulls new samples from the
+// acquisition rings on the GUI thread (the acquisition thread only pays for the ring lock) and feeds one pyramid
+// per channel. Painting draws a per-pixel min/max envelope with QPainter::drawLines from reused line buffers:
+// the pyramid when zoomed out, raw ring samples when a pixel covers fewer than TRACE_PYRAMID_FACTOR samples.
+// Mouse wheel zooms time; with Ctrl it scales amplitude.
+class TraceViewer : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit TraceViewer(QWidget *parent = nullptr);
+
+    void setStream(StreamDataHandler *streamDataHandler);
+    void setChannels(QVector<int> channelIDs, QStringList labels);
+    void setTimeWindow(double seconds);
+    void setAmplitudeRange(double range);
+    QJsonObject report() const;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+
+private:
+    void pullSamples();
+    void resetPyramids();
+    int rawEnvelope(int channelID, int windowSamples, int pixels);
+
+    StreamDataHandler *streamDataHandler = nullptr;
+    QVector<int> channelIDs;
+    QStringList labels;
+    QList<TracePyramid> pyramids;
+    QVector<quint64> readPositions;
+
+    QTimer frameTimer;
+    double timeWindow = 2.0;
+    double maxTimeWindow = 10.0;
+    double amplitudeRange = 500;
+
+    // Reused every frame
+    QVector<int16> readBuffer;
+    QVector<int16> rawWindow;
+    QVector<int16> envelopeMinimum;
+    QVector<int16> envelopeMaximum;
+    QVector<QLineF> segments;
+
+    LatencyHistogram paintTime;
+    LatencyHistogram pullTime;
+};
+
+#endif // TRACEVIEWER_H
@@ -0,0 +1,46 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#include "workerthread.h"
+
+WorkerThread::WorkerThread(QObject *parent) :
+    QThread(parent)
+{
+    running = 0;
+}
+
+bool WorkerThread::isArmed() const
+{
+    return running.loadAcquire() != 0;
+}
+
+void WorkerThread::arm()
+{
+    running = 1;
+}
+
+// Clear the flag, wake a loop sleeping on "condition" and join the thread.
+void WorkerThread::disarm(QMutex *mutex, QWaitCondition *condition)
+{
+    running = 0;
+    if (mutex != nullptr && condition != nullptr)
+    {
+        mutex->lock();
+        condition->wakeAll();
+        mutex->unlock();
+    }
+    if (this->isRunning()) this->wait();
+}
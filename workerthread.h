@@ -0,0 +1,41 @@
+/*******************************************************************************
+Copyright (c) 2021, Jackson Cagle, University of Floria
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*********************************************************************************/
+#ifndef WORKERTHREAD_H
+#define WORKERTHREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+
+// Base of the background workers whose run() loops on "running". The flag is armed by configure(), before start(),
+// and only cleared by disarm(), so a stop requested before the thread is scheduled is never overwritten.
+class WorkerThread : public QThread
+{
+public:
+    explicit WorkerThread(QObject *parent = nullptr);
+
+    bool isArmed() const;
+
+protected:
+    void arm();
+    void disarm(QMutex *mutex = nullptr, QWaitCondition *condition = nullptr);
+
+    QAtomicInt running;
+};
+
+#endif // WORKERTHREAD_H